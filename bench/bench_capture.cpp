@@ -0,0 +1,151 @@
+#include "dispctrl/capture.hpp"
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/framebuffer.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::size_t kHeads = 16;
+constexpr std::uint32_t kFirstPlane = 50;
+constexpr std::uint64_t kInterval = 200'000'000; // 5 fps per head
+constexpr CaptureFormat kFormat{1920, 1080, fourcc::XRGB8888, modifier::Linear};
+
+// memfds stand in for DMA-BUFs: VirtualKms imports any fd, and the pages
+// are never touched.
+class MemfdAllocator final : public CaptureAllocator {
+public:
+    std::error_code allocate(const CaptureFormat& format, UniqueFd& fd, DmaBufDesc& desc) override
+    {
+        std::size_t size = 0;
+        if (std::error_code ec = linear_capture_layout(format, desc, size))
+            return ec;
+        UniqueFd memfd(::memfd_create("capture", MFD_CLOEXEC));
+        if (!memfd || ::ftruncate(memfd.get(), static_cast<off_t>(size)) != 0)
+            return {errno, std::system_category()};
+        for (std::uint32_t i = 0; i < desc.plane_count; ++i)
+            desc.planes[i].fd = memfd.get();
+        fd = std::move(memfd);
+        return {};
+    }
+};
+
+// One simulated second of 16 1080p60 heads, each captured at 5 fps with
+// the captures spread over the interval. Arg 0 reads every capture back
+// synchronously: the head's loop waits a refresh for the frame to be
+// scanned out and copies it on the CPU for the encoder. Arg 1 adds a
+// writeback job to the head's commit and hands the pool buffer with its
+// fence to a stand-in encoder that releases it once the fence signals.
+// The iteration time is the CPU time of driving all heads for a second.
+void BM_CaptureHeads(benchmark::State& state)
+{
+    const bool writeback = state.range(0) != 0;
+    VirtualKms kms(kHeads, VirtualHead{});
+    FramebufferImporter importer(kms);
+    MemfdAllocator allocator;
+    std::uint32_t fb_prop = 0, crtc_prop = 0;
+    kms.find_property(kFirstPlane, ObjectType::Plane, "FB_ID", fb_prop);
+    kms.find_property(kFirstPlane, ObjectType::Plane, "CRTC_ID", crtc_prop);
+
+    std::deque<CaptureFrame> encoding;
+    std::uint64_t encoded = 0;
+    std::vector<std::unique_ptr<CommitQueue>> queues;
+    std::vector<std::unique_ptr<CapturePool>> pools;
+    std::vector<std::unique_ptr<WritebackCapture>> captures;
+    std::vector<CaptureTimer> timers; // arg 0
+    for (std::size_t h = 0; h < kHeads; ++h) {
+        const CaptureSchedule schedule{kInterval, kInterval / kHeads * h};
+        queues.push_back(std::make_unique<CommitQueue>(kms, kms.crtc_id(h)));
+        queues[h]->set(kFirstPlane + static_cast<std::uint32_t>(h), crtc_prop, kms.crtc_id(h));
+        timers.emplace_back(schedule);
+        WritebackConnector wb;
+        find_writeback_connector(kms, kms.writeback_connector_id(h), wb);
+        pools.push_back(std::make_unique<CapturePool>(allocator, &importer, kFormat));
+        captures.push_back(std::make_unique<WritebackCapture>(
+            *queues[h], wb, *pools[h], [&](CaptureFrame frame) { encoding.push_back(std::move(frame)); },
+            schedule));
+        // The writeback connector joins the head with its mode set.
+        captures[h]->bind();
+        queues[h]->allow_modeset();
+    }
+
+    // What the synchronous path reads back and copies each capture.
+    std::vector<std::uint8_t> scanout(std::size_t{kFormat.width} * kFormat.height * 4, 0x40);
+    std::vector<std::uint8_t> readback(scanout.size());
+    std::array<std::uint32_t, kHeads> stalled{};
+    std::uint64_t frames = 0, stalls = 0, copied = 0, fb = 0;
+
+    const std::uint64_t period = 1'000'000'000'000ULL / VirtualHead{}.refresh_mhz;
+    for (auto _ : state) {
+        for (int vblank = 0; vblank < 60; ++vblank) {
+            const std::uint64_t now = kms.now();
+            for (std::size_t h = 0; h < kHeads; ++h) {
+                if (stalled[h]) {
+                    --stalled[h];
+                    ++stalls;
+                    continue;
+                }
+                CommitQueue& queue = *queues[h];
+                queue.set(kFirstPlane + static_cast<std::uint32_t>(h), fb_prop, 1000 + ++fb % 3);
+                if (!writeback) {
+                    if (timers[h].take(now)) {
+                        std::memcpy(readback.data(), scanout.data(), scanout.size());
+                        benchmark::DoNotOptimize(readback.data());
+                        copied += readback.size();
+                        stalled[h] = 1;
+                    }
+                } else {
+                    captures[h]->poll(now);
+                }
+                if (std::error_code ec = queue.flush()) {
+                    state.SkipWithError(ec.message().c_str());
+                    return;
+                }
+                ++frames;
+            }
+            kms.advance(period);
+            std::array<KmsEvent, kMaxEventsPerRead> events;
+            std::size_t count = 0;
+            while (!read_kms_events(kms.event_fd(), events, count) && count)
+                for (std::size_t i = 0; i < count; ++i)
+                    queues[events[i].crtc_id - VirtualKms::kFirstCrtc]->on_flip_complete(events[i]);
+            // The encoder reads each buffer once it is written, then
+            // returns it.
+            while (!encoding.empty()) {
+                FenceStatus status;
+                if (kms.fence_status(encoding.front().fence.get(), status) || !status.signaled())
+                    break;
+                encoding.pop_front();
+                ++encoded;
+            }
+        }
+    }
+
+    std::uint64_t skipped = 0;
+    for (const auto& c : captures)
+        skipped += c->stats().skipped;
+    const auto per_second = [&](double v) { return benchmark::Counter(v, benchmark::Counter::kAvgIterations); };
+    state.counters["captures_per_s"] =
+        per_second(static_cast<double>(writeback ? encoded : copied / readback.size()));
+    state.counters["copy_MB_per_s"] = per_second(static_cast<double>(copied) / 1e6);
+    state.counters["stalled_frames_per_s"] = per_second(static_cast<double>(stalls));
+    state.counters["frames_per_s"] = per_second(static_cast<double>(frames));
+    state.counters["skipped_per_s"] = per_second(static_cast<double>(skipped));
+}
+BENCHMARK(BM_CaptureHeads)->Arg(0)->Arg(1)->ArgName("writeback")->Unit(benchmark::kMillisecond);
+
+} // namespace
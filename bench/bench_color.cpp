@@ -0,0 +1,63 @@
+#include "dispctrl/color.hpp"
+#include "dispctrl/color_pipeline.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+const ColorProfile& content_profile()
+{
+    static const ColorProfile p = srgb_profile();
+    return p;
+}
+
+const ColorProfile& display_profile()
+{
+    static const ColorProfile p = make_color_profile(kDisplayP3Primaries, ToneCurve::gamma(2.2));
+    return p;
+}
+
+// Software fallback: one 1080p frame through the 3D LUT.
+void BM_Lut3dApply(benchmark::State& state)
+{
+    const Lut3d lut = build_lut3d(content_profile(), display_profile(), static_cast<std::uint32_t>(state.range(0)));
+    std::vector<std::uint32_t> frame(1920 * 1080);
+    std::mt19937 rng(7);
+    for (std::uint32_t& p : frame)
+        p = rng() | 0xff000000;
+    std::vector<std::uint32_t> work(frame.size());
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        work = frame;
+        state.ResumeTiming();
+        apply_lut3d(lut, work.data(), static_cast<std::uint32_t>(work.size()));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(frame.size()));
+}
+BENCHMARK(BM_Lut3dApply)->Arg(17)->Arg(33)->Unit(benchmark::kMillisecond);
+
+// A profile change: building the transform versus finding it cached.
+void BM_ColorTransform(benchmark::State& state)
+{
+    const bool cached = state.range(0) != 0;
+    const CrtcColorCaps caps{0, 1024, false}; // gamma-only CRTC: software 3D LUT
+    ColorTransformCache cache;
+    for (auto _ : state) {
+        if (!cached) {
+            benchmark::DoNotOptimize(build_color_transform(content_profile(), display_profile(), caps));
+        } else {
+            benchmark::DoNotOptimize(cache.lookup(content_profile(), display_profile(), caps));
+        }
+    }
+}
+BENCHMARK(BM_ColorTransform)->ArgName("cached")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,155 @@
+#include "dispctrl/alloc_counter.hpp"
+#include "dispctrl/atomic_request.hpp"
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/kms_shadow.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+
+namespace {
+
+using namespace dispctrl;
+constexpr std::uint32_t kCrtc = VirtualKms::kFirstCrtc;
+constexpr std::uint32_t kFirstPlane = 50;
+constexpr std::uint32_t kPropsPerPlane = 12; // FB_ID, CRTC_ID, SRC_*, CRTC_*, alpha, rotation, zpos, damage
+
+// One frame's writes: every plane gets its full property set, and a third
+// of the planes are touched twice, as happens when a compositor moves a
+// layer after already positioning it.
+void record_frame(CommitQueue& queue, std::uint32_t planes, std::uint64_t frame)
+{
+    queue.set(kCrtc, 1, 1);
+    for (std::uint32_t p = 0; p < planes; ++p) {
+        for (std::uint32_t prop = 0; prop < kPropsPerPlane; ++prop)
+            queue.set(kFirstPlane + p, 100 + prop, frame + prop);
+        if (p % 3 == 0)
+            queue.set(kFirstPlane + p, 100 + 5, frame + 1);
+    }
+}
+
+void complete(VirtualKms& kms, CommitQueue& queue)
+{
+    kms.complete_flips();
+    std::array<KmsEvent, kMaxEventsPerRead> events;
+    std::size_t count = 0;
+    if (read_kms_events(kms.event_fd(), events, count))
+        return;
+    for (std::size_t i = 0; i < count; ++i)
+        queue.on_flip_complete(events[i]);
+}
+
+// Full frame loop: record, coalesce, submit, complete.
+void BM_CommitFrame(benchmark::State& state)
+{
+    const auto planes = static_cast<std::uint32_t>(state.range(0));
+    VirtualKms kms(1, VirtualHead{});
+    CommitQueue queue(kms, kCrtc);
+
+    std::uint64_t frame = 0;
+    for (int i = 0; i < 8; ++i) { // warm up the arena
+        record_frame(queue, planes, ++frame);
+        queue.flush();
+        complete(kms, queue);
+    }
+
+    std::uint64_t allocations = 0;
+    for (auto _ : state) {
+        HeapAllocationScope scope;
+        record_frame(queue, planes, ++frame);
+        if (std::error_code ec = queue.flush()) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        complete(kms, queue);
+        allocations += scope.count();
+    }
+
+    state.SetItemsProcessed(state.iterations() * (1 + planes * kPropsPerPlane));
+    state.counters["superseded_per_frame"] =
+        benchmark::Counter(static_cast<double>(queue.stats().superseded), benchmark::Counter::kAvgIterations);
+    if (heap_allocation_tracking())
+        state.counters["allocs_per_frame"] =
+            benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_CommitFrame)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+// A steady frame as a compositor writes it: every plane's full property
+// set again, of which only FB_ID changed. Arg 1 diffs against a KmsShadow
+// so only the FB_IDs reach the ioctl.
+void BM_CommitFrameShadow(benchmark::State& state)
+{
+    const auto planes = static_cast<std::uint32_t>(state.range(0));
+    VirtualKms kms(1, VirtualHead{});
+    CommitQueue queue(kms, kCrtc);
+    KmsShadow shadow;
+    if (state.range(1))
+        queue.set_shadow(&shadow);
+    std::uint32_t fb_prop = 0, crtc_prop = 0;
+    kms.find_property(kFirstPlane, ObjectType::Plane, "FB_ID", fb_prop);
+    kms.find_property(kFirstPlane, ObjectType::Plane, "CRTC_ID", crtc_prop);
+
+    std::uint64_t frame = 0;
+    const auto record = [&] {
+        ++frame;
+        for (std::uint32_t p = 0; p < planes; ++p) {
+            queue.set(kFirstPlane + p, fb_prop, 1000 + frame % 2);
+            queue.set(kFirstPlane + p, crtc_prop, kCrtc);
+            for (std::uint32_t prop = 2; prop < kPropsPerPlane; ++prop)
+                queue.set(kFirstPlane + p, 200 + prop, prop * 64);
+        }
+    };
+    for (int i = 0; i < 8; ++i) {
+        record();
+        queue.flush();
+        complete(kms, queue);
+    }
+
+    std::uint64_t allocations = 0;
+    const std::uint64_t commits = queue.stats().commits;
+    for (auto _ : state) {
+        HeapAllocationScope scope;
+        record();
+        if (std::error_code ec = queue.flush()) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        complete(kms, queue);
+        allocations += scope.count();
+    }
+
+    state.SetItemsProcessed(state.iterations() * planes * kPropsPerPlane);
+    state.counters["unchanged_per_frame"] =
+        benchmark::Counter(static_cast<double>(shadow.stats().unchanged), benchmark::Counter::kAvgIterations);
+    state.counters["commits_per_frame"] = benchmark::Counter(
+        static_cast<double>(queue.stats().commits - commits), benchmark::Counter::kAvgIterations);
+    if (heap_allocation_tracking())
+        state.counters["allocs_per_frame"] =
+            benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_CommitFrameShadow)->ArgsProduct({{4, 16, 64}, {0, 1}})->ArgNames({"planes", "shadow"});
+
+// Request building and finalize() alone, without the queue.
+void BM_AtomicFinalize(benchmark::State& state)
+{
+    const auto planes = static_cast<std::uint32_t>(state.range(0));
+    AtomicRequest request;
+    std::uint64_t frame = 0;
+    for (auto _ : state) {
+        request.clear();
+        ++frame;
+        // Reverse order so the sort has real work to do.
+        for (std::uint32_t p = planes; p-- > 0;)
+            for (std::uint32_t prop = kPropsPerPlane; prop-- > 0;)
+                request.set(kFirstPlane + p, 100 + prop, frame);
+        benchmark::DoNotOptimize(request.finalize());
+        benchmark::DoNotOptimize(request.values().data());
+    }
+    state.SetItemsProcessed(state.iterations() * planes * kPropsPerPlane);
+}
+BENCHMARK(BM_AtomicFinalize)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+} // namespace
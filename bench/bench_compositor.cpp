@@ -0,0 +1,152 @@
+#include "dispctrl/compositor.hpp"
+#include "dispctrl/format.hpp"
+#include "dispctrl/thread_pool.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::uint32_t kWidth = 3840;
+constexpr std::uint32_t kHeight = 2160;
+
+/// Wallpaper, a scaled video, three translucent windows and a cursor on
+/// a 4K output, with random premultiplied contents.
+struct Scene {
+    Scene()
+    {
+        add(fourcc::XRGB8888, 3840, 2160, Rect::from_size(0, 0, 3840, 2160));
+        add(fourcc::XRGB8888, 1920, 1080, Rect::from_size(200, 200, 2560, 1440));
+        add(fourcc::ARGB8888, 1200, 900, Rect::from_size(400, 300, 1200, 900));
+        add(fourcc::ARGB8888, 800, 600, Rect::from_size(2900, 100, 800, 600));
+        add(fourcc::ARGB8888, 600, 400, Rect::from_size(2900, 1600, 600, 400));
+        add(fourcc::ARGB8888, 64, 64, Rect::from_size(1000, 900, 64, 64));
+    }
+
+    void add(std::uint32_t format, std::uint32_t w, std::uint32_t h, Rect dst)
+    {
+        std::mt19937 rng(static_cast<unsigned>(layers.size()));
+        std::vector<std::uint32_t>& px = pixels.emplace_back(std::size_t{w} * h);
+        for (std::uint32_t& p : px) {
+            const std::uint32_t a = rng() % 4 == 0 ? 255 : rng() % 256;
+            p = a << 24 | (rng() % (a + 1)) << 16 | (rng() % (a + 1)) << 8 | (rng() % (a + 1));
+        }
+        const Surface s{reinterpret_cast<const std::uint8_t*>(px.data()), w * 4, w, h, format};
+        layers.push_back({s, Rect::from_size(0, 0, static_cast<std::int32_t>(w), static_cast<std::int32_t>(h)), dst});
+    }
+
+    std::vector<std::vector<std::uint32_t>> pixels;
+    std::vector<CompositeLayer> layers;
+};
+
+const Scene& scene()
+{
+    static const Scene s;
+    return s;
+}
+
+// Args: threads, damage (0 = full frame, 1 = one 600x400 window).
+void BM_Compose(benchmark::State& state, ConvertIsa isa)
+{
+    const Scene& s = scene();
+    ThreadPool pool(static_cast<unsigned>(state.range(0)));
+    TileCompositor compositor(pool);
+    std::vector<std::uint32_t> out(std::size_t{kWidth} * kHeight);
+    OutputBuffer buffer{reinterpret_cast<std::uint8_t*>(out.data()), kWidth * 4, kWidth, kHeight};
+    const Rect full = Rect::from_size(0, 0, kWidth, kHeight);
+    const Rect damage = state.range(1) ? Rect::from_size(2900, 1600, 600, 400) : full;
+
+    // Same policy as the conversion kernels: refuse to time a SIMD blend
+    // that disagrees with the scalar one.
+    if (isa != ConvertIsa::Scalar) {
+        std::vector<std::uint32_t> ref(out.size());
+        OutputBuffer ref_buffer{reinterpret_cast<std::uint8_t*>(ref.data()), kWidth * 4, kWidth, kHeight};
+        compositor.set_isa(ConvertIsa::Scalar);
+        compositor.compose(s.layers, {&full, 1}, ref_buffer);
+        compositor.set_isa(isa);
+        compositor.compose(s.layers, {&full, 1}, buffer);
+        if (std::memcmp(ref.data(), out.data(), ref.size() * sizeof(ref[0])) != 0) {
+            state.SkipWithError("output differs from the scalar reference");
+            return;
+        }
+    } else {
+        compositor.set_isa(isa);
+    }
+
+    for (auto _ : state) {
+        if (std::error_code ec = compositor.compose(s.layers, {&damage, 1}, buffer)) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * damage.width() * damage.height());
+    state.counters["steals"] = static_cast<double>(pool.stats().steals);
+}
+
+// One translucent 1080p window over an opaque one, on one thread. Args:
+// rotation (quarter turns), blend (0 = premultiplied, 1 = coverage), source
+// format (0 = ARGB8888, 1 = ABGR8888). Bytes are those read and written.
+void BM_ComposeTransformed(benchmark::State& state)
+{
+    constexpr std::uint32_t w = 1920, h = 1080;
+    const auto rotation = static_cast<Rotation>(state.range(0));
+    const bool quarter = swaps_axes(rotation);
+    const std::uint32_t sw = quarter ? h : w, sh = quarter ? w : h;
+    std::vector<std::uint32_t> base(std::size_t{w} * h, 0xff336699), top(std::size_t{w} * h);
+    std::mt19937 rng(7);
+    for (std::uint32_t& p : top)
+        p = rng() | 0x80000000u;
+
+    CompositeLayer layers[2];
+    const Rect full = Rect::from_size(0, 0, w, h);
+    layers[0] = {{reinterpret_cast<const std::uint8_t*>(base.data()), w * 4, w, h, fourcc::XRGB8888}, full, full};
+    layers[1].surface = {reinterpret_cast<const std::uint8_t*>(top.data()), sw * 4, sw, sh,
+                         state.range(2) ? fourcc::ABGR8888 : fourcc::ARGB8888};
+    layers[1].src = Rect::from_size(0, 0, static_cast<std::int32_t>(sw), static_cast<std::int32_t>(sh));
+    layers[1].dst = full;
+    layers[1].rotation = rotation;
+    layers[1].blend = state.range(1) ? BlendMode::Coverage : BlendMode::Premultiplied;
+
+    ThreadPool pool(1);
+    TileCompositor compositor(pool);
+    std::vector<std::uint32_t> out(std::size_t{w} * h);
+    OutputBuffer buffer{reinterpret_cast<std::uint8_t*>(out.data()), w * 4, w, h};
+    for (auto _ : state) {
+        if (std::error_code ec = compositor.compose(layers, {&full, 1}, buffer)) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+    // Both sources read, the output written.
+    state.SetBytesProcessed(state.iterations() * std::int64_t{w} * h * 4 * 3);
+}
+BENCHMARK(BM_ComposeTransformed)
+    ->ArgsProduct({{0, 1, 2, 3}, {0, 1}, {0, 1}})
+    ->ArgNames({"rotation", "coverage", "bgr"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+const bool registered = [] {
+    for (ConvertIsa isa : {ConvertIsa::Scalar, ConvertIsa::Avx2, ConvertIsa::Neon}) {
+        if (!convert_isa_available(isa))
+            continue;
+        const std::string name = std::string("BM_Compose/") + to_string(isa);
+        benchmark::RegisterBenchmark(name.c_str(), BM_Compose, isa)
+            ->ArgsProduct({{1, 2, 4, 8}, {0, 1}})
+            ->ArgNames({"threads", "partial"})
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+    }
+    return true;
+}();
+
+} // namespace
@@ -0,0 +1,60 @@
+#include "dispctrl/config_store.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr int kConnectors = 8;
+
+std::string temp_path()
+{
+    const char* dir = std::getenv("TMPDIR");
+    return std::string(dir ? dir : "/tmp") + "/dispctrl_bench_" + std::to_string(::getpid()) + ".cfg";
+}
+
+// Startup path: map the saved configuration and look up every connector.
+void BM_ConfigLoad(benchmark::State& state)
+{
+    const std::string path = temp_path();
+    {
+        ConfigStore store(path);
+        for (int i = 0; i < kConnectors; ++i) {
+            ConnectorConfig c;
+            std::snprintf(c.connector, sizeof(c.connector), "DP-%d", i + 1);
+            c.mode.hdisplay = 1920;
+            c.mode.vdisplay = 1080;
+            c.x = 1920 * i;
+            store.put(c);
+        }
+        if (std::error_code ec = store.flush()) {
+            state.SkipWithError(ec.message().c_str());
+            return;
+        }
+    }
+
+    ConfigStore store(path);
+    char name[ConnectorConfig::kNameSize];
+    for (auto _ : state) {
+        if (std::error_code ec = store.load()) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        for (int i = 0; i < kConnectors; ++i) {
+            const int len = std::snprintf(name, sizeof(name), "DP-%d", i + 1);
+            benchmark::DoNotOptimize(store.find({name, static_cast<std::size_t>(len)}));
+        }
+    }
+    ::unlink(path.c_str());
+}
+BENCHMARK(BM_ConfigLoad)->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,99 @@
+#include "dispctrl/format.hpp"
+#include "dispctrl/pixel_convert.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::uint32_t kWidth = 1920;
+constexpr std::uint32_t kHeight = 1080;
+
+/// A random source image in @c fourcc with packed rows.
+struct SourceImage {
+    explicit SourceImage(std::uint32_t fourcc)
+    {
+        image.width = kWidth;
+        image.height = kHeight;
+        image.fourcc = fourcc;
+        std::size_t sizes[3] = {};
+        switch (fourcc) {
+        case fourcc::NV12:
+            image.pitches[0] = image.pitches[1] = kWidth;
+            sizes[0] = std::size_t{kWidth} * kHeight;
+            sizes[1] = sizes[0] / 2;
+            break;
+        case fourcc::YUYV:
+        case fourcc::RGB565:
+            image.pitches[0] = kWidth * 2;
+            sizes[0] = std::size_t{kWidth} * 2 * kHeight;
+            break;
+        }
+        std::mt19937 rng(fourcc);
+        for (int p = 0; p < 3; ++p) {
+            planes[p].resize(sizes[p]);
+            for (std::uint8_t& b : planes[p])
+                b = static_cast<std::uint8_t>(rng());
+            image.planes[p] = planes[p].data();
+        }
+    }
+
+    ConstImage image;
+    std::vector<std::uint8_t> planes[3];
+};
+
+// Args: fourcc, ConvertIsa.
+void BM_ConvertToXrgb8888(benchmark::State& state, std::uint32_t fourcc, ConvertIsa isa)
+{
+    const SourceImage src(fourcc);
+    const std::uint32_t pitch = kWidth * 4;
+    std::vector<std::uint8_t> dst(std::size_t{pitch} * kHeight);
+
+    // There is no test suite for the SIMD kernels, so refuse to time one
+    // that disagrees with the scalar reference.
+    if (isa != ConvertIsa::Scalar) {
+        std::vector<std::uint8_t> ref(dst.size());
+        convert_to_xrgb8888(src.image, ref.data(), pitch, ConvertIsa::Scalar);
+        convert_to_xrgb8888(src.image, dst.data(), pitch, isa);
+        if (std::memcmp(ref.data(), dst.data(), ref.size()) != 0) {
+            state.SkipWithError("output differs from the scalar reference");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        if (std::error_code ec = convert_to_xrgb8888(src.image, dst.data(), pitch, isa)) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(dst.size()));
+    state.SetItemsProcessed(state.iterations() * kWidth * kHeight);
+}
+
+const bool registered = [] {
+    const struct {
+        const char* name;
+        std::uint32_t fourcc;
+    } formats[] = {{"NV12", fourcc::NV12}, {"YUYV", fourcc::YUYV}, {"RGB565", fourcc::RGB565}};
+
+    for (const auto& format : formats)
+        for (ConvertIsa isa : {ConvertIsa::Scalar, ConvertIsa::Avx2, ConvertIsa::Neon}) {
+            if (!convert_isa_available(isa))
+                continue;
+            const std::string name = std::string("BM_ConvertToXrgb8888/") + format.name + "/" + to_string(isa);
+            benchmark::RegisterBenchmark(name.c_str(), BM_ConvertToXrgb8888, format.fourcc, isa)
+                ->Unit(benchmark::kMicrosecond);
+        }
+    return true;
+}();
+
+} // namespace
@@ -0,0 +1,108 @@
+#include "dispctrl/clock.hpp"
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/cursor_latch.hpp"
+#include "dispctrl/histogram.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include <benchmark/benchmark.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::uint32_t kCursorPlane = 60;
+constexpr std::uint64_t kMoveIntervalNs = 1'000'000; // 1 kHz pointer
+constexpr std::uint64_t kFrameIntervalNs = 50'000'000; // content redraws at 20 fps
+
+// Input-to-photon latency of a 1 kHz pointer on a 60 Hz head whose content
+// redraws at 20 fps, in real time. Arg 0 lets positions ride along with
+// frame commits only; arg 1 late-latches them with CursorLatch. Each
+// iteration is one pointer move.
+void BM_CursorInputToPhoton(benchmark::State& state)
+{
+    const bool late_latch = state.range(0) != 0;
+    VirtualHead head;
+    head.flip_latency_ns = 300'000;
+    VirtualKms kms(1, head, VirtualKms::Clock::Realtime);
+    const std::uint32_t crtc = kms.crtc_id(0);
+    CommitQueue queue(kms, crtc);
+
+    std::uint32_t crtc_id_prop = 0, active_prop = 0, x_prop = 0, y_prop = 0;
+    kms.find_property(kCursorPlane, ObjectType::Plane, "CRTC_ID", crtc_id_prop);
+    kms.find_property(crtc, ObjectType::Crtc, "ACTIVE", active_prop);
+    kms.find_property(kCursorPlane, ObjectType::Plane, "CRTC_X", x_prop);
+    kms.find_property(kCursorPlane, ObjectType::Plane, "CRTC_Y", y_prop);
+
+    std::optional<CursorLatch> latch;
+    std::size_t cursor = 0;
+    if (late_latch) {
+        latch.emplace(kms, queue, head.refresh_mhz);
+        latch->add_plane(kCursorPlane, cursor);
+    }
+    LatencyHistogram frame_only;
+    queue.set_report_callback([&](const CommitReport& r) {
+        if (latch)
+            latch->on_report(r);
+        else if (r.latched && r.complete_ns >= r.latched_input_ns)
+            frame_only.record(r.complete_ns - r.latched_input_ns);
+    });
+
+    queue.set(kCursorPlane, crtc_id_prop, crtc);
+    queue.set(crtc, active_prop, 1);
+    queue.flush();
+
+    std::int32_t x = 0;
+    std::uint64_t next_move = monotonic_ns();
+    std::uint64_t frame_at = next_move + kFrameIntervalNs;
+    std::array<KmsEvent, kMaxEventsPerRead> events;
+    for (auto _ : state) {
+        // Run the event loop until the next pointer move is due.
+        for (std::uint64_t now = monotonic_ns(); now < next_move; now = monotonic_ns()) {
+            const std::uint64_t until = std::min(next_move, frame_at);
+            pollfd fds[2] = {{kms.event_fd(), POLLIN, 0}, {latch ? latch->timer_fd() : -1, POLLIN, 0}};
+            const std::uint64_t wait = until > now ? until - now : 0;
+            const timespec timeout{static_cast<time_t>(wait / 1'000'000'000), static_cast<long>(wait % 1'000'000'000)};
+            ::ppoll(fds, 2, &timeout, nullptr);
+
+            std::size_t count = 0;
+            if ((fds[0].revents & POLLIN) && !read_kms_events(kms.event_fd(), events, count)) {
+                for (std::size_t i = 0; i < count; ++i)
+                    queue.on_flip_complete(events[i]);
+            }
+            if (latch && (fds[1].revents & POLLIN))
+                latch->on_timer();
+            if (monotonic_ns() >= frame_at) {
+                queue.set(crtc, active_prop, 1);
+                queue.flush();
+                frame_at += kFrameIntervalNs;
+            }
+        }
+
+        x = (x + 3) % 1920;
+        if (latch) {
+            latch->move(cursor, x, 540, next_move);
+        } else {
+            queue.set_latched(kCursorPlane, x_prop, static_cast<std::uint64_t>(x), next_move);
+            queue.set_latched(kCursorPlane, y_prop, 540, next_move);
+        }
+        next_move += kMoveIntervalNs;
+    }
+
+    const LatencyHistogram& h = latch ? latch->input_to_photon() : frame_only;
+    const LatencyHistogram::Summary s = h.summary();
+    state.counters["p50_ms"] = static_cast<double>(s.p50) / 1e6;
+    state.counters["p99_ms"] = static_cast<double>(s.p99) / 1e6;
+    if (latch) {
+        state.counters["margin_us"] = static_cast<double>(latch->margin_ns()) / 1e3;
+        state.counters["missed"] = static_cast<double>(latch->stats().missed);
+    }
+}
+BENCHMARK(BM_CursorInputToPhoton)->ArgName("late_latch")->Arg(0)->Arg(1)->Iterations(1000)->UseRealTime();
+
+} // namespace
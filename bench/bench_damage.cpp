@@ -0,0 +1,75 @@
+#include "dispctrl/damage.hpp"
+#include "dispctrl/geometry.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::int32_t kWidth = 3840;
+constexpr std::int32_t kHeight = 2160;
+
+// Small widget-sized rectangles clustered around a few hot spots, which is
+// what a desktop produces (cursor trail, clock, scrolling text, video).
+std::vector<Rect> make_damage(std::size_t count, std::uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<std::int32_t> hot(0, 7);
+    std::normal_distribution<double> jitter(0.0, 120.0);
+    std::uniform_int_distribution<std::int32_t> size(8, 160);
+
+    std::vector<Rect> rects;
+    rects.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::int32_t spot = hot(rng);
+        const auto cx = static_cast<std::int32_t>((spot % 4) * kWidth / 4 + kWidth / 8 + jitter(rng));
+        const auto cy = static_cast<std::int32_t>((spot / 4) * kHeight / 2 + kHeight / 4 + jitter(rng));
+        const std::int32_t w = size(rng);
+        const std::int32_t h = size(rng);
+        rects.push_back(Rect::from_size(cx, cy, w, h));
+    }
+    return rects;
+}
+
+// Args: rectangles per frame, max_waste in percent.
+void BM_DamageCoalesce(benchmark::State& state)
+{
+    const auto count = static_cast<std::size_t>(state.range(0));
+    DamagePolicy policy;
+    policy.max_waste = static_cast<double>(state.range(1)) / 100.0;
+
+    constexpr std::size_t kFrames = 64;
+    std::vector<std::vector<Rect>> frames;
+    for (std::size_t f = 0; f < kFrames; ++f)
+        frames.push_back(make_damage(count, static_cast<std::uint32_t>(f + 1)));
+
+    DamageTracker tracker(kWidth, kHeight, policy);
+    tracker.end_frame(); // consume the initial full-frame invalidation
+
+    std::size_t f = 0;
+    std::uint64_t rects_out = 0;
+    for (auto _ : state) {
+        for (const Rect& r : frames[f])
+            tracker.add(r);
+        const DamageRegion& region = tracker.end_frame();
+        rects_out += region.rects().size();
+        benchmark::DoNotOptimize(region.rects().data());
+        f = (f + 1) % kFrames;
+    }
+
+    const auto& stats = tracker.stats();
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(count));
+    state.counters["rects_out"] =
+        benchmark::Counter(static_cast<double>(rects_out), benchmark::Counter::kAvgIterations);
+    state.counters["damaged_pct"] = stats.pixels_total
+        ? 100.0 * static_cast<double>(stats.pixels_damaged) / static_cast<double>(stats.pixels_total)
+        : 0.0;
+}
+BENCHMARK(BM_DamageCoalesce)->ArgsProduct({{4, 16, 64, 256}, {0, 25, 100}});
+
+} // namespace
@@ -0,0 +1,124 @@
+#include "dispctrl/ddc_queue.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <time.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::size_t kMonitors = 16;
+constexpr unsigned kSliderSteps = 10;
+
+// MCCS delays divided by ten, to keep the suite short; every figure
+// scales back linearly.
+constexpr DdcTiming kTiming{5'000'000, 4'000'000, 5'000'000};
+
+void sleep_ns(std::uint64_t ns) noexcept
+{
+    timespec ts{0, static_cast<long>(ns)};
+    while (::nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+// A DDC/CI monitor answering Get/Set VCP Feature, with the bus time of
+// 100 kHz I2C (about 90 us per byte).
+class SimulatedMonitor final : public DdcTransport {
+public:
+    std::error_code write(std::span<const std::uint8_t> msg) noexcept override
+    {
+        sleep_ns(90'000 * msg.size());
+        if (msg.size() < 4 || msg[0] != 0x51)
+            return std::make_error_code(std::errc::io_error);
+        const std::uint8_t* p = msg.data() + 2;
+        if (p[0] == 0x03 && msg.size() >= 7) {
+            vcp_[p[1]] = static_cast<std::uint16_t>(p[2] << 8 | p[3]);
+        } else if (p[0] == 0x01) {
+            const std::uint16_t v = vcp_[p[1]];
+            const std::uint8_t payload[] = {0x02, 0, p[1], 0, 0, 100, static_cast<std::uint8_t>(v >> 8),
+                                            static_cast<std::uint8_t>(v)};
+            reply_len_ = 0;
+            reply_[reply_len_++] = 0x6e;
+            reply_[reply_len_++] = static_cast<std::uint8_t>(0x80 | sizeof(payload));
+            for (std::uint8_t b : payload)
+                reply_[reply_len_++] = b;
+            std::uint8_t sum = 0x50;
+            for (std::size_t i = 0; i < reply_len_; ++i)
+                sum ^= reply_[i];
+            reply_[reply_len_++] = sum;
+        }
+        return {};
+    }
+
+    std::error_code read(std::span<std::uint8_t> msg, std::size_t& len) noexcept override
+    {
+        sleep_ns(90'000 * reply_len_);
+        len = std::min(msg.size(), reply_len_);
+        std::copy_n(reply_.begin(), len, msg.begin());
+        return {};
+    }
+
+private:
+    std::array<std::uint16_t, 256> vcp_{};
+    std::array<std::uint8_t, 16> reply_{};
+    std::size_t reply_len_ = 0;
+};
+
+// What an operator does to each monitor of a wall: power on, pick the
+// input, set contrast, drag the brightness slider and read it back.
+void apply_scene(DdcQueue& queue, std::uint16_t brightness, bool serial)
+{
+    const auto step = [&](auto&& command) {
+        command();
+        if (serial)
+            queue.wait_idle();
+    };
+    step([&] { queue.set_vcp(vcp::kPowerMode, 1); });
+    step([&] { queue.set_vcp(vcp::kInputSource, 0x0f); });
+    step([&] { queue.set_vcp(vcp::kContrast, 70); });
+    for (unsigned i = 1; i <= kSliderSteps; ++i)
+        step([&] { queue.set_vcp(vcp::kBrightness, static_cast<std::uint16_t>(brightness * i / kSliderSteps)); });
+    step([&] { queue.get_vcp(vcp::kBrightness, [](std::error_code, const DdcQueue::Reply&) {}); });
+}
+
+// Arg 0 drives the monitors one command at a time, as a blocking loop
+// does; arg 1 queues everything on per-bus queues and waits once.
+void BM_DdcWall(benchmark::State& state)
+{
+    const bool queued = state.range(0) != 0;
+    std::vector<std::unique_ptr<SimulatedMonitor>> monitors;
+    std::vector<std::unique_ptr<DdcQueue>> queues;
+    for (std::size_t i = 0; i < kMonitors; ++i) {
+        monitors.push_back(std::make_unique<SimulatedMonitor>());
+        queues.push_back(std::make_unique<DdcQueue>(*monitors.back(), kTiming));
+    }
+
+    std::uint16_t brightness = 0;
+    for (auto _ : state) {
+        brightness = static_cast<std::uint16_t>(brightness == 80 ? 40 : 80);
+        for (auto& queue : queues)
+            apply_scene(*queue, brightness, !queued);
+        for (auto& queue : queues)
+            queue->wait_idle();
+    }
+
+    std::uint64_t transactions = 0, superseded = 0;
+    for (auto& queue : queues) {
+        transactions += queue->stats().transactions;
+        superseded += queue->stats().superseded;
+    }
+    state.counters["transactions_per_monitor"] =
+        benchmark::Counter(static_cast<double>(transactions) / kMonitors, benchmark::Counter::kAvgIterations);
+    state.counters["superseded_per_monitor"] =
+        benchmark::Counter(static_cast<double>(superseded) / kMonitors, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_DdcWall)->Arg(0)->Arg(1)->ArgName("queued")->UseRealTime()->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,137 @@
+#include "dispctrl/async_kms.hpp"
+#include "dispctrl/clock.hpp"
+#include "dispctrl/executor.hpp"
+#include "dispctrl/event_dispatcher.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include <benchmark/benchmark.h>
+#include <poll.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+std::vector<std::uint32_t> crtc_ids(const VirtualKms& kms)
+{
+    std::vector<std::uint32_t> ids(kms.heads());
+    for (std::size_t i = 0; i < ids.size(); ++i)
+        ids[i] = kms.crtc_id(i);
+    return ids;
+}
+
+// Read, decode and route one flip per head on the calling thread.
+void BM_EventDispatch(benchmark::State& state)
+{
+    VirtualKms kms(static_cast<std::size_t>(state.range(0)), VirtualHead{});
+    const auto ids = crtc_ids(kms);
+    EventDispatcher dispatcher;
+    std::vector<EventDispatcher::Head*> heads;
+    for (std::uint32_t id : ids)
+        heads.push_back(&dispatcher.add_head(kms, id));
+
+    std::uint64_t serial = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (std::uint32_t id : ids)
+            kms.page_flip(id, 1, ++serial);
+        kms.complete_flips();
+        state.ResumeTiming();
+
+        if (std::error_code ec = dispatcher.dispatch(0)) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        KmsEvent event;
+        for (EventDispatcher::Head* head : heads)
+            while (head->pop(event))
+                benchmark::DoNotOptimize(event);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(ids.size()));
+}
+BENCHMARK(BM_EventDispatch)->Arg(1)->Arg(4)->Arg(16)->Arg(256);
+
+// Latency from the kernel event becoming readable to a consumer sleeping
+// in poll() on its head's notify fd waking up with the event in hand, with
+// the dispatcher running on its own thread.
+void BM_EventWakeupLatency(benchmark::State& state)
+{
+    VirtualKms kms(1, VirtualHead{});
+    const auto ids = crtc_ids(kms);
+    EventDispatcher dispatcher;
+    EventDispatcher::Head& head = dispatcher.add_head(kms, ids[0]);
+    std::thread reader([&] { dispatcher.run(); });
+
+    std::uint64_t serial = 0;
+    std::uint64_t total_ns = 0;
+    for (auto _ : state) {
+        kms.page_flip(ids[0], 1, ++serial);
+        const std::uint64_t start = monotonic_ns();
+        kms.complete_flips();
+
+        KmsEvent event{};
+        for (;;) {
+            head.clear_notify();
+            if (head.pop(event))
+                break;
+            pollfd pfd{head.notify_fd(), POLLIN, 0};
+            ::poll(&pfd, 1, 1000);
+        }
+        total_ns += monotonic_ns() - start;
+        if (event.user_data != serial) {
+            state.SkipWithError("event delivered out of order");
+            break;
+        }
+    }
+
+    dispatcher.stop();
+    reader.join();
+    state.counters["latency_ns"] =
+        benchmark::Counter(static_cast<double>(total_ns), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_EventWakeupLatency)->UseRealTime();
+
+Task<void> flip_loop(AsyncKms& kms, std::uint32_t crtc, benchmark::State& state)
+{
+    for (auto _ : state) {
+        const FlipResult r = co_await kms.page_flip(crtc, 1);
+        if (r.error) {
+            state.SkipWithError(r.error.message().c_str());
+            co_return;
+        }
+    }
+}
+
+Task<void> vblank_loop(Executor& ex, VirtualKms& kms, const AsyncKms& async)
+{
+    // Stand-in for the display: complete whatever has been submitted.
+    for (;;) {
+        co_await ex.yield();
+        if (async.pending())
+            kms.complete_flips();
+        else if (ex.tasks() == 1)
+            co_return;
+    }
+}
+
+// Submit, suspend, and resume on the flip-complete event through the
+// coroutine executor: the per-flip overhead of the async API.
+void BM_AsyncFlipRoundTrip(benchmark::State& state)
+{
+    VirtualKms kms(1, VirtualHead{});
+    const auto ids = crtc_ids(kms);
+    Executor ex;
+    AsyncKms async(ex, kms);
+    ex.spawn(flip_loop(async, ids[0], state));
+    ex.spawn(vblank_loop(ex, kms, async));
+    if (std::error_code ec = ex.run())
+        state.SkipWithError(ec.message().c_str());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncFlipRoundTrip);
+
+} // namespace
@@ -0,0 +1,112 @@
+#include "dispctrl/clock.hpp"
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/sync_file.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <poll.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::uint32_t kCrtc = VirtualKms::kFirstCrtc;
+constexpr std::uint32_t kPlane = 50;
+// A 1 kHz head keeps real-time runs short; the client's CPU and GPU work
+// per frame each fit in a refresh, their sum does not.
+constexpr std::uint64_t kCpuNs = 500'000;
+constexpr std::uint64_t kGpuNs = 600'000;
+
+void spin_until(std::uint64_t deadline_ns)
+{
+    while (monotonic_ns() < deadline_ns) {
+    }
+}
+
+// A client rendering as fast as it can on a real-time head: each frame
+// is recorded on the CPU, rendered on the GPU (a stand-in fence), then
+// committed. Arg 0 waits for the fence on the CPU before committing,
+// serialising the two; arg 1 commits the buffer with its fence at once,
+// so the next frame is recorded while this one renders. At most one frame
+// waits behind the commit in flight.
+void BM_FencePipeline(benchmark::State& state)
+{
+    const bool explicit_sync = state.range(0) != 0;
+    VirtualHead head;
+    head.refresh_mhz = 1'000'000;
+    VirtualKms kms(1, head, VirtualKms::Clock::Realtime);
+    CommitQueue queue(kms, kCrtc);
+    std::uint32_t fb_prop = 0, crtc_prop = 0, fence_prop = 0;
+    kms.find_property(kPlane, ObjectType::Plane, "FB_ID", fb_prop);
+    kms.find_property(kPlane, ObjectType::Plane, "CRTC_ID", crtc_prop);
+    kms.find_property(kPlane, ObjectType::Plane, "IN_FENCE_FD", fence_prop);
+    queue.set(kPlane, crtc_prop, kCrtc);
+
+    std::deque<std::uint64_t> starts; // of the frames not yet on screen
+    std::uint64_t latency_ns = 0, shown = 0;
+    queue.set_report_callback([&](const CommitReport& report) {
+        if (starts.empty())
+            return;
+        latency_ns += report.complete_ns - starts.front();
+        starts.pop_front();
+        ++shown;
+    });
+    const auto pump = [&](int timeout_ms) {
+        pollfd pfd{kms.event_fd(), POLLIN, 0};
+        if (::poll(&pfd, 1, timeout_ms) <= 0)
+            return;
+        std::array<KmsEvent, kMaxEventsPerRead> events;
+        std::size_t count = 0;
+        if (!read_kms_events(kms.event_fd(), events, count))
+            for (std::size_t i = 0; i < count; ++i)
+                queue.on_flip_complete(events[i]);
+    };
+
+    std::uint64_t gpu_free = 0, cpu_wait_ns = 0, fb = 0;
+    const std::uint64_t begin = monotonic_ns();
+    for (auto _ : state) {
+        const std::uint64_t start = monotonic_ns();
+        spin_until(start + kCpuNs);
+        gpu_free = std::max(gpu_free, monotonic_ns()) + kGpuNs;
+        UniqueFd fence;
+        if (std::error_code ec = kms.create_fence(gpu_free, fence)) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        if (explicit_sync) {
+            queue.set_in_fence(kPlane, fence_prop, std::move(fence));
+        } else {
+            const std::uint64_t t = monotonic_ns();
+            wait_fence(fence.get(), 1'000'000'000);
+            cpu_wait_ns += monotonic_ns() - t;
+        }
+        queue.set(kPlane, fb_prop, 1000 + ++fb % 3);
+        starts.push_back(start);
+        if (std::error_code ec = queue.flush()) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        pump(0);
+        while (queue.in_flight() && !queue.empty())
+            pump(100);
+    }
+    while (queue.in_flight())
+        pump(100);
+    const double seconds = static_cast<double>(monotonic_ns() - begin) / 1e9;
+
+    state.counters["frames_per_s"] = static_cast<double>(shown) / seconds;
+    state.counters["latency_us"] = shown ? static_cast<double>(latency_ns) / static_cast<double>(shown) / 1e3 : 0.0;
+    state.counters["cpu_wait_us"] =
+        benchmark::Counter(static_cast<double>(cpu_wait_ns) / 1e3, benchmark::Counter::kAvgIterations);
+    state.counters["fence_wait_p50_us"] = static_cast<double>(queue.fence_wait().percentile(0.5)) / 1e3;
+}
+BENCHMARK(BM_FencePipeline)->Arg(0)->Arg(1)->ArgName("explicit")->Iterations(1000)->UseRealTime();
+
+} // namespace
@@ -0,0 +1,205 @@
+#include "dispctrl/edid.hpp"
+#include "dispctrl/hotplug.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+void set_checksum(std::uint8_t* block)
+{
+    std::uint8_t sum = 0;
+    for (int i = 0; i < 127; ++i)
+        sum = static_cast<std::uint8_t>(sum + block[i]);
+    block[127] = static_cast<std::uint8_t>(0x100 - sum);
+}
+
+// A 3840x2160@60 monitor with a name descriptor, a range-limits descriptor
+// and a CTA-861 extension listing the usual TV VICs. @p serial makes each
+// connector's blob distinct.
+std::vector<std::uint8_t> make_edid(std::uint32_t serial)
+{
+    std::vector<std::uint8_t> edid(256, 0);
+    std::uint8_t* b = edid.data();
+    const std::uint8_t header[] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+    std::copy(std::begin(header), std::end(header), b);
+    b[8] = 0x10; // "DEL"
+    b[9] = 0xac;
+    b[10] = 0x42;
+    b[12] = static_cast<std::uint8_t>(serial);
+    b[13] = static_cast<std::uint8_t>(serial >> 8);
+    b[18] = 1;
+    b[19] = 4;
+    b[21] = 60;
+    b[22] = 34;
+
+    // DTD: 594 MHz, 3840/4400 x 2160/2250.
+    std::uint8_t* d = b + 54;
+    d[0] = 0x08;
+    d[1] = 0xe8;
+    d[2] = 3840 & 0xff;
+    d[3] = 560 & 0xff;
+    d[4] = (3840 >> 8) << 4 | (560 >> 8);
+    d[5] = 2160 & 0xff;
+    d[6] = 90 & 0xff;
+    d[7] = (2160 >> 8) << 4 | (90 >> 8);
+    d[8] = 176;
+    d[9] = 88;
+    d[10] = 8 << 4 | 10;
+    d[17] = 0x1e;
+
+    std::uint8_t* name = b + 72;
+    name[3] = 0xfc;
+    const char model[] = "BENCH 4K\n     ";
+    std::copy(model, model + 13, name + 5);
+
+    std::uint8_t* range = b + 90;
+    range[3] = 0xfd;
+    range[5] = 48;
+    range[6] = 144;
+    range[7] = 30;
+    range[8] = 160;
+    range[9] = 60;
+
+    b[108 + 3] = 0x10; // dummy descriptor
+    b[126] = 1;
+    set_checksum(b);
+
+    std::uint8_t* cta = b + 128;
+    const std::uint8_t vics[] = {97, 16, 4, 31, 3, 2, 1, 95, 96, 93};
+    cta[0] = 0x02;
+    cta[1] = 3;
+    cta[2] = static_cast<std::uint8_t>(5 + sizeof(vics));
+    cta[4] = static_cast<std::uint8_t>(2 << 5 | sizeof(vics));
+    std::copy(std::begin(vics), std::end(vics), cta + 5);
+    set_checksum(cta);
+    return edid;
+}
+
+std::vector<std::vector<std::uint8_t>> make_connectors(std::size_t count)
+{
+    std::vector<std::vector<std::uint8_t>> blobs;
+    for (std::size_t i = 0; i < count; ++i)
+        blobs.push_back(make_edid(static_cast<std::uint32_t>(1000 + i)));
+    return blobs;
+}
+
+// Reprobe of every connector after a hotplug, decoding each EDID afresh.
+void BM_HotplugReprobeUncached(benchmark::State& state)
+{
+    const auto blobs = make_connectors(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+        for (const auto& blob : blobs) {
+            DisplayInfo info;
+            if (std::error_code ec = parse_display_info(blob, info)) {
+                state.SkipWithError(ec.message().c_str());
+                return;
+            }
+            benchmark::DoNotOptimize(info.modes.data());
+        }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HotplugReprobeUncached)->Arg(1)->Arg(4)->Arg(16);
+
+// The same reprobe through a warm EdidCache.
+void BM_HotplugReprobeCached(benchmark::State& state)
+{
+    const auto blobs = make_connectors(static_cast<std::size_t>(state.range(0)));
+    EdidCache cache;
+    std::shared_ptr<const DisplayInfo> info;
+    for (const auto& blob : blobs)
+        cache.lookup(blob, info);
+
+    for (auto _ : state)
+        for (const auto& blob : blobs) {
+            if (std::error_code ec = cache.lookup(blob, info)) {
+                state.SkipWithError(ec.message().c_str());
+                return;
+            }
+            benchmark::DoNotOptimize(info.get());
+        }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["hit_pct"] = 100.0 * static_cast<double>(cache.stats().hits) /
+                                static_cast<double>(cache.stats().hits + cache.stats().misses);
+}
+BENCHMARK(BM_HotplugReprobeCached)->Arg(1)->Arg(4)->Arg(16);
+
+// Connectors of a VirtualKms, standing in for per-connector probes.
+class VirtualProber final : public ConnectorProber {
+public:
+    explicit VirtualProber(VirtualKms& kms) noexcept : kms_(kms) {}
+
+    std::error_code probe(std::uint32_t connector_id, ConnectorInfo& out) override
+    {
+        out = {};
+        out.connector_id = connector_id;
+        out.status = kms_.connected(connector_id - VirtualKms::kFirstConnector) ? ConnectorInfo::Status::Connected
+                                                                                 : ConnectorInfo::Status::Disconnected;
+        if (out.connected())
+            out.modes.resize(1);
+        return {};
+    }
+
+    std::error_code connectors(std::vector<std::uint32_t>& out) override
+    {
+        out.clear();
+        for (std::size_t h = 0; h < kms_.heads(); ++h)
+            out.push_back(kms_.connector_id(h));
+        return {};
+    }
+
+private:
+    VirtualKms& kms_;
+};
+
+// One simulated second per iteration of 16 heads, one of whose cables
+// flaps every 20 ms. Arg 0 handles each event as before, re-enumerating
+// the card at once; arg 1 reprobes only the named connector, debounced.
+// Reported: connector probes and connector changes (each a mode set) per
+// second.
+void BM_HotplugFlap(benchmark::State& state)
+{
+    const bool incremental = state.range(0) != 0;
+    std::vector<VirtualHead> heads(16);
+    heads[3].hotplug_period_ns = 40'000'000;
+    heads[3].hotplug_down_ns = 20'000'000;
+    VirtualKms kms(heads);
+    VirtualProber prober(kms);
+
+    HotplugDebounce debounce;
+    if (!incremental)
+        debounce = {0, 0, ~0u, 0};
+    std::uint64_t changes = 0;
+    HotplugMonitor monitor(prober, -1, [&](const ConnectorChange&) { ++changes; }, debounce);
+    monitor.rescan(kms.now());
+    monitor.poll(kms.now());
+    changes = 0;
+    kms.set_hotplug_handler([&](std::uint32_t connector_id, bool, std::uint64_t timestamp_ns) {
+        monitor.on_uevent({0, incremental ? connector_id : 0, 0, 0}, timestamp_ns);
+    });
+
+    const std::uint64_t probes = monitor.stats().probes;
+    for (auto _ : state) {
+        for (int ms = 0; ms < 1000; ++ms) {
+            kms.advance(1'000'000);
+            const std::uint64_t deadline = monitor.next_deadline();
+            if (deadline && deadline <= kms.now())
+                monitor.poll(kms.now());
+        }
+    }
+
+    const auto seconds = static_cast<double>(state.iterations());
+    state.counters["probes_per_s"] = static_cast<double>(monitor.stats().probes - probes) / seconds;
+    state.counters["changes_per_s"] = static_cast<double>(changes) / seconds;
+}
+BENCHMARK(BM_HotplugFlap)->Arg(0)->Arg(1)->ArgName("incremental");
+
+} // namespace
@@ -0,0 +1,79 @@
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/damage.hpp"
+#include "dispctrl/idle_scheduler.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::uint32_t kCrtc = VirtualKms::kFirstCrtc;
+constexpr std::uint32_t kPlane = 50;
+constexpr std::uint64_t kRefreshNs = 16'666'667;
+constexpr int kFramesPerSecond = 60;
+
+// One simulated second per iteration of a signage screen whose content
+// changes every range(0) ms (a ticker at 16, a clock at 1000, a poster at
+// 10000). Arg 1 gates the frames through an IdleScheduler; arg 0 commits
+// every refresh, which is what a naive loop does.
+void BM_IdleSignage(benchmark::State& state)
+{
+    const auto content_ns = static_cast<std::uint64_t>(state.range(0)) * 1'000'000;
+    const bool gated = state.range(1) != 0;
+    VirtualKms kms(1, VirtualHead{});
+    CommitQueue queue(kms, kCrtc);
+    std::uint32_t fb_prop = 0, crtc_prop = 0;
+    kms.find_property(kPlane, ObjectType::Plane, "FB_ID", fb_prop);
+    kms.find_property(kPlane, ObjectType::Plane, "CRTC_ID", crtc_prop);
+    queue.set(kPlane, crtc_prop, kCrtc);
+    DamageTracker tracker(1920, 1080);
+    IdleScheduler scheduler;
+
+    std::uint64_t next_content = kms.now();
+    std::uint64_t fb = 0;
+    std::uint64_t ticks = 0;
+    const std::uint64_t commits = kms.stats().commits;
+    for (auto _ : state) {
+        for (int f = 0; f < kFramesPerSecond; ++f) {
+            const std::uint64_t now = kms.now();
+            if (now >= next_content) {
+                tracker.add(Rect::from_size(64, 960, 1792, 64));
+                next_content += content_ns;
+                scheduler.on_activity(now);
+            }
+            // An Idle output would sleep until the next change.
+            if (!gated || scheduler.frame_clock()) {
+                ++ticks;
+                const bool dirty = !tracker.end_frame().empty();
+                if (!gated || scheduler.begin_frame(dirty, now)) {
+                    queue.set(kPlane, fb_prop, 1000 + ++fb % 2);
+                    if (std::error_code ec = queue.flush()) {
+                        state.SkipWithError(ec.message().c_str());
+                        return;
+                    }
+                }
+            }
+            kms.advance(kRefreshNs);
+            std::array<KmsEvent, kMaxEventsPerRead> events;
+            std::size_t count = 0;
+            if (!read_kms_events(kms.event_fd(), events, count))
+                for (std::size_t i = 0; i < count; ++i)
+                    queue.on_flip_complete(events[i]);
+        }
+    }
+
+    const auto seconds = static_cast<double>(state.iterations());
+    state.counters["commits_per_s"] = static_cast<double>(kms.stats().commits - commits) / seconds;
+    state.counters["ticks_per_s"] = static_cast<double>(ticks) / seconds;
+    state.counters["suppressed_per_s"] = static_cast<double>(scheduler.stats().suppressed) / seconds;
+    state.counters["idle_pct"] = 100.0 * static_cast<double>(scheduler.stats().idle_ns) / (seconds * 1e9);
+}
+BENCHMARK(BM_IdleSignage)->ArgsProduct({{16, 1000, 10000}, {0, 1}})->ArgNames({"content_ms", "gated"});
+
+} // namespace
@@ -0,0 +1,140 @@
+#include "dispctrl/clock.hpp"
+#include "dispctrl/ipc.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+std::string socket_name()
+{
+    return "@dispctrl-bench-" + std::to_string(::getpid());
+}
+
+// Acknowledges every update with a Presented event, as a daemon does once
+// the frame is on screen.
+class EchoHandler final : public IpcServer::Handler {
+public:
+    IpcServer* server = nullptr;
+    std::uint64_t updates = 0;
+
+    void on_connect(std::uint32_t, const IpcPeer&) override {}
+    void on_attach(std::uint32_t, std::uint32_t, const DmaBufDesc&) override {}
+    void on_detach(std::uint32_t, std::uint32_t) override {}
+    void on_update(std::uint32_t client, const IpcLayerUpdate& update, const DmaBufDesc*) override
+    {
+        ++updates;
+        if (!server)
+            return;
+        IpcEvent event;
+        event.surface_id = update.surface_id;
+        event.serial = update.serial;
+        event.timestamp_ns = monotonic_ns();
+        server->post(client, event);
+    }
+    void on_disconnect(std::uint32_t) override {}
+};
+
+// Client update to its Presented event with the daemon on its own thread,
+// both sides sleeping on their doorbells in between.
+void BM_IpcRoundTrip(benchmark::State& state)
+{
+    EchoHandler handler;
+    IpcServer server(socket_name(), handler);
+    handler.server = &server;
+    std::atomic<bool> stop{false};
+    std::thread daemon([&] {
+        while (!stop.load(std::memory_order_relaxed))
+            server.dispatch(10);
+    });
+    IpcClient client(socket_name());
+
+    IpcLayerUpdate update;
+    update.surface_id = 1;
+    std::uint64_t total_ns = 0;
+    for (auto _ : state) {
+        ++update.serial;
+        const std::uint64_t start = monotonic_ns();
+        if (client.submit(update)) {
+            state.SkipWithError("update ring full");
+            break;
+        }
+        IpcEvent event{};
+        while (client.read_events({&event, 1}) == 0) {
+            pollfd pfd{client.event_fd(), POLLIN, 0};
+            ::poll(&pfd, 1, 1000);
+        }
+        total_ns += monotonic_ns() - start;
+        if (event.serial != update.serial) {
+            state.SkipWithError("event out of order");
+            break;
+        }
+    }
+
+    stop = true;
+    daemon.join();
+    state.counters["latency_ns"] =
+        benchmark::Counter(static_cast<double>(total_ns), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_IpcRoundTrip)->UseRealTime();
+
+// A signage wall: every client pushes a burst of small updates per tick and
+// the daemon drains all of them in one dispatch loop. Measures the daemon's
+// cost per update and how often a client had to ring the doorbell.
+void BM_IpcUpdates(benchmark::State& state)
+{
+    constexpr std::uint32_t kBurst = 8;
+    const auto count = static_cast<std::size_t>(state.range(0));
+    EchoHandler handler;
+    IpcServer server(socket_name(), handler);
+    std::vector<std::unique_ptr<IpcClient>> clients;
+    {
+        // The handshake blocks the client until the daemon answers.
+        std::thread daemon([&] {
+            while (server.stats().connects < count)
+                server.dispatch(10);
+        });
+        for (std::size_t i = 0; i < count; ++i)
+            clients.push_back(std::make_unique<IpcClient>(socket_name()));
+        daemon.join();
+    }
+
+    IpcLayerUpdate update;
+    const std::uint64_t wakeups = server.stats().wakeups;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (auto& client : clients)
+            for (std::uint32_t i = 0; i < kBurst; ++i) {
+                ++update.serial;
+                update.surface_id = i;
+                client->submit(update);
+            }
+        const std::uint64_t expected = handler.updates + count * kBurst;
+        state.ResumeTiming();
+
+        while (handler.updates < expected)
+            if (std::error_code ec = server.dispatch(0)) {
+                state.SkipWithError(ec.message().c_str());
+                break;
+            }
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(count * kBurst));
+    state.counters["doorbells_per_update"] =
+        benchmark::Counter(static_cast<double>(server.stats().wakeups - wakeups) /
+                           static_cast<double>(count * kBurst), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_IpcUpdates)->Arg(1)->Arg(16)->Arg(128);
+
+} // namespace
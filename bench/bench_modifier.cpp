@@ -0,0 +1,65 @@
+#include "dispctrl/modifier.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::uint32_t kFormats[] = {
+    fourcc::XRGB8888, fourcc::ARGB8888, fourcc::XBGR8888, fourcc::ABGR8888,
+    fourcc::XRGB2101010, fourcc::RGB565, fourcc::YUYV, fourcc::NV12,
+};
+
+// Roughly what a Gen12 scanout device and a Mali render device report:
+// every format in a handful of layouts, compressed ones first.
+std::vector<PlaneFormat> intel_formats()
+{
+    std::vector<PlaneFormat> formats;
+    for (std::uint64_t m : {modifier::IntelYTiledGen12RcCcs, modifier::IntelYTiledGen12McCcs, modifier::IntelYTiled,
+                            modifier::IntelXTiled, modifier::Linear})
+        for (std::uint32_t f : kFormats)
+            formats.push_back({f, m});
+    return formats;
+}
+
+std::vector<PlaneFormat> mali_formats()
+{
+    using namespace modifier::afbc;
+    std::vector<PlaneFormat> formats;
+    for (std::uint64_t m : {modifier::arm_afbc(Block16x16 | Ytr | Sparse), modifier::arm_afbc(Block16x16 | Sparse),
+                            modifier::arm_afbc(Block32x8 | Split | Sparse), modifier::IntelXTiled, modifier::Linear})
+        for (std::uint32_t f : kFormats)
+            formats.push_back({f, m});
+    return formats;
+}
+
+void BM_NegotiateModifier(benchmark::State& state)
+{
+    const std::vector<PlaneFormat> render = mali_formats();
+    const std::vector<PlaneFormat> scanout = intel_formats();
+    ModifierChoice choice;
+    for (auto _ : state) {
+        negotiate_modifier(fourcc::XRGB8888, render, scanout, choice);
+        benchmark::DoNotOptimize(choice);
+    }
+}
+BENCHMARK(BM_NegotiateModifier);
+
+void BM_NegotiateModifierCached(benchmark::State& state)
+{
+    ModifierNegotiator negotiator;
+    const std::uint32_t render = negotiator.add_device(mali_formats());
+    const std::uint32_t scanout = negotiator.add_device(intel_formats());
+    ModifierChoice choice;
+    for (auto _ : state) {
+        negotiator.negotiate(render, scanout, fourcc::XRGB8888, choice);
+        benchmark::DoNotOptimize(choice);
+    }
+}
+BENCHMARK(BM_NegotiateModifierCached);
+
+} // namespace
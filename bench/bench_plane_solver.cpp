@@ -0,0 +1,147 @@
+#include "dispctrl/format.hpp"
+#include "dispctrl/plane_solver.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+constexpr std::uint32_t kCrtc = VirtualKms::kFirstCrtc;
+
+std::vector<PlaneCaps> make_planes()
+{
+    const std::vector<PlaneFormat> rgb = {{fourcc::XRGB8888, modifier::Linear}, {fourcc::ARGB8888, modifier::Linear}};
+    std::vector<PlaneFormat> video = rgb;
+    video.push_back({fourcc::NV12, modifier::Linear});
+
+    std::vector<PlaneCaps> planes(4);
+    planes[0] = {31, PlaneType::Primary, 0, rgb};
+    planes[1] = {32, PlaneType::Overlay, 1, video, 4.0, 8.0};
+    planes[2] = {33, PlaneType::Overlay, 2, video, 4.0, 8.0};
+    planes[3] = {34, PlaneType::Cursor, 3, {{fourcc::ARGB8888, modifier::Linear}}, 1.0, 1.0, 256, 256};
+    return planes;
+}
+
+// Wallpaper, a scaled video, two windows and a cursor on a 4K output.
+std::vector<Layer> make_layers()
+{
+    return {
+        {100, fourcc::XRGB8888, modifier::Linear, Rect::from_size(0, 0, 3840, 2160), Rect::from_size(0, 0, 3840, 2160)},
+        {101, fourcc::NV12, modifier::Linear, Rect::from_size(0, 0, 1920, 1080), Rect::from_size(200, 200, 2560, 1440)},
+        {102, fourcc::ARGB8888, modifier::Linear, Rect::from_size(0, 0, 800, 600), Rect::from_size(2900, 100, 800, 600)},
+        {103, fourcc::ARGB8888, modifier::Linear, Rect::from_size(0, 0, 600, 400), Rect::from_size(2900, 1600, 600, 400)},
+        {104, fourcc::ARGB8888, modifier::Linear, Rect::from_size(0, 0, 64, 64), Rect::from_size(1000, 900, 64, 64)},
+    };
+}
+
+const CompositionTarget kTarget{200, fourcc::XRGB8888, modifier::Linear, 3840, 2160};
+
+// The kernel accepts at most three active planes, so the first candidate
+// (all four planes) is rejected and the solver has to demote.
+VirtualKms& limited_kms()
+{
+    static VirtualKms kms(1, VirtualHead{});
+    std::uint32_t fb_prop = 0;
+    kms.find_property(0, ObjectType::Plane, "FB_ID", fb_prop);
+    kms.set_plane_limit(3, fb_prop);
+    return kms;
+}
+
+// Steady state: buffers flip every frame, nothing moves.
+void BM_PlaneSolveCached(benchmark::State& state)
+{
+    PlaneSolver solver(limited_kms(), kCrtc, make_planes());
+    std::vector<Layer> layers = make_layers();
+    PlaneAssignment assignment;
+    solver.solve(layers, kTarget, assignment);
+
+    std::uint32_t frame = 0;
+    for (auto _ : state) {
+        for (Layer& layer : layers)
+            layer.fb_id = 100 + (++frame & 1);
+        if (std::error_code ec = solver.solve(layers, kTarget, assignment)) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(assignment.plane_ids.data());
+    }
+    state.counters["tests_per_solve"] = static_cast<double>(solver.stats().test_commits) /
+                                        static_cast<double>(solver.stats().solves);
+    state.counters["offloaded"] = static_cast<double>(assignment.offloaded());
+}
+BENCHMARK(BM_PlaneSolveCached);
+
+// A window moves every frame, so each solve runs the search.
+void BM_PlaneSolveSearch(benchmark::State& state)
+{
+    PlaneSolver solver(limited_kms(), kCrtc, make_planes());
+    std::vector<Layer> layers = make_layers();
+    PlaneAssignment assignment;
+
+    std::int32_t x = 0;
+    for (auto _ : state) {
+        x = (x + 1) % 512;
+        layers[2].dst = Rect::from_size(2900 - x, 100, 800, 600);
+        if (std::error_code ec = solver.solve(layers, kTarget, assignment)) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(assignment.plane_ids.data());
+    }
+    state.counters["tests_per_solve"] = static_cast<double>(solver.stats().test_commits) /
+                                        static_cast<double>(solver.stats().solves);
+    state.counters["offloaded"] = static_cast<double>(assignment.offloaded());
+}
+BENCHMARK(BM_PlaneSolveSearch);
+
+// Portrait signage on a 1920x1080 panel mounted sideways: a wallpaper, a
+// landscape video at the top and a ticker that moves every frame, all
+// rotated a quarter turn onto the output. Arguments: whether the planes
+// can rotate, whether there is a GPU. Without plane rotation the desktop
+// is composed in output orientation and every layer is rotated in
+// software.
+void BM_PlaneSolvePortrait(benchmark::State& state)
+{
+    const bool rotate = state.range(0) != 0;
+    std::vector<PlaneCaps> planes = make_planes();
+    if (rotate)
+        for (std::size_t p = 0; p < 3; ++p)
+            planes[p].rotations = drm_rotation(Rotation::R0) | drm_rotation(Rotation::R90);
+    PlaneLimits limits;
+    if (state.range(1))
+        limits.costs.gpu_bytes_per_ns = 40.0;
+    PlaneSolver solver(limited_kms(), kCrtc, std::move(planes), limits);
+
+    CompositionTarget target{200, fourcc::XRGB8888, modifier::Linear, 1080, 1920, Rotation::R90};
+    if (!solver.rotates_target(target))
+        target = {200, fourcc::XRGB8888, modifier::Linear, 1920, 1080};
+    std::vector<Layer> layers = {
+        {100, fourcc::XRGB8888, modifier::Linear, Rect::from_size(0, 0, 1080, 1920), Rect::from_size(0, 0, 1920, 1080), Rotation::R90},
+        {101, fourcc::NV12, modifier::Linear, Rect::from_size(0, 0, 1920, 1080), Rect::from_size(0, 0, 608, 1080), Rotation::R90},
+        {102, fourcc::ARGB8888, modifier::Linear, Rect::from_size(0, 0, 1080, 160), Rect::from_size(1700, 0, 160, 1080), Rotation::R90},
+    };
+    PlaneAssignment assignment;
+
+    std::int32_t y = 0;
+    for (auto _ : state) {
+        y = (y + 1) % 64;
+        layers[2].dst = Rect::from_size(1700 - y, 0, 160, 1080);
+        if (std::error_code ec = solver.solve(layers, target, assignment)) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(assignment.plane_ids.data());
+    }
+    const auto solves = static_cast<double>(solver.stats().solves);
+    state.counters["target_rotated"] = target.rotation != Rotation::R0;
+    state.counters["offloaded"] = static_cast<double>(assignment.offloaded());
+    state.counters["cpu_transforms"] = static_cast<double>(solver.stats().cpu_transforms) / solves;
+    state.counters["gpu_transforms"] = static_cast<double>(solver.stats().gpu_transforms) / solves;
+}
+BENCHMARK(BM_PlaneSolvePortrait)->Args({0, 0})->Args({0, 1})->Args({1, 0})->Args({1, 1});
+
+} // namespace
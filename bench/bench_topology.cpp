@@ -0,0 +1,46 @@
+#include "dispctrl/topology.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+using namespace dispctrl;
+
+// A 16 MiB copy (a 2048x2048 XRGB layer) by a thread pinned to the first
+// node, between buffers on that node (arg 0) or on the last one (arg 1),
+// which is what a compositor worker on the wrong socket pays. Both cases
+// measure the same thing on a single-node machine.
+void BM_NodeCopy(benchmark::State& state)
+{
+    constexpr std::size_t kBytes = 16u << 20;
+    const Topology topology = Topology::discover();
+    const Topology::Node& home = topology.nodes().front();
+    const int node = state.range(0) ? topology.nodes().back().id : home.id;
+    if (std::error_code ec = pin_current_thread(home.cpus)) {
+        state.SkipWithError(ec.message().c_str());
+        return;
+    }
+    if (topology.nodes().size() == 1)
+        state.SetLabel("single node");
+
+    NodeMemoryResource memory(node);
+    void* src = memory.allocate(kBytes);
+    void* dst = memory.allocate(kBytes);
+    std::memset(src, 0x5a, kBytes);
+    std::memset(dst, 0, kBytes);
+    for (auto _ : state) {
+        std::memcpy(dst, src, kBytes);
+        benchmark::ClobberMemory();
+    }
+    memory.deallocate(dst, kBytes);
+    memory.deallocate(src, kBytes);
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(kBytes));
+    state.counters["node"] = node;
+}
+BENCHMARK(BM_NodeCopy)->Arg(0)->Arg(1)->ArgName("remote");
+
+} // namespace
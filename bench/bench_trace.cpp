@@ -0,0 +1,34 @@
+#include "dispctrl/trace.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+
+namespace {
+
+using namespace dispctrl;
+
+// Cost of instrumenting one frame (five stages and the flip) per mode.
+void BM_TraceFrame(benchmark::State& state)
+{
+    const auto tracer = std::make_unique<Tracer>(static_cast<TraceMode>(state.range(0)));
+    std::uint64_t frame = 0;
+    std::uint64_t now = 1'000'000;
+    for (auto _ : state) {
+        tracer->record(0, frame, TracePoint::ClientSubmit, now);
+        tracer->record(0, frame, TracePoint::ComposeBegin, now + 100'000);
+        tracer->record(0, frame, TracePoint::ComposeEnd, now + 2'100'000);
+        tracer->record(0, frame, TracePoint::CommitBegin, now + 2'200'000);
+        tracer->record(0, frame, TracePoint::CommitEnd, now + 2'250'000);
+        tracer->record(0, frame, TracePoint::FlipComplete, now + 8'000'000);
+        ++frame;
+        now += 16'666'667;
+        if ((frame & 511) == 0)
+            tracer->collect(); // keep the ring from overflowing, as a periodic drain would
+    }
+    state.counters["dropped"] = static_cast<double>(tracer->stats().dropped);
+}
+BENCHMARK(BM_TraceFrame)->ArgName("mode")->Arg(0)->Arg(1)->Arg(2);
+
+} // namespace
@@ -0,0 +1,70 @@
+#include "dispctrl/event_dispatcher.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+// A wall of mixed monitors: 60, 120 and 144 Hz heads with a little flip
+// latency, a few of them replugged every second.
+std::vector<VirtualHead> mixed_heads(std::size_t count)
+{
+    constexpr std::uint32_t kRates[] = {60000, 120000, 144000};
+    std::vector<VirtualHead> heads(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        heads[i].refresh_mhz = kRates[i % 3];
+        heads[i].flip_latency_ns = 500'000;
+        if (i % 16 == 15) {
+            heads[i].hotplug_period_ns = 1'000'000'000;
+            heads[i].hotplug_down_ns = 100'000'000;
+            heads[i].hotplug_phase_ns = i * 1'000'000;
+        }
+    }
+    return heads;
+}
+
+// Event-loop scaling: every head flips again as soon as its previous flip
+// completes; each iteration advances simulated time by 1 ms, then reads,
+// routes and resubmits.
+void BM_VirtualHeads(benchmark::State& state)
+{
+    const auto count = static_cast<std::size_t>(state.range(0));
+    VirtualKms kms(mixed_heads(count));
+    EventDispatcher dispatcher;
+    std::vector<EventDispatcher::Head*> heads;
+    for (std::size_t i = 0; i < count; ++i)
+        heads.push_back(&dispatcher.add_head(kms, kms.crtc_id(i)));
+
+    std::uint64_t serial = 0;
+    for (std::size_t i = 0; i < count; ++i)
+        kms.page_flip(kms.crtc_id(i), 1, ++serial);
+
+    std::uint64_t flips = 0;
+    for (auto _ : state) {
+        kms.advance(1'000'000);
+        if (std::error_code ec = dispatcher.dispatch(0)) {
+            state.SkipWithError(ec.message().c_str());
+            break;
+        }
+        KmsEvent event;
+        for (std::size_t i = 0; i < count; ++i) {
+            while (heads[i]->pop(event)) {
+                ++flips;
+                kms.page_flip(event.crtc_id, 1, ++serial);
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(flips));
+    const VirtualKms::Stats stats = kms.stats();
+    state.counters["dropped"] = static_cast<double>(stats.dropped);
+    state.counters["busy"] = static_cast<double>(stats.busy);
+}
+BENCHMARK(BM_VirtualHeads)->Arg(16)->Arg(64)->Arg(256);
+
+} // namespace
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+namespace dispctrl {
+
+/// Global operator new calls made by the calling thread so far.
+///
+/// Counting requires linking the `dispctrl_alloc_hooks` object library,
+/// which replaces the global allocation functions; without it the count
+/// stays at zero and heap_allocation_tracking() returns false.
+std::uint64_t thread_heap_allocations() noexcept;
+
+/// True when the allocation hooks are linked into the program.
+bool heap_allocation_tracking() noexcept;
+
+/// Counts heap allocations made by this thread during its lifetime, e.g.
+/// to assert that a steady-state frame allocates nothing.
+class HeapAllocationScope {
+public:
+    HeapAllocationScope() noexcept : start_(thread_heap_allocations()) {}
+    std::uint64_t count() const noexcept { return thread_heap_allocations() - start_; }
+
+private:
+    std::uint64_t start_;
+};
+
+namespace detail {
+void note_heap_allocation() noexcept;
+void enable_heap_allocation_tracking() noexcept;
+} // namespace detail
+
+} // namespace dispctrl
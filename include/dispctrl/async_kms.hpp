@@ -0,0 +1,154 @@
+#pragma once
+
+#include "dispctrl/executor.hpp"
+#include "dispctrl/kms_device.hpp"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+
+namespace dispctrl {
+
+class AtomicRequest;
+
+/// Outcome of an awaited flip or commit.
+struct FlipResult {
+    std::error_code error; ///< Submission failure; `event` is unset then.
+    KmsEvent event;
+};
+
+/// A connector whose status may have changed.
+struct HotplugEvent {
+    std::uint32_t connector_id = 0; ///< 0 when the source does not say which.
+    std::uint64_t timestamp_ns = 0;
+};
+
+/// Awaitable KMS operations on one device, run by an Executor.
+///
+///     FlipResult r = co_await kms.page_flip(crtc, fb);
+///     HotplugEvent h = co_await kms.hotplug();
+///
+/// The device's event fd is watched by the executor; flip completions
+/// resume the coroutine that submitted the flip, matched by a serial in
+/// the event's user data. The awaitables live in the awaiting coroutine's
+/// frame, so waiting allocates nothing. Do not mix this with another
+/// consumer of the same device's events (EventDispatcher, CommitQueue).
+class AsyncKms {
+public:
+    struct Stats {
+        std::uint64_t submitted = 0;
+        std::uint64_t completed = 0;
+        std::uint64_t unmatched = 0; ///< Events that no awaiter was waiting for.
+    };
+
+    /// Awaitable flip or atomic commit; resumes at its flip-complete event.
+    class FlipOperation {
+    public:
+        FlipOperation(const FlipOperation&) = delete;
+        FlipOperation& operator=(const FlipOperation&) = delete;
+        ~FlipOperation();
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h) noexcept;
+        FlipResult await_resume() const noexcept { return result_; }
+
+    private:
+        friend class AsyncKms;
+        FlipOperation(AsyncKms& kms, std::uint32_t crtc_id, std::uint32_t fb_id) noexcept
+            : kms_(kms), crtc_id_(crtc_id), fb_id_(fb_id)
+        {
+        }
+        FlipOperation(AsyncKms& kms, const AtomicRequest& request, std::uint32_t flags) noexcept
+            : kms_(kms), request_(&request), flags_(flags)
+        {
+        }
+
+        AsyncKms& kms_;
+        const AtomicRequest* request_ = nullptr;
+        std::uint32_t flags_ = 0;
+        std::uint32_t crtc_id_ = 0;
+        std::uint32_t fb_id_ = 0;
+        std::uint64_t serial_ = 0;
+        std::coroutine_handle<> handle_;
+        FlipResult result_;
+        FlipOperation* prev_ = nullptr;
+        FlipOperation* next_ = nullptr;
+        bool linked_ = false;
+    };
+
+    /// Awaitable for the next hotplug; every waiter sees the same event.
+    class HotplugWait {
+    public:
+        HotplugWait(const HotplugWait&) = delete;
+        HotplugWait& operator=(const HotplugWait&) = delete;
+        ~HotplugWait();
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept;
+        HotplugEvent await_resume() const noexcept { return event_; }
+
+    private:
+        friend class AsyncKms;
+        explicit HotplugWait(AsyncKms& kms) noexcept : kms_(kms) {}
+
+        AsyncKms& kms_;
+        std::coroutine_handle<> handle_;
+        HotplugEvent event_;
+        HotplugWait* next_ = nullptr;
+        bool linked_ = false;
+    };
+
+    /// Watches @p device's event fd on @p executor; throws
+    /// std::system_error if it cannot. Coroutines still waiting when the
+    /// AsyncKms is destroyed are never resumed.
+    AsyncKms(Executor& executor, KmsDevice& device);
+    ~AsyncKms();
+    AsyncKms(const AsyncKms&) = delete;
+    AsyncKms& operator=(const AsyncKms&) = delete;
+
+    KmsDevice& device() const noexcept { return device_; }
+
+    /// Legacy page flip of @p crtc_id to @p fb_id.
+    FlipOperation page_flip(std::uint32_t crtc_id, std::uint32_t fb_id) noexcept { return {*this, crtc_id, fb_id}; }
+
+    /// Non-blocking atomic commit of a finalized @p request; resumes when
+    /// the first CRTC it touches completes its flip. @p request must stay
+    /// alive until then.
+    FlipOperation commit(const AtomicRequest& request, std::uint32_t flags = 0) noexcept
+    {
+        return {*this, request, flags};
+    }
+
+    /// A commit that may perform a full mode set.
+    FlipOperation modeset(const AtomicRequest& request) noexcept { return commit(request, commit::AllowModeset); }
+
+    /// Suspends until notify_hotplug() is next called.
+    HotplugWait hotplug() noexcept { return HotplugWait(*this); }
+
+    /// Resumes every coroutine waiting in hotplug(). Called by whatever
+    /// detects connector changes (a uevent listener, a reprobe timer).
+    void notify_hotplug(const HotplugEvent& event) noexcept;
+
+    /// Flips submitted and not yet completed.
+    std::size_t pending() const noexcept { return pending_; }
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    void link(FlipOperation& op) noexcept;
+    void unlink(FlipOperation& op) noexcept;
+    void unlink(HotplugWait& wait) noexcept;
+    void drain() noexcept;
+
+    Executor& executor_;
+    KmsDevice& device_;
+    std::uint64_t serial_ = 0;
+    FlipOperation* flips_ = nullptr;
+    std::size_t pending_ = 0;
+    HotplugWait* hotplug_ = nullptr;
+    HotplugWait* notifying_ = nullptr; ///< Detached by notify_hotplug(), not resumed yet.
+    Stats stats_;
+};
+
+} // namespace dispctrl
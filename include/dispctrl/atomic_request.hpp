@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+namespace dispctrl {
+
+/// A set of KMS property writes destined for one atomic commit.
+///
+/// Writes may arrive in any order and may repeat; finalize() sorts them by
+/// object and property, keeps the last value written to each pair, and lays
+/// them out in the array form DRM_IOCTL_MODE_ATOMIC expects. Storage is
+/// reused across clear() calls, so a request that is refilled every frame
+/// stops allocating once it has seen its largest frame; alternatively it
+/// can be built on a FrameArena and discarded with the frame.
+class AtomicRequest {
+public:
+    explicit AtomicRequest(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : entries_(mr), objects_(mr), counts_(mr), props_(mr), values_(mr)
+    {
+    }
+
+    void set(std::uint32_t object_id, std::uint32_t prop_id, std::uint64_t value);
+
+    /// Appends every write of @p other after the writes already present.
+    void merge(const AtomicRequest& other);
+
+    void clear() noexcept;
+    bool empty() const noexcept { return entries_.empty(); }
+
+    /// Number of writes recorded since the last clear(), duplicates included.
+    std::size_t writes() const noexcept { return entries_.size(); }
+
+    /// Coalesces the recorded writes. Returns how many were superseded by a
+    /// later write to the same property.
+    std::size_t finalize();
+
+    /// After finalize(): removes the writes for which @p drop(object_id,
+    /// prop_id, value) returns true, and objects left without writes.
+    /// Returns how many writes were removed.
+    template <class Drop>
+    std::size_t erase_if(Drop drop);
+
+    // Ioctl arrays; valid after finalize() until the next mutation.
+    std::span<const std::uint32_t> objects() const noexcept { return objects_; }
+    std::span<const std::uint32_t> prop_counts() const noexcept { return counts_; }
+    std::span<const std::uint32_t> props() const noexcept { return props_; }
+    std::span<const std::uint64_t> values() const noexcept { return values_; }
+
+private:
+    struct Entry {
+        std::uint32_t object_id;
+        std::uint32_t prop_id;
+        std::uint64_t value;
+        std::uint32_t order;
+    };
+
+    std::pmr::vector<Entry> entries_;
+    std::pmr::vector<std::uint32_t> objects_;
+    std::pmr::vector<std::uint32_t> counts_;
+    std::pmr::vector<std::uint32_t> props_;
+    std::pmr::vector<std::uint64_t> values_;
+};
+
+template <class Drop>
+std::size_t AtomicRequest::erase_if(Drop drop)
+{
+    // Compacts the ioctl arrays in place (entries_ is left alone), through
+    // raw pointers so the stores need not be assumed to alias the vectors.
+    std::uint32_t* objects = objects_.data();
+    std::uint32_t* counts = counts_.data();
+    std::uint32_t* props = props_.data();
+    std::uint64_t* values = values_.data();
+    const std::size_t object_count = objects_.size();
+    const std::size_t total = props_.size();
+
+    std::size_t read = 0, write = 0, kept_objects = 0;
+    for (std::size_t o = 0; o < object_count; ++o) {
+        const std::uint32_t object_id = objects[o];
+        const std::size_t first = write;
+        for (const std::size_t end = read + counts[o]; read < end; ++read) {
+            if (drop(object_id, props[read], values[read]))
+                continue;
+            props[write] = props[read];
+            values[write] = values[read];
+            ++write;
+        }
+        if (write != first) {
+            objects[kept_objects] = object_id;
+            counts[kept_objects] = static_cast<std::uint32_t>(write - first);
+            ++kept_objects;
+        }
+    }
+    objects_.resize(kept_objects);
+    counts_.resize(kept_objects);
+    props_.resize(write);
+    values_.resize(write);
+    return total - write;
+}
+
+} // namespace dispctrl
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "dispctrl/ddc_queue.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+namespace dispctrl {
+
+/// Something that sets a display's brightness: a kernel backlight device
+/// or a monitor's DDC/CI brightness control.
+class BrightnessSink {
+public:
+    virtual ~BrightnessSink() = default;
+
+    /// Highest level write() accepts; 0 is the lowest.
+    virtual std::uint32_t max_level() const noexcept = 0;
+
+    /// Level in effect when the sink was opened.
+    virtual std::uint32_t initial_level() const noexcept = 0;
+
+    /// Sets the level. May block for as long as the bus needs.
+    virtual std::error_code write(std::uint32_t level) noexcept = 0;
+
+    /// Shortest interval between writes the hardware tolerates.
+    virtual std::uint64_t min_interval_ns() const noexcept = 0;
+};
+
+/// A /sys/class/backlight device (laptop panels, embedded displays).
+class SysfsBacklight final : public BrightnessSink {
+public:
+    /// Opens @p dir, e.g. "/sys/class/backlight/intel_backlight"; throws
+    /// std::system_error if it is not a usable backlight.
+    static std::unique_ptr<SysfsBacklight> open(const std::string& dir);
+
+    std::uint32_t max_level() const noexcept override { return max_; }
+    std::uint32_t initial_level() const noexcept override { return initial_; }
+    std::error_code write(std::uint32_t level) noexcept override;
+    std::uint64_t min_interval_ns() const noexcept override { return 0; }
+
+private:
+    SysfsBacklight(UniqueFd brightness, std::uint32_t max, std::uint32_t initial) noexcept
+        : fd_(std::move(brightness)), max_(max), initial_(initial)
+    {
+    }
+
+    UniqueFd fd_;
+    std::uint32_t max_;
+    std::uint32_t initial_;
+};
+
+/// Brightness (VCP feature 0x10) of an external monitor over DDC/CI.
+///
+/// Writes go through a DdcQueue for the bus, which keeps the MCCS delays
+/// between transactions and folds a write into one still waiting, so
+/// write() returns at once; a write that failed on the bus is reported by
+/// the next call. Other commands for the monitor belong on the same queue
+/// (queue()) so they are ordered with the brightness writes and share the
+/// bus timing.
+class DdcBacklight final : public BrightnessSink {
+public:
+    /// Opens the monitor on @p i2c_dev, e.g. "/dev/i2c-5", and queries
+    /// the brightness range; throws std::system_error on failure.
+    static std::unique_ptr<DdcBacklight> open(const std::string& i2c_dev, DdcTiming timing = {});
+
+    /// As above, over an already open bus.
+    static std::unique_ptr<DdcBacklight> open(std::unique_ptr<DdcTransport> bus, DdcTiming timing = {});
+
+    /// Waits for the last write to reach the monitor.
+    ~DdcBacklight() override;
+    DdcBacklight(const DdcBacklight&) = delete;
+    DdcBacklight& operator=(const DdcBacklight&) = delete;
+
+    std::uint32_t max_level() const noexcept override { return max_; }
+    std::uint32_t initial_level() const noexcept override { return initial_; }
+    std::error_code write(std::uint32_t level) noexcept override;
+    std::uint64_t min_interval_ns() const noexcept override { return interval_ns_; }
+
+    DdcQueue& queue() noexcept { return *queue_; }
+
+private:
+    DdcBacklight(std::unique_ptr<DdcTransport> bus, DdcTiming timing);
+
+    static std::unique_ptr<DdcBacklight> create(std::unique_ptr<DdcTransport> bus, DdcTiming timing,
+                                                const std::string& name);
+
+    std::unique_ptr<DdcTransport> bus_;
+    std::mutex mutex_;
+    std::error_code error_; ///< Of a write that failed since the last write() call.
+    // After the state its callbacks touch, so its worker stops first.
+    std::unique_ptr<DdcQueue> queue_;
+    const std::uint64_t interval_ns_;
+    std::uint32_t max_ = 0;
+    std::uint32_t initial_ = 0;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "dispctrl/backlight.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace dispctrl {
+
+/// How a ramp moves between two brightness values.
+enum class RampCurve : std::uint8_t {
+    Linear,     ///< Linear in sink levels.
+    Perceptual, ///< Linear in perceived lightness (gamma 2.2), so dimming looks even.
+};
+
+/// Animates brightness changes on a BrightnessSink from a worker thread.
+///
+/// set() only records the new target and returns; the worker samples the
+/// ramp and writes the value for *now*, no faster than the sink allows
+/// (and no faster than its previous write took). Intermediate values the
+/// bus had no time for are skipped rather than queued, so a slow DDC/CI
+/// monitor follows the same curve in fewer, larger steps and a retarget
+/// mid-ramp continues smoothly from wherever the ramp was. A write that
+/// still fails after kMaxRetries retries makes the worker give the target
+/// up, so an unplugged monitor is not retried forever; the next set()
+/// tries again.
+class BrightnessRamp {
+public:
+    struct Stats {
+        std::uint64_t writes = 0;
+        std::uint64_t superseded = 0; ///< Targets replaced before they were reached.
+        std::uint64_t errors = 0;
+        std::uint64_t abandoned = 0; ///< Targets given up once their retries failed.
+        std::error_code last_error;
+    };
+
+    /// Retries of a failed write before its target is given up.
+    static constexpr unsigned kMaxRetries = 3;
+
+    /// Upper bound on the step rate for fast sinks such as sysfs.
+    static constexpr std::uint64_t kDefaultStepNs = 1'000'000'000 / 120;
+
+    /// Starts the worker; throws std::system_error if it cannot. The sink
+    /// must outlive the ramp and is only used from the worker thread.
+    explicit BrightnessRamp(BrightnessSink& sink, RampCurve curve = RampCurve::Perceptual,
+                            std::uint64_t step_ns = kDefaultStepNs);
+    ~BrightnessRamp();
+    BrightnessRamp(const BrightnessRamp&) = delete;
+    BrightnessRamp& operator=(const BrightnessRamp&) = delete;
+
+    /// Ramps to @p target (0 = darkest, 1 = brightest) over
+    /// @p duration_ns; 0 jumps at the next write. Thread-safe.
+    void set(double target, std::uint64_t duration_ns = 0);
+
+    /// Brightness most recently written to the sink, in [0, 1].
+    double current() const;
+
+    /// True once the last target has been written or given up.
+    bool idle() const;
+
+    Stats stats() const;
+
+private:
+    struct Ramp {
+        double from;
+        double to;
+        std::uint64_t start_ns;
+        std::uint64_t duration_ns;
+    };
+
+    double value_at(std::uint64_t now_ns) const noexcept;
+    void worker();
+
+    BrightnessSink& sink_;
+    const RampCurve curve_;
+    const std::uint64_t step_ns_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    Ramp ramp_;
+    bool pending_ = false; ///< Target not yet reached on the sink.
+    bool stopping_ = false;
+    std::uint64_t generation_ = 0; ///< Bumped by set(), to spot retargets.
+    unsigned failures_ = 0;        ///< Failed writes in a row.
+    std::uint32_t written_level_;
+    Stats stats_;
+    std::thread thread_;
+};
+
+} // namespace dispctrl
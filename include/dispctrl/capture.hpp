@@ -0,0 +1,351 @@
+#pragma once
+
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/format.hpp"
+#include "dispctrl/framebuffer.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace dispctrl {
+
+/// Size and layout of the buffers a CapturePool hands out.
+struct CaptureFormat {
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint32_t fourcc = fourcc::XRGB8888;
+    std::uint64_t modifier = modifier::Linear;
+};
+
+/// Row pitch capture buffers are aligned to; enough for the display
+/// engines and encoders that import them.
+inline constexpr std::uint32_t kCapturePitchAlign = 256;
+
+/// Fills in the linear layout of @p format, all planes in one buffer
+/// (plane fds left at -1), and the buffer's size in bytes. Fails with
+/// not_supported for unknown formats and non-linear modifiers.
+std::error_code linear_capture_layout(const CaptureFormat& format, DmaBufDesc& desc, std::size_t& size) noexcept;
+
+/// Allocates the DMA-BUFs of a CapturePool: memory the display engine (or
+/// GPU) writes and the encoder reads, so it must be importable by both.
+class CaptureAllocator {
+public:
+    virtual ~CaptureAllocator() = default;
+
+    /// Allocates one buffer of @p format. @p fd owns it; the plane fds of
+    /// @p desc refer to it.
+    virtual std::error_code allocate(const CaptureFormat& format, UniqueFd& fd, DmaBufDesc& desc) = 0;
+};
+
+/// CaptureAllocator on a DMA-BUF heap (/dev/dma_heap/<name>), which V4L2
+/// and VA-API encoders import from. Linear layouts only.
+class DmaHeapAllocator final : public CaptureAllocator {
+public:
+    /// Opens heap @p name: "system", or a CMA heap such as "linux,cma" for
+    /// display engines without an IOMMU. Throws std::system_error if it
+    /// cannot be opened.
+    static std::unique_ptr<DmaHeapAllocator> open(const std::string& name = "system");
+
+    std::error_code allocate(const CaptureFormat& format, UniqueFd& fd, DmaBufDesc& desc) override;
+
+private:
+    explicit DmaHeapAllocator(UniqueFd heap) noexcept : heap_(std::move(heap)) {}
+
+    UniqueFd heap_;
+};
+
+class CapturePool;
+
+/// A buffer lent out by a CapturePool; goes back to the pool when the
+/// lease is destroyed or reset(), from any thread.
+class CaptureLease {
+public:
+    CaptureLease() noexcept = default;
+    ~CaptureLease() { reset(); }
+    CaptureLease(CaptureLease&& other) noexcept : pool_(std::exchange(other.pool_, nullptr)), index_(other.index_) {}
+    CaptureLease& operator=(CaptureLease&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            pool_ = std::exchange(other.pool_, nullptr);
+            index_ = other.index_;
+        }
+        return *this;
+    }
+    CaptureLease(const CaptureLease&) = delete;
+    CaptureLease& operator=(const CaptureLease&) = delete;
+
+    explicit operator bool() const noexcept { return pool_ != nullptr; }
+
+    /// The DMA-BUF; its fds stay owned by the pool (dup them to keep
+    /// them past the lease).
+    const DmaBufDesc& buffer() const noexcept;
+
+    /// Its KMS framebuffer; 0 if the pool has no importer.
+    std::uint32_t fb_id() const noexcept;
+
+    void reset() noexcept;
+
+private:
+    friend class CapturePool;
+    CaptureLease(CapturePool* pool, std::uint32_t index) noexcept : pool_(pool), index_(index) {}
+
+    CapturePool* pool_ = nullptr;
+    std::uint32_t index_ = 0;
+};
+
+/// Fixed set of reusable capture buffers of one format.
+///
+/// Buffers are allocated on first need, up to a limit, and then cycle:
+/// a capture writes into a free one and the encoder returns it by
+/// dropping the lease, so the steady state allocates nothing, and an
+/// encoder that caches its imports by fd sees the same few buffers. When
+/// every buffer is lent out the capture is skipped instead of waiting.
+///
+/// acquire() belongs to one thread; leases may be released from any.
+class CapturePool {
+public:
+    struct Stats {
+        std::uint64_t allocated = 0; ///< Buffers allocated.
+        std::uint64_t acquired = 0;  ///< Leases handed out.
+        std::uint64_t exhausted = 0; ///< acquire() calls that found every buffer lent out.
+    };
+
+    /// @p importer, if not null, also turns every buffer into a KMS
+    /// framebuffer, which writeback needs. @p allocator and @p importer
+    /// must outlive the pool, and the pool every lease.
+    CapturePool(CaptureAllocator& allocator, FramebufferImporter* importer, const CaptureFormat& format,
+                std::size_t max_buffers = 3);
+    ~CapturePool();
+    CapturePool(const CapturePool&) = delete;
+    CapturePool& operator=(const CapturePool&) = delete;
+
+    /// Lends out a free buffer, allocating one if the limit allows. Fails
+    /// with errc::resource_unavailable_try_again when all are lent out.
+    std::error_code acquire(CaptureLease& out);
+
+    const CaptureFormat& format() const noexcept { return format_; }
+    std::size_t max_buffers() const noexcept { return max_buffers_; }
+    Stats stats() const;
+
+private:
+    friend class CaptureLease;
+
+    struct Slot {
+        UniqueFd fd;
+        DmaBufDesc desc;
+        std::shared_ptr<Framebuffer> fb;
+        bool lent = false;
+    };
+
+    void release(std::uint32_t index) noexcept;
+
+    CaptureAllocator& allocator_;
+    FramebufferImporter* importer_;
+    const CaptureFormat format_;
+    const std::size_t max_buffers_;
+
+    mutable std::mutex mutex_;
+    std::vector<Slot> slots_; ///< Reserved up front; never reallocates, so leases may point into it.
+    std::size_t reserved_ = 0; ///< Slots being allocated outside the lock.
+    Stats stats_;
+};
+
+/// A captured frame, handed to the encoder without copying it.
+struct CaptureFrame {
+    std::uint32_t source_id = 0; ///< CRTC or plane captured.
+    std::uint64_t sequence = 0;  ///< Counts the frames delivered for the source.
+    std::uint64_t request_ns = 0; ///< When the capture was taken from the schedule.
+    std::uint64_t serial = 0;    ///< Writeback: the commit carrying it (CommitReport::serial).
+    /// Signals once the buffer holds the frame. Pass it to an encoder that
+    /// takes fences, or wait for it on the encoder's thread, before reading.
+    UniqueFd fence;
+    CaptureLease buffer;
+};
+
+/// Receives captured frames; own the frame (and so the buffer) for as long
+/// as the encoder reads it.
+using FrameCallback = std::function<void(CaptureFrame frame)>;
+
+/// When a capture source is snapshotted.
+struct CaptureSchedule {
+    std::uint64_t interval_ns = 200'000'000; ///< 5 frames per second; 0 captures on request only.
+    /// Offset of the first capture from the first poll, to spread the
+    /// captures of many heads over the interval.
+    std::uint64_t phase_ns = 0;
+};
+
+/// Tracks when a CaptureSchedule is next due.
+class CaptureTimer {
+public:
+    explicit CaptureTimer(const CaptureSchedule& schedule) noexcept : schedule_(schedule) {}
+
+    /// True if a capture is due at @p now_ns, which then moves on to the
+    /// next slot. Slots missed entirely are dropped, not caught up.
+    bool take(std::uint64_t now_ns) noexcept;
+
+    /// Makes the next take() succeed, on top of the schedule.
+    void request() noexcept { requested_ = true; }
+
+    /// Next slot: 1 (at once) after request(); 0 until the first take(),
+    /// or without an interval.
+    std::uint64_t next_ns() const noexcept { return requested_ ? 1 : next_ns_; }
+
+private:
+    CaptureSchedule schedule_;
+    std::uint64_t next_ns_ = 0;
+    bool requested_ = false;
+};
+
+/// Property ids of a writeback connector.
+struct WritebackConnector {
+    std::uint32_t connector_id = 0;
+    std::uint32_t crtc_prop = 0;  ///< CRTC_ID.
+    std::uint32_t fb_prop = 0;    ///< WRITEBACK_FB_ID.
+    std::uint32_t fence_prop = 0; ///< WRITEBACK_OUT_FENCE_PTR.
+};
+
+/// Looks up the properties of writeback connector @p connector_id.
+/// Writeback connectors are listed only on a DrmDevice that has called
+/// enable_writeback().
+std::error_code find_writeback_connector(KmsDevice& device, std::uint32_t connector_id,
+                                         WritebackConnector& out) noexcept;
+
+/// Captures the output of one CRTC through a writeback connector.
+///
+/// The display engine writes each captured frame into a pool buffer while
+/// it scans the frame out, so nothing is read back or copied on the CPU
+/// and the frame loop never waits: poll() adds a writeback job to the
+/// frame being recorded in the CRTC's CommitQueue, and the frame, with the
+/// fence that signals once it is written, goes to the callback as soon as
+/// the commit has been submitted. At most one job waits in the queue; a
+/// slot that comes while every buffer is with the encoder is skipped.
+///
+/// Routing the connector onto the CRTC, or off it, is a mode set to the
+/// kernel, so it belongs to head setup: bind() during the head's mode set
+/// and unbind() with its teardown or next mode change. The capture never
+/// sets ALLOW_MODESET itself; poll() does nothing until bound. The pool's
+/// buffers must match the CRTC's mode and have framebuffers.
+/// Single-threaded, like the CommitQueue.
+class WritebackCapture {
+public:
+    struct Stats {
+        std::uint64_t queued = 0;    ///< Writeback jobs added to a batch.
+        std::uint64_t delivered = 0; ///< Frames handed to the callback.
+        std::uint64_t skipped = 0;   ///< Slots dropped for want of a free buffer.
+        std::uint64_t failed = 0;    ///< Jobs whose commit failed or that were dropped.
+    };
+
+    /// @p queue and @p pool must outlive the capture. A queued job reports
+    /// back to the capture, so do not destroy it while pending().
+    WritebackCapture(CommitQueue& queue, const WritebackConnector& connector, CapturePool& pool,
+                     FrameCallback callback, CaptureSchedule schedule = {});
+
+    /// Records the connector's CRTC_ID binding to the queue's CRTC with the
+    /// pending batch. Call it while recording the head's mode set, whose
+    /// commit carries ALLOW_MODESET (CommitQueue::allow_modeset()).
+    void bind();
+
+    /// Records the connector's release from the CRTC, likewise for a batch
+    /// committed with a mode set. A job poll() added must have been
+    /// committed first: the kernel rejects a writeback on an unbound
+    /// connector.
+    void unbind();
+
+    bool bound() const noexcept { return bound_; }
+
+    /// Adds a writeback job to the pending batch if the connector is bound
+    /// and a capture is due; true if it did. An idle head must then flush()
+    /// the queue for the job to be committed.
+    bool poll(std::uint64_t now_ns);
+
+    /// Captures with the next poll(), on top of the schedule (a screenshot).
+    void request() noexcept { timer_.request(); }
+
+    /// A job is waiting in the queue's pending batch.
+    bool pending() const noexcept { return static_cast<bool>(pending_); }
+
+    /// When poll() next has work; 0 without a schedule.
+    std::uint64_t next_deadline() const noexcept { return timer_.next_ns(); }
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    void written(std::uint64_t serial, std::error_code ec, UniqueFd fence);
+
+    CommitQueue& queue_;
+    const WritebackConnector connector_;
+    CapturePool& pool_;
+    FrameCallback callback_;
+    CaptureTimer timer_;
+    bool bound_ = false;
+    CaptureLease pending_; ///< Buffer of the job waiting in the queue.
+    std::uint64_t pending_ns_ = 0;
+    std::uint64_t sequence_ = 0;
+    Stats stats_;
+};
+
+/// Copies one buffer into another on a GPU or another copy engine.
+class ReadbackEngine {
+public:
+    virtual ~ReadbackEngine() = default;
+
+    /// Queues a copy of @p src into @p dst, converted and scaled to the
+    /// format and size of @p dst, that starts once @p src_fence has
+    /// signalled (-1: at once). @p done receives a fence that signals when
+    /// @p dst is written. Returns without waiting for the copy.
+    virtual std::error_code copy(const DmaBufDesc& src, int src_fence, const DmaBufDesc& dst, UniqueFd& done) = 0;
+};
+
+/// Captures the buffers presented on one plane, or on a CRTC without a
+/// writeback connector, by copying them into pool buffers with a
+/// ReadbackEngine.
+///
+/// The copy is queued behind the buffer's render fence and the frame goes
+/// to the callback at once, with the copy's fence: neither the frame loop
+/// nor the CPU waits for the GPU, and no pixel passes through the CPU.
+/// Offer every buffer presented; only those falling on the schedule are
+/// copied. Single-threaded.
+class ReadbackCapture {
+public:
+    struct Stats {
+        std::uint64_t delivered = 0; ///< Copies queued and handed to the callback.
+        std::uint64_t skipped = 0;   ///< Slots dropped for want of a free buffer.
+        std::uint64_t failed = 0;    ///< Copies the engine refused.
+    };
+
+    /// Reports frames as coming from @p source_id (a plane or CRTC id).
+    ReadbackCapture(ReadbackEngine& engine, CapturePool& pool, std::uint32_t source_id, FrameCallback callback,
+                    CaptureSchedule schedule = {});
+
+    /// Offers @p src, the buffer being presented with render fence
+    /// @p src_fence (-1 if none). If it is copied, @p copy_fence receives
+    /// the copy's fence: the client must not render into @p src again
+    /// before it signals, so merge it into the buffer's release
+    /// (merge_fences()). It is left empty otherwise.
+    std::error_code offer(const DmaBufDesc& src, int src_fence, std::uint64_t now_ns, UniqueFd& copy_fence);
+
+    void request() noexcept { timer_.request(); }
+    std::uint64_t next_deadline() const noexcept { return timer_.next_ns(); }
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    ReadbackEngine& engine_;
+    CapturePool& pool_;
+    const std::uint32_t source_id_;
+    FrameCallback callback_;
+    CaptureTimer timer_;
+    std::uint64_t sequence_ = 0;
+    Stats stats_;
+};
+
+} // namespace dispctrl
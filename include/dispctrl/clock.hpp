@@ -0,0 +1,17 @@
+#pragma once
+
+#include <time.h>
+
+#include <cstdint>
+
+namespace dispctrl {
+
+/// CLOCK_MONOTONIC in nanoseconds, the time base of DRM event timestamps.
+inline std::uint64_t monotonic_ns() noexcept
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1'000'000'000ULL + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+} // namespace dispctrl
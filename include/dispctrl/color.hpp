@@ -0,0 +1,105 @@
+#pragma once
+
+#include "dispctrl/hash.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace dispctrl {
+
+/// A per-channel transfer function mapping encoded values in [0, 1] to
+/// linear light in [0, 1].
+///
+/// Parametric curves use the general ICC form (parametricCurveType 4):
+/// Y = (a X + b)^g + e for X >= d, and Y = c X + f below; the simpler
+/// ICC function types and plain gammas are expressed in it. Sampled
+/// curves (ICC 'curv' tables) are interpolated linearly.
+struct ToneCurve {
+    enum class Type : std::uint8_t { Parametric, Table };
+
+    Type type = Type::Parametric;
+    double g = 1.0, a = 1.0, b = 0.0, c = 0.0, d = 0.0, e = 0.0, f = 0.0;
+    std::vector<double> table;
+
+    static ToneCurve gamma(double g) noexcept;
+    static ToneCurve srgb() noexcept;
+
+    /// Encoded to linear.
+    double eval(double x) const noexcept;
+    /// Linear to encoded; curves are assumed monotonic.
+    double inverse(double y) const noexcept;
+
+    std::uint64_t hash(std::uint64_t seed = kFnvOffset) const noexcept;
+};
+
+/// An RGB colour space as linear RGB -> CIE XYZ (D50, the ICC profile
+/// connection space) plus the transfer function of each channel.
+struct ColorProfile {
+    std::array<double, 9> to_xyz{}; ///< Row-major.
+    ToneCurve trc[3];
+
+    /// Content hash, for keying caches and ConnectorConfig::color_profile.
+    std::uint64_t hash() const noexcept;
+};
+
+struct Chromaticity {
+    double x = 0;
+    double y = 0;
+};
+
+/// Gamut description as found in EDIDs and video metadata.
+struct ColorPrimaries {
+    Chromaticity red, green, blue, white;
+};
+
+inline constexpr ColorPrimaries kSrgbPrimaries{{0.640, 0.330}, {0.300, 0.600}, {0.150, 0.060}, {0.3127, 0.3290}};
+inline constexpr ColorPrimaries kDisplayP3Primaries{{0.680, 0.320}, {0.265, 0.690}, {0.150, 0.060}, {0.3127, 0.3290}};
+inline constexpr ColorPrimaries kBt2020Primaries{{0.708, 0.292}, {0.170, 0.797}, {0.131, 0.046}, {0.3127, 0.3290}};
+
+/// Builds a profile from primaries (Bradford-adapted to D50) and one
+/// transfer function for all channels.
+ColorProfile make_color_profile(const ColorPrimaries& primaries, const ToneCurve& trc);
+
+/// Row-major matrix from linear @p source RGB to linear @p display RGB.
+std::array<double, 9> color_matrix(const ColorProfile& source, const ColorProfile& display) noexcept;
+
+/// The sRGB profile (IEC 61966-2-1).
+ColorProfile srgb_profile();
+
+/// Decodes a matrix/TRC ICC profile (v2 or v4): the rXYZ/gXYZ/bXYZ
+/// colorants and rTRC/gTRC/bTRC curves ('curv' or 'para'). Returns
+/// errc::not_supported for LUT-based profiles without colorant tags,
+/// and errc::invalid_argument for blobs that are not RGB ICC profiles.
+std::error_code parse_icc_profile(std::span<const std::uint8_t> blob, ColorProfile& out);
+
+/// A precomputed RGB -> RGB transform for 8-bit pixels: a per-channel
+/// shaper into lattice coordinates, then a size^3 lattice interpolated
+/// tetrahedrally (four lattice reads per pixel instead of eight).
+struct Lut3d {
+    static constexpr std::uint32_t kDefaultSize = 17;
+
+    std::uint32_t size = 0;
+    /// Input byte -> offset of its lattice cell << 9 | fraction within
+    /// the cell (0-256), per channel; offsets include the channel stride.
+    std::array<std::array<std::uint32_t, 256>, 3> shaper{};
+    /// Output RGB in 1/16 of an 8-bit step, packed into 21-bit lanes
+    /// (red << 42 | green << 21 | blue) so one multiply weighs all three
+    /// channels; blue varies fastest.
+    std::vector<std::uint64_t> lattice;
+};
+
+/// Samples the source -> display transform into a LUT. A shaper that
+/// redistributes the lattice is used when the source encoding is close
+/// to linear light; otherwise the lattice is spaced evenly.
+Lut3d build_lut3d(const ColorProfile& source, const ColorProfile& display,
+                  std::uint32_t size = Lut3d::kDefaultSize);
+
+/// Applies @p lut to @p width XRGB8888 pixels in place; the X byte is
+/// kept.
+void apply_lut3d(const Lut3d& lut, std::uint32_t* pixels, std::uint32_t width) noexcept;
+
+} // namespace dispctrl
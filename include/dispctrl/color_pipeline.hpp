@@ -0,0 +1,151 @@
+#pragma once
+
+#include "dispctrl/color.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace dispctrl {
+
+class CommitQueue;
+class KmsDevice;
+
+/// One entry of a DEGAMMA_LUT or GAMMA_LUT blob (struct drm_color_lut).
+struct ColorLutEntry {
+    std::uint16_t red = 0;
+    std::uint16_t green = 0;
+    std::uint16_t blue = 0;
+    std::uint16_t reserved = 0;
+};
+
+/// Colour management hardware of a CRTC, from its DEGAMMA_LUT_SIZE and
+/// GAMMA_LUT_SIZE properties and the presence of a CTM property.
+struct CrtcColorCaps {
+    std::uint32_t degamma_size = 0;
+    std::uint32_t gamma_size = 0;
+    bool ctm = false;
+
+    bool operator==(const CrtcColorCaps&) const noexcept = default;
+};
+
+/// The programming that shows content in one profile correctly on a
+/// display in another, computed once per profile pair.
+///
+/// When the CRTC has the full DEGAMMA_LUT -> CTM -> GAMMA_LUT chain the
+/// transform is offloaded: the source curves linearise, the matrix maps
+/// between gamuts and the inverse display curves re-encode. A CRTC with
+/// only a GAMMA_LUT can still take transforms whose matrix is the
+/// identity, as one composed curve. Anything else falls back to a 3D LUT
+/// applied during software composition, and the hardware is left in
+/// bypass.
+struct ColorTransform {
+    bool offloaded = true;
+    std::vector<ColorLutEntry> degamma; ///< Empty: property cleared.
+    std::vector<ColorLutEntry> gamma;
+    std::array<std::uint64_t, 9> ctm{}; ///< S31.32 sign-magnitude (struct drm_color_ctm).
+    bool has_ctm = false;
+    Lut3d lut3d; ///< Only when !offloaded.
+
+    /// Content hashes of the three blobs; 0 for a cleared property.
+    std::uint64_t degamma_hash = 0;
+    std::uint64_t ctm_hash = 0;
+    std::uint64_t gamma_hash = 0;
+};
+
+ColorTransform build_color_transform(const ColorProfile& source, const ColorProfile& display,
+                                     const CrtcColorCaps& caps);
+
+/// Process-wide cache of ColorTransforms keyed by profile contents and
+/// CRTC capabilities, so heads sharing a calibration and repeated
+/// switches between the same profiles cost a hash lookup. Least recently
+/// used entries are evicted; thread-safe, building runs outside the lock.
+class ColorTransformCache {
+public:
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+    };
+
+    explicit ColorTransformCache(std::size_t capacity = 16) noexcept : capacity_(capacity ? capacity : 1) {}
+
+    std::shared_ptr<const ColorTransform> lookup(const ColorProfile& source, const ColorProfile& display,
+                                                 const CrtcColorCaps& caps);
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::uint64_t key;
+        std::uint64_t source;
+        std::uint64_t display;
+        CrtcColorCaps caps;
+        std::shared_ptr<const ColorTransform> transform;
+    };
+    using Lru = std::list<Entry>;
+
+    const std::size_t capacity_;
+    mutable std::mutex mutex_;
+    Lru lru_; ///< Most recently used first.
+    std::unordered_map<std::uint64_t, Lru::iterator> index_;
+    Stats stats_;
+};
+
+/// Colour state of one CRTC.
+///
+/// set_profiles() picks the transform (from the cache) and apply() queues
+/// only the blobs whose contents differ from what was last queued, so an
+/// unchanged calibration costs no blob creation and no property writes.
+/// When the transform is not offloaded, pass software_lut() to
+/// TileCompositor::set_color_lut().
+class ColorPipeline {
+public:
+    struct Stats {
+        std::uint64_t uploads = 0; ///< Blob or property writes queued.
+        std::uint64_t skipped = 0; ///< Writes avoided because the value was unchanged.
+    };
+
+    /// Resolves the colour properties present in @p caps; throws
+    /// std::system_error if one is missing.
+    ColorPipeline(KmsDevice& device, std::uint32_t crtc_id, const CrtcColorCaps& caps, ColorTransformCache& cache);
+
+    void set_profiles(const ColorProfile& source, const ColorProfile& display);
+
+    bool offloaded() const noexcept { return !transform_ || transform_->offloaded; }
+
+    /// The software fallback, or nullptr when the CRTC does the work.
+    const Lut3d* software_lut() const noexcept { return offloaded() ? nullptr : &transform_->lut3d; }
+
+    /// Queues the changed colour properties on @p queue.
+    std::error_code apply(CommitQueue& queue);
+
+    /// Forgets what the hardware holds, e.g. after a failed commit or when
+    /// another client had the device; the next apply() rewrites all.
+    void invalidate() noexcept { known_ = false; }
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    std::uint32_t crtc_id_;
+    CrtcColorCaps caps_;
+    ColorTransformCache& cache_;
+    std::uint32_t degamma_prop_ = 0;
+    std::uint32_t ctm_prop_ = 0;
+    std::uint32_t gamma_prop_ = 0;
+
+    std::shared_ptr<const ColorTransform> transform_;
+    bool known_ = false; ///< The hashes below reflect the hardware.
+    std::uint64_t degamma_hash_ = 0;
+    std::uint64_t ctm_hash_ = 0;
+    std::uint64_t gamma_hash_ = 0;
+    Stats stats_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,274 @@
+#pragma once
+
+#include "dispctrl/atomic_request.hpp"
+#include "dispctrl/frame_arena.hpp"
+#include "dispctrl/histogram.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <system_error>
+#include <vector>
+
+namespace dispctrl {
+
+class KmsShadow;
+
+/// Timing of one atomic commit, reported when its flip completes.
+struct CommitReport {
+    std::uint64_t serial = 0;
+    std::size_t properties = 0; ///< Property writes sent to the kernel.
+    std::size_t superseded = 0; ///< Writes folded into a later write.
+    std::size_t unchanged = 0;  ///< Writes dropped as already in place (see set_shadow()).
+    std::uint64_t first_write_ns = 0; ///< First set() of the batch.
+    std::uint64_t submit_ns = 0;      ///< Entry into the atomic ioctl.
+    std::uint64_t ioctl_ns = 0;       ///< Time spent inside the ioctl.
+    std::uint64_t complete_ns = 0;    ///< Flip-complete (vblank) timestamp.
+    std::size_t latched = 0;          ///< Writes from set_latched() carried by this commit.
+    std::uint64_t latched_input_ns = 0; ///< Newest input timestamp among them.
+    bool latch_only = false;          ///< Submitted by flush_latched() without a frame.
+    std::size_t in_fences = 0;        ///< IN_FENCE_FDs carried by this commit.
+    std::uint64_t fence_signal_ns = 0; ///< When the last of them signalled; 0 without fences.
+    bool writeback = false;           ///< Carried a writeback job (set_writeback()).
+
+    /// Submission to the flip reaching the screen.
+    std::uint64_t latency_ns() const noexcept { return complete_ns > submit_ns ? complete_ns - submit_ns : 0; }
+
+    /// How long the kernel held the commit for rendering to finish.
+    std::uint64_t fence_wait_ns() const noexcept { return fence_signal_ns > submit_ns ? fence_signal_ns - submit_ns : 0; }
+};
+
+/// Batches the plane, CRTC and connector property writes of one head into
+/// at most one atomic commit per vblank.
+///
+/// set() only records a write. flush() submits everything recorded so far
+/// as a single non-blocking commit; while that commit is in flight, new
+/// writes accumulate and a further flush() is deferred until the flip
+/// completes, so a frame's worth of changes always lands in one ioctl.
+/// Repeated writes to the same property collapse to the last value.
+///
+/// Each batch is built on a per-queue FrameArena that is reset once the
+/// batch has been submitted, so a steady-state frame loop does not touch
+/// the heap.
+///
+/// Writes that must not wait for the frame (cursor and small overlay
+/// positions) go through set_latched() instead: they join whichever commit
+/// is submitted next, a frame's flush() or a flush_latched() that sends
+/// them on their own, without the half-recorded frame (see CursorLatch).
+///
+/// With a KmsShadow (set_shadow()), writes that would not change the
+/// committed state are dropped before the ioctl, and a batch left with
+/// nothing to send is not committed at all: flush() then returns without
+/// a flip, and no report follows.
+///
+/// Explicit synchronisation: a buffer whose rendering has been queued but
+/// not finished is committed with its render fence (set_in_fence()), and
+/// the kernel holds the flip until the fence signals, instead of the
+/// compositor waiting for the GPU before it records the frame; the client
+/// can meanwhile queue the next frame. With set_out_fence() every frame
+/// commit also returns a fence that signals once its flip has landed, the
+/// release fence for the buffers it replaces. fence_wait() shows how long
+/// scanout waited on rendering.
+///
+/// A writeback job (set_writeback()) rides along with the frame it
+/// captures: the display engine writes the CRTC's output into the job's
+/// framebuffer while scanning it out, and the fence returned at
+/// submission signals once it is written. Nothing waits for it here.
+///
+/// The queue owns the flip events of its CRTC: feed it every FlipComplete
+/// event for that CRTC and do not drive the CRTC through other pipelines.
+class CommitQueue {
+public:
+    using ReportCallback = std::function<void(const CommitReport&)>;
+
+    struct Stats {
+        std::uint64_t commits = 0;
+        std::uint64_t writes = 0;
+        std::uint64_t superseded = 0;
+        std::uint64_t deferred = 0; ///< flush() calls postponed by an in-flight commit.
+        std::uint64_t busy = 0;     ///< Commits the kernel rejected with EBUSY and that were retried.
+        std::uint64_t failed = 0;
+        std::uint64_t latch_commits = 0; ///< Commits made by flush_latched().
+        std::uint64_t unchanged = 0;     ///< Writes dropped by the shadow.
+        std::uint64_t skipped = 0;       ///< Batches that changed nothing and were not committed.
+        std::uint64_t in_fences = 0;     ///< In-fences committed.
+        std::uint64_t fence_waits = 0;   ///< Of those, fences that signalled after submission.
+        std::uint64_t out_fences = 0;
+        std::uint64_t writebacks = 0;    ///< Writeback jobs committed.
+    };
+
+    /// Receives the out-fence of the commit with @p serial (see
+    /// CommitReport::serial), right after its submission.
+    using OutFenceCallback = std::function<void(std::uint64_t serial, UniqueFd fence)>;
+
+    /// Receives the fence of a writeback job once the commit with
+    /// @p serial carrying it has been submitted, or the error that dropped
+    /// the job (serial 0).
+    using WritebackCallback = std::function<void(std::uint64_t serial, std::error_code ec, UniqueFd fence)>;
+
+    /// Distinct (object, property) pairs set_latched() can hold.
+    static constexpr std::size_t kMaxLatched = 16;
+
+    CommitQueue(KmsDevice& device, std::uint32_t crtc_id) noexcept : device_(device), crtc_id_(crtc_id) {}
+    ~CommitQueue() { end_batch(); }
+    CommitQueue(const CommitQueue&) = delete;
+    CommitQueue& operator=(const CommitQueue&) = delete;
+
+    std::uint32_t crtc_id() const noexcept { return crtc_id_; }
+
+    void set_report_callback(ReportCallback cb) { report_ = std::move(cb); }
+
+    /// Diffs every commit against @p shadow, which records what the kernel
+    /// accepted; share one per device between all its queues. nullptr
+    /// sends every write. The shadow must outlive its use.
+    void set_shadow(KmsShadow* shadow) noexcept { shadow_ = shadow; }
+    KmsShadow* shadow() const noexcept { return shadow_; }
+
+    void set(std::uint32_t object_id, std::uint32_t prop_id, std::uint64_t value);
+
+    /// Wraps @p data in a property blob and queues it as the value of
+    /// @p prop_id. The queue destroys the blob once the batch containing it
+    /// has been submitted (or dropped). With a shadow, data equal to the
+    /// blob the property already holds creates no blob, unless the
+    /// property is volatile.
+    std::error_code set_blob(std::uint32_t object_id, std::uint32_t prop_id, const void* data, std::size_t size);
+
+    /// Records a write that may be committed ahead of the frame being
+    /// recorded. @p input_ns is the time of the input it reflects, for
+    /// CommitReport::latched_input_ns. Fails with no_buffer_space when
+    /// kMaxLatched other pairs are already waiting.
+    std::error_code set_latched(std::uint32_t object_id, std::uint32_t prop_id, std::uint64_t value,
+                                std::uint64_t input_ns = 0) noexcept;
+
+    /// Submits the latched writes alone if no commit is in flight; they
+    /// otherwise stay queued for the next commit. The pending frame batch
+    /// is left untouched.
+    std::error_code flush_latched();
+
+    bool has_latched() const noexcept { return latched_count_ != 0; }
+
+    /// Commits @p fence as the IN_FENCE_FD (@p prop_id) of @p plane_id
+    /// with the pending batch, normally alongside the FB_ID it guards. The
+    /// queue owns the fd until the flip completes, then reads its signal
+    /// time for fence_wait(); a later fence for the same plane in the same
+    /// batch replaces it. With a shadow, the property is registered as
+    /// volatile.
+    void set_in_fence(std::uint32_t plane_id, std::uint32_t prop_id, UniqueFd fence);
+
+    /// Requests the CRTC's OUT_FENCE_PTR (@p prop_id) with every frame
+    /// commit and passes the fence to @p cb. A prop_id of 0 stops.
+    void set_out_fence(std::uint32_t prop_id, OutFenceCallback cb);
+
+    /// Queues a writeback of the frame being recorded into framebuffer
+    /// @p fb_id, through writeback connector @p connector_id (already bound
+    /// to this CRTC by its CRTC_ID) whose WRITEBACK_FB_ID is @p fb_prop and
+    /// WRITEBACK_OUT_FENCE_PTR @p fence_prop. The batch is committed even
+    /// if nothing else changed. @p cb is called exactly once, after the
+    /// batch has been submitted or dropped; a second job in the same batch
+    /// replaces the first, which is dropped with errc::operation_canceled.
+    /// A job still recorded when the queue is destroyed goes unreported.
+    /// With a shadow, both properties are registered as volatile.
+    void set_writeback(std::uint32_t connector_id, std::uint32_t fb_prop, std::uint32_t fence_prop, std::uint32_t fb_id,
+                       WritebackCallback cb);
+
+    /// Lets the next commit perform a full mode set.
+    void allow_modeset() { batch().allow_modeset = true; }
+
+    /// Submits the pending writes, or defers them if a commit is in flight.
+    /// A rejected batch is dropped and its error returned; EBUSY keeps the
+    /// batch queued for the next flush.
+    std::error_code flush();
+
+    /// Completes the in-flight commit and submits a deferred flush.
+    std::error_code on_flip_complete(const KmsEvent& event);
+
+    bool in_flight() const noexcept { return in_flight_; }
+    bool empty() const noexcept { return !batch_ || batch_->request.empty(); }
+    const Stats& stats() const noexcept { return stats_; }
+    const FrameArena::Stats& arena_stats() const noexcept { return arena_.stats(); }
+
+    /// Per in-fence, submission to signal (0 if it had signalled already).
+    const LatencyHistogram& fence_wait() const noexcept { return fence_wait_; }
+
+private:
+    struct BlobWrite {
+        std::uint32_t object_id;
+        std::uint32_t prop_id;
+        std::uint32_t blob_id;
+        std::size_t offset; ///< Into Batch::blob_data.
+        std::size_t size;
+    };
+
+    struct InFence {
+        std::uint32_t plane_id;
+        std::uint32_t prop_id;
+        UniqueFd fd;
+    };
+
+    /// Everything recorded for the next commit; lives in arena_.
+    struct Batch {
+        explicit Batch(std::pmr::memory_resource* mr)
+            : request(mr), blobs(mr), blob_writes(mr), blob_data(mr), in_fences(mr)
+        {
+        }
+
+        AtomicRequest request;
+        std::pmr::vector<std::uint32_t> blobs;
+        /// With a shadow: the contents of each blob, for record_blob().
+        std::pmr::vector<BlobWrite> blob_writes;
+        std::pmr::vector<std::uint8_t> blob_data;
+        std::pmr::vector<InFence> in_fences;
+        WritebackCallback writeback; ///< Set by set_writeback().
+        std::uint32_t writeback_connector = 0;
+        std::uint32_t writeback_fb_prop = 0;
+        std::uint32_t writeback_fence_prop = 0;
+        std::uint64_t first_write_ns = 0;
+        bool allow_modeset = false;
+    };
+
+    Batch& batch();
+    void end_batch() noexcept;
+    std::error_code submit();
+    std::error_code commit(AtomicRequest& request, std::uint32_t flags, std::size_t superseded,
+                           std::uint64_t first_write_ns, bool latch_only);
+    void take_latched(AtomicRequest& request) noexcept;
+    void complete_fences();
+
+    KmsDevice& device_;
+    std::uint32_t crtc_id_;
+    ReportCallback report_;
+    KmsShadow* shadow_ = nullptr;
+
+    FrameArena arena_;
+    Batch* batch_ = nullptr;
+    bool flush_deferred_ = false;
+
+    struct LatchedWrite {
+        std::uint32_t object_id;
+        std::uint32_t prop_id;
+        std::uint64_t value;
+    };
+    std::array<LatchedWrite, kMaxLatched> latched_;
+    std::size_t latched_count_ = 0;
+    std::uint64_t latched_first_ns_ = 0;
+    std::uint64_t latched_input_ns_ = 0;
+    AtomicRequest latch_request_; ///< Reused by flush_latched(); stops allocating after the first.
+
+    std::uint32_t out_fence_prop_ = 0;
+    OutFenceCallback out_fence_cb_;
+    std::int32_t out_fence_ = -1; ///< OUT_FENCE_PTR points here during the ioctl.
+    std::int32_t writeback_fence_ = -1; ///< WRITEBACK_OUT_FENCE_PTR points here during the ioctl.
+    std::vector<UniqueFd> fences_; ///< In-fences of the commit in flight.
+    LatencyHistogram fence_wait_;
+
+    bool in_flight_ = false;
+    CommitReport current_;
+    std::uint64_t serial_ = 0;
+    Stats stats_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "dispctrl/color.hpp"
+#include "dispctrl/geometry.hpp"
+#include "dispctrl/pixel_convert.hpp"
+#include "dispctrl/thread_pool.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace dispctrl {
+
+namespace blend {
+struct BlendKernels;
+}
+
+/// A CPU-visible XRGB8888, XBGR8888 (opaque), ARGB8888 or ABGR8888 buffer.
+struct Surface {
+    const std::uint8_t* pixels = nullptr;
+    std::uint32_t pitch = 0;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint32_t fourcc = 0;
+};
+
+/// How a layer's alpha channel is interpreted, as the KMS plane "pixel
+/// blend mode" property.
+enum class BlendMode : std::uint8_t {
+    Premultiplied, ///< Colour channels are already multiplied by alpha.
+    Coverage,      ///< Straight alpha: colours are multiplied by it first.
+    Opaque,        ///< Alpha is ignored ("None").
+};
+
+/// One input of a software composition, in bottom-to-top order.
+struct CompositeLayer {
+    Surface surface;
+    Rect src; ///< Crop of the surface; rotated, then scaled to dst with nearest sampling.
+    Rect dst; ///< Position on the output.
+    BlendMode blend = BlendMode::Premultiplied;
+    Rotation rotation = Rotation::R0;
+};
+
+/// The XRGB8888 buffer a composition renders into.
+struct OutputBuffer {
+    std::uint8_t* pixels = nullptr;
+    std::uint32_t pitch = 0;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+};
+
+/// CPU fallback for layers that did not get a hardware plane.
+///
+/// The output is cut into tiles small enough that a tile's destination
+/// rows stay in L1/L2 while every layer is blended into them; tiles are
+/// spread over a ThreadPool. Only tiles touched by damage are drawn, and
+/// each tile starts from the topmost opaque layer covering it, so layers
+/// hidden under a fullscreen window cost nothing. Other formats (NV12,
+/// YUYV, ...) must be converted with convert_to_xrgb8888() first.
+///
+/// Source rows are fetched by kernels instantiated for every format, blend
+/// mode, rotation and scaled/unscaled combination and picked from a table
+/// once per layer, so no per-pixel code branches on them; unrotated,
+/// unscaled XRGB8888 and premultiplied ARGB8888 are read in place.
+class TileCompositor {
+public:
+    struct Stats {
+        std::uint64_t frames = 0;
+        std::uint64_t tiles = 0;         ///< Tiles in all composed frames.
+        std::uint64_t tiles_drawn = 0;   ///< Tiles that had damage.
+        std::uint64_t layers_culled = 0; ///< Per-tile layer draws skipped as occluded.
+    };
+
+    static constexpr std::uint32_t kTileWidth = 128;
+    static constexpr std::uint32_t kTileHeight = 64; ///< 32 KiB of XRGB8888 per tile.
+
+    explicit TileCompositor(ThreadPool& pool, std::uint32_t tile_width = kTileWidth,
+                            std::uint32_t tile_height = kTileHeight);
+
+    /// Forces a kernel set; errc::not_supported if @p isa is unavailable.
+    /// Intended for validation and benchmarking.
+    std::error_code set_isa(ConvertIsa isa) noexcept;
+
+    /// Colour-corrects every redrawn pixel through @p lut once all layers
+    /// are blended, for CRTCs that cannot offload the transform (see
+    /// ColorPipeline::software_lut()); nullptr disables it. The LUT must
+    /// outlive its use.
+    void set_color_lut(const Lut3d* lut) noexcept { lut_ = lut; }
+
+    /// Redraws the parts of @p out inside @p damage (output coordinates)
+    /// from @p background and @p layers. Returns errc::invalid_argument
+    /// for unsupported layer formats or buffers, before drawing anything.
+    std::error_code compose(std::span<const CompositeLayer> layers, std::span<const Rect> damage,
+                            OutputBuffer& out, std::uint32_t background = 0xff000000);
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    struct Frame;
+    /// How one layer of the frame is drawn.
+    struct LayerOp {
+        std::uint16_t fetch; ///< Index into blend::kFetchKernels, or kInPlace.
+        bool copy;           ///< Opaque: copied over the output, not blended.
+    };
+    static constexpr std::uint16_t kInPlace = UINT16_MAX;
+
+    void draw_tile(const Frame& frame, std::size_t tile, unsigned thread) noexcept;
+
+    ThreadPool& pool_;
+    std::uint32_t tile_w_;
+    std::uint32_t tile_h_;
+    const blend::BlendKernels* kernels_;
+    const Lut3d* lut_ = nullptr;
+    std::vector<LayerOp> ops_;
+    std::vector<std::vector<std::uint32_t>> scratch_; ///< Per thread, one scaled source row.
+    std::atomic<std::uint64_t> drawn_{0};
+    std::atomic<std::uint64_t> culled_{0};
+    Stats stats_;
+};
+
+} // namespace dispctrl
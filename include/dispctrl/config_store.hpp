@@ -0,0 +1,131 @@
+#pragma once
+
+#include "dispctrl/edid.hpp"
+#include "dispctrl/mode.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dispctrl {
+
+/// Persisted settings for one connector. The struct is the on-disk
+/// record: it is read in place from the mapped file, so it must stay
+/// trivially copyable and any layout change bumps ConfigStore::kVersion.
+struct ConnectorConfig {
+    enum Flags : std::uint32_t {
+        Enabled = 1u << 0,
+        Vrr = 1u << 1,
+    };
+
+    static constexpr std::size_t kNameSize = 32;
+
+    char connector[kNameSize] = {}; ///< NUL-terminated name, e.g. "DP-1"; the lookup key.
+    std::uint64_t monitor = 0;      ///< monitor_id() of the display it was saved for.
+    std::uint32_t connector_id = 0; ///< KMS object ids from the last run; hints only,
+    std::uint32_t crtc_id = 0;      ///< to be confirmed by a TEST_ONLY commit.
+    ModeInfo mode;
+    std::int32_t x = 0;             ///< Position in the desktop layout.
+    std::int32_t y = 0;
+    std::uint32_t rotation = 1;     ///< DRM_MODE_ROTATE_* / DRM_MODE_REFLECT_* bits.
+    std::uint32_t flags = Enabled;  ///< ConnectorConfig::Flags.
+    std::uint64_t color_profile = 0; ///< Content hash of the colour profile; 0 for none.
+
+    std::string_view name() const noexcept;
+};
+
+static_assert(std::is_trivially_copyable_v<ConnectorConfig>);
+
+/// Identity of a monitor (vendor, product, serial and name), for noticing
+/// that a different display was plugged into a saved connector.
+std::uint64_t monitor_id(const DisplayInfo& info) noexcept;
+
+/// Per-connector configuration in a versioned binary file that is mapped,
+/// not parsed.
+///
+/// load() maps the file and checks its header and checksum; find() then
+/// binary-searches the mapped records, so the first commit after boot
+/// needs neither a config parser nor a connector probe. put() updates the
+/// in-memory copy and hands a snapshot to a writer thread, which writes
+/// a temporary file, fsyncs it and renames it over the old one: readers
+/// see either the old or the new file, never a torn one, and saving never
+/// blocks the caller on disk I/O. Snapshots queued faster than the disk
+/// takes them are coalesced into the latest.
+///
+/// find(), put() and entries() must be called from one thread.
+class ConfigStore {
+public:
+    struct Stats {
+        std::uint64_t writes = 0;
+        std::uint64_t coalesced = 0; ///< Snapshots replaced before they were written.
+        std::uint64_t errors = 0;
+        std::error_code last_error;
+    };
+
+    static constexpr std::uint32_t kMagic = 0x47464344; ///< "DCFG"
+    static constexpr std::uint16_t kVersion = 1;
+
+    /// Starts the writer thread; throws std::system_error if it cannot.
+    /// Does no file I/O.
+    explicit ConfigStore(std::string path);
+    /// Waits for a pending write.
+    ~ConfigStore();
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+    /// Maps the file, replacing the in-memory records. Errors leave the
+    /// store empty: errc::no_such_file_or_directory on first boot, and
+    /// errc::invalid_argument for a file with the wrong magic, version,
+    /// size or checksum.
+    std::error_code load();
+
+    /// Saved settings of @p connector, or nullptr. The pointer is valid
+    /// until the next put() or load().
+    const ConnectorConfig* find(std::string_view connector) const noexcept;
+
+    std::span<const ConnectorConfig> entries() const noexcept { return view_; }
+
+    /// Inserts or replaces the record for config.name() and schedules a
+    /// write. errc::invalid_argument if the name is empty or too long;
+    /// errc::not_enough_memory, with the store unchanged, out of memory.
+    std::error_code put(const ConnectorConfig& config);
+
+    /// Blocks until every scheduled write has finished; returns the error
+    /// of the last one.
+    std::error_code flush();
+
+    Stats stats() const;
+
+private:
+    void unmap() noexcept;
+    void writer();
+    std::error_code write_file(const std::vector<ConnectorConfig>& records) const;
+
+    const std::string path_;
+
+    void* map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::vector<ConnectorConfig> owned_; ///< Records once modified; sorted by name.
+    std::span<const ConnectorConfig> view_; ///< Into map_ or owned_.
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::vector<ConnectorConfig> pending_;
+    bool dirty_ = false;   ///< pending_ holds a snapshot not yet written.
+    bool writing_ = false;
+    bool stopping_ = false;
+    std::error_code result_;
+    Stats stats_;
+    std::thread thread_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/histogram.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include <vector>
+
+namespace dispctrl {
+
+/// Commits cursor and small overlay plane positions as late as possible
+/// before each vblank, decoupled from frame composition.
+///
+/// move() hands the newest position to the CommitQueue as latched writes
+/// (CommitQueue::set_latched()) and arms a timer for the latch point: the
+/// predicted vblank minus a margin. When timer_fd() fires, on_timer()
+/// sends the positions in a commit of their own unless a frame commit has
+/// already carried them. The margin starts at kInitialMarginNs and is
+/// tuned from the outcome of every latch-only commit: one that lands a
+/// vblank late widens it, on-time ones narrow it towards twice the
+/// measured ioctl time. A latch point that finds a commit in flight moves
+/// to the next vblank.
+///
+/// Feed every CommitReport of the queue to on_report(). Give latched
+/// planes their positions through move() only: a frame commit that writes
+/// their CRTC_X/CRTC_Y itself would undo a newer latched position.
+class CursorLatch {
+public:
+    struct Stats {
+        std::uint64_t moves = 0;
+        std::uint64_t latches = 0; ///< Latch-only commits made.
+        std::uint64_t merged = 0;  ///< Frame commits that carried a position.
+        std::uint64_t blocked = 0; ///< Latch points deferred by a commit in flight.
+        std::uint64_t missed = 0;  ///< Latch-only commits that landed a vblank late.
+    };
+
+    static constexpr std::uint64_t kInitialMarginNs = 2'000'000;
+    static constexpr std::uint64_t kMinMarginNs = 250'000;
+
+    /// @p refresh_mhz is the refresh rate of the current mode; pass 0 with
+    /// variable refresh, where a flip starts a refresh right away, to
+    /// commit positions as soon as they arrive. Throws std::system_error
+    /// if the timer cannot be created.
+    CursorLatch(KmsDevice& device, CommitQueue& queue, std::uint32_t refresh_mhz);
+
+    /// Adds a plane and resolves its CRTC_X/CRTC_Y properties; @p index
+    /// is the handle for move().
+    std::error_code add_plane(std::uint32_t plane_id, std::size_t& index);
+
+    /// Moves plane @p index to (@p x, @p y). @p input_ns is the
+    /// CLOCK_MONOTONIC time of the input event (evdev timestamps are).
+    std::error_code move(std::size_t index, std::int32_t x, std::int32_t y, std::uint64_t input_ns);
+
+    /// Pollable; readable at the latch point.
+    int timer_fd() const noexcept { return timer_.get(); }
+    std::error_code on_timer();
+
+    void on_report(const CommitReport& report);
+
+    std::uint64_t margin_ns() const noexcept { return margin_ns_; }
+
+    /// Input to photon for every commit that carried a position: from the
+    /// newest input it reflects to the vblank that showed it.
+    const LatencyHistogram& input_to_photon() const noexcept { return input_to_photon_; }
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    struct Plane {
+        std::uint32_t plane_id;
+        std::uint32_t crtc_x;
+        std::uint32_t crtc_y;
+    };
+
+    /// Arms the timer for the first latch point after @p now_ns.
+    std::error_code arm(std::uint64_t now_ns);
+    std::error_code latch();
+
+    KmsDevice& device_;
+    CommitQueue& queue_;
+    const std::uint64_t period_ns_;
+    UniqueFd timer_;
+    std::vector<Plane> planes_;
+
+    bool armed_ = false;
+    std::uint64_t last_vblank_ns_ = 0;
+    std::uint64_t target_vblank_ns_ = 0;  ///< Vblank the armed latch point aims at.
+    std::uint64_t pending_target_ns_ = 0; ///< Same, for the latch-only commit in flight.
+    std::uint64_t margin_ns_ = kInitialMarginNs;
+    std::uint64_t ioctl_ns_ = 0;          ///< Smoothed ioctl time of latch-only commits.
+    LatencyHistogram input_to_photon_;
+    Stats stats_;
+};
+
+} // namespace dispctrl
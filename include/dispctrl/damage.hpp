@@ -0,0 +1,112 @@
+#pragma once
+
+#include "dispctrl/geometry.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace dispctrl {
+
+class CommitQueue;
+
+/// Controls how eagerly damage rectangles are merged.
+struct DamagePolicy {
+    /// Hard cap on the rectangle count; FB_DAMAGE_CLIPS lists and per-rect
+    /// composition overhead both grow with it.
+    std::size_t max_rects = 16;
+
+    /// Two rectangles are merged into their bounding box when the box
+    /// covers at most this fraction of pixels that neither rectangle did.
+    /// 0 merges only when the box adds no pixels (containment or aligned
+    /// neighbours); 1 always merges.
+    double max_waste = 0.25;
+};
+
+/// A set of dirty rectangles, coalesced according to a DamagePolicy.
+class DamageRegion {
+public:
+    explicit DamageRegion(std::pmr::memory_resource* mr = std::pmr::get_default_resource()) : rects_(mr) {}
+
+    /// Adds @p rect and merges it with existing rectangles per @p policy.
+    void add(const Rect& rect, const DamagePolicy& policy);
+
+    void clear() noexcept { rects_.clear(); }
+    bool empty() const noexcept { return rects_.empty(); }
+
+    std::span<const Rect> rects() const noexcept { return rects_; }
+    Rect bounds() const noexcept;
+
+    /// Sum of the rectangle areas. Coalesced rectangles never contain one
+    /// another, but may still overlap, so this can slightly overcount.
+    std::uint64_t area() const noexcept;
+
+private:
+    void enforce_limit(const DamagePolicy& policy);
+
+    std::pmr::vector<Rect> rects_;
+};
+
+/// Accumulates per-layer damage for one output and reports how many pixels
+/// partial composition saves compared to redrawing every frame.
+class DamageTracker {
+public:
+    struct Stats {
+        std::uint64_t frames = 0;
+        std::uint64_t full_frames = 0;   ///< Frames that had to be redrawn completely.
+        std::uint64_t idle_frames = 0;   ///< Frames with no damage at all.
+        std::uint64_t pixels_total = 0;  ///< Output pixels across all frames.
+        std::uint64_t pixels_damaged = 0;
+
+        std::uint64_t pixels_saved() const noexcept { return pixels_total - pixels_damaged; }
+    };
+
+    DamageTracker(std::int32_t width, std::int32_t height, DamagePolicy policy = {}) noexcept
+        : output_{0, 0, width, height}, policy_(policy)
+    {
+    }
+
+    const Rect& output() const noexcept { return output_; }
+    const DamagePolicy& policy() const noexcept { return policy_; }
+    void set_policy(const DamagePolicy& policy) noexcept { policy_ = policy; }
+
+    /// Damage already expressed in output coordinates.
+    void add(const Rect& rect);
+
+    /// Damage @p buffer_damage of a layer whose @p src_w x @p src_h buffer
+    /// is scaled onto @p dst. The mapped rectangle is rounded outwards.
+    void add_layer_damage(const Rect& dst, std::int32_t src_w, std::int32_t src_h, const Rect& buffer_damage);
+
+    /// A layer moved, resized, appeared or disappeared: both its old and its
+    /// new footprint need recomposition. Pass an empty Rect for "none".
+    void add_layer_change(const Rect& old_dst, const Rect& new_dst);
+
+    /// Forces a full redraw, e.g. after a mode set or layer restack.
+    void invalidate() noexcept { full_ = true; }
+
+    /// Closes the frame: returns the region to recompose and updates the
+    /// statistics. The region stays valid until the next add() or end_frame().
+    const DamageRegion& end_frame();
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    Rect output_;
+    DamagePolicy policy_;
+    DamageRegion current_;
+    DamageRegion frame_;
+    bool full_ = true;
+    Stats stats_;
+};
+
+/// Queues FB_DAMAGE_CLIPS for @p plane_id. Clips must be in framebuffer
+/// coordinates. An empty region clears the property, which the kernel
+/// treats as "whole plane damaged"; idle frames should not be committed
+/// at all.
+std::error_code set_damage_clips(CommitQueue& queue, std::uint32_t plane_id, std::uint32_t prop_id,
+                                 const DamageRegion& damage);
+
+} // namespace dispctrl
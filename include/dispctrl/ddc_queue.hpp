@@ -0,0 +1,162 @@
+#pragma once
+
+#include "dispctrl/unique_fd.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace dispctrl {
+
+/// MCCS VCP feature codes used for monitor control.
+namespace vcp {
+inline constexpr std::uint8_t kBrightness = 0x10;
+inline constexpr std::uint8_t kContrast = 0x12;
+inline constexpr std::uint8_t kInputSource = 0x60;
+inline constexpr std::uint8_t kPowerMode = 0xd6; ///< 1 on, 4 standby, 5 off.
+} // namespace vcp
+
+/// One monitor's end of an I2C bus, carrying raw DDC/CI messages.
+class DdcTransport {
+public:
+    virtual ~DdcTransport() = default;
+
+    /// Writes one framed request.
+    virtual std::error_code write(std::span<const std::uint8_t> msg) noexcept = 0;
+
+    /// Reads a reply of up to msg.size() bytes; @p len is set to what
+    /// was read. Displays pad short replies, so callers decode the length.
+    virtual std::error_code read(std::span<std::uint8_t> msg, std::size_t& len) noexcept = 0;
+};
+
+/// DdcTransport over an i2c-dev node.
+class I2cDdcTransport final : public DdcTransport {
+public:
+    /// Opens @p i2c_dev, e.g. "/dev/i2c-5", addressed to the DDC/CI
+    /// slave; throws std::system_error on failure.
+    static std::unique_ptr<I2cDdcTransport> open(const std::string& i2c_dev);
+
+    std::error_code write(std::span<const std::uint8_t> msg) noexcept override;
+    std::error_code read(std::span<std::uint8_t> msg, std::size_t& len) noexcept override;
+
+private:
+    explicit I2cDdcTransport(UniqueFd fd) noexcept : fd_(std::move(fd)) {}
+
+    UniqueFd fd_;
+};
+
+/// Delays MCCS requires between DDC/CI transactions. Some monitors need
+/// more; scale them rather than retrying faster.
+struct DdcTiming {
+    std::uint64_t command_interval_ns = 50'000'000;   ///< From the end of one transaction to the next.
+    std::uint64_t reply_delay_ns = 40'000'000;        ///< Get VCP Feature request to reply.
+    std::uint64_t capabilities_delay_ns = 50'000'000; ///< Capabilities request to reply fragment.
+};
+
+/// Value of a VCP feature, from Get VCP Feature.
+struct VcpValue {
+    std::uint8_t type = 0; ///< 0 set parameter, 1 momentary.
+    std::uint16_t max = 0;
+    std::uint16_t current = 0;
+};
+
+/// Asynchronous command queue for one DDC/CI bus.
+///
+/// Every MCCS transaction is followed by a mandatory pause, so a monitor
+/// takes tens of milliseconds per command and a caller that sleeps through
+/// them serialises every monitor behind the slowest. A DdcQueue owns one
+/// bus: requests return at once and a worker thread runs them in order,
+/// keeping the delays of DdcTiming, so queues for different buses proceed
+/// in parallel. A set_vcp() for the code of the last command, if that is
+/// a waiting write, replaces the write's value instead of queueing another
+/// transaction, and the replaced write completes with
+/// errc::operation_canceled; commands otherwise run in the order they were
+/// queued. Busy (null) replies and corrupt messages are retried up to
+/// kMaxRetries times.
+///
+/// Callbacks run on the worker thread and must not call back into the
+/// queue's destructor. Destroying the queue cancels what has not started.
+/// Thread-safe.
+class DdcQueue {
+public:
+    struct Reply {
+        VcpValue value;           ///< get_vcp().
+        std::string capabilities; ///< read_capabilities(): the MCCS capability string.
+    };
+
+    using Callback = std::function<void(std::error_code, const Reply&)>;
+
+    struct Stats {
+        std::uint64_t transactions = 0; ///< Requests sent on the bus, capability fragments included.
+        std::uint64_t superseded = 0;   ///< Writes folded into a later one before reaching the bus.
+        std::uint64_t retries = 0;
+        std::uint64_t errors = 0; ///< Commands that failed after their retries.
+    };
+
+    static constexpr unsigned kMaxRetries = 3;
+    /// Capability strings longer than this are cut short.
+    static constexpr std::size_t kMaxCapabilities = 4096;
+
+    /// Starts the worker; throws std::system_error if it cannot. The
+    /// transport must outlive the queue and is only used from the worker.
+    explicit DdcQueue(DdcTransport& bus, DdcTiming timing = {});
+    ~DdcQueue();
+    DdcQueue(const DdcQueue&) = delete;
+    DdcQueue& operator=(const DdcQueue&) = delete;
+
+    /// Set VCP Feature @p code to @p value.
+    void set_vcp(std::uint8_t code, std::uint16_t value, Callback done = {});
+
+    /// Get VCP Feature @p code; the value arrives in Reply::value.
+    void get_vcp(std::uint8_t code, Callback done);
+
+    /// Reads the capability string, fragment by fragment.
+    void read_capabilities(Callback done);
+
+    /// Blocks until every queued command has completed.
+    void wait_idle();
+
+    /// Commands queued or running.
+    std::size_t pending() const;
+
+    Stats stats() const;
+
+private:
+    struct Command {
+        enum class Kind : std::uint8_t { Set, Get, Capabilities };
+
+        Kind kind;
+        std::uint8_t code;
+        std::uint16_t value;
+        Callback done;
+    };
+
+    void worker();
+    std::error_code execute(std::unique_lock<std::mutex>& lock, const Command& cmd, Reply& reply);
+    std::error_code transact(std::unique_lock<std::mutex>& lock, const std::uint8_t* request, std::size_t size,
+                             std::uint64_t delay_ns, std::uint8_t* reply, std::size_t& reply_size);
+    bool pause(std::unique_lock<std::mutex>& lock, std::uint64_t until_ns);
+
+    DdcTransport& bus_;
+    const DdcTiming timing_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<Command> queue_;
+    bool running_ = false; ///< The worker is executing a command taken off queue_.
+    bool stopping_ = false;
+    std::uint64_t next_ns_ = 0; ///< Earliest start of the next transaction.
+    Stats stats_;
+    std::thread thread_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "dispctrl/edid.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/mode.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace dispctrl {
+
+/// KMS objects of a card, from DRM_IOCTL_MODE_GETRESOURCES.
+struct CardResources {
+    std::vector<std::uint32_t> crtcs;
+    std::vector<std::uint32_t> connectors;
+    std::vector<std::uint32_t> encoders;
+};
+
+/// A connector as last probed.
+struct ConnectorInfo {
+    enum class Status : std::uint8_t { Connected, Disconnected, Unknown };
+
+    std::uint32_t connector_id = 0;
+    std::uint32_t type = 0;    ///< DRM_MODE_CONNECTOR_*.
+    std::uint32_t type_id = 0;
+    std::string name;          ///< Kernel-style name, e.g. "HDMI-A-1"; the ConnectorConfig key.
+    Status status = Status::Unknown;
+    std::uint32_t possible_crtcs = 0; ///< Bit i set: CardResources::crtcs[i] can drive it.
+    std::uint32_t width_mm = 0;
+    std::uint32_t height_mm = 0;
+    std::vector<ModeInfo> modes;      ///< Kernel mode list, preferred first.
+    std::shared_ptr<const DisplayInfo> display; ///< Decoded EDID; null without a valid one.
+
+    bool connected() const noexcept { return status == Status::Connected; }
+};
+
+std::error_code get_card_resources(const DrmDevice& device, CardResources& out);
+
+/// Reads a connector. Without @p force only the kernel's last detection
+/// result is returned, which costs no DDC traffic; the kernel probes every
+/// output when the driver loads, so at boot this is current. When the
+/// kernel has no result yet (status unknown, or connected without modes)
+/// a full probe is done anyway. @p edids may be null.
+std::error_code probe_connector(const DrmDevice& device, std::uint32_t connector_id, bool force,
+                                EdidCache* edids, ConnectorInfo& out);
+
+/// /dev/dri/card* nodes in numeric order.
+std::vector<std::string> find_card_nodes(const std::string& dir = "/dev/dri");
+
+/// Result of probing one card.
+struct ProbedCard {
+    std::string path;
+    std::unique_ptr<DrmDevice> device; ///< Null if the card could not be opened.
+    /// First failure; connectors probed before it are kept. Out of memory
+    /// is errc::not_enough_memory; any other exception ending the probe,
+    /// e.g. thrown by the callback, is errc::operation_canceled.
+    std::error_code error;
+    CardResources resources;
+    std::vector<ConnectorInfo> connectors;
+    std::uint64_t probe_ns = 0;        ///< Open to last connector.
+};
+
+/// Opens and probes several cards concurrently.
+///
+/// Detection and EDID reads block in the kernel, which serialises probes
+/// of one card on its mode_config lock; distinct cards do not contend, so
+/// each card gets its own thread. The callback runs on that thread as soon
+/// as a connector is probed, in connector order; callbacks for different
+/// cards run concurrently. It may use card.device (no other thread touches
+/// it until wait() returns), e.g. to light up the head straight away
+/// instead of waiting for the slowest card.
+class DeviceDiscovery {
+public:
+    using ConnectorCallback = std::function<void(ProbedCard& card, const ConnectorInfo& connector)>;
+
+    /// @p force_probe re-detects every connector (see probe_connector()).
+    DeviceDiscovery(EdidCache& edids, ConnectorCallback callback, bool force_probe = false);
+    /// Waits for running probes.
+    ~DeviceDiscovery();
+    DeviceDiscovery(const DeviceDiscovery&) = delete;
+    DeviceDiscovery& operator=(const DeviceDiscovery&) = delete;
+
+    /// Starts probing @p paths; throws std::system_error if a thread cannot
+    /// be started. May be called again once wait() has returned.
+    void start(const std::vector<std::string>& paths);
+
+    /// Joins the probe threads and hands over the results, in the order
+    /// the paths were given.
+    std::vector<ProbedCard> wait();
+
+private:
+    void probe(ProbedCard& card) noexcept;
+
+    EdidCache& edids_;
+    ConnectorCallback callback_;
+    const bool force_;
+    std::vector<std::unique_ptr<ProbedCard>> cards_;
+    std::vector<std::thread> threads_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "dispctrl/mode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace dispctrl {
+
+/// What DispCtrl needs to know about a monitor, decoded from its EDID
+/// (including CTA-861 and DisplayID extensions) or a bare DisplayID blob.
+struct DisplayInfo {
+    char vendor[4] = {}; ///< PNP id, e.g. "DEL".
+    std::uint16_t product = 0;
+    std::uint32_t serial = 0;
+    std::string name;
+    std::uint16_t width_mm = 0;
+    std::uint16_t height_mm = 0;
+
+    /// Vertical refresh range from the range-limits descriptor, in Hz;
+    /// zero when the monitor does not declare one.
+    std::uint16_t min_vrefresh = 0;
+    std::uint16_t max_vrefresh = 0;
+
+    /// Decoded timings without duplicates; the preferred mode comes first.
+    std::vector<ModeInfo> modes;
+
+    bool operator==(const DisplayInfo&) const = default;
+};
+
+/// Decodes an EDID or DisplayID blob.
+///
+/// Modes come from detailed timing descriptors (base block and CTA-861),
+/// the common CTA-861 VICs, and DisplayID type I/VII timings. Established
+/// and standard timings are not decoded. Returns errc::invalid_argument
+/// for blobs that are neither EDID nor DisplayID or fail their checksum.
+std::error_code parse_display_info(std::span<const std::uint8_t> blob, DisplayInfo& out);
+
+/// Process-wide cache of decoded DisplayInfo, keyed by blob content.
+///
+/// Connector reprobes after a hotplug hand over the same few hundred bytes
+/// again and again; a hit costs one hash and one memcmp instead of a full
+/// decode. Entries are shared and immutable, and the least recently used
+/// one is evicted once @p capacity is reached. Thread-safe; decoding runs
+/// outside the lock so parallel probes do not serialise on it.
+class EdidCache {
+public:
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+    };
+
+    explicit EdidCache(std::size_t capacity = 64) noexcept : capacity_(capacity ? capacity : 1) {}
+
+    /// Returns the decoded blob, parsing it only if it was not seen before.
+    std::error_code lookup(std::span<const std::uint8_t> blob, std::shared_ptr<const DisplayInfo>& out);
+
+    void clear();
+    std::size_t size() const;
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::uint64_t hash;
+        std::vector<std::uint8_t> blob;
+        std::shared_ptr<const DisplayInfo> info;
+    };
+    using Lru = std::list<Entry>;
+
+    const std::size_t capacity_;
+    mutable std::mutex mutex_;
+    Lru lru_; ///< Most recently used first.
+    std::unordered_map<std::uint64_t, Lru::iterator> index_;
+    Stats stats_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/spsc_ring.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace dispctrl {
+
+/// Reads DRM events from every registered device on one thread and fans
+/// them out to per-head SPSC rings.
+///
+/// Each head is consumed independently: a slow consumer only fills its own
+/// ring (further events for it are counted as dropped) and never delays
+/// delivery to other heads. Devices and heads are registered up front;
+/// once dispatching starts nothing is allocated and no lock is taken.
+class EventDispatcher {
+public:
+    static constexpr std::size_t kRingCapacity = 64;
+
+    /// Consumer end of one head's event stream.
+    class Head {
+    public:
+        Head(const Head&) = delete;
+        Head& operator=(const Head&) = delete;
+
+        std::uint32_t crtc_id() const noexcept { return crtc_id_; }
+        KmsDevice& device() const noexcept { return *device_; }
+
+        /// Pops the oldest event. Only one thread may consume a head.
+        bool pop(KmsEvent& event) noexcept { return ring_.try_pop(event); }
+
+        /// eventfd signalled after every push, for consumers that sleep in
+        /// poll/epoll. Call clear_notify() before draining with pop() so no
+        /// wakeup is lost.
+        int notify_fd() const noexcept { return notify_.get(); }
+        void clear_notify() noexcept;
+
+        /// Events discarded because the ring was full.
+        std::uint64_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        friend class EventDispatcher;
+        Head(KmsDevice& device, std::uint32_t crtc_id);
+        void push(const KmsEvent& event) noexcept;
+
+        KmsDevice* device_;
+        std::uint32_t crtc_id_;
+        UniqueFd notify_;
+        std::atomic<std::uint64_t> dropped_{0};
+        SpscRing<KmsEvent, kRingCapacity> ring_;
+    };
+
+    struct Stats {
+        std::uint64_t events = 0;
+        std::uint64_t unrouted = 0; ///< Events for CRTCs with no registered head.
+    };
+
+    /// Throws std::system_error if the epoll or wakeup fds cannot be created.
+    EventDispatcher();
+
+    /// Registers a head; its device's event fd joins the epoll set on first
+    /// use. Must not be called once dispatch() or run() is running.
+    Head& add_head(KmsDevice& device, std::uint32_t crtc_id);
+
+    /// Waits up to @p timeout_ms for events and routes everything that is
+    /// ready. Must be called from one thread at a time.
+    std::error_code dispatch(int timeout_ms);
+
+    /// Dispatches until stop() is called from any thread. A stopped
+    /// dispatcher does not restart.
+    std::error_code run();
+    void stop() noexcept;
+
+    /// Reader-thread statistics; read them from the reader thread.
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    struct Source {
+        KmsDevice* device;
+        int fd;
+        std::vector<Head*> heads;
+    };
+
+    std::error_code drain(const Source& source);
+
+    UniqueFd epoll_;
+    UniqueFd wakeup_;
+    std::atomic<bool> stopping_{false};
+    std::vector<Source> sources_;
+    std::vector<std::unique_ptr<Head>> heads_;
+    Stats stats_;
+};
+
+} // namespace dispctrl
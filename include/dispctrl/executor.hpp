@@ -0,0 +1,141 @@
+#pragma once
+
+#include "dispctrl/task.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace dispctrl {
+
+/// Single-threaded epoll event loop that runs coroutines.
+///
+/// Spawned tasks, fd watches and timers all live on the thread that calls
+/// run(); nothing here is thread-safe except stop(). One executor can
+/// drive any number of heads, since a coroutine waiting for a flip or a
+/// hotplug costs a suspended frame rather than a blocked thread.
+class Executor {
+public:
+    using Callback = std::function<void()>;
+
+    /// Throws std::system_error if the epoll or wakeup fds cannot be created.
+    Executor();
+    /// Destroys spawned tasks that are still suspended.
+    ~Executor();
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /// Starts @p task on the next run() iteration and keeps it alive until
+    /// it finishes. An exception escaping a spawned task terminates the
+    /// program, as with std::thread.
+    void spawn(Task<void> task);
+
+    /// Number of spawned tasks that have not finished.
+    std::size_t tasks() const noexcept { return detached_.size(); }
+
+    /// Runs until every spawned task has finished or stop() is called.
+    std::error_code run();
+
+    /// Makes run() return after the current iteration; callable from any
+    /// thread.
+    void stop() noexcept;
+
+    /// Calls @p callback whenever @p fd is readable, until unwatch(). A
+    /// watch does not keep run() going on its own.
+    std::error_code watch(int fd, Callback callback);
+    void unwatch(int fd) noexcept;
+
+    /// Resumes @p h on the next iteration.
+    void post(std::coroutine_handle<> h) { ready_.push_back(h); }
+
+    class ReadableAwaiter {
+    public:
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h) noexcept;
+        std::error_code await_resume() const noexcept { return error_; }
+
+    private:
+        friend class Executor;
+        ReadableAwaiter(Executor& ex, int fd) noexcept : ex_(ex), fd_(fd) {}
+
+        Executor& ex_;
+        int fd_;
+        std::error_code error_;
+    };
+
+    class SleepAwaiter {
+    public:
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> h);
+        void await_resume() const noexcept {}
+
+    private:
+        friend class Executor;
+        SleepAwaiter(Executor& ex, std::uint64_t deadline_ns) noexcept : ex_(ex), deadline_(deadline_ns) {}
+
+        Executor& ex_;
+        std::uint64_t deadline_;
+    };
+
+    struct YieldAwaiter {
+        Executor& ex;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { ex.post(h); }
+        void await_resume() const noexcept {}
+    };
+
+    /// `co_await ex.readable(fd)` suspends until @p fd is readable. Only
+    /// one coroutine may wait on a given fd at a time, and never on an fd
+    /// with a watch().
+    ReadableAwaiter readable(int fd) noexcept { return {*this, fd}; }
+
+    /// Suspends until CLOCK_MONOTONIC reaches @p deadline_ns.
+    SleepAwaiter sleep_until(std::uint64_t deadline_ns) noexcept { return {*this, deadline_ns}; }
+    SleepAwaiter sleep_for(std::uint64_t duration_ns) noexcept;
+
+    /// Lets other ready coroutines run first.
+    YieldAwaiter yield() noexcept { return {*this}; }
+
+private:
+    struct Watch {
+        int fd;
+        Callback callback;
+        std::coroutine_handle<> waiter;
+        bool dead = false;
+    };
+
+    struct Timer {
+        std::uint64_t deadline;
+        std::uint64_t seq;
+        std::coroutine_handle<> handle;
+    };
+
+    struct Detached;
+
+    Detached drive(Task<void> task);
+    void finished(std::coroutine_handle<> h) noexcept;
+    std::error_code arm(int fd, std::coroutine_handle<> waiter) noexcept;
+    void fire_timers();
+    int wait_events(std::uint64_t timeout_ns);
+
+    UniqueFd epoll_;
+    UniqueFd wakeup_;
+    std::atomic<bool> stopping_{false};
+    std::deque<std::coroutine_handle<>> ready_;
+    std::vector<std::coroutine_handle<>> detached_;
+    std::unordered_map<int, std::unique_ptr<Watch>> watches_;
+    std::unordered_map<int, std::unique_ptr<Watch>>::node_type spare_; ///< Reused by arm().
+    std::vector<std::unique_ptr<Watch>> graveyard_; ///< Unwatched mid-dispatch.
+    std::vector<Timer> timers_;                     ///< Min-heap on deadline.
+    std::uint64_t timer_seq_ = 0;
+};
+
+} // namespace dispctrl
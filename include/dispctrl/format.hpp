@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+
+namespace dispctrl {
+
+/// Builds a DRM fourcc code; values match <drm_fourcc.h>.
+constexpr std::uint32_t fourcc_code(char a, char b, char c, char d) noexcept
+{
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(a)) |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(b)) << 8 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(c)) << 16 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(d)) << 24;
+}
+
+namespace fourcc {
+inline constexpr std::uint32_t XRGB8888 = fourcc_code('X', 'R', '2', '4');
+inline constexpr std::uint32_t ARGB8888 = fourcc_code('A', 'R', '2', '4');
+inline constexpr std::uint32_t XBGR8888 = fourcc_code('X', 'B', '2', '4');
+inline constexpr std::uint32_t ABGR8888 = fourcc_code('A', 'B', '2', '4');
+inline constexpr std::uint32_t XRGB2101010 = fourcc_code('X', 'R', '3', '0');
+inline constexpr std::uint32_t RGB565 = fourcc_code('R', 'G', '1', '6');
+inline constexpr std::uint32_t YUYV = fourcc_code('Y', 'U', 'Y', 'V');
+inline constexpr std::uint32_t NV12 = fourcc_code('N', 'V', '1', '2');
+} // namespace fourcc
+
+/// DRM format modifiers; values match <drm_fourcc.h>.
+namespace modifier {
+inline constexpr std::uint64_t Linear = 0;
+inline constexpr std::uint64_t Invalid = 0x00ffffffffffffffULL;
+
+enum class Vendor : std::uint8_t {
+    None = 0,
+    Intel = 0x01,
+    Amd = 0x02,
+    Nvidia = 0x03,
+    Samsung = 0x04,
+    Qcom = 0x05,
+    Vivante = 0x06,
+    Broadcom = 0x07,
+    Arm = 0x08,
+    Allwinner = 0x09,
+    Amlogic = 0x0a,
+};
+
+constexpr std::uint64_t code(Vendor vendor, std::uint64_t value) noexcept
+{
+    return static_cast<std::uint64_t>(vendor) << 56 | (value & 0x00ffffffffffffffULL);
+}
+
+constexpr Vendor vendor(std::uint64_t modifier) noexcept
+{
+    return static_cast<Vendor>(modifier >> 56);
+}
+
+inline constexpr std::uint64_t IntelXTiled = code(Vendor::Intel, 1);
+inline constexpr std::uint64_t IntelYTiled = code(Vendor::Intel, 2);
+inline constexpr std::uint64_t IntelYTiledCcs = code(Vendor::Intel, 4);
+inline constexpr std::uint64_t IntelYTiledGen12RcCcs = code(Vendor::Intel, 6);
+inline constexpr std::uint64_t IntelYTiledGen12McCcs = code(Vendor::Intel, 7);
+inline constexpr std::uint64_t Intel4Tiled = code(Vendor::Intel, 9);
+
+/// ARM AFBC with the given AFBC_FORMAT_MOD_* bits.
+constexpr std::uint64_t arm_afbc(std::uint64_t flags) noexcept
+{
+    return code(Vendor::Arm, flags & 0x000fffffffffffffULL);
+}
+
+namespace afbc {
+inline constexpr std::uint64_t Block16x16 = 1;
+inline constexpr std::uint64_t Block32x8 = 2;
+inline constexpr std::uint64_t Ytr = 1u << 4;
+inline constexpr std::uint64_t Split = 1u << 5;
+inline constexpr std::uint64_t Sparse = 1u << 6;
+inline constexpr std::uint64_t Tiled = 1u << 8;
+} // namespace afbc
+} // namespace modifier
+
+/// Static description of a pixel format's memory layout.
+struct FormatInfo {
+    std::uint32_t fourcc;
+    std::uint8_t plane_count;
+    std::uint8_t bytes_per_pixel[3]; ///< Per plane, for one (sub-sampled) sample.
+    std::uint8_t hsub;               ///< Horizontal chroma sub-sampling factor.
+    std::uint8_t vsub;               ///< Vertical chroma sub-sampling factor.
+    bool has_alpha;
+    bool is_yuv;
+};
+
+/// Returns the layout of @p fourcc, or nullptr when DispCtrl does not know it.
+const FormatInfo* format_info(std::uint32_t fourcc) noexcept;
+
+} // namespace dispctrl
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace dispctrl {
+
+/// Bump allocator for state that lives for exactly one frame.
+///
+/// Allocation is a pointer increment and deallocation is a no-op; reset()
+/// rewinds the arena once the frame's commit has been submitted. Memory is
+/// retained across resets, and if a frame overflowed into extra blocks the
+/// next reset() replaces them with one block large enough for that frame,
+/// so a steady-state frame loop stops touching the heap after warm-up.
+///
+/// Use it through std::pmr containers, and destroy everything allocated
+/// from the arena before calling reset().
+class FrameArena final : public std::pmr::memory_resource {
+public:
+    struct Stats {
+        std::size_t used = 0;        ///< Bytes handed out since the last reset.
+        std::size_t high_water = 0;  ///< Largest `used` seen at a reset.
+        std::size_t capacity = 0;    ///< Bytes currently held from upstream.
+        std::uint64_t upstream_allocations = 0;
+        std::uint64_t resets = 0;
+    };
+
+    explicit FrameArena(std::size_t initial_bytes = 16 * 1024,
+                        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+    ~FrameArena() override;
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void reset() noexcept;
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    struct Block {
+        Block* next;
+        std::size_t size; ///< Usable bytes following the header.
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) noexcept override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    Block* allocate_block(std::size_t size);
+    void free_blocks(Block* first) noexcept;
+
+    std::pmr::memory_resource* upstream_;
+    Block* first_ = nullptr;
+    Block* current_ = nullptr;
+    std::size_t offset_ = 0;
+    Stats stats_;
+};
+
+} // namespace dispctrl
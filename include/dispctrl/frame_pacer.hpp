@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+
+namespace dispctrl {
+
+class CommitQueue;
+
+/// Decides when to flip on a variable-refresh (adaptive-sync) output.
+///
+/// With VRR active the panel starts a new refresh whenever a flip lands,
+/// as long as the time since the previous one stays within
+/// [1 / max_hz, 1 / min_hz]. The pacer keeps flips inside that window:
+/// schedule() holds frames that are ready too early, and
+/// repeat_deadline() says when the current buffer must be flipped again
+/// so the panel does not fall below its minimum rate. When the content
+/// rate is known and lies below the window (24 fps on a 48-144 Hz panel,
+/// say), low-framerate compensation shows every frame a whole number of
+/// times at an even cadence instead of repeating at the last moment.
+///
+/// Without VRR the pacer models a fixed refresh at max_hz. It does not
+/// own a timer or a queue: drive it from the flip-complete events and
+/// the event loop, e.g.
+///
+///     at = pacer.schedule(ready_ns);                 // frame rendered
+///     pacer.on_submit(now); queue.flush();           // timer fires at `at`
+///     pacer.on_vblank(event.timestamp_ns, repeated); // FlipComplete
+///     // repeat_deadline() reached with no new frame: flip the current
+///     // buffer again
+class FramePacer {
+public:
+    struct Stats {
+        std::uint64_t frames = 0;    ///< New content frames displayed.
+        std::uint64_t repeats = 0;   ///< Flips that re-showed the previous frame.
+        std::uint64_t held = 0;      ///< Frames delayed by schedule().
+        std::uint64_t late = 0;      ///< Refreshes that exceeded the maximum interval.
+    };
+
+    /// Margin before the maximum interval at which a repeat is due, on top
+    /// of the measured flip latency.
+    static constexpr std::uint64_t kRepeatGuardNs = 1'000'000;
+
+    /// Refresh range in Hz as reported by the monitor (see
+    /// DisplayInfo::min_vrefresh); a missing or inverted minimum means a
+    /// fixed-rate panel.
+    FramePacer(std::uint32_t min_hz, std::uint32_t max_hz) noexcept;
+
+    /// Enables or disables variable refresh; the connector's VRR_ENABLED
+    /// state must match (see set_vrr_enabled()).
+    void set_vrr(bool enabled) noexcept { vrr_ = enabled && max_interval_ > min_interval_; }
+    bool vrr() const noexcept { return vrr_; }
+
+    /// Nominal frame interval of the content, e.g. 41'708'333 for 23.976
+    /// fps video; 0 when the rate is unknown or varies.
+    void set_content_interval(std::uint64_t interval_ns) noexcept;
+
+    /// How many refreshes each content frame spans under low-framerate
+    /// compensation; 1 when LFC is inactive.
+    unsigned lfc_multiplier() const noexcept { return vrr_ ? lfc_ : 1; }
+
+    std::uint64_t min_interval_ns() const noexcept { return min_interval_; }
+    std::uint64_t max_interval_ns() const noexcept { return max_interval_; }
+
+    /// Records that a commit is being submitted at @p now_ns.
+    void on_submit(std::uint64_t now_ns) noexcept { submit_ns_ = now_ns; }
+
+    /// Records a completed flip; @p repeat marks a flip of the buffer that
+    /// was already on screen.
+    void on_vblank(std::uint64_t timestamp_ns, bool repeat) noexcept;
+
+    /// Earliest time to submit a frame that is ready at @p ready_ns:
+    /// as soon as possible, but no sooner than the panel's maximum rate
+    /// allows and, for content with a known rate, on its cadence.
+    std::uint64_t schedule(std::uint64_t ready_ns) noexcept;
+
+    /// Time by which the current buffer must be flipped again if no new
+    /// frame has arrived; 0 when no repeat is needed (fixed refresh, or
+    /// before the first vblank).
+    std::uint64_t repeat_deadline() const noexcept;
+
+    /// When a frame submitted at @p now_ns would reach the screen, for
+    /// clients that render just in time.
+    std::uint64_t predict_next_vblank(std::uint64_t now_ns) const noexcept;
+
+    /// Smoothed submit-to-vblank latency.
+    std::uint64_t flip_latency_ns() const noexcept { return latency_; }
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    /// Longest refresh interval the pacer plans for: the maximum less
+    /// the guard, but never below the minimum.
+    std::uint64_t repeat_limit() const noexcept;
+
+    std::uint64_t min_interval_;
+    std::uint64_t max_interval_;
+    bool vrr_ = false;
+
+    std::uint64_t content_ = 0;
+    unsigned lfc_ = 1;
+
+    std::uint64_t last_vblank_ = 0;
+    std::uint64_t last_frame_vblank_ = 0;
+    std::uint64_t submit_ns_ = 0;
+    std::uint64_t latency_ = 0;
+    Stats stats_;
+};
+
+/// Queues the CRTC's VRR_ENABLED property.
+void set_vrr_enabled(CommitQueue& queue, std::uint32_t crtc_id, std::uint32_t prop_id, bool enabled);
+
+} // namespace dispctrl
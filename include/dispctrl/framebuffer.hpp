@@ -0,0 +1,121 @@
+#pragma once
+
+#include "dispctrl/kms_device.hpp"
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <system_error>
+#include <unordered_map>
+
+namespace dispctrl {
+
+/// A client buffer as handed to DispCtrl: one DMA-BUF fd per plane.
+///
+/// The fds are borrowed; DispCtrl never maps them or copies their pixels.
+struct DmaBufDesc {
+    struct Plane {
+        int fd = -1;
+        std::uint32_t offset = 0;
+        std::uint32_t pitch = 0;
+    };
+
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint32_t fourcc = 0;
+    std::uint64_t modifier = 0;
+    std::uint32_t plane_count = 0;
+    Plane planes[4];
+};
+
+class FramebufferImporter;
+
+/// A KMS framebuffer that scans out directly from imported client memory.
+///
+/// Destroying it removes the FB object and drops its GEM handle references.
+class Framebuffer {
+public:
+    ~Framebuffer();
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    std::uint32_t id() const noexcept { return fb_id_; }
+    const FramebufferLayout& layout() const noexcept { return layout_; }
+    std::uint32_t width() const noexcept { return layout_.width; }
+    std::uint32_t height() const noexcept { return layout_.height; }
+    std::uint32_t fourcc() const noexcept { return layout_.fourcc; }
+
+private:
+    friend class FramebufferImporter;
+    Framebuffer(FramebufferImporter& owner, const FramebufferLayout& layout, std::uint32_t fb_id) noexcept
+        : owner_(owner), layout_(layout), fb_id_(fb_id)
+    {
+    }
+
+    FramebufferImporter& owner_;
+    FramebufferLayout layout_;
+    std::uint32_t fb_id_;
+};
+
+/// Turns client DMA-BUFs into scanout framebuffers without copying pixels.
+///
+/// Swapchains cycle through a small set of buffers, so imports are cached
+/// by the identity of the underlying DMA-BUF objects: presenting a buffer
+/// that was seen before costs a hash lookup instead of two ioctls. GEM
+/// handles are reference-counted because planes of one buffer (and buffers
+/// sharing one allocation) resolve to the same handle.
+///
+/// The importer must outlive every Framebuffer it returns.
+class FramebufferImporter {
+public:
+    explicit FramebufferImporter(KmsDevice& device) noexcept : device_(device) {}
+    ~FramebufferImporter();
+    FramebufferImporter(const FramebufferImporter&) = delete;
+    FramebufferImporter& operator=(const FramebufferImporter&) = delete;
+
+    /// Returns the framebuffer for @p desc, importing it on first use.
+    std::error_code import(const DmaBufDesc& desc, std::shared_ptr<Framebuffer>& out);
+
+    /// Drops the cached import of @p desc, e.g. when the client destroys the
+    /// buffer; the fds in @p desc must still be open. Framebuffers still on
+    /// screen stay valid until their last reference goes away.
+    void evict(const DmaBufDesc& desc);
+
+    /// Drops every cached import.
+    void clear() noexcept { cache_.clear(); }
+
+    std::size_t cached() const noexcept { return cache_.size(); }
+    KmsDevice& device() const noexcept { return device_; }
+
+private:
+    friend class Framebuffer;
+
+    struct Key {
+        dev_t dev[4] = {};
+        ino_t ino[4] = {};
+        std::uint32_t offsets[4] = {};
+        std::uint32_t pitches[4] = {};
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        std::uint32_t fourcc = 0;
+        std::uint64_t modifier = 0;
+        std::uint32_t plane_count = 0;
+
+        bool operator==(const Key&) const noexcept = default;
+    };
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const noexcept;
+    };
+
+    std::error_code make_key(const DmaBufDesc& desc, Key& key) const noexcept;
+    void ref_handle(std::uint32_t handle);
+    void unref_handle(std::uint32_t handle) noexcept;
+    void release(Framebuffer& fb) noexcept;
+
+    KmsDevice& device_;
+    std::unordered_map<Key, std::shared_ptr<Framebuffer>, KeyHash> cache_;
+    std::unordered_map<std::uint32_t, std::uint32_t> handle_refs_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace dispctrl {
+
+/// Half-open integer rectangle [x1, x2) x [y1, y2).
+///
+/// The layout matches struct drm_mode_rect, so arrays of Rect can be
+/// handed to the kernel (e.g. as FB_DAMAGE_CLIPS) without conversion.
+struct Rect {
+    std::int32_t x1 = 0;
+    std::int32_t y1 = 0;
+    std::int32_t x2 = 0;
+    std::int32_t y2 = 0;
+
+    static constexpr Rect from_size(std::int32_t x, std::int32_t y, std::int32_t w, std::int32_t h) noexcept
+    {
+        return {x, y, x + w, y + h};
+    }
+
+    constexpr std::int32_t width() const noexcept { return x2 - x1; }
+    constexpr std::int32_t height() const noexcept { return y2 - y1; }
+    constexpr bool empty() const noexcept { return x2 <= x1 || y2 <= y1; }
+    constexpr std::uint64_t area() const noexcept
+    {
+        return empty() ? 0 : static_cast<std::uint64_t>(width()) * static_cast<std::uint64_t>(height());
+    }
+
+    constexpr bool contains(const Rect& o) const noexcept
+    {
+        return o.x1 >= x1 && o.y1 >= y1 && o.x2 <= x2 && o.y2 <= y2;
+    }
+
+    constexpr bool operator==(const Rect&) const noexcept = default;
+};
+
+constexpr Rect intersect(const Rect& a, const Rect& b) noexcept
+{
+    Rect r{std::max(a.x1, b.x1), std::max(a.y1, b.y1), std::min(a.x2, b.x2), std::min(a.y2, b.y2)};
+    return r.empty() ? Rect{} : r;
+}
+
+/// Smallest rectangle containing both; an empty operand is ignored.
+constexpr Rect bounding(const Rect& a, const Rect& b) noexcept
+{
+    if (a.empty())
+        return b;
+    if (b.empty())
+        return a;
+    return {std::min(a.x1, b.x1), std::min(a.y1, b.y1), std::max(a.x2, b.x2), std::max(a.y2, b.y2)};
+}
+
+/// Counter-clockwise rotation, in the order of the KMS plane "rotation"
+/// property: drm_rotation() gives its DRM_MODE_ROTATE_* bit.
+enum class Rotation : std::uint8_t { R0, R90, R180, R270 };
+
+constexpr std::uint32_t drm_rotation(Rotation r) noexcept
+{
+    return 1u << static_cast<unsigned>(r);
+}
+
+/// True for the quarter turns, which exchange width and height.
+constexpr bool swaps_axes(Rotation r) noexcept
+{
+    return r == Rotation::R90 || r == Rotation::R270;
+}
+
+} // namespace dispctrl
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dispctrl {
+
+inline constexpr std::uint64_t kFnvOffset = 0xcbf29ce484222325ULL;
+
+/// 64-bit FNV-1a. Fast enough for the small blobs DispCtrl keys caches on
+/// (EDIDs, LUTs, layer topologies); not collision resistant, so callers
+/// that cannot tolerate a false hit must compare the underlying data too.
+inline std::uint64_t fnv1a64(const void* data, std::size_t size, std::uint64_t seed = kFnvOffset) noexcept
+{
+    const auto* p = static_cast<const unsigned char*>(data);
+    std::uint64_t h = seed;
+    for (std::size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+} // namespace dispctrl
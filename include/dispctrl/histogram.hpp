@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace dispctrl {
+
+/// Log-linear (HDR) histogram of nanosecond latencies.
+///
+/// Values below 128 ns are counted exactly; above that every power of two
+/// is split into 64 buckets, so a reported percentile is within 1.6% of
+/// the true value across the whole range (up to about 68 s; larger values
+/// land in the top bucket). record() is wait-free and may be called from
+/// any thread; readers see a consistent-enough snapshot for reporting.
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBucketBits = 7;
+    static constexpr unsigned kMaxShift = 29;
+    static constexpr std::size_t kBuckets = std::size_t{kMaxShift + 2} << (kSubBucketBits - 1);
+
+    struct Summary {
+        std::uint64_t count = 0;
+        std::uint64_t p50 = 0;
+        std::uint64_t p99 = 0;
+        std::uint64_t p999 = 0;
+        std::uint64_t max = 0;
+    };
+
+    void record(std::uint64_t value_ns) noexcept;
+
+    std::uint64_t count() const noexcept { return count_.load(std::memory_order_relaxed); }
+    std::uint64_t max() const noexcept { return max_.load(std::memory_order_relaxed); }
+
+    /// Value at quantile @p q in [0, 1]; 0 when empty.
+    std::uint64_t percentile(double q) const noexcept;
+
+    Summary summary() const noexcept;
+
+    /// Not atomic with respect to concurrent record() calls.
+    void reset() noexcept;
+
+private:
+    std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+    std::atomic<std::uint64_t> count_{0};
+    std::atomic<std::uint64_t> max_{0};
+};
+
+} // namespace dispctrl
@@ -0,0 +1,216 @@
+#pragma once
+
+#include "dispctrl/discovery.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace dispctrl {
+
+/// A DRM hotplug uevent ("change" on a card with HOTPLUG=1).
+struct DrmUevent {
+    int card = -1;                  ///< N of DEVNAME=dri/cardN; -1 if absent.
+    std::uint32_t connector_id = 0; ///< CONNECTOR hint; 0 for an event about the whole card.
+    std::uint32_t property_id = 0;  ///< PROPERTY hint: a property of the connector changed, not its connection.
+    std::uint64_t seqnum = 0;
+};
+
+/// Decodes one kernel uevent message ("change@<devpath>\0KEY=value\0...").
+/// Returns false for anything but a DRM hotplug event.
+bool parse_drm_uevent(std::span<const char> msg, DrmUevent& out) noexcept;
+
+/// Netlink socket receiving the kernel's uevents, filtered to DRM
+/// hotplug events.
+///
+/// A socket filter drops every action but "change" in the kernel, so add,
+/// remove and bind storms of unrelated devices never wake the reader; the
+/// rest are parsed in userspace. Messages not sent by the kernel are
+/// ignored. Not thread-safe.
+class UeventSocket {
+public:
+    struct Stats {
+        std::uint64_t received = 0; ///< Messages read past the socket filter.
+        std::uint64_t filtered = 0; ///< Of those, not DRM hotplug events.
+        std::uint64_t overruns = 0; ///< Times the socket buffer overflowed and events were lost.
+    };
+
+    /// Throws std::system_error if the socket cannot be created.
+    static std::unique_ptr<UeventSocket> open();
+
+    /// Pollable, non-blocking fd.
+    int fd() const noexcept { return fd_.get(); }
+
+    /// Reads the DRM events queued on the socket, up to out.size(). Fails
+    /// with errc::no_buffer_space if events were lost: rescan every card
+    /// (HotplugMonitor::rescan()) then.
+    std::error_code read(std::span<DrmUevent> out, std::size_t& count) noexcept;
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    explicit UeventSocket(UniqueFd fd) noexcept : fd_(std::move(fd)) {}
+
+    UniqueFd fd_;
+    Stats stats_;
+};
+
+/// Reads the connectors of one card for a HotplugMonitor.
+class ConnectorProber {
+public:
+    virtual ~ConnectorProber() = default;
+
+    virtual std::error_code probe(std::uint32_t connector_id, ConnectorInfo& out) = 0;
+
+    /// Every connector of the card; MST connectors come and go.
+    virtual std::error_code connectors(std::vector<std::uint32_t>& out) = 0;
+};
+
+/// ConnectorProber over a DrmDevice. Each probe is a full probe of the one
+/// connector (probe_connector() with force), so the mode list is rebuilt
+/// from the EDID of whatever is plugged in now rather than kept from the
+/// monitor that was there before.
+class DrmConnectorProber final : public ConnectorProber {
+public:
+    /// @p edids may be null; with a cache, an unchanged EDID is not decoded
+    /// again. Either way a reprobe of an unchanged monitor reports no change.
+    explicit DrmConnectorProber(const DrmDevice& device, EdidCache* edids = nullptr) noexcept
+        : device_(device), edids_(edids)
+    {
+    }
+
+    std::error_code probe(std::uint32_t connector_id, ConnectorInfo& out) override;
+    std::error_code connectors(std::vector<std::uint32_t>& out) override;
+
+private:
+    const DrmDevice& device_;
+    EdidCache* edids_;
+};
+
+/// How long a HotplugMonitor waits for a connector to settle.
+struct HotplugDebounce {
+    /// Quiet time after an event before the connector is probed. Every
+    /// further event restarts it.
+    std::uint64_t settle_ns = 100'000'000;
+    /// A connector with more than flap_threshold events within
+    /// flap_window_ns is flapping: its settle time doubles with each
+    /// further event, up to max_settle_ns. A connector that never settles
+    /// is still probed max_settle_ns after its first unprobed event.
+    std::uint64_t flap_window_ns = 2'000'000'000;
+    unsigned flap_threshold = 3;
+    std::uint64_t max_settle_ns = 2'000'000'000;
+};
+
+/// What a reprobe found.
+struct ConnectorChange {
+    enum class Kind : std::uint8_t {
+        Connected,
+        Disconnected,
+        Updated,  ///< Still connected, with other modes or another display.
+        Property, ///< A property changed (e.g. "link-status"); not probed.
+        Removed,  ///< An MST connector went away.
+    };
+
+    Kind kind = Kind::Updated;
+    std::uint32_t connector_id = 0;
+    std::uint32_t property_id = 0;       ///< Property: the property that changed.
+    /// State after the change; null for Removed and for Property events
+    /// of a connector not probed yet.
+    const ConnectorInfo* info = nullptr;
+};
+
+/// Turns the hotplug uevents of one card into per-connector changes.
+///
+/// The kernel names the connector an event is about (CONNECTOR=), so only
+/// that connector is probed again; the card's resources are re-enumerated
+/// only for events without that hint and after lost events (rescan()).
+/// Events are debounced per connector (HotplugDebounce): a cable that
+/// flaps is probed once it has been quiet for a while, and a probe that
+/// finds the state it had before the first event reports nothing, so
+/// bouncing contacts cause no mode sets. Heads whose connectors saw no
+/// event are never touched.
+///
+/// Owns no timer: call poll() when next_deadline() is reached, e.g.
+///
+///     monitor.on_uevent(ev, now);                 // for each event read
+///     monitor.poll(now);                          // at next_deadline()
+///
+/// and from the change callback, reconfigure the head and wake coroutines
+/// waiting in AsyncKms::hotplug() with notify_hotplug(). The callback must
+/// not call back into the monitor. Not thread-safe.
+class HotplugMonitor {
+public:
+    using ChangeCallback = std::function<void(const ConnectorChange&)>;
+
+    struct Stats {
+        std::uint64_t events = 0;    ///< Uevents accepted for this card.
+        std::uint64_t debounced = 0; ///< Events folded into a probe already pending.
+        std::uint64_t probes = 0;    ///< Connectors probed.
+        std::uint64_t unchanged = 0; ///< Probes that found the state already known.
+        std::uint64_t rescans = 0;   ///< Re-enumerations of the whole card.
+        std::uint64_t errors = 0;    ///< Probes that failed; retried at the next event.
+    };
+
+    /// Watches card @p card (the N of /dev/dri/cardN; -1 accepts events of
+    /// any card). @p prober must outlive the monitor.
+    HotplugMonitor(ConnectorProber& prober, int card, ChangeCallback callback, HotplugDebounce debounce = {});
+
+    /// Records the connectors as found at start-up (DeviceDiscovery), so
+    /// the first events are compared against them.
+    void seed(std::span<const ConnectorInfo> connectors);
+
+    void on_uevent(const DrmUevent& event, std::uint64_t now_ns);
+
+    /// Probes the whole card at the next poll(), e.g. after
+    /// UeventSocket::read() reported lost events or on resume.
+    void rescan(std::uint64_t now_ns);
+
+    /// Probes the connectors whose settle time has passed and reports what
+    /// changed.
+    void poll(std::uint64_t now_ns);
+
+    /// When poll() next has work; 0 if nothing is pending.
+    std::uint64_t next_deadline() const noexcept;
+
+    /// Last known state of @p connector_id; null if unknown.
+    const ConnectorInfo* connector(std::uint32_t connector_id) const noexcept;
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    struct Connector {
+        ConnectorInfo info;
+        bool known = false;
+        bool pending = false;
+        std::uint64_t deadline_ns = 0;
+        std::uint64_t first_event_ns = 0; ///< Of the events since the last probe.
+        std::uint64_t window_start_ns = 0;
+        unsigned window_events = 0;
+        std::vector<std::uint32_t> properties; ///< Property events waiting for poll().
+    };
+
+    void emit(ConnectorChange::Kind kind, std::uint32_t id, std::uint32_t property_id, const ConnectorInfo* info);
+
+    void schedule(Connector& c, std::uint64_t now_ns);
+    void reprobe(std::uint32_t id, Connector& c);
+    void scan();
+
+    ConnectorProber& prober_;
+    const int card_;
+    ChangeCallback callback_;
+    const HotplugDebounce debounce_;
+    std::unordered_map<std::uint32_t, Connector> connectors_;
+    bool rescan_ = false;
+    std::uint64_t rescan_deadline_ns_ = 0;
+    std::uint64_t property_ns_ = 0; ///< Oldest undelivered property event; 0 if none.
+    std::vector<std::uint32_t> ids_; ///< Scratch for scan().
+    Stats stats_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <system_error>
+
+namespace dispctrl {
+
+/// Panel Self Refresh support of an eDP sink, from its DPCD receiver
+/// capabilities (DP_PSR_SUPPORT and DP_PSR_CAPS).
+struct PsrCaps {
+    enum class Version : std::uint8_t {
+        None,
+        Psr1,       ///< Whole-frame self refresh.
+        Psr2,       ///< Selective update, without Y coordinates.
+        Psr2YCoord, ///< Selective update; the panel needs Y coordinates.
+        Psr2EarlyTransport,
+    };
+
+    Version version = Version::None;
+    std::uint32_t setup_time_us = 0;      ///< Extra time the panel needs before it can enter PSR.
+    bool su_granularity_required = false; ///< PSR2 updates must be aligned to the panel's granularity.
+
+    bool supported() const noexcept { return version != Version::None; }
+    bool selective_update() const noexcept { return version >= Version::Psr2; }
+};
+
+/// Reads @p caps through the DisplayPort AUX character device @p aux_dev,
+/// e.g. "/dev/drm_dp_aux0" (CONFIG_DRM_DP_AUX_CHARDEV).
+std::error_code read_psr_caps(const std::string& aux_dev, PsrCaps& caps) noexcept;
+
+/// The AUX device of the connector at @p connector_dir, e.g.
+/// "/sys/class/drm/card0-eDP-1"; empty if it has none.
+std::string find_dp_aux(const std::string& connector_dir);
+
+/// When an IdleScheduler considers its output idle.
+struct IdlePolicy {
+    /// Run of unchanged frames, in time, after which the output goes Idle.
+    /// PSR drivers themselves wait a few unchanged frames before entering
+    /// self refresh, so values well below a second lose nothing; 0 goes
+    /// Idle at the first unchanged frame.
+    std::uint64_t idle_timeout_ns = 500'000'000;
+};
+
+/// Decides, frame by frame, whether an output has anything to commit.
+///
+/// Committing a frame with no damage and no pending property writes
+/// re-sends the buffer already on screen: the display engine, the memory
+/// controller and the CPU all wake up for it, and an eDP panel with PSR
+/// never gets the run of unchanged frames it needs to start refreshing
+/// itself. begin_frame() suppresses those frames. Once nothing has
+/// changed for IdlePolicy::idle_timeout_ns the output is Idle: the event loop
+/// should stop its frame clock as well (vblank waits, repeat and latch
+/// timers, anything that requests a vblank event), because a held vblank
+/// interrupt also keeps the driver from entering self refresh. The next
+/// on_activity() reports the wakeup so the loop restarts it.
+///
+/// The scheduler owns no timer and never touches the device; drive it
+/// from the frame clock, e.g.
+///
+///     if (scheduler.on_activity(now)) restart_frame_clock();  // damage
+///     // at each frame tick while frame_clock() is true:
+///     bool dirty = !tracker.end_frame().empty() || !queue.empty();
+///     if (scheduler.begin_frame(dirty, now)) compose_and_flush();
+///
+/// Not thread-safe.
+class IdleScheduler {
+public:
+    enum class State : std::uint8_t {
+        Active,      ///< The last frame had changes.
+        Suppressing, ///< Skipping unchanged frames; the frame clock still runs.
+        Idle,        ///< Nothing changed for idle_timeout_ns; no frame clock.
+    };
+
+    struct Stats {
+        std::uint64_t frames = 0;     ///< Frame ticks seen by begin_frame().
+        std::uint64_t committed = 0;  ///< Frames that had to be committed.
+        std::uint64_t suppressed = 0; ///< Unchanged frames that were not.
+        std::uint64_t idle_entries = 0;
+        std::uint64_t idle_ns = 0; ///< Time spent Idle, up to the last wakeup.
+    };
+
+    /// Called on every transition into (true) or out of (false) Idle.
+    using IdleCallback = std::function<void(bool idle)>;
+
+    explicit IdleScheduler(IdlePolicy policy = {}) noexcept : policy_(policy) {}
+
+    const IdlePolicy& policy() const noexcept { return policy_; }
+    void set_policy(const IdlePolicy& policy) noexcept { policy_ = policy; }
+    void set_idle_callback(IdleCallback cb) { idle_cb_ = std::move(cb); }
+
+    /// Something will need a commit: damage, a property write, a cursor
+    /// move. Returns true if this ends an Idle period, in which case the
+    /// frame clock has to be restarted.
+    bool on_activity(std::uint64_t now_ns);
+
+    /// At a frame tick: true if the frame must be composed and committed,
+    /// false if it is suppressed. @p dirty says whether anything changed
+    /// since the last committed frame.
+    bool begin_frame(bool dirty, std::uint64_t now_ns);
+
+    State state() const noexcept { return state_; }
+
+    /// True while the event loop should keep ticking frames.
+    bool frame_clock() const noexcept { return state_ != State::Idle; }
+
+    /// While Suppressing, when the output goes Idle if nothing changes;
+    /// 0 otherwise. Only needed by loops that tick less often than every
+    /// refresh.
+    std::uint64_t idle_deadline() const noexcept;
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    void wake(std::uint64_t now_ns);
+
+    IdlePolicy policy_;
+    IdleCallback idle_cb_;
+    State state_ = State::Active;
+    std::uint64_t last_change_ns_ = 0;
+    std::uint64_t idle_since_ns_ = 0;
+    Stats stats_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "dispctrl/framebuffer.hpp"
+#include "dispctrl/geometry.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <sys/types.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace dispctrl {
+
+namespace ipc {
+struct Channel;
+struct Message;
+} // namespace ipc
+
+/// Version of the wire types below and of the shared channel layout;
+/// client and daemon must agree exactly.
+inline constexpr std::uint32_t kIpcVersion = 1;
+
+/// One layer change, pushed by a client through its shared-memory ring.
+struct IpcLayerUpdate {
+    std::uint32_t surface_id = 0; ///< Client-chosen layer id.
+    std::uint32_t buffer_id = 0;  ///< From attach_buffer(); 0 hides the surface.
+    Rect src;                     ///< Crop of the buffer.
+    Rect dst;                     ///< Position on the output.
+    std::int32_t zpos = 0;
+    std::uint64_t serial = 0; ///< Echoed in IpcEvents about this update.
+};
+
+/// Daemon to client, through the second ring of the channel.
+struct IpcEvent {
+    enum class Type : std::uint32_t {
+        Presented, ///< The update is on screen since timestamp_ns.
+        Released,  ///< The daemon no longer reads buffer_id.
+        Dropped,   ///< The update was superseded before reaching the screen.
+    };
+
+    Type type = Type::Presented;
+    std::uint32_t surface_id = 0;
+    std::uint32_t buffer_id = 0;
+    std::uint64_t serial = 0;
+    std::uint64_t timestamp_ns = 0;
+};
+
+/// Credentials of a connected client, from SO_PEERCRED.
+struct IpcPeer {
+    pid_t pid = 0;
+    uid_t uid = 0;
+    gid_t gid = 0;
+};
+
+/// Daemon end of the client protocol.
+///
+/// Clients connect to a SOCK_SEQPACKET socket, which only carries rare
+/// control messages: the handshake, and buffer attachment with the
+/// DMA-BUF fds passed as SCM_RIGHTS. The handshake hands each client a
+/// sealed memfd holding a pair of SPSC rings, one for IpcLayerUpdates and
+/// one for IpcEvents, plus an eventfd doorbell per direction. A side rings
+/// the doorbell only when the other announced in shared memory that it is
+/// going to sleep, so a busy client costs no system call per update.
+///
+/// dispatch() runs everything from one thread and calls the Handler. Each
+/// wakeup takes at most a ring's worth of updates from a client before
+/// moving on to the next, so one flooding client cannot starve the rest.
+/// The shared memory is writable by the client: the daemon never trusts
+/// what it reads there beyond the ring bounds.
+class IpcServer {
+public:
+    static constexpr std::size_t kUpdateRing = 256;
+    static constexpr std::size_t kEventRing = 256;
+
+    /// Called from dispatch().
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+
+        virtual void on_connect(std::uint32_t client, const IpcPeer& peer) = 0;
+        /// @p desc carries fds the server owns until the buffer is
+        /// detached or the client goes away.
+        virtual void on_attach(std::uint32_t client, std::uint32_t buffer_id, const DmaBufDesc& desc) = 0;
+        virtual void on_detach(std::uint32_t client, std::uint32_t buffer_id) = 0;
+        /// @p buffer is the attached buffer the update refers to, or
+        /// nullptr for buffer id 0 and ids the client never attached.
+        virtual void on_update(std::uint32_t client, const IpcLayerUpdate& update, const DmaBufDesc* buffer) = 0;
+        virtual void on_disconnect(std::uint32_t client) = 0;
+    };
+
+    struct Stats {
+        std::uint64_t connects = 0;
+        std::uint64_t disconnects = 0;
+        std::uint64_t rejected = 0;  ///< Handshakes refused (version, resources).
+        std::uint64_t updates = 0;
+        std::uint64_t attaches = 0;
+        std::uint64_t wakeups = 0;   ///< Doorbells rung by clients.
+        std::uint64_t overflows = 0; ///< post() calls that found the event ring full.
+    };
+
+    /// Listens on the Unix socket @p path, replacing a stale one; a path
+    /// starting with '@' names an abstract socket. Throws std::system_error
+    /// on failure.
+    IpcServer(const std::string& path, Handler& handler);
+    ~IpcServer();
+    IpcServer(const IpcServer&) = delete;
+    IpcServer& operator=(const IpcServer&) = delete;
+
+    /// Pollable; readable whenever dispatch() has work.
+    int fd() const noexcept { return epoll_.get(); }
+
+    /// Waits up to @p timeout_ms for client activity and handles it.
+    std::error_code dispatch(int timeout_ms);
+
+    /// Queues @p event for @p client. Fails with no_buffer_space when its
+    /// ring is full and invalid_argument for unknown clients.
+    std::error_code post(std::uint32_t client, const IpcEvent& event) noexcept;
+
+    /// Closes the connection of @p client (on_disconnect() follows).
+    void disconnect(std::uint32_t client);
+
+    std::size_t clients() const noexcept { return clients_.size(); }
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    struct Buffer {
+        DmaBufDesc desc;
+        UniqueFd fds[4];
+    };
+    struct Client;
+
+    void accept_clients();
+    void read_socket(Client& client);
+    bool handshake(Client& client);
+    bool attach(Client& client, const ipc::Message& message, std::array<UniqueFd, 4>& fds, std::size_t fd_count);
+    bool drain(Client& client);
+    void remove(std::uint32_t client);
+
+    Handler& handler_;
+    std::string path_;
+    UniqueFd listen_;
+    UniqueFd epoll_;
+    std::unordered_map<std::uint32_t, std::unique_ptr<Client>> clients_;
+    std::vector<std::uint32_t> ready_;   ///< Clients with updates left after their last turn.
+    std::vector<std::uint32_t> turn_;    ///< ready_ of the previous dispatch(), being served.
+    std::vector<std::uint32_t> closing_; ///< Removed at the end of dispatch().
+    std::uint32_t next_id_ = 1;
+    Stats stats_;
+};
+
+/// Client end: attach buffers once, then push updates without a system
+/// call in the common case.
+///
+/// Not thread-safe; one thread submits and reads events.
+class IpcClient {
+public:
+    /// Connects to the daemon at @p path and performs the handshake;
+    /// throws std::system_error on failure.
+    explicit IpcClient(const std::string& path);
+    ~IpcClient();
+    IpcClient(const IpcClient&) = delete;
+    IpcClient& operator=(const IpcClient&) = delete;
+
+    /// Sends @p desc with its fds; @p buffer_id names it in later updates.
+    /// The fds are duplicated by the kernel and may be closed afterwards.
+    std::error_code attach_buffer(std::uint32_t buffer_id, const DmaBufDesc& desc) noexcept;
+    std::error_code detach_buffer(std::uint32_t buffer_id) noexcept;
+
+    /// Pushes @p update; no_buffer_space if the daemon is a full ring behind.
+    /// Updates that name a buffer must follow its attach_buffer().
+    std::error_code submit(const IpcLayerUpdate& update) noexcept;
+
+    /// Pollable; readable when events may be waiting.
+    int event_fd() const noexcept { return notify_.get(); }
+
+    /// Reads up to out.size() events; fewer means the ring is drained and
+    /// event_fd() will signal the next one.
+    std::size_t read_events(std::span<IpcEvent> out) noexcept;
+
+    /// False once the daemon has closed the connection.
+    bool connected() const noexcept;
+
+private:
+    UniqueFd socket_;
+    UniqueFd doorbell_; ///< Rung to wake the daemon.
+    UniqueFd notify_;   ///< Rung by the daemon.
+    ipc::Channel* channel_ = nullptr;
+    std::size_t map_size_ = 0;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "dispctrl/atomic_request.hpp"
+#include "dispctrl/sync_file.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace dispctrl {
+
+/// KMS object kinds, as used for property lookups.
+enum class ObjectType : std::uint32_t {
+    Crtc = 0xcccccccc,
+    Connector = 0xc0c0c0c0,
+    Plane = 0xeeeeeeee,
+};
+
+/// Flags for KmsDevice::atomic_commit(); values match DRM_MODE_ATOMIC_*.
+namespace commit {
+inline constexpr std::uint32_t PageFlipEvent = 0x0001;
+inline constexpr std::uint32_t TestOnly = 0x0100;
+inline constexpr std::uint32_t Nonblock = 0x0200;
+inline constexpr std::uint32_t AllowModeset = 0x0400;
+} // namespace commit
+
+/// Kernel-side description of a framebuffer built from GEM handles.
+struct FramebufferLayout {
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint32_t fourcc = 0;
+    std::uint64_t modifier = 0;
+    std::uint32_t plane_count = 0;
+    std::uint32_t handles[4] = {};
+    std::uint32_t pitches[4] = {};
+    std::uint32_t offsets[4] = {};
+};
+
+/// A vblank or page-flip completion event decoded from a DRM fd.
+struct KmsEvent {
+    enum class Type : std::uint8_t { Vblank, FlipComplete };
+
+    Type type = Type::Vblank;
+    std::uint32_t crtc_id = 0;
+    std::uint32_t sequence = 0;
+    std::uint64_t timestamp_ns = 0; ///< CLOCK_MONOTONIC scanout timestamp.
+    std::uint64_t user_data = 0;
+};
+
+/// Largest number of events a single read_kms_events() call can return.
+inline constexpr std::size_t kMaxEventsPerRead = 32;
+
+/// Reads and decodes the events currently queued on a DRM fd.
+///
+/// @p out must provide room for kMaxEventsPerRead entries. Returns an empty
+/// error and @p count == 0 when nothing is pending on a non-blocking fd.
+std::error_code read_kms_events(int fd, std::span<KmsEvent> out, std::size_t& count) noexcept;
+
+/// The subset of KMS that DispCtrl drives.
+///
+/// DrmDevice implements it on top of a /dev/dri/card* node; other
+/// implementations exist to run the pipeline without display hardware.
+/// Operations report failure through std::error_code and never throw.
+class KmsDevice {
+public:
+    virtual ~KmsDevice() = default;
+
+    /// Pollable fd that delivers DRM events (see read_kms_events()).
+    virtual int event_fd() const noexcept = 0;
+
+    /// Imports a DMA-BUF as a GEM handle without copying its contents.
+    ///
+    /// Importing the same DMA-BUF twice yields the same handle; callers must
+    /// reference-count handles themselves (see FramebufferImporter).
+    virtual std::error_code import_dmabuf(int dmabuf_fd, std::uint32_t& handle) noexcept = 0;
+    virtual void close_handle(std::uint32_t handle) noexcept = 0;
+
+    virtual std::error_code add_framebuffer(const FramebufferLayout& layout,
+                                            std::uint32_t& fb_id) noexcept = 0;
+    virtual void remove_framebuffer(std::uint32_t fb_id) noexcept = 0;
+
+    /// Queues a flip of @p crtc_id to @p fb_id at the next vblank. A
+    /// KmsEvent::Type::FlipComplete carrying @p user_data follows.
+    virtual std::error_code page_flip(std::uint32_t crtc_id, std::uint32_t fb_id,
+                                      std::uint64_t user_data) noexcept = 0;
+
+    /// Applies a finalized AtomicRequest in one DRM_IOCTL_MODE_ATOMIC call.
+    /// With commit::PageFlipEvent, one FlipComplete event carrying
+    /// @p user_data is delivered per CRTC touched by the commit.
+    virtual std::error_code atomic_commit(const AtomicRequest& request, std::uint32_t flags,
+                                          std::uint64_t user_data) noexcept = 0;
+
+    /// Resolves a property name (e.g. "FB_ID") on a KMS object to its id.
+    virtual std::error_code find_property(std::uint32_t object_id, ObjectType type,
+                                          std::string_view name, std::uint32_t& prop_id) noexcept = 0;
+
+    /// Creates a property blob holding a copy of @p data. Once a commit
+    /// referencing the blob has been accepted, the blob may be destroyed;
+    /// the committed state keeps its own reference.
+    virtual std::error_code create_blob(const void* data, std::size_t size, std::uint32_t& blob_id) noexcept = 0;
+    virtual void destroy_blob(std::uint32_t blob_id) noexcept = 0;
+
+    /// State of a fence fd passed to (IN_FENCE_FD) or returned by
+    /// (OUT_FENCE_PTR) this device's commits; sync_files unless the device
+    /// stands in fences of its own.
+    virtual std::error_code fence_status(int fence_fd, FenceStatus& status) noexcept
+    {
+        return query_fence(fence_fd, status);
+    }
+};
+
+/// KmsDevice backed by a DRM card node.
+class DrmDevice final : public KmsDevice {
+public:
+    /// Opens @p path (e.g. "/dev/dri/card0"). Throws std::system_error when
+    /// the node cannot be opened or lacks PRIME import support.
+    static std::unique_ptr<DrmDevice> open(const std::string& path);
+
+    /// Takes ownership of an already opened DRM fd.
+    explicit DrmDevice(UniqueFd fd);
+
+    int fd() const noexcept { return fd_.get(); }
+    bool supports_atomic() const noexcept { return atomic_; }
+    bool supports_modifiers() const noexcept { return modifiers_; }
+    bool supports_prime_export() const noexcept { return prime_export_; }
+
+    /// Asks the kernel to list this device's writeback connectors, for
+    /// capturing CRTC output (WritebackCapture); false if it has none or
+    /// the device is not atomic. Discovery then reports them with type
+    /// DRM_MODE_CONNECTOR_WRITEBACK (18).
+    bool enable_writeback() noexcept;
+
+    /// Like find_property(), also returning the property's current value
+    /// on @p object_id.
+    std::error_code get_property(std::uint32_t object_id, ObjectType type, std::string_view name,
+                                 std::uint32_t& prop_id, std::uint64_t& value) const noexcept;
+
+    /// Reads the contents of a property blob (EDID, IN_FORMATS, ...).
+    std::error_code read_blob(std::uint32_t blob_id, std::vector<std::uint8_t>& out) const noexcept;
+
+    /// Exports a GEM handle of this device as a DMA-BUF that other devices
+    /// can import. The caller owns the returned fd.
+    std::error_code export_dmabuf(std::uint32_t handle, int& dmabuf_fd) const noexcept;
+
+    int event_fd() const noexcept override { return fd_.get(); }
+    std::error_code import_dmabuf(int dmabuf_fd, std::uint32_t& handle) noexcept override;
+    void close_handle(std::uint32_t handle) noexcept override;
+    std::error_code add_framebuffer(const FramebufferLayout& layout,
+                                    std::uint32_t& fb_id) noexcept override;
+    void remove_framebuffer(std::uint32_t fb_id) noexcept override;
+    std::error_code page_flip(std::uint32_t crtc_id, std::uint32_t fb_id,
+                              std::uint64_t user_data) noexcept override;
+    std::error_code atomic_commit(const AtomicRequest& request, std::uint32_t flags,
+                                  std::uint64_t user_data) noexcept override;
+    std::error_code find_property(std::uint32_t object_id, ObjectType type, std::string_view name,
+                                  std::uint32_t& prop_id) noexcept override;
+    std::error_code create_blob(const void* data, std::size_t size, std::uint32_t& blob_id) noexcept override;
+    void destroy_blob(std::uint32_t blob_id) noexcept override;
+
+private:
+    UniqueFd fd_;
+    bool atomic_ = false;
+    bool modifiers_ = false;
+    bool prime_export_ = false;
+};
+
+} // namespace dispctrl
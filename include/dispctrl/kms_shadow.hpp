@@ -0,0 +1,96 @@
+#pragma once
+
+#include "dispctrl/atomic_request.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace dispctrl {
+
+/// Shadow copy of the KMS state committed through the CommitQueues that
+/// share it, for sending only the property writes that change something.
+///
+/// Keep one per device and hand it to the queue of every CRTC
+/// (CommitQueue::set_shadow()): planes and connectors move between CRTCs,
+/// so their state is not per head. Values are recorded only once the
+/// kernel has accepted a commit, so a rejected one leaves the shadow
+/// describing the hardware. Blob properties (MODE_ID, GAMMA_LUT, ...) are
+/// compared by content, not by blob id: re-applying the mode the CRTC
+/// already shows creates no blob and writes nothing, so it cannot trigger
+/// a mode set.
+///
+/// The shadow knows only what went through it. Call invalidate() when
+/// another client may have changed the state (after regaining DRM master,
+/// on resume) and forget() when an object goes away. Writes that are an
+/// action rather than state (IN_FENCE_FD, OUT_FENCE_PTR, FB_DAMAGE_CLIPS)
+/// must be registered with add_volatile() so they are always sent.
+///
+/// Lookups are binary searches in one sorted array, which a finalized
+/// request walks in order; not thread-safe.
+class KmsShadow {
+public:
+    struct Stats {
+        std::uint64_t checked = 0;   ///< Writes compared against the shadow.
+        std::uint64_t unchanged = 0; ///< Of those, dropped as already in place.
+        std::uint64_t recorded = 0;  ///< Writes recorded from committed requests.
+    };
+
+    void add_volatile(std::uint32_t prop_id);
+    bool is_volatile(std::uint32_t prop_id) const noexcept;
+
+    /// True if the last committed value of the property is @p value.
+    bool matches(std::uint32_t object_id, std::uint32_t prop_id, std::uint64_t value) const noexcept;
+
+    /// True if the property holds a blob recorded with record_blob() whose
+    /// contents equal @p data; @p blob_id is then set to it.
+    bool matches_blob(std::uint32_t object_id, std::uint32_t prop_id, const void* data, std::size_t size,
+                      std::uint32_t& blob_id) const noexcept;
+
+    /// Removes the writes of finalized @p request that would change
+    /// nothing; returns how many.
+    std::size_t filter(AtomicRequest& request) noexcept;
+
+    /// Records the writes of finalized @p request, which the kernel has
+    /// accepted. Out of memory, the shadow is invalidated instead.
+    void record(const AtomicRequest& request) noexcept;
+
+    /// Records that @p blob_id, committed as the property's value, holds
+    /// @p data.
+    void record_blob(std::uint32_t object_id, std::uint32_t prop_id, std::uint32_t blob_id, const void* data,
+                     std::size_t size) noexcept;
+
+    /// Drops everything known about @p object_id.
+    void forget(std::uint32_t object_id) noexcept;
+
+    /// Drops everything; the next commits send every write.
+    void invalidate() noexcept;
+
+    /// Properties with a known value.
+    std::size_t size() const noexcept { return values_.size(); }
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    struct Value {
+        std::uint64_t key; ///< Object id << 32 | property id.
+        std::uint64_t value;
+    };
+    struct Blob {
+        std::uint32_t blob_id;
+        std::vector<std::uint8_t> data;
+    };
+
+    static constexpr std::uint64_t key(std::uint32_t object_id, std::uint32_t prop_id) noexcept
+    {
+        return std::uint64_t{object_id} << 32 | prop_id;
+    }
+
+    std::vector<Value> values_; ///< Sorted by key, the order of a finalized request.
+    std::unordered_map<std::uint64_t, Blob> blobs_;
+    std::vector<std::uint32_t> volatile_;
+    Stats stats_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace dispctrl {
+
+/// A display timing, decoded from EDID/DisplayID or reported by the kernel.
+struct ModeInfo {
+    enum Flags : std::uint32_t {
+        PHSync = 1u << 0,
+        NHSync = 1u << 1,
+        PVSync = 1u << 2,
+        NVSync = 1u << 3,
+        Interlace = 1u << 4,
+    };
+
+    std::uint32_t clock_khz = 0;
+    std::uint16_t hdisplay = 0;
+    std::uint16_t hsync_start = 0;
+    std::uint16_t hsync_end = 0;
+    std::uint16_t htotal = 0;
+    std::uint16_t vdisplay = 0;
+    std::uint16_t vsync_start = 0;
+    std::uint16_t vsync_end = 0;
+    std::uint16_t vtotal = 0;
+    std::uint32_t flags = 0; ///< ModeInfo::Flags; values match DRM_MODE_FLAG_*.
+    bool preferred = false;
+
+    /// Vertical refresh in millihertz (59940 for 59.94 Hz).
+    std::uint32_t refresh_mhz() const noexcept
+    {
+        const std::uint64_t pixels = static_cast<std::uint64_t>(htotal) * vtotal;
+        if (pixels == 0)
+            return 0;
+        std::uint64_t mhz = (static_cast<std::uint64_t>(clock_khz) * 1'000'000 + pixels / 2) / pixels;
+        if (flags & Interlace)
+            mhz *= 2;
+        return static_cast<std::uint32_t>(mhz);
+    }
+
+    /// "1920x1080@60.00"-style label for logs.
+    std::string name() const;
+
+    bool operator==(const ModeInfo&) const noexcept = default;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "dispctrl/format.hpp"
+#include "dispctrl/framebuffer.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/plane_solver.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace dispctrl {
+
+/// How a modifier lays pixels out, in increasing order of how little
+/// memory bandwidth scanning it out takes.
+enum class LayoutClass : std::uint8_t {
+    Implicit,   ///< modifier::Invalid: driver-private, only valid on one device.
+    Linear,
+    Tiled,
+    Compressed, ///< AFBC, CCS, DCC, ...; may carry auxiliary planes.
+};
+
+LayoutClass classify_modifier(std::uint64_t modifier) noexcept;
+
+/// Decodes an IN_FORMATS property blob into format/modifier pairs.
+std::error_code parse_in_formats(std::span<const std::uint8_t> blob, std::vector<PlaneFormat>& out);
+
+/// What @p plane_id can scan out: its IN_FORMATS when the driver exposes
+/// one, otherwise its format list, linear only.
+std::error_code read_plane_formats(const DrmDevice& device, std::uint32_t plane_id, std::vector<PlaneFormat>& out);
+
+/// Result of a negotiation for one fourcc.
+struct ModifierChoice {
+    /// Layout the producer should allocate.
+    std::uint64_t modifier = modifier::Invalid;
+    /// True if the consumer can import that layout, so the buffer is
+    /// shared through PRIME. Otherwise modifier is the producer's best
+    /// layout and the buffer has to be copied (composited) for scanout.
+    bool direct = false;
+};
+
+/// Picks the best layout of @p fourcc both sides support: the highest
+/// LayoutClass, ties going to the earlier entry of @p producer (drivers
+/// list their preferred layouts first). Implicit layouts never cross a
+/// device boundary and are ignored. Fails with not_supported when the
+/// producer cannot render @p fourcc at all.
+std::error_code negotiate_modifier(std::uint32_t fourcc, std::span<const PlaneFormat> producer,
+                                   std::span<const PlaneFormat> consumer, ModifierChoice& out);
+
+/// True if @p desc can be imported and scanned out as is by a device
+/// supporting @p consumer: format and modifier are listed and, for a
+/// linear buffer, every pitch is a multiple of @p linear_pitch_align
+/// (tiled layouts carry their own pitch rules).
+bool scanout_compatible(const DmaBufDesc& desc, std::span<const PlaneFormat> consumer,
+                        std::uint32_t linear_pitch_align = 64) noexcept;
+
+/// Caches modifier negotiations between registered devices.
+///
+/// A render device, and every scanout device it feeds, is registered once
+/// with the layouts it supports; negotiate() then costs a hash lookup per
+/// (producer, consumer, fourcc) after the first. Format lists are immutable
+/// once registered; update() replaces one and drops the results that used
+/// it. Thread-safe; misses are computed outside the lock.
+class ModifierNegotiator {
+public:
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+    };
+
+    /// Registers a device; returns the id to pass to negotiate().
+    std::uint32_t add_device(std::vector<PlaneFormat> formats);
+    /// Replaces the formats of @p device, e.g. after a driver reload.
+    void update(std::uint32_t device, std::vector<PlaneFormat> formats);
+
+    /// Negotiates @p fourcc for buffers rendered by @p producer and
+    /// scanned out by @p consumer; see negotiate_modifier(). Unknown ids
+    /// fail with invalid_argument.
+    std::error_code negotiate(std::uint32_t producer, std::uint32_t consumer, std::uint32_t fourcc,
+                              ModifierChoice& out);
+
+    Stats stats() const;
+
+private:
+    using FormatList = std::shared_ptr<const std::vector<PlaneFormat>>;
+    struct Key {
+        std::uint32_t producer;
+        std::uint32_t consumer;
+        std::uint32_t fourcc;
+
+        bool operator==(const Key&) const noexcept = default;
+    };
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const noexcept;
+    };
+    struct Result {
+        ModifierChoice choice;
+        std::error_code error;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<FormatList> devices_;
+    std::unordered_map<Key, Result, KeyHash> results_;
+    Stats stats_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <system_error>
+
+namespace dispctrl {
+
+/// Read-only view of a client image in any supported source format.
+struct ConstImage {
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint32_t fourcc = 0;
+    const std::uint8_t* planes[3] = {};
+    std::uint32_t pitches[3] = {};
+};
+
+/// Instruction set used by a conversion kernel.
+enum class ConvertIsa : std::uint8_t { Scalar, Avx2, Neon };
+
+const char* to_string(ConvertIsa isa) noexcept;
+
+/// Best kernel set available on this CPU, detected once at first use.
+ConvertIsa best_convert_isa() noexcept;
+
+/// True if kernels for @p isa are compiled in and the CPU can run them.
+bool convert_isa_available(ConvertIsa isa) noexcept;
+
+/// Software fallback for planes that cannot scan out @p src.fourcc:
+/// converts NV12, YUYV or RGB565 into XRGB8888 at @p dst.
+///
+/// YUV input is treated as BT.601 limited range. Every ConvertIsa produces
+/// bit-identical output; ConvertIsa::Scalar is the reference. Returns
+/// errc::not_supported for unknown source formats and
+/// errc::invalid_argument for YUYV images of odd width.
+std::error_code convert_to_xrgb8888(const ConstImage& src, std::uint8_t* dst,
+                                    std::uint32_t dst_pitch) noexcept;
+
+/// As above, but forces a kernel set; errc::not_supported if @p isa is
+/// unavailable. Intended for validation and benchmarking.
+std::error_code convert_to_xrgb8888(const ConstImage& src, std::uint8_t* dst, std::uint32_t dst_pitch,
+                                    ConvertIsa isa) noexcept;
+
+} // namespace dispctrl
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "dispctrl/atomic_request.hpp"
+#include "dispctrl/geometry.hpp"
+#include "dispctrl/kms_device.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace dispctrl {
+
+class CommitQueue;
+
+enum class PlaneType : std::uint8_t { Primary, Overlay, Cursor };
+
+/// A format/modifier pair a plane can scan out.
+struct PlaneFormat {
+    std::uint32_t fourcc = 0;
+    std::uint64_t modifier = 0;
+
+    constexpr bool operator==(const PlaneFormat&) const noexcept = default;
+};
+
+/// What one hardware plane of the CRTC can do.
+struct PlaneCaps {
+    std::uint32_t plane_id = 0;
+    PlaneType type = PlaneType::Overlay;
+    /// Immutable stacking position; higher values are closer to the viewer.
+    std::uint32_t zpos = 0;
+    std::vector<PlaneFormat> formats;
+    /// Largest supported source/destination ratio (downscaling) and
+    /// destination/source ratio (upscaling); 1.0 means no scaling.
+    double max_downscale = 1.0;
+    double max_upscale = 1.0;
+    std::uint32_t max_width = 8192;
+    std::uint32_t max_height = 8192;
+    /// DRM_MODE_ROTATE_* bits of the plane's "rotation" property (see
+    /// drm_rotation()); planes without the property only scan out upright.
+    std::uint32_t rotations = drm_rotation(Rotation::R0);
+    /// Whether quarter turns work on linear buffers; many engines rotate
+    /// only tiled ones.
+    bool rotate_linear = true;
+
+    bool supports(std::uint32_t fourcc, std::uint64_t modifier) const noexcept;
+    bool supports(Rotation rotation, std::uint64_t modifier) const noexcept;
+};
+
+/// One client surface of the frame, in bottom-to-top order.
+struct Layer {
+    std::uint32_t fb_id = 0;
+    std::uint32_t fourcc = 0;
+    std::uint64_t modifier = 0;
+    Rect src; ///< Crop of the buffer, in buffer pixels.
+    Rect dst; ///< Position on the output.
+    /// Applied to the crop before it is scaled to dst, as by the plane
+    /// "rotation" property and CompositeLayer::rotation.
+    Rotation rotation = Rotation::R0;
+};
+
+/// The buffer non-offloaded layers are composited into; it is scanned out
+/// by the primary plane and covers the whole output.
+struct CompositionTarget {
+    std::uint32_t fb_id = 0;
+    std::uint32_t fourcc = 0;
+    std::uint64_t modifier = 0;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    /// Applied by the primary plane when scanning the target out, e.g. R90
+    /// for a portrait desktop on a panel mounted sideways: width and height
+    /// are then the target's, the output's are exchanged. See
+    /// PlaneSolver::rotates_target().
+    Rotation rotation = Rotation::R0;
+};
+
+/// Where a layer's scaling and rotation are carried out.
+enum class TransformPath : std::uint8_t {
+    Plane, ///< By the plane scanning the layer out, at no memory cost.
+    Cpu,   ///< By the compositor while blending, or nothing to transform.
+    Gpu,   ///< By the GPU, into a buffer that the compositor blends as is.
+};
+
+/// Result of PlaneSolver::solve().
+struct PlaneAssignment {
+    /// Per layer, the plane that scans it out, or 0 if it is composited.
+    std::vector<std::uint32_t> plane_ids;
+    /// Per layer, where its scaling and rotation happen: Plane for exactly
+    /// the offloaded layers.
+    std::vector<TransformPath> paths;
+    /// True if the primary plane shows the composition target.
+    bool composited = false;
+
+    std::size_t offloaded() const noexcept;
+};
+
+/// Cost model for composited layers, in bytes per nanosecond (GB/s) of
+/// memory traffic.
+struct TransformCosts {
+    double cpu_bytes_per_ns = 8.0;
+    /// Slowdown of a rotated fetch, whose column walks touch a new cache
+    /// line for every pixel.
+    double cpu_rotate_factor = 3.0;
+    /// 0 if there is no GPU to transform layers ahead of composition.
+    double gpu_bytes_per_ns = 0.0;
+    /// Fixed cost of one GPU pass: submission, fence, wakeup.
+    std::uint64_t gpu_pass_ns = 150'000;
+};
+
+/// Limits that TEST_ONLY cannot be relied upon to enforce.
+struct PlaneLimits {
+    /// Bytes the display engine may fetch per frame across all planes,
+    /// composition target included; 0 disables the check.
+    std::uint64_t max_fetch_bytes = 0;
+    /// TEST_ONLY commits per search; after that everything is composited.
+    unsigned max_tests = 4;
+    /// Planes that may scale at once, for engines whose scalers are a pool
+    /// shared by the CRTC's planes; 0 if every plane has its own.
+    unsigned max_scalers = 0;
+    /// Plane scalers have few filter taps and alias beyond about 2:1, so
+    /// when there is a GPU stronger downscales are left to it whatever
+    /// max_downscale allows; 0 disables the check.
+    double max_quality_downscale = 2.0;
+    TransformCosts costs;
+};
+
+/// Assigns layers to the hardware planes of one CRTC.
+///
+/// A search checks format, scaling, size, z-order and bandwidth locally,
+/// so only assignments that can plausibly work reach the kernel, then
+/// validates the candidate with TEST_ONLY commits, demoting the
+/// layer whose composition is cheapest after each rejection, so rotated and
+/// scaled layers keep their planes longest. Composited layers that need a
+/// transform are given to the CPU or GPU path, whichever TransformCosts
+/// rates cheaper; the compositor maps them into the target through its
+/// rotation. Solutions are cached by layer topology (formats, crops,
+/// positions and rotations, but not framebuffer ids), so frames where only
+/// buffer contents change reuse the previous answer without any ioctl.
+class PlaneSolver {
+public:
+    struct Stats {
+        std::uint64_t solves = 0;
+        std::uint64_t cache_hits = 0;
+        std::uint64_t test_commits = 0;
+        std::uint64_t test_failures = 0;
+        std::uint64_t gpu_transforms = 0; ///< Layers searches gave TransformPath::Gpu.
+        std::uint64_t cpu_transforms = 0; ///< Layers searches left to transform on the CPU.
+    };
+
+    static constexpr std::size_t kCacheSize = 4;
+
+    /// Looks up the plane properties, "rotation" only for planes that can
+    /// rotate; throws std::system_error if a plane lacks one. Exactly one
+    /// plane must be PlaneType::Primary.
+    PlaneSolver(KmsDevice& device, std::uint32_t crtc_id, std::vector<PlaneCaps> planes,
+                PlaneLimits limits = {});
+
+    /// Whether the primary plane can scan out @p target at its rotation.
+    /// If not, compose in output orientation: an unrotated target, with
+    /// each layer's rotation adjusted.
+    bool rotates_target(const CompositionTarget& target) const noexcept;
+
+    /// Finds an assignment for @p layers. Fails with errc::not_supported
+    /// if !rotates_target(target), otherwise only if even full composition
+    /// is rejected by the kernel.
+    std::error_code solve(std::span<const Layer> layers, const CompositionTarget& target,
+                          PlaneAssignment& out);
+
+    /// Queues the plane state of @p assignment, disabling unused planes.
+    void apply(std::span<const Layer> layers, const CompositionTarget& target,
+               const PlaneAssignment& assignment, CommitQueue& queue) const;
+
+    /// Drops cached solutions, e.g. after a mode set or hotplug.
+    void invalidate() noexcept;
+
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    struct Props {
+        std::uint32_t fb_id, crtc_id;
+        std::uint32_t src_x, src_y, src_w, src_h;
+        std::uint32_t crtc_x, crtc_y, crtc_w, crtc_h;
+        std::uint32_t rotation; ///< 0 if the plane has no rotation property.
+    };
+
+    struct Plane {
+        PlaneCaps caps;
+        Props props;
+    };
+
+    /// The part of a layer that determines its assignment.
+    struct LayerKey {
+        std::uint32_t fourcc;
+        std::uint64_t modifier;
+        Rect src;
+        Rect dst;
+        Rotation rotation;
+
+        bool operator==(const LayerKey&) const noexcept = default;
+    };
+
+    struct CacheEntry {
+        std::uint64_t hash = 0;
+        std::vector<LayerKey> topology;
+        PlaneFormat target_format;
+        Rotation target_rotation;
+        PlaneAssignment assignment;
+        std::uint64_t last_used = 0;
+    };
+
+    std::uint64_t make_key(std::span<const Layer> layers, const CompositionTarget& target);
+    bool fits(const Plane& plane, const Layer& layer) const noexcept;
+    bool within_quality(const Layer& layer) const noexcept;
+    TransformPath compose_path(const Layer& layer, const CompositionTarget& target, std::uint64_t& ns) const noexcept;
+    void choose_paths(std::span<const Layer> layers, const CompositionTarget& target, PlaneAssignment& assignment);
+    void search(std::span<const Layer> layers, const CompositionTarget& target, PlaneAssignment& out) const;
+    std::uint64_t fetch_bytes(std::span<const Layer> layers, const CompositionTarget& target,
+                              const PlaneAssignment& assignment) const noexcept;
+    bool demote(std::span<const Layer> layers, const CompositionTarget& target, PlaneAssignment& assignment) const;
+    void restore_order(std::span<const Layer> layers, PlaneAssignment& assignment) const noexcept;
+    std::error_code test(std::span<const Layer> layers, const CompositionTarget& target,
+                         const PlaneAssignment& assignment);
+
+    template <typename Sink>
+    void write_state(std::span<const Layer> layers, const CompositionTarget& target,
+                     const PlaneAssignment& assignment, Sink& sink) const;
+
+    KmsDevice& device_;
+    std::uint32_t crtc_id_;
+    std::vector<Plane> planes_; ///< Sorted by zpos, primary first.
+    PlaneLimits limits_;
+
+    std::array<CacheEntry, kCacheSize> cache_;
+    std::uint64_t clock_ = 0;
+    std::vector<LayerKey> key_;
+    AtomicRequest request_;
+    Stats stats_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "dispctrl/framebuffer.hpp"
+#include "dispctrl/kms_device.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <system_error>
+
+namespace dispctrl {
+
+/// Flips imported client framebuffers onto one CRTC.
+///
+/// Buffers are never copied: the pipeline keeps a reference to each
+/// framebuffer until the display engine has stopped reading it, then hands
+/// it back through the release callback so the client may render into it
+/// again. At most one flip is in flight; frames presented while a flip is
+/// pending replace each other (mailbox semantics) and only the newest one
+/// reaches the screen.
+class ScanoutPipeline {
+public:
+    using ReleaseCallback = std::function<void(const std::shared_ptr<Framebuffer>&)>;
+
+    struct Stats {
+        std::uint64_t presented = 0; ///< Frames handed to present().
+        std::uint64_t flipped = 0;   ///< Flips completed by the kernel.
+        std::uint64_t replaced = 0;  ///< Frames superseded before reaching the screen.
+    };
+
+    ScanoutPipeline(KmsDevice& device, std::uint32_t crtc_id) noexcept
+        : device_(device), crtc_id_(crtc_id)
+    {
+    }
+
+    std::uint32_t crtc_id() const noexcept { return crtc_id_; }
+
+    /// Called whenever the pipeline drops its last use of a framebuffer.
+    void set_release_callback(ReleaseCallback cb) { release_ = std::move(cb); }
+
+    /// Schedules @p fb for scanout at the next available vblank.
+    std::error_code present(std::shared_ptr<Framebuffer> fb);
+
+    /// Feeds a FlipComplete event for this CRTC back into the pipeline.
+    /// Events for other CRTCs or stale flips are ignored.
+    std::error_code on_flip_complete(const KmsEvent& event);
+
+    bool flip_pending() const noexcept { return pending_ != nullptr; }
+    const std::shared_ptr<Framebuffer>& front() const noexcept { return front_; }
+    const Stats& stats() const noexcept { return stats_; }
+
+private:
+    std::error_code flip(std::shared_ptr<Framebuffer> fb);
+    void release(std::shared_ptr<Framebuffer> fb);
+
+    KmsDevice& device_;
+    std::uint32_t crtc_id_;
+    ReleaseCallback release_;
+
+    std::shared_ptr<Framebuffer> front_;   ///< On screen.
+    std::shared_ptr<Framebuffer> pending_; ///< Flip submitted, not yet complete.
+    std::shared_ptr<Framebuffer> queued_;  ///< Waiting for the pending flip.
+    std::uint64_t flip_serial_ = 0;
+    Stats stats_;
+};
+
+} // namespace dispctrl
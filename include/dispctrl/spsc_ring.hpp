@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace dispctrl {
+
+/// Destructive interference size of the x86-64 and ARMv8 cores we target.
+/// Spelled out rather than taken from <new>, whose value is ABI-unstable.
+inline constexpr std::size_t kCacheLine = 64;
+
+/// Bounded single-producer/single-consumer queue with fixed storage.
+///
+/// try_push() may only be called from one thread and try_pop() from one
+/// (possibly different) thread. Neither allocates nor blocks; a full ring
+/// rejects the push and leaves overflow policy to the caller.
+template <typename T, std::size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+public:
+    static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+    bool try_push(const T& value) noexcept
+    {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == Capacity) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == Capacity)
+                return false;
+        }
+        slots_[tail & (Capacity - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) noexcept
+    {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_)
+                return false;
+        }
+        value = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Snapshot of the fill level; exact only when both sides are quiescent.
+    std::size_t size_approx() const noexcept
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const noexcept { return size_approx() == 0; }
+
+private:
+    // Producer and consumer indices live on separate cache lines, each next
+    // to the other side's index cached locally, so the steady state touches
+    // the shared line only when the cached view runs out.
+    alignas(kCacheLine) std::atomic<std::size_t> tail_{0};
+    std::size_t cached_head_ = 0;
+    alignas(kCacheLine) std::atomic<std::size_t> head_{0};
+    std::size_t cached_tail_ = 0;
+    alignas(kCacheLine) std::array<T, Capacity> slots_{};
+};
+
+} // namespace dispctrl
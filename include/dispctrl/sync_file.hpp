@@ -0,0 +1,34 @@
+#pragma once
+
+#include "dispctrl/unique_fd.hpp"
+
+#include <cstdint>
+#include <system_error>
+
+namespace dispctrl {
+
+/// Signal state of a fence fd: a sync_file a renderer exported for a
+/// buffer (IN_FENCE_FD) or one returned by a commit (OUT_FENCE_PTR).
+struct FenceStatus {
+    enum class State : std::uint8_t { Pending, Signaled, Error };
+
+    State state = State::Pending;
+    /// CLOCK_MONOTONIC time the last fence of the file signalled; 0 while
+    /// pending, or if the driver does not record it.
+    std::uint64_t timestamp_ns = 0;
+
+    bool signaled() const noexcept { return state == State::Signaled; }
+};
+
+/// Reads the state of the sync_file @p fence_fd without waiting.
+std::error_code query_fence(int fence_fd, FenceStatus& status) noexcept;
+
+/// Blocks until @p fence_fd signals, for at most @p timeout_ns (0 polls);
+/// errc::timed_out if it has not.
+std::error_code wait_fence(int fence_fd, std::uint64_t timeout_ns) noexcept;
+
+/// A sync_file that signals once both @p a and @p b have, for planes
+/// whose buffer depends on more than one renderer.
+std::error_code merge_fences(int a, int b, UniqueFd& merged) noexcept;
+
+} // namespace dispctrl
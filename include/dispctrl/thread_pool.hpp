@@ -0,0 +1,88 @@
+#pragma once
+
+#include "dispctrl/spsc_ring.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dispctrl {
+
+/// Fork-join pool for data-parallel frame work (tiles, rows).
+///
+/// parallel_for() splits the index range evenly over all threads, the
+/// caller included. A thread that runs out of work steals the upper half
+/// of another thread's remaining range, so uneven items (a tile under six
+/// layers next to one under none) still keep every core busy. Ranges are
+/// single atomic words; parallel_for() takes no lock and allocates
+/// nothing.
+class ThreadPool {
+public:
+    struct Stats {
+        std::uint64_t jobs = 0;
+        std::uint64_t steals = 0;
+    };
+
+    /// @p threads counts the calling thread; 0 picks one per online CPU,
+    /// or one per entry of @p cpus. With @p cpus (see
+    /// PlacementPolicy::resolve()) worker thread i (from 1) pins itself to
+    /// cpus[(i - 1) % cpus.size()]. The calling thread keeps its own
+    /// affinity; a pool of cpus.size() threads leaves cpus.back() for it
+    /// to pin itself to (pin_current_thread()).
+    /// Throws std::system_error if a worker cannot be started.
+    explicit ThreadPool(unsigned threads = 0, std::span<const unsigned> cpus = {});
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Threads that run items, the caller included.
+    unsigned size() const noexcept { return static_cast<unsigned>(slots_.size()); }
+
+    /// Calls body(index, thread) for every index in [0, count) and returns
+    /// once all calls have. `thread` is in [0, size()) and identifies the
+    /// executing thread for per-thread scratch. Must not be called
+    /// concurrently or from inside a body; bodies must not throw.
+    template <typename Body>
+    void parallel_for(std::size_t count, Body&& body)
+    {
+        using Fn = std::remove_reference_t<Body>;
+        run(count, [](void* ctx, std::size_t index, unsigned thread) { (*static_cast<Fn*>(ctx))(index, thread); },
+            const_cast<void*>(static_cast<const void*>(&body)));
+    }
+
+    Stats stats() const noexcept;
+
+private:
+    using Invoke = void (*)(void*, std::size_t, unsigned);
+
+    /// One thread's remaining [begin, end), packed as begin | end << 32.
+    struct alignas(kCacheLine) Slot {
+        std::atomic<std::uint64_t> range{0};
+    };
+
+    void run(std::size_t count, Invoke invoke, void* ctx);
+    /// Spreads [0, count) over all threads; count fits a slot's range.
+    void dispatch(std::size_t count, Invoke invoke, void* ctx);
+    void work(unsigned self) noexcept;
+    bool take(unsigned self, std::size_t& index) noexcept;
+    bool steal(unsigned self) noexcept;
+    void worker(unsigned self, int cpu) noexcept;
+
+    std::vector<Slot> slots_;
+    std::vector<std::thread> threads_;
+
+    Invoke invoke_ = nullptr;
+    void* ctx_ = nullptr;
+    alignas(kCacheLine) std::atomic<std::uint64_t> generation_{0};
+    alignas(kCacheLine) std::atomic<unsigned> running_{0}; ///< Workers still inside the current job.
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::uint64_t> jobs_{0};
+    std::atomic<std::uint64_t> steals_{0};
+};
+
+} // namespace dispctrl
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dispctrl {
+
+/// CPUs and NUMA nodes of the machine, and where each GPU is attached.
+///
+/// On a multi-socket machine each GPU hangs off one socket's PCIe root;
+/// a compositor worker on the other socket reads every source and writes
+/// every target across the interconnect. discover() reads the layout from
+/// sysfs once; the placement helpers below turn it into thread affinity
+/// and memory policy. Machines without NUMA information look like a
+/// single node holding every online CPU.
+class Topology {
+public:
+    struct Node {
+        int id = 0;
+        std::vector<unsigned> cpus; ///< Online CPUs, ascending.
+    };
+
+    /// Reads "<sysfs>/devices/system/node" and "<sysfs>/devices/system/cpu".
+    /// Never fails; what cannot be read is left out.
+    static Topology discover(const std::string& sysfs = "/sys");
+
+    std::span<const Node> nodes() const noexcept { return nodes_; }
+    const Node* node(int id) const noexcept;
+
+    /// Node of @p cpu, or -1 if it is not online.
+    int node_of(unsigned cpu) const noexcept;
+
+    /// Every online CPU, ascending.
+    std::vector<unsigned> cpus() const;
+
+    /// NUMA node of the PCI device behind @p card ("card1",
+    /// "/dev/dri/card1" or "renderD128"), or -1 if the firmware does not
+    /// say (single-socket machines report -1 as well).
+    int device_node(const std::string& card) const;
+
+    /// PCI address of the device behind @p card, e.g. "0000:41:00.0";
+    /// empty if it is not a PCI device.
+    std::string device_address(const std::string& card) const;
+
+private:
+    std::string sysfs_;
+    std::vector<Node> nodes_;
+};
+
+/// Where the threads and buffers working for one device go.
+struct Placement {
+    enum class Cpus : std::uint8_t {
+        Any,        ///< Leave affinity alone.
+        DeviceNode, ///< The CPUs of the node the GPU is attached to.
+        Node,       ///< The CPUs of `node`.
+        List,       ///< Exactly `cpu_list`.
+    };
+
+    Cpus cpus = Cpus::DeviceNode;
+    int node = -1;
+    std::vector<unsigned> cpu_list;
+    /// Prefer memory of the node the CPUs belong to for buffers and
+    /// arenas (see NodeMemoryResource).
+    bool local_memory = true;
+};
+
+/// A Placement resolved against a Topology for one device.
+struct ResolvedPlacement {
+    std::vector<unsigned> cpus; ///< Empty: no affinity.
+    int memory_node = -1;       ///< -1: default memory policy.
+};
+
+/// Per-device placement configuration.
+///
+/// Devices are named either by DRM node ("card1") or by PCI address, so a
+/// configuration survives card numbers changing between boots. Devices
+/// without their own entry use the default, which follows the GPU's node.
+/// When that node is unknown, or has no online CPU, placement falls back
+/// to no affinity rather than to an arbitrary node.
+class PlacementPolicy {
+public:
+    explicit PlacementPolicy(Topology topology, Placement fallback = {})
+        : topology_(std::move(topology)), default_(std::move(fallback))
+    {
+    }
+
+    const Topology& topology() const noexcept { return topology_; }
+
+    void set_default(Placement placement) { default_ = std::move(placement); }
+    void set(const std::string& device, Placement placement);
+
+    /// Placement of the device behind @p card.
+    ResolvedPlacement resolve(const std::string& card) const;
+
+private:
+    Topology topology_;
+    Placement default_;
+    std::unordered_map<std::string, Placement> devices_;
+};
+
+/// Restricts the calling thread to @p cpus; an empty set is a no-op.
+std::error_code pin_current_thread(std::span<const unsigned> cpus) noexcept;
+
+/// Sets the memory policy of the page-aligned range [@p addr, +@p size)
+/// to prefer @p node and migrates pages already faulted in elsewhere.
+/// A node of -1 is a no-op.
+std::error_code bind_memory(void* addr, std::size_t size, int node) noexcept;
+
+/// Memory resource whose blocks come from anonymous mappings preferring
+/// one NUMA node.
+///
+/// Every allocation is its own mapping, so use it upstream of pooling
+/// resources (FrameArena, std::pmr::unsynchronized_pool_resource) or for
+/// large buffers, not for small objects. A node of -1 maps with the
+/// default policy.
+class NodeMemoryResource final : public std::pmr::memory_resource {
+public:
+    explicit NodeMemoryResource(int node) noexcept : node_(node) {}
+
+    int node() const noexcept { return node_; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    int node_;
+};
+
+} // namespace dispctrl
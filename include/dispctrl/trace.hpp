@@ -0,0 +1,146 @@
+#pragma once
+
+#include "dispctrl/clock.hpp"
+#include "dispctrl/histogram.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace dispctrl {
+
+struct CommitReport;
+
+/// The stages of a frame, in order.
+enum class TracePoint : std::uint8_t {
+    ClientSubmit,
+    ComposeBegin,
+    ComposeEnd,
+    CommitBegin, ///< Entry into the atomic ioctl.
+    CommitEnd,
+    FlipComplete,
+};
+
+inline constexpr std::size_t kTracePointCount = 6;
+
+enum class TraceMode : std::uint8_t {
+    Off,
+    Counters, ///< Latency histograms only; a few stores per trace point.
+    Full,     ///< Histograms plus every event, for export_chrome_trace().
+};
+
+struct TraceEvent {
+    std::uint64_t timestamp_ns = 0;
+    std::uint64_t frame = 0;
+    std::uint32_t head = 0;
+    std::uint32_t tid = 0;
+    TracePoint point = TracePoint::ClientSubmit;
+};
+
+/// Latency of each frame stage on one head, completed at FlipComplete.
+struct HeadLatency {
+    LatencyHistogram submit_to_flip; ///< ClientSubmit -> FlipComplete.
+    LatencyHistogram compose;        ///< ComposeBegin -> ComposeEnd.
+    LatencyHistogram commit;         ///< CommitBegin -> CommitEnd.
+    LatencyHistogram commit_to_flip; ///< CommitEnd -> FlipComplete.
+    std::atomic<std::uint64_t> frames{0};
+};
+
+/// Frame-stage instrumentation for every head.
+///
+/// record() is safe from any thread and lock-free in TraceMode::Counters:
+/// each stage timestamp goes into a per-head slot tagged with its frame
+/// number, and the FlipComplete of a frame turns the slots into histogram
+/// samples. In TraceMode::Full each thread additionally appends events to
+/// its own SPSC ring; collect() drains the rings into a bounded history
+/// that export_chrome_trace() writes as Chrome trace JSON, which Perfetto
+/// and chrome://tracing load. A full ring drops events and counts them
+/// rather than blocking the frame loop. A thread's first Full event into
+/// a tracer registers its ring under a mutex; each thread then caches the
+/// rings of the last kRingCacheSize tracers it used, so only a thread
+/// cycling through more tracers than that takes the mutex again.
+///
+/// The head table is sized at construction. Stages of up to kFrameSlots
+/// frames may be in flight per head.
+class Tracer {
+public:
+    static constexpr std::uint32_t kDefaultHeads = 16;
+    static constexpr std::size_t kFrameSlots = 16;
+    static constexpr std::size_t kRingCacheSize = 4;
+    static constexpr std::size_t kRingSize = 4096;
+    static constexpr std::size_t kHistorySize = 1 << 16;
+
+    struct Stats {
+        std::uint64_t events = 0;  ///< Events taken from thread rings.
+        std::uint64_t dropped = 0; ///< Events lost to full rings.
+        std::uint64_t bad_head = 0; ///< Records ignored for a head past heads().
+    };
+
+    /// Traces heads 0 .. @p heads - 1.
+    explicit Tracer(TraceMode mode = TraceMode::Counters, std::uint32_t heads = kDefaultHeads);
+    ~Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    void set_mode(TraceMode mode) noexcept { mode_.store(mode, std::memory_order_relaxed); }
+    TraceMode mode() const noexcept { return mode_.load(std::memory_order_relaxed); }
+
+    std::uint32_t heads() const noexcept { return head_count_; }
+
+    /// Records that @p frame of @p head (0 .. heads() - 1) reached
+    /// @p point. Heads out of range are counted in Stats::bad_head and
+    /// otherwise ignored.
+    void record(std::uint32_t head, std::uint64_t frame, TracePoint point,
+                std::uint64_t timestamp_ns = monotonic_ns()) noexcept;
+
+    /// Records CommitBegin, CommitEnd and FlipComplete from a CommitQueue
+    /// report, e.g. from its report callback.
+    void record_commit(std::uint32_t head, std::uint64_t frame, const CommitReport& report) noexcept;
+
+    /// @p head must be below heads().
+    const HeadLatency& latency(std::uint32_t head) const noexcept { return heads_[head].latency; }
+
+    /// Moves events from the thread rings into the history. Returns how
+    /// many were moved. Call it regularly (e.g. once per second) in
+    /// TraceMode::Full so rings do not overflow.
+    std::size_t collect();
+
+    /// Collects, then writes the history to @p path.
+    std::error_code export_chrome_trace(const std::string& path);
+
+    Stats stats() const;
+
+private:
+    struct Slot {
+        std::atomic<std::uint64_t> frame{UINT64_MAX};
+        std::atomic<std::uint64_t> timestamp{0};
+    };
+    struct Head {
+        std::array<std::array<Slot, kTracePointCount>, kFrameSlots> slots;
+        HeadLatency latency;
+    };
+    struct ThreadRing;
+
+    ThreadRing* ring() noexcept;
+    void complete(Head& head, std::uint64_t frame, std::uint64_t flip_ns) noexcept;
+
+    const std::uint64_t id_; ///< Distinguishes tracers for the per-thread ring cache.
+    std::atomic<TraceMode> mode_;
+    const std::uint32_t head_count_;
+    const std::unique_ptr<Head[]> heads_;
+    std::atomic<std::uint64_t> bad_head_{0};
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadRing>> rings_;
+    std::deque<TraceEvent> history_;
+    Stats stats_;
+};
+
+} // namespace dispctrl
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace dispctrl {
+
+/// One simulated output of a VirtualKms.
+struct VirtualHead {
+    std::uint32_t refresh_mhz = 60000;
+    /// A flip completes at the first vblank at least this long after it
+    /// was submitted; 0 latches it at the next vblank.
+    std::uint64_t flip_latency_ns = 0;
+    bool connected = true;
+    /// Hotplug pattern: every period the connector is unplugged for
+    /// down_ns, starting phase_ns after creation. Period 0 never toggles.
+    std::uint64_t hotplug_period_ns = 0;
+    std::uint64_t hotplug_down_ns = 0;
+    std::uint64_t hotplug_phase_ns = 0;
+};
+
+/// KmsDevice simulating any number of heads in memory, for load tests and
+/// benchmarks on machines without a display.
+///
+/// Each head has a vblank clock at its own refresh rate. A flip, or an
+/// atomic commit with commit::PageFlipEvent that sets a property on a
+/// CRTC or on a plane bound to it (by the plane's CRTC_ID, written in this
+/// or an earlier commit), completes at that head's next vblank after
+/// flip_latency_ns: a drm_event_vblank carrying the vblank's timestamp and
+/// sequence is then written to event_fd(), so the real event decoding
+/// path is exercised.
+/// Like the kernel, a second flip on a head whose previous one has not
+/// completed fails with EBUSY.
+///
+/// Fences are stood in for by sockets (create_fence()): a commit's flips
+/// wait for the fences it sets as IN_FENCE_FD, and an OUT_FENCE_PTR write
+/// receives one that signals with the flip. A stand-in becomes readable
+/// with its signal time when it signals, so wait_fence() works on it, and
+/// fence_status() reports that time; other fds are queried as sync_files.
+///
+/// Each head also has a writeback connector (writeback_connector_id()).
+/// Once its CRTC_ID binds it to the head, a commit writing its
+/// WRITEBACK_OUT_FENCE_PTR receives a stand-in fence that signals one
+/// refresh after the commit's flip, when the frame has been written out.
+///
+/// With Clock::Manual time stands still until advance() or
+/// complete_flips() moves it, which makes runs deterministic; with
+/// Clock::Realtime a worker thread delivers events on CLOCK_MONOTONIC.
+/// Thread-safe.
+class VirtualKms final : public KmsDevice {
+public:
+    enum class Clock : std::uint8_t { Manual, Realtime };
+
+    static constexpr std::uint32_t kFirstCrtc = 0x1000;
+    static constexpr std::uint32_t kFirstConnector = 0x2000;
+    static constexpr std::uint32_t kFirstWriteback = 0x3000;
+
+    struct Stats {
+        std::uint64_t commits = 0;  ///< Flips and atomic commits, TEST_ONLY included.
+        std::uint64_t flips = 0;    ///< Completion events delivered.
+        std::uint64_t busy = 0;     ///< Flips rejected with EBUSY.
+        std::uint64_t hotplugs = 0; ///< Connector state changes.
+        std::uint64_t dropped = 0;  ///< Events lost to a full event pipe.
+        std::uint64_t writebacks = 0; ///< Writeback jobs accepted.
+    };
+
+    /// Called on every connector state change; from the worker thread with
+    /// Clock::Realtime, otherwise from within advance().
+    using HotplugHandler = std::function<void(std::uint32_t connector_id, bool connected, std::uint64_t timestamp_ns)>;
+
+    /// Throws std::system_error if the event pipe or the worker thread
+    /// cannot be created.
+    explicit VirtualKms(std::vector<VirtualHead> heads, Clock clock = Clock::Manual);
+    /// @p count identical heads.
+    VirtualKms(std::size_t count, const VirtualHead& head, Clock clock = Clock::Manual)
+        : VirtualKms(std::vector<VirtualHead>(count, head), clock)
+    {
+    }
+    ~VirtualKms() override;
+    VirtualKms(const VirtualKms&) = delete;
+    VirtualKms& operator=(const VirtualKms&) = delete;
+
+    std::size_t heads() const noexcept { return heads_.size(); }
+    std::uint32_t crtc_id(std::size_t head) const noexcept { return kFirstCrtc + static_cast<std::uint32_t>(head); }
+    std::uint32_t connector_id(std::size_t head) const noexcept
+    {
+        return kFirstConnector + static_cast<std::uint32_t>(head);
+    }
+    std::uint32_t writeback_connector_id(std::size_t head) const noexcept
+    {
+        return kFirstWriteback + static_cast<std::uint32_t>(head);
+    }
+    bool connected(std::size_t head) const;
+
+    void set_hotplug_handler(HotplugHandler handler);
+
+    /// Plugs or unplugs a head now, on top of its hotplug pattern.
+    void set_connected(std::size_t head, bool connected);
+
+    /// Simulated CLOCK_MONOTONIC time.
+    std::uint64_t now() const;
+
+    /// Clock::Manual only: moves time forward by @p ns, delivering every
+    /// completion and hotplug that falls due on the way.
+    void advance(std::uint64_t ns);
+
+    /// Clock::Manual only: advances to the last pending completion, so
+    /// every flip submitted so far has its event written.
+    void complete_flips();
+
+    /// Makes TEST_ONLY commits that enable more than @p planes planes fail
+    /// with EINVAL, standing in for hardware limits the kernel enforces.
+    /// Planes are recognised by @p fb_prop (their FB_ID property).
+    void set_plane_limit(std::size_t planes, std::uint32_t fb_prop);
+
+    /// A stand-in render fence that signals at @p signal_ns on the
+    /// device's clock. Fences are known by their socket, not their fd
+    /// number, so one may be closed at any time.
+    std::error_code create_fence(std::uint64_t signal_ns, UniqueFd& fence) noexcept;
+
+    Stats stats() const;
+
+    int event_fd() const noexcept override { return read_.get(); }
+    std::error_code import_dmabuf(int dmabuf_fd, std::uint32_t& handle) noexcept override;
+    void close_handle(std::uint32_t) noexcept override {}
+    std::error_code add_framebuffer(const FramebufferLayout& layout, std::uint32_t& fb_id) noexcept override;
+    void remove_framebuffer(std::uint32_t) noexcept override {}
+    std::error_code page_flip(std::uint32_t crtc_id, std::uint32_t fb_id, std::uint64_t user_data) noexcept override;
+    std::error_code atomic_commit(const AtomicRequest& request, std::uint32_t flags,
+                                  std::uint64_t user_data) noexcept override;
+    std::error_code find_property(std::uint32_t object_id, ObjectType type, std::string_view name,
+                                  std::uint32_t& prop_id) noexcept override;
+    std::error_code create_blob(const void* data, std::size_t size, std::uint32_t& blob_id) noexcept override;
+    void destroy_blob(std::uint32_t) noexcept override {}
+    std::error_code fence_status(int fence_fd, FenceStatus& status) noexcept override;
+
+private:
+    struct Head {
+        VirtualHead config;
+        std::uint64_t period_ns;
+        bool connected;
+        bool flip_pending = false;
+        std::uint64_t flip_due_ns = 0;
+        bool touched = false; ///< Scratch for atomic_commit().
+    };
+    struct Due {
+        enum class Kind : std::uint8_t { Flip, Hotplug, Fence };
+
+        std::uint64_t time_ns;
+        std::uint32_t head;
+        Kind kind;
+        std::uint64_t user_data; ///< Flip: its user data. Hotplug: 1 to connect. Fence: its key.
+
+        bool operator>(const Due& other) const noexcept { return time_ns > other.time_ns; }
+    };
+    /// A fence until it signals.
+    struct Fence {
+        std::uint64_t key; ///< Inode of the caller's end.
+        std::uint64_t signal_ns;
+        UniqueFd signal; ///< Our end of the socket pair.
+    };
+    struct Notification {
+        std::uint32_t connector_id;
+        bool connected;
+        std::uint64_t timestamp_ns;
+    };
+
+    std::uint64_t next_vblank(const Head& head, std::uint64_t after_ns) const noexcept;
+    std::uint64_t queue_flip(std::uint32_t head, std::uint64_t user_data, std::uint64_t not_before_ns);
+    std::error_code add_fence(std::uint64_t signal_ns, UniqueFd& fence);
+    std::vector<Fence>::iterator find_fence(std::uint64_t key) noexcept;
+    void schedule_hotplug(std::uint32_t head, std::uint64_t from_ns);
+    void run_until(std::unique_lock<std::mutex>& lock, std::uint64_t time_ns);
+    void toggle(std::uint32_t head, bool connected, std::uint64_t time_ns);
+    void emit(std::uint32_t head, std::uint64_t user_data, std::uint64_t time_ns) noexcept;
+    void worker();
+
+    const Clock clock_;
+    const std::uint64_t epoch_ns_;
+    UniqueFd read_;
+    UniqueFd write_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<Head> heads_;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> due_;
+    std::vector<Notification> notifications_;
+    HotplugHandler hotplug_handler_;
+    std::uint64_t now_ns_;
+    std::unordered_map<std::uint32_t, std::uint32_t> plane_heads_; ///< Plane id -> head, from CRTC_ID.
+    std::vector<std::uint32_t> touched_;
+    std::vector<Fence> fences_; ///< Pending fences; few enough to search.
+    std::uint32_t crtc_id_prop_ = 0;
+    std::uint32_t in_fence_prop_ = 0;
+    std::uint32_t out_fence_prop_ = 0;
+    std::uint32_t writeback_fence_prop_ = 0;
+    std::uint32_t next_id_ = 1000;
+    std::size_t plane_limit_ = SIZE_MAX;
+    std::uint32_t fb_prop_ = 0;
+    Stats stats_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+} // namespace dispctrl
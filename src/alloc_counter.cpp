@@ -0,0 +1,40 @@
+#include "dispctrl/alloc_counter.hpp"
+
+#include <atomic>
+
+namespace dispctrl {
+
+namespace {
+
+// Constant-initialised so the hooks can touch it from inside operator new
+// without triggering TLS constructors.
+constinit thread_local std::uint64_t t_allocations = 0;
+constinit std::atomic<bool> g_tracking{false};
+
+} // namespace
+
+std::uint64_t thread_heap_allocations() noexcept
+{
+    return t_allocations;
+}
+
+bool heap_allocation_tracking() noexcept
+{
+    return g_tracking.load(std::memory_order_relaxed);
+}
+
+namespace detail {
+
+void note_heap_allocation() noexcept
+{
+    ++t_allocations;
+}
+
+void enable_heap_allocation_tracking() noexcept
+{
+    g_tracking.store(true, std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+} // namespace dispctrl
@@ -0,0 +1,156 @@
+#include "dispctrl/async_kms.hpp"
+
+#include "dispctrl/atomic_request.hpp"
+
+#include <array>
+#include <initializer_list>
+#include <utility>
+
+namespace dispctrl {
+
+AsyncKms::AsyncKms(Executor& executor, KmsDevice& device) : executor_(executor), device_(device)
+{
+    if (std::error_code ec = executor_.watch(device_.event_fd(), [this] { drain(); }))
+        throw std::system_error(ec, "watch KMS event fd");
+}
+
+AsyncKms::~AsyncKms()
+{
+    executor_.unwatch(device_.event_fd());
+    // Abandoned awaiters never resume; make sure their destructors do
+    // not reach back into this object.
+    for (FlipOperation* op = flips_; op; op = op->next_)
+        op->linked_ = false;
+    for (HotplugWait* list : {hotplug_, notifying_})
+        for (HotplugWait* wait = list; wait; wait = wait->next_)
+            wait->linked_ = false;
+}
+
+AsyncKms::FlipOperation::~FlipOperation()
+{
+    // The awaiting frame was destroyed before the flip completed.
+    if (linked_)
+        kms_.unlink(*this);
+}
+
+bool AsyncKms::FlipOperation::await_suspend(std::coroutine_handle<> h) noexcept
+{
+    serial_ = ++kms_.serial_;
+    std::error_code ec;
+    if (request_)
+        ec = kms_.device_.atomic_commit(*request_, flags_ | commit::Nonblock | commit::PageFlipEvent, serial_);
+    else
+        ec = kms_.device_.page_flip(crtc_id_, fb_id_, serial_);
+    if (ec) {
+        result_.error = ec;
+        return false;
+    }
+    handle_ = h;
+    kms_.link(*this);
+    ++kms_.stats_.submitted;
+    return true;
+}
+
+AsyncKms::HotplugWait::~HotplugWait()
+{
+    if (linked_)
+        kms_.unlink(*this);
+}
+
+void AsyncKms::HotplugWait::await_suspend(std::coroutine_handle<> h) noexcept
+{
+    handle_ = h;
+    next_ = kms_.hotplug_;
+    kms_.hotplug_ = this;
+    linked_ = true;
+}
+
+void AsyncKms::link(FlipOperation& op) noexcept
+{
+    op.prev_ = nullptr;
+    op.next_ = flips_;
+    if (flips_)
+        flips_->prev_ = &op;
+    flips_ = &op;
+    op.linked_ = true;
+    ++pending_;
+}
+
+void AsyncKms::unlink(FlipOperation& op) noexcept
+{
+    if (op.prev_)
+        op.prev_->next_ = op.next_;
+    else
+        flips_ = op.next_;
+    if (op.next_)
+        op.next_->prev_ = op.prev_;
+    op.linked_ = false;
+    --pending_;
+}
+
+void AsyncKms::unlink(HotplugWait& wait) noexcept
+{
+    // A waiter of the batch notify_hotplug() is resuming may be destroyed
+    // by one resumed before it.
+    for (HotplugWait** list : {&hotplug_, &notifying_}) {
+        for (HotplugWait** p = list; *p; p = &(*p)->next_) {
+            if (*p == &wait) {
+                *p = wait.next_;
+                wait.linked_ = false;
+                return;
+            }
+        }
+    }
+    wait.linked_ = false;
+}
+
+void AsyncKms::drain() noexcept
+{
+    std::array<KmsEvent, kMaxEventsPerRead> events;
+    std::size_t count = 0;
+    if (read_kms_events(device_.event_fd(), events, count))
+        return;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const KmsEvent& event = events[i];
+        FlipOperation* op = flips_;
+        while (op && op->serial_ != event.user_data)
+            op = op->next_;
+        if (event.type != KmsEvent::Type::FlipComplete || !op) {
+            ++stats_.unmatched;
+            continue;
+        }
+        unlink(*op);
+        ++stats_.completed;
+        op->result_.event = event;
+        // The resumed coroutine may submit its next flip before we look at
+        // the remaining events; it is linked afresh, which is harmless.
+        op->handle_.resume();
+    }
+}
+
+void AsyncKms::notify_hotplug(const HotplugEvent& event) noexcept
+{
+    // Detach the whole list first: resumed coroutines typically wait for
+    // the next hotplug straight away and must not see this one again. The
+    // batch stays reachable from notifying_ so that a waiter destroyed by
+    // an earlier one's continuation unlinks itself from it; a nested call
+    // takes over the rest of the batch with its newer event.
+    HotplugWait* batch = std::exchange(hotplug_, nullptr);
+    if (!batch)
+        return;
+    HotplugWait* last = batch;
+    while (last->next_)
+        last = last->next_;
+    last->next_ = notifying_;
+    notifying_ = batch;
+    while (HotplugWait* wait = notifying_) {
+        notifying_ = wait->next_;
+        wait->next_ = nullptr;
+        wait->linked_ = false;
+        wait->event_ = event;
+        wait->handle_.resume();
+    }
+}
+
+} // namespace dispctrl
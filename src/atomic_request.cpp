@@ -0,0 +1,60 @@
+#include "dispctrl/atomic_request.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace dispctrl {
+
+void AtomicRequest::set(std::uint32_t object_id, std::uint32_t prop_id, std::uint64_t value)
+{
+    entries_.push_back({object_id, prop_id, value, static_cast<std::uint32_t>(entries_.size())});
+}
+
+void AtomicRequest::merge(const AtomicRequest& other)
+{
+    for (const Entry& e : other.entries_)
+        set(e.object_id, e.prop_id, e.value);
+}
+
+void AtomicRequest::clear() noexcept
+{
+    entries_.clear();
+    objects_.clear();
+    counts_.clear();
+    props_.clear();
+    values_.clear();
+}
+
+std::size_t AtomicRequest::finalize()
+{
+    // std::sort rather than std::stable_sort: the insertion order is part of
+    // the key, and std::sort never allocates.
+    std::sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+        return std::tie(a.object_id, a.prop_id, a.order) < std::tie(b.object_id, b.prop_id, b.order);
+    });
+
+    objects_.clear();
+    counts_.clear();
+    props_.clear();
+    values_.clear();
+
+    std::size_t superseded = 0;
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        const Entry& e = entries_[i];
+        if (i + 1 < entries_.size() && entries_[i + 1].object_id == e.object_id &&
+            entries_[i + 1].prop_id == e.prop_id) {
+            ++superseded;
+            continue;
+        }
+        if (objects_.empty() || objects_.back() != e.object_id) {
+            objects_.push_back(e.object_id);
+            counts_.push_back(0);
+        }
+        ++counts_.back();
+        props_.push_back(e.prop_id);
+        values_.push_back(e.value);
+    }
+    return superseded;
+}
+
+} // namespace dispctrl
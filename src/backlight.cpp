@@ -0,0 +1,125 @@
+#include "dispctrl/backlight.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+namespace dispctrl {
+
+namespace {
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+std::uint32_t read_number(const std::string& path)
+{
+    UniqueFd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd)
+        throw std::system_error(last_error(), "open " + path);
+    char buf[32];
+    const ssize_t len = ::read(fd.get(), buf, sizeof(buf) - 1);
+    if (len <= 0)
+        throw std::system_error(len < 0 ? last_error() : std::make_error_code(std::errc::io_error), "read " + path);
+    buf[len] = '\0';
+    return static_cast<std::uint32_t>(std::strtoul(buf, nullptr, 10));
+}
+
+} // namespace
+
+std::unique_ptr<SysfsBacklight> SysfsBacklight::open(const std::string& dir)
+{
+    const std::uint32_t max = read_number(dir + "/max_brightness");
+    if (max == 0)
+        throw std::system_error(std::make_error_code(std::errc::not_supported), dir + ": max_brightness is 0");
+    const std::uint32_t initial = read_number(dir + "/brightness");
+
+    const std::string path = dir + "/brightness";
+    int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(last_error(), "open " + path);
+    return std::unique_ptr<SysfsBacklight>(new SysfsBacklight(UniqueFd(fd), max, initial));
+}
+
+std::error_code SysfsBacklight::write(std::uint32_t level) noexcept
+{
+    char buf[16];
+    const int len = std::snprintf(buf, sizeof(buf), "%u\n", level > max_ ? max_ : level);
+    ssize_t ret;
+    do {
+        ret = ::pwrite(fd_.get(), buf, static_cast<std::size_t>(len), 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret < 0 ? last_error() : std::error_code{};
+}
+
+DdcBacklight::DdcBacklight(std::unique_ptr<DdcTransport> bus, DdcTiming timing)
+    : bus_(std::move(bus)), queue_(std::make_unique<DdcQueue>(*bus_, timing)),
+      interval_ns_(timing.command_interval_ns)
+{
+}
+
+DdcBacklight::~DdcBacklight()
+{
+    queue_->wait_idle();
+}
+
+std::unique_ptr<DdcBacklight> DdcBacklight::open(const std::string& i2c_dev, DdcTiming timing)
+{
+    return create(I2cDdcTransport::open(i2c_dev), timing, i2c_dev);
+}
+
+std::unique_ptr<DdcBacklight> DdcBacklight::open(std::unique_ptr<DdcTransport> bus, DdcTiming timing)
+{
+    return create(std::move(bus), timing, "DDC/CI bus");
+}
+
+std::unique_ptr<DdcBacklight> DdcBacklight::create(std::unique_ptr<DdcTransport> bus, DdcTiming timing,
+                                                   const std::string& name)
+{
+    std::unique_ptr<DdcBacklight> self(new DdcBacklight(std::move(bus), timing));
+    std::error_code ec;
+    VcpValue value;
+    self->queue_->get_vcp(vcp::kBrightness, [&](std::error_code e, const DdcQueue::Reply& reply) {
+        ec = e;
+        value = reply.value;
+    });
+    self->queue_->wait_idle();
+    if (ec)
+        throw std::system_error(ec, "DDC/CI brightness on " + name);
+    if (value.max == 0)
+        throw std::system_error(std::make_error_code(std::errc::not_supported), name + ": brightness range is 0");
+    self->max_ = value.max;
+    self->initial_ = value.current;
+    return self;
+}
+
+std::error_code DdcBacklight::write(std::uint32_t level) noexcept
+{
+    std::error_code failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        failed = std::exchange(error_, {});
+    }
+    try {
+        queue_->set_vcp(vcp::kBrightness, static_cast<std::uint16_t>(std::min(level, max_)),
+                        [this](std::error_code ec, const DdcQueue::Reply&) {
+                            // A write replaced by a newer one is not a failure.
+                            if (!ec || ec == std::errc::operation_canceled)
+                                return;
+                            std::lock_guard<std::mutex> lock(mutex_);
+                            error_ = ec;
+                        });
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+    return failed;
+}
+
+} // namespace dispctrl
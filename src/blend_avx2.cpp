@@ -0,0 +1,55 @@
+// Built with -mavx2; only reached after a runtime CPU check.
+
+#include "blend_kernels.hpp"
+
+#include <immintrin.h>
+
+namespace dispctrl::blend {
+
+namespace {
+
+// 16-bit lanes of (255 - alpha), replicated over each pixel's 4 channels.
+inline __m256i inv_alpha(__m256i s, __m256i shuffle) noexcept
+{
+    return _mm256_sub_epi16(_mm256_set1_epi16(255), _mm256_shuffle_epi8(s, shuffle));
+}
+
+inline __m256i scale(__m256i d16, __m256i inv) noexcept
+{
+    const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(d16, inv), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+void over_row_avx2(const std::uint32_t* src, std::uint32_t* dst, std::uint32_t width) noexcept
+{
+    // Alpha bytes of pixels 0/1 (lo) and 2/3 (hi) of each 128-bit lane.
+    const __m256i lo_mask = _mm256_setr_epi8(3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1,
+                                             3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+    const __m256i hi_mask = _mm256_setr_epi8(11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1,
+                                             11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+    const __m256i alpha_bits = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+    const __m256i zero = _mm256_setzero_si256();
+
+    std::uint32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        const __m256i a = _mm256_and_si256(s, alpha_bits);
+        // Opaque runs are a plain copy (255 - a == 0 makes the blend exact).
+        if (_mm256_testc_si256(a, alpha_bits)) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), s);
+            continue;
+        }
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + x));
+        const __m256i lo = scale(_mm256_unpacklo_epi8(d, zero), inv_alpha(s, lo_mask));
+        const __m256i hi = scale(_mm256_unpackhi_epi8(d, zero), inv_alpha(s, hi_mask));
+        const __m256i out = _mm256_adds_epu8(s, _mm256_packus_epi16(lo, hi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), out);
+    }
+    over_row_scalar(src + x, dst + x, width - x);
+}
+
+} // namespace
+
+const BlendKernels kAvx2Kernels{over_row_avx2};
+
+} // namespace dispctrl::blend
@@ -0,0 +1,49 @@
+#pragma once
+
+// Row kernels behind TileCompositor. As with the conversion kernels, each
+// SIMD translation unit is built with its own ISA flags, exports a
+// BlendKernels table and must match the scalar arithmetic exactly.
+
+#include <cstdint>
+
+namespace dispctrl::blend {
+
+/// dst = src + dst * (255 - src.alpha) / 255 per channel, saturating, for
+/// premultiplied ARGB8888 `src`.
+using OverRow = void (*)(const std::uint32_t* src, std::uint32_t* dst, std::uint32_t width);
+
+struct BlendKernels {
+    OverRow over;
+};
+
+// x * y / 255 rounded to nearest, exact for all 8-bit inputs: the usual
+// (t + (t >> 8)) >> 8 division trick with t = x * y + 128, which never
+// leaves an unsigned 16-bit lane. Blending scales by y = 255 - alpha.
+inline std::uint32_t mul_div255(std::uint32_t x, std::uint32_t y) noexcept
+{
+    const std::uint32_t t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+inline std::uint32_t over_pixel(std::uint32_t s, std::uint32_t d) noexcept
+{
+    const std::uint32_t inv = 255 - (s >> 24);
+    std::uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        const std::uint32_t c = (s >> shift & 0xff) + mul_div255(d >> shift & 0xff, inv);
+        out |= (c > 255 ? 255 : c) << shift;
+    }
+    return out;
+}
+
+void over_row_scalar(const std::uint32_t* src, std::uint32_t* dst, std::uint32_t width) noexcept;
+
+extern const BlendKernels kScalarKernels;
+#ifdef DISPCTRL_HAVE_AVX2
+extern const BlendKernels kAvx2Kernels;
+#endif
+#ifdef DISPCTRL_HAVE_NEON
+extern const BlendKernels kNeonKernels;
+#endif
+
+} // namespace dispctrl::blend
@@ -0,0 +1,40 @@
+#include "blend_kernels.hpp"
+
+#include <arm_neon.h>
+
+namespace dispctrl::blend {
+
+namespace {
+
+inline uint8x8_t over_channel(uint8x8_t s, uint8x8_t d, uint8x8_t inv) noexcept
+{
+    const uint16x8_t t = vaddq_u16(vmull_u8(d, inv), vdupq_n_u16(128));
+    const uint8x8_t scaled = vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+    return vqadd_u8(s, scaled);
+}
+
+void over_row_neon(const std::uint32_t* src, std::uint32_t* dst, std::uint32_t width) noexcept
+{
+    std::uint32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        // De-interleaved B, G, R, A planes of 8 pixels.
+        const uint8x8x4_t s = vld4_u8(reinterpret_cast<const std::uint8_t*>(src + x));
+        if (vminv_u8(s.val[3]) == 255) {
+            vst4_u8(reinterpret_cast<std::uint8_t*>(dst + x), s);
+            continue;
+        }
+        const uint8x8x4_t d = vld4_u8(reinterpret_cast<const std::uint8_t*>(dst + x));
+        const uint8x8_t inv = vmvn_u8(s.val[3]);
+        uint8x8x4_t out;
+        for (int c = 0; c < 4; ++c)
+            out.val[c] = over_channel(s.val[c], d.val[c], inv);
+        vst4_u8(reinterpret_cast<std::uint8_t*>(dst + x), out);
+    }
+    over_row_scalar(src + x, dst + x, width - x);
+}
+
+} // namespace
+
+const BlendKernels kNeonKernels{over_row_neon};
+
+} // namespace dispctrl::blend
@@ -0,0 +1,144 @@
+#include "dispctrl/brightness_ramp.hpp"
+
+#include "dispctrl/clock.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr double kGamma = 2.2;
+
+double to_perceptual(double v) noexcept
+{
+    return std::pow(v, 1.0 / kGamma);
+}
+
+double from_perceptual(double v) noexcept
+{
+    return std::pow(v, kGamma);
+}
+
+} // namespace
+
+BrightnessRamp::BrightnessRamp(BrightnessSink& sink, RampCurve curve, std::uint64_t step_ns)
+    : sink_(sink), curve_(curve), step_ns_(step_ns), written_level_(sink.initial_level())
+{
+    const double initial = std::clamp(static_cast<double>(written_level_) / sink_.max_level(), 0.0, 1.0);
+    ramp_ = {initial, initial, 0, 0};
+    thread_ = std::thread([this] { worker(); });
+}
+
+BrightnessRamp::~BrightnessRamp()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+double BrightnessRamp::value_at(std::uint64_t now_ns) const noexcept
+{
+    const Ramp& r = ramp_;
+    if (r.duration_ns == 0 || now_ns >= r.start_ns + r.duration_ns)
+        return r.to;
+    const double t = static_cast<double>(now_ns - r.start_ns) / static_cast<double>(r.duration_ns);
+    if (curve_ == RampCurve::Linear)
+        return r.from + (r.to - r.from) * t;
+    const double a = to_perceptual(r.from);
+    const double b = to_perceptual(r.to);
+    return from_perceptual(a + (b - a) * t);
+}
+
+void BrightnessRamp::set(double target, std::uint64_t duration_ns)
+{
+    target = std::clamp(target, 0.0, 1.0);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const std::uint64_t now = monotonic_ns();
+        if (pending_)
+            ++stats_.superseded;
+        ramp_ = {value_at(now), target, now, duration_ns};
+        pending_ = true;
+        failures_ = 0;
+        ++generation_;
+    }
+    wake_.notify_one();
+}
+
+double BrightnessRamp::current() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<double>(written_level_) / sink_.max_level();
+}
+
+bool BrightnessRamp::idle() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !pending_;
+}
+
+BrightnessRamp::Stats BrightnessRamp::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BrightnessRamp::worker()
+{
+    const double max = sink_.max_level();
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || pending_; });
+        if (stopping_)
+            return;
+
+        const std::uint64_t now = monotonic_ns();
+        const auto level = static_cast<std::uint32_t>(std::lround(value_at(now) * max));
+        const auto target = static_cast<std::uint32_t>(std::lround(ramp_.to * max));
+        const bool done = now >= ramp_.start_ns + ramp_.duration_ns;
+        const std::uint64_t generation = generation_;
+
+        std::uint64_t took = 0;
+        if (level != written_level_) {
+            // The write may take tens of milliseconds on DDC/CI; set() must
+            // not wait for it.
+            lock.unlock();
+            const std::error_code ec = sink_.write(level);
+            took = monotonic_ns() - now;
+            lock.lock();
+            if (ec) {
+                ++stats_.errors;
+                stats_.last_error = ec;
+                if (++failures_ > kMaxRetries && generation == generation_) {
+                    // The sink keeps failing; stay idle until the next set().
+                    ++stats_.abandoned;
+                    pending_ = false;
+                    continue;
+                }
+            } else {
+                ++stats_.writes;
+                written_level_ = level;
+                failures_ = 0;
+            }
+        }
+        // Reached unless set() retargeted while we were writing.
+        if (done && written_level_ == target && generation == generation_)
+            pending_ = false;
+
+        // Rate limit: whatever set() does meanwhile is picked up at the
+        // next step, as a single write of the then-current value.
+        const std::uint64_t interval = std::max({step_ns_, sink_.min_interval_ns(), took});
+        wake_.wait_for(lock, std::chrono::nanoseconds(interval - std::min(interval, monotonic_ns() - now)),
+                       [this] { return stopping_; });
+        if (stopping_)
+            return;
+    }
+}
+
+} // namespace dispctrl
@@ -0,0 +1,315 @@
+#include "dispctrl/capture.hpp"
+
+#include "dispctrl/sync_file.hpp"
+
+#include <fcntl.h>
+#include <linux/dma-heap.h>
+#include <sys/ioctl.h>
+
+#include <cerrno>
+#include <utility>
+
+namespace dispctrl {
+
+namespace {
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+constexpr std::uint32_t align_up(std::uint32_t value, std::uint32_t align) noexcept
+{
+    return (value + align - 1) / align * align;
+}
+
+} // namespace
+
+std::error_code linear_capture_layout(const CaptureFormat& format, DmaBufDesc& desc, std::size_t& size) noexcept
+{
+    const FormatInfo* info = format_info(format.fourcc);
+    if (!info || format.modifier != modifier::Linear)
+        return std::make_error_code(std::errc::not_supported);
+    if (format.width == 0 || format.height == 0 || format.width > 16384 || format.height > 16384)
+        return std::make_error_code(std::errc::invalid_argument);
+
+    desc = {};
+    desc.width = format.width;
+    desc.height = format.height;
+    desc.fourcc = format.fourcc;
+    desc.modifier = format.modifier;
+    desc.plane_count = info->plane_count;
+    std::size_t offset = 0;
+    for (std::uint32_t i = 0; i < info->plane_count; ++i) {
+        const std::uint32_t hsub = i ? info->hsub : 1;
+        const std::uint32_t vsub = i ? info->vsub : 1;
+        const std::uint32_t pitch =
+            align_up((format.width + hsub - 1) / hsub * info->bytes_per_pixel[i], kCapturePitchAlign);
+        desc.planes[i].offset = static_cast<std::uint32_t>(offset);
+        desc.planes[i].pitch = pitch;
+        offset += static_cast<std::size_t>(pitch) * ((format.height + vsub - 1) / vsub);
+    }
+    size = offset;
+    return {};
+}
+
+std::unique_ptr<DmaHeapAllocator> DmaHeapAllocator::open(const std::string& name)
+{
+    const std::string path = "/dev/dma_heap/" + name;
+    UniqueFd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd)
+        throw std::system_error(last_error(), "open " + path);
+    return std::unique_ptr<DmaHeapAllocator>(new DmaHeapAllocator(std::move(fd)));
+}
+
+std::error_code DmaHeapAllocator::allocate(const CaptureFormat& format, UniqueFd& fd, DmaBufDesc& desc)
+{
+    std::size_t size = 0;
+    if (std::error_code ec = linear_capture_layout(format, desc, size))
+        return ec;
+    dma_heap_allocation_data req{};
+    req.len = size;
+    req.fd_flags = O_RDWR | O_CLOEXEC;
+    int r;
+    do
+        r = ::ioctl(heap_.get(), DMA_HEAP_IOCTL_ALLOC, &req);
+    while (r < 0 && (errno == EINTR || errno == EAGAIN));
+    if (r < 0)
+        return last_error();
+    fd.reset(static_cast<int>(req.fd));
+    for (std::uint32_t i = 0; i < desc.plane_count; ++i)
+        desc.planes[i].fd = fd.get();
+    return {};
+}
+
+const DmaBufDesc& CaptureLease::buffer() const noexcept
+{
+    return pool_->slots_[index_].desc;
+}
+
+std::uint32_t CaptureLease::fb_id() const noexcept
+{
+    const auto& fb = pool_->slots_[index_].fb;
+    return fb ? fb->id() : 0;
+}
+
+void CaptureLease::reset() noexcept
+{
+    if (pool_)
+        std::exchange(pool_, nullptr)->release(index_);
+}
+
+CapturePool::CapturePool(CaptureAllocator& allocator, FramebufferImporter* importer, const CaptureFormat& format,
+                         std::size_t max_buffers)
+    : allocator_(allocator), importer_(importer), format_(format), max_buffers_(max_buffers)
+{
+    slots_.reserve(max_buffers_);
+}
+
+CapturePool::~CapturePool()
+{
+    if (!importer_)
+        return;
+    // The importer caches every import; drop ours while the fds are open.
+    for (Slot& slot : slots_) {
+        slot.fb.reset();
+        importer_->evict(slot.desc);
+    }
+}
+
+CapturePool::Stats CapturePool::stats() const
+{
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+std::error_code CapturePool::acquire(CaptureLease& out)
+{
+    {
+        std::lock_guard lock(mutex_);
+        for (std::uint32_t i = 0; i < slots_.size(); ++i) {
+            if (!slots_[i].lent) {
+                slots_[i].lent = true;
+                ++stats_.acquired;
+                out = CaptureLease(this, i);
+                return {};
+            }
+        }
+        if (slots_.size() + reserved_ == max_buffers_) {
+            ++stats_.exhausted;
+            return std::make_error_code(std::errc::resource_unavailable_try_again);
+        }
+        ++reserved_;
+    }
+
+    // Allocation and import are ioctls; the encoder keeps returning its
+    // leases meanwhile.
+    Slot slot;
+    std::error_code ec = allocator_.allocate(format_, slot.fd, slot.desc);
+    if (!ec && importer_)
+        ec = importer_->import(slot.desc, slot.fb);
+
+    std::lock_guard lock(mutex_);
+    --reserved_;
+    if (ec)
+        return ec;
+    slot.lent = true;
+    slots_.push_back(std::move(slot)); // within the reserved capacity
+    ++stats_.allocated;
+    ++stats_.acquired;
+    out = CaptureLease(this, static_cast<std::uint32_t>(slots_.size() - 1));
+    return {};
+}
+
+void CapturePool::release(std::uint32_t index) noexcept
+{
+    std::lock_guard lock(mutex_);
+    slots_[index].lent = false;
+}
+
+bool CaptureTimer::take(std::uint64_t now_ns) noexcept
+{
+    if (requested_) {
+        requested_ = false;
+        return true;
+    }
+    const std::uint64_t interval = schedule_.interval_ns;
+    if (interval == 0)
+        return false;
+    if (next_ns_ == 0)
+        next_ns_ = now_ns + schedule_.phase_ns;
+    if (now_ns < next_ns_)
+        return false;
+    // Stay on the grid of slots; those that passed unpolled are gone.
+    next_ns_ += ((now_ns - next_ns_) / interval + 1) * interval;
+    return true;
+}
+
+std::error_code find_writeback_connector(KmsDevice& device, std::uint32_t connector_id,
+                                         WritebackConnector& out) noexcept
+{
+    WritebackConnector wb;
+    wb.connector_id = connector_id;
+    if (std::error_code ec = device.find_property(connector_id, ObjectType::Connector, "CRTC_ID", wb.crtc_prop))
+        return ec;
+    if (std::error_code ec = device.find_property(connector_id, ObjectType::Connector, "WRITEBACK_FB_ID", wb.fb_prop))
+        return ec;
+    if (std::error_code ec =
+            device.find_property(connector_id, ObjectType::Connector, "WRITEBACK_OUT_FENCE_PTR", wb.fence_prop))
+        return ec;
+    out = wb;
+    return {};
+}
+
+WritebackCapture::WritebackCapture(CommitQueue& queue, const WritebackConnector& connector, CapturePool& pool,
+                                   FrameCallback callback, CaptureSchedule schedule)
+    : queue_(queue), connector_(connector), pool_(pool), callback_(std::move(callback)), timer_(schedule)
+{
+}
+
+void WritebackCapture::bind()
+{
+    queue_.set(connector_.connector_id, connector_.crtc_prop, queue_.crtc_id());
+    bound_ = true;
+}
+
+void WritebackCapture::unbind()
+{
+    queue_.set(connector_.connector_id, connector_.crtc_prop, 0);
+    bound_ = false;
+}
+
+bool WritebackCapture::poll(std::uint64_t now_ns)
+{
+    // The job already queued has not been committed yet; it already
+    // captures the frame that will be.
+    if (!bound_ || pending_ || !timer_.take(now_ns))
+        return false;
+    CaptureLease lease;
+    if (std::error_code ec = pool_.acquire(lease)) {
+        ++(ec == std::errc::resource_unavailable_try_again ? stats_.skipped : stats_.failed);
+        return false;
+    }
+    if (!lease.fb_id()) {
+        ++stats_.failed;
+        return false;
+    }
+    pending_ = std::move(lease);
+    pending_ns_ = now_ns;
+    ++stats_.queued;
+    queue_.set_writeback(connector_.connector_id, connector_.fb_prop, connector_.fence_prop, pending_.fb_id(),
+                         [this](std::uint64_t serial, std::error_code ec, UniqueFd fence) {
+                             written(serial, ec, std::move(fence));
+                         });
+    return true;
+}
+
+void WritebackCapture::written(std::uint64_t serial, std::error_code ec, UniqueFd fence)
+{
+    CaptureLease lease = std::move(pending_);
+    if (ec) {
+        ++stats_.failed;
+        return;
+    }
+    ++stats_.delivered;
+    CaptureFrame frame;
+    frame.source_id = queue_.crtc_id();
+    frame.sequence = sequence_++;
+    frame.request_ns = pending_ns_;
+    frame.serial = serial;
+    frame.fence = std::move(fence);
+    frame.buffer = std::move(lease);
+    if (callback_)
+        callback_(std::move(frame));
+}
+
+ReadbackCapture::ReadbackCapture(ReadbackEngine& engine, CapturePool& pool, std::uint32_t source_id,
+                                 FrameCallback callback, CaptureSchedule schedule)
+    : engine_(engine), pool_(pool), source_id_(source_id), callback_(std::move(callback)), timer_(schedule)
+{
+}
+
+std::error_code ReadbackCapture::offer(const DmaBufDesc& src, int src_fence, std::uint64_t now_ns,
+                                       UniqueFd& copy_fence)
+{
+    copy_fence.reset();
+    if (!timer_.take(now_ns))
+        return {};
+    CaptureLease lease;
+    if (std::error_code ec = pool_.acquire(lease)) {
+        if (ec != std::errc::resource_unavailable_try_again) {
+            ++stats_.failed;
+            return ec;
+        }
+        ++stats_.skipped;
+        return {};
+    }
+    UniqueFd done;
+    if (std::error_code ec = engine_.copy(src, src_fence, lease.buffer(), done)) {
+        ++stats_.failed;
+        return ec;
+    }
+    if (done) {
+        copy_fence.reset(::fcntl(done.get(), F_DUPFD_CLOEXEC, 0));
+        if (!copy_fence) {
+            // The copy is queued, but the client could not be kept off
+            // the buffer until it is done: wait for it here instead.
+            const std::error_code ec = last_error();
+            wait_fence(done.get(), 1'000'000'000);
+            ++stats_.failed;
+            return ec;
+        }
+    }
+    ++stats_.delivered;
+    CaptureFrame frame;
+    frame.source_id = source_id_;
+    frame.sequence = sequence_++;
+    frame.request_ns = now_ns;
+    frame.fence = std::move(done);
+    frame.buffer = std::move(lease);
+    if (callback_)
+        callback_(std::move(frame));
+    return {};
+}
+
+} // namespace dispctrl
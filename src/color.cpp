@@ -0,0 +1,394 @@
+#include "dispctrl/color.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dispctrl {
+
+namespace {
+
+using Matrix = std::array<double, 9>;
+
+constexpr Chromaticity kD50{0.3457, 0.3585};
+
+Matrix multiply(const Matrix& a, const Matrix& b) noexcept
+{
+    Matrix m{};
+    for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+            m[r * 3 + c] = a[r * 3] * b[c] + a[r * 3 + 1] * b[3 + c] + a[r * 3 + 2] * b[6 + c];
+    return m;
+}
+
+Matrix invert(const Matrix& m) noexcept
+{
+    const double c0 = m[4] * m[8] - m[5] * m[7];
+    const double c1 = m[5] * m[6] - m[3] * m[8];
+    const double c2 = m[3] * m[7] - m[4] * m[6];
+    const double det = m[0] * c0 + m[1] * c1 + m[2] * c2;
+    if (det == 0)
+        return {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    const double k = 1.0 / det;
+    return {c0 * k, (m[2] * m[7] - m[1] * m[8]) * k, (m[1] * m[5] - m[2] * m[4]) * k,
+            c1 * k, (m[0] * m[8] - m[2] * m[6]) * k, (m[2] * m[3] - m[0] * m[5]) * k,
+            c2 * k, (m[1] * m[6] - m[0] * m[7]) * k, (m[0] * m[4] - m[1] * m[3]) * k};
+}
+
+std::array<double, 3> apply(const Matrix& m, const std::array<double, 3>& v) noexcept
+{
+    return {m[0] * v[0] + m[1] * v[1] + m[2] * v[2], m[3] * v[0] + m[4] * v[1] + m[5] * v[2],
+            m[6] * v[0] + m[7] * v[1] + m[8] * v[2]};
+}
+
+std::array<double, 3> to_xyz(Chromaticity c) noexcept
+{
+    return {c.x / c.y, 1.0, (1.0 - c.x - c.y) / c.y};
+}
+
+// Bradford chromatic adaptation from white point @p from to @p to.
+Matrix bradford(Chromaticity from, Chromaticity to) noexcept
+{
+    static constexpr Matrix kBradford{0.8951, 0.2664, -0.1614, -0.7502, 1.7135, 0.0367, 0.0389, -0.0685, 1.0296};
+    const std::array<double, 3> src = apply(kBradford, to_xyz(from));
+    const std::array<double, 3> dst = apply(kBradford, to_xyz(to));
+    const Matrix scale{dst[0] / src[0], 0, 0, 0, dst[1] / src[1], 0, 0, 0, dst[2] / src[2]};
+    return multiply(invert(kBradford), multiply(scale, kBradford));
+}
+
+bool plain_gamma(const ToneCurve& t) noexcept
+{
+    return t.type == ToneCurve::Type::Parametric && t.a == 1.0 && t.b == 0.0 && t.d == 0.0 && t.e == 0.0;
+}
+
+// ICC profiles are big-endian.
+std::uint32_t be32(const std::uint8_t* p) noexcept
+{
+    return std::uint32_t{p[0]} << 24 | std::uint32_t{p[1]} << 16 | std::uint32_t{p[2]} << 8 | p[3];
+}
+
+std::uint16_t be16(const std::uint8_t* p) noexcept
+{
+    return static_cast<std::uint16_t>(p[0] << 8 | p[1]);
+}
+
+double s15f16(const std::uint8_t* p) noexcept
+{
+    return static_cast<std::int32_t>(be32(p)) / 65536.0;
+}
+
+constexpr std::uint32_t sig(const char (&s)[5]) noexcept
+{
+    return std::uint32_t(std::uint8_t(s[0])) << 24 | std::uint32_t(std::uint8_t(s[1])) << 16 |
+           std::uint32_t(std::uint8_t(s[2])) << 8 | std::uint8_t(s[3]);
+}
+
+/// Tag table of a validated profile.
+class IccReader {
+public:
+    explicit IccReader(std::span<const std::uint8_t> blob) noexcept : blob_(blob) {}
+
+    /// Body of tag @p tag, or an empty span when absent or out of bounds.
+    std::span<const std::uint8_t> tag(std::uint32_t tag) const noexcept
+    {
+        const std::uint32_t count = be32(&blob_[128]);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            const std::uint8_t* entry = &blob_[132 + 12 * std::size_t{i}];
+            if (be32(entry) != tag)
+                continue;
+            const std::uint32_t offset = be32(entry + 4);
+            const std::uint32_t size = be32(entry + 8);
+            if (offset > blob_.size() || size > blob_.size() - offset || size < 12)
+                return {};
+            return blob_.subspan(offset, size);
+        }
+        return {};
+    }
+
+private:
+    std::span<const std::uint8_t> blob_;
+};
+
+bool parse_xyz(std::span<const std::uint8_t> t, std::array<double, 3>& out) noexcept
+{
+    if (t.size() < 20 || be32(t.data()) != sig("XYZ "))
+        return false;
+    out = {s15f16(&t[8]), s15f16(&t[12]), s15f16(&t[16])};
+    return true;
+}
+
+bool parse_curve(std::span<const std::uint8_t> t, ToneCurve& out)
+{
+    out = ToneCurve{};
+    if (be32(t.data()) == sig("curv")) {
+        const std::uint32_t count = be32(&t[8]);
+        if (t.size() < 12 + 2 * std::size_t{count})
+            return false;
+        if (count == 0)
+            return true; // identity
+        if (count == 1) {
+            out.g = be16(&t[12]) / 256.0;
+            return out.g > 0;
+        }
+        out.type = ToneCurve::Type::Table;
+        out.table.resize(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+            out.table[i] = be16(&t[12 + 2 * std::size_t{i}]) / 65535.0;
+        return true;
+    }
+    if (be32(t.data()) == sig("para")) {
+        static constexpr std::size_t kParams[] = {1, 3, 4, 5, 7};
+        const std::uint16_t fn = be16(&t[8]);
+        if (fn >= std::size(kParams) || t.size() < 12 + 4 * kParams[fn])
+            return false;
+        double p[7] = {};
+        for (std::size_t i = 0; i < kParams[fn]; ++i)
+            p[i] = s15f16(&t[12 + 4 * i]);
+        out.g = p[0];
+        if (fn == 0)
+            return out.g > 0;
+        out.a = p[1];
+        out.b = p[2];
+        if (out.a == 0)
+            return false;
+        switch (fn) {
+        case 1:
+            out.d = -out.b / out.a;
+            break;
+        case 2:
+            out.d = -out.b / out.a;
+            out.e = out.f = p[3];
+            break;
+        case 3:
+            out.c = p[3];
+            out.d = p[4];
+            break;
+        case 4:
+            out.c = p[3];
+            out.d = p[4];
+            out.e = p[5];
+            out.f = p[6];
+            break;
+        }
+        return out.g > 0;
+    }
+    return false;
+}
+
+// Encodings whose midpoint is close to linear light waste most lattice
+// points on highlights; such inputs get a gamma 2.2 shaper.
+bool needs_shaper(const ToneCurve& t) noexcept
+{
+    return std::abs(t.eval(0.5) - 0.5) < 0.1;
+}
+
+constexpr double kShaperGamma = 2.2;
+
+} // namespace
+
+ToneCurve ToneCurve::gamma(double g) noexcept
+{
+    ToneCurve t;
+    t.g = g;
+    return t;
+}
+
+ToneCurve ToneCurve::srgb() noexcept
+{
+    ToneCurve t;
+    t.g = 2.4;
+    t.a = 1.0 / 1.055;
+    t.b = 0.055 / 1.055;
+    t.c = 1.0 / 12.92;
+    t.d = 0.04045;
+    return t;
+}
+
+double ToneCurve::eval(double x) const noexcept
+{
+    x = std::clamp(x, 0.0, 1.0);
+    double y;
+    if (type == Type::Table) {
+        if (table.empty())
+            return x;
+        const double pos = x * static_cast<double>(table.size() - 1);
+        const std::size_t i = std::min(static_cast<std::size_t>(pos), table.size() - 2);
+        y = table[i] + (table[i + 1] - table[i]) * (pos - static_cast<double>(i));
+    } else if (x >= d) {
+        const double base = a * x + b;
+        y = (base > 0 ? std::pow(base, g) : 0.0) + e;
+    } else {
+        y = c * x + f;
+    }
+    return std::clamp(y, 0.0, 1.0);
+}
+
+double ToneCurve::inverse(double y) const noexcept
+{
+    y = std::clamp(y, 0.0, 1.0);
+    if (plain_gamma(*this))
+        return std::pow(y, 1.0 / g);
+    // Bisection to well below a 16-bit step.
+    double lo = 0.0, hi = 1.0;
+    for (int i = 0; i < 24; ++i) {
+        const double mid = (lo + hi) / 2;
+        (eval(mid) < y ? lo : hi) = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+std::uint64_t ToneCurve::hash(std::uint64_t seed) const noexcept
+{
+    const double params[] = {g, a, b, c, d, e, f};
+    std::uint64_t h = fnv1a64(&type, sizeof(type), seed);
+    h = fnv1a64(params, sizeof(params), h);
+    return fnv1a64(table.data(), table.size() * sizeof(double), h);
+}
+
+std::uint64_t ColorProfile::hash() const noexcept
+{
+    std::uint64_t h = fnv1a64(to_xyz.data(), sizeof(to_xyz));
+    for (const ToneCurve& t : trc)
+        h = t.hash(h);
+    return h;
+}
+
+ColorProfile make_color_profile(const ColorPrimaries& primaries, const ToneCurve& trc)
+{
+    const std::array<double, 3> r = to_xyz(primaries.red);
+    const std::array<double, 3> g = to_xyz(primaries.green);
+    const std::array<double, 3> b = to_xyz(primaries.blue);
+    const Matrix p{r[0], g[0], b[0], r[1], g[1], b[1], r[2], g[2], b[2]};
+    // Scale the primaries so that RGB (1, 1, 1) hits the white point.
+    const std::array<double, 3> s = apply(invert(p), to_xyz(primaries.white));
+    const Matrix m{p[0] * s[0], p[1] * s[1], p[2] * s[2], p[3] * s[0], p[4] * s[1],
+                   p[5] * s[2], p[6] * s[0], p[7] * s[1], p[8] * s[2]};
+
+    ColorProfile profile;
+    profile.to_xyz = multiply(bradford(primaries.white, kD50), m);
+    profile.trc[0] = profile.trc[1] = profile.trc[2] = trc;
+    return profile;
+}
+
+std::array<double, 9> color_matrix(const ColorProfile& source, const ColorProfile& display) noexcept
+{
+    return multiply(invert(display.to_xyz), source.to_xyz);
+}
+
+ColorProfile srgb_profile()
+{
+    return make_color_profile(kSrgbPrimaries, ToneCurve::srgb());
+}
+
+std::error_code parse_icc_profile(std::span<const std::uint8_t> blob, ColorProfile& out)
+{
+    if (blob.size() < 132 || be32(&blob[0]) > blob.size() || be32(&blob[36]) != sig("acsp") ||
+        be32(&blob[16]) != sig("RGB "))
+        return std::make_error_code(std::errc::invalid_argument);
+    blob = blob.first(be32(&blob[0]));
+    if (blob.size() < 132 || (blob.size() - 132) / 12 < be32(&blob[128]))
+        return std::make_error_code(std::errc::invalid_argument);
+
+    const IccReader reader(blob);
+    static constexpr std::uint32_t kColorants[] = {sig("rXYZ"), sig("gXYZ"), sig("bXYZ")};
+    static constexpr std::uint32_t kCurves[] = {sig("rTRC"), sig("gTRC"), sig("bTRC")};
+
+    ColorProfile profile;
+    for (int c = 0; c < 3; ++c) {
+        std::array<double, 3> xyz;
+        const std::span<const std::uint8_t> colorant = reader.tag(kColorants[c]);
+        if (colorant.empty() && !reader.tag(sig("A2B0")).empty())
+            return std::make_error_code(std::errc::not_supported);
+        if (be32(&blob[20]) != sig("XYZ ") || !parse_xyz(colorant, xyz))
+            return std::make_error_code(std::errc::invalid_argument);
+        profile.to_xyz[c] = xyz[0];
+        profile.to_xyz[3 + c] = xyz[1];
+        profile.to_xyz[6 + c] = xyz[2];
+
+        const std::span<const std::uint8_t> curve = reader.tag(kCurves[c]);
+        if (curve.empty() || !parse_curve(curve, profile.trc[c]))
+            return std::make_error_code(std::errc::invalid_argument);
+    }
+    out = std::move(profile);
+    return {};
+}
+
+Lut3d build_lut3d(const ColorProfile& source, const ColorProfile& display, std::uint32_t size)
+{
+    size = std::clamp<std::uint32_t>(size, 2, 65);
+    const Matrix m = color_matrix(source, display);
+    const std::uint32_t strides[3] = {size * size, size, 1};
+
+    Lut3d lut;
+    lut.size = size;
+    // nodes[c][k]: encoded source value sampled by lattice index k.
+    std::vector<double> nodes[3];
+    for (int c = 0; c < 3; ++c) {
+        const bool shaped = needs_shaper(source.trc[c]);
+        for (int v = 0; v < 256; ++v) {
+            double t = v / 255.0;
+            if (shaped)
+                t = std::pow(t, 1.0 / kShaperGamma);
+            // The top cell is closed: position size - 1 is cell size - 2
+            // with a full fraction.
+            const auto pos = static_cast<std::uint32_t>(std::lround(t * (size - 1) * 256));
+            const std::uint32_t cell = std::min(pos >> 8, size - 2);
+            lut.shaper[c][v] = cell * strides[c] << 9 | (pos - cell * 256);
+        }
+        nodes[c].resize(size);
+        for (std::uint32_t k = 0; k < size; ++k) {
+            const double t = static_cast<double>(k) / (size - 1);
+            nodes[c][k] = shaped ? std::pow(t, kShaperGamma) : t;
+        }
+    }
+
+    lut.lattice.resize(std::size_t{size} * size * size);
+    std::uint64_t* out = lut.lattice.data();
+    for (std::uint32_t r = 0; r < size; ++r)
+        for (std::uint32_t g = 0; g < size; ++g)
+            for (std::uint32_t b = 0; b < size; ++b) {
+                const std::array<double, 3> linear = apply(
+                    m, {source.trc[0].eval(nodes[0][r]), source.trc[1].eval(nodes[1][g]), source.trc[2].eval(nodes[2][b])});
+                std::uint64_t node = 0;
+                for (int c = 0; c < 3; ++c)
+                    node = node << 21 | static_cast<std::uint64_t>(std::lround(display.trc[c].inverse(linear[c]) * 255 * 16));
+                *out++ = node;
+            }
+    return lut;
+}
+
+void apply_lut3d(const Lut3d& lut, std::uint32_t* pixels, std::uint32_t width) noexcept
+{
+    constexpr std::uint64_t kLane = (1u << 21) - 1;
+    const std::uint32_t n = lut.size;
+    const std::uint32_t sr = n * n, sg = n, sb = 1;
+    const std::uint64_t* lattice = lut.lattice.data();
+
+    for (std::uint32_t x = 0; x < width; ++x) {
+        const std::uint32_t p = pixels[x];
+        const std::uint32_t er = lut.shaper[0][(p >> 16) & 0xff];
+        const std::uint32_t eg = lut.shaper[1][(p >> 8) & 0xff];
+        const std::uint32_t eb = lut.shaper[2][p & 0xff];
+        const std::uint32_t fr = er & 0x1ff, fg = eg & 0x1ff, fb = eb & 0x1ff;
+
+        // Pick the tetrahedron containing the point: walk from c000 to
+        // c111 along the axes in order of decreasing fraction. Selected
+        // without branches; on noisy content the six cases are random.
+        const std::uint32_t rg = fr > fg, gb = fg > fb, rb = fr > fb;
+        const std::uint32_t r_max = -(rg & rb), g_max = -(~rg & gb & 1), b_min = -(gb & rb), g_min = -(~gb & rg & 1);
+        const std::uint32_t b_max = ~(r_max | g_max), r_min = ~(b_min | g_min);
+        const std::uint32_t f0 = (fr & r_max) | (fg & g_max) | (fb & b_max);
+        const std::uint32_t f2 = (fb & b_min) | (fg & g_min) | (fr & r_min);
+        const std::uint32_t f1 = fr + fg + fb - f0 - f2;
+        const std::uint32_t v1 = (sr & r_max) | (sg & g_max) | (sb & b_max);
+        const std::uint32_t v2 = sr + sg + sb - ((sb & b_min) | (sg & g_min) | (sr & r_min));
+
+        // Lanes hold at most 255 * 16 and the weights sum to 256, so the
+        // weighted sum cannot carry into the next lane.
+        const std::uint64_t* c0 = lattice + (er >> 9) + (eg >> 9) + (eb >> 9);
+        const std::uint64_t v = c0[0] * (256 - f0) + c0[v1] * (f0 - f1) + c0[v2] * (f1 - f2) + c0[sr + sg + sb] * f2;
+        const auto lane = [v](int shift) { return static_cast<std::uint32_t>(((v >> shift & kLane) + 2048) >> 12); };
+        pixels[x] = (p & 0xff000000) | lane(42) << 16 | lane(21) << 8 | lane(0);
+    }
+}
+
+} // namespace dispctrl
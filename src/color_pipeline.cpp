@@ -0,0 +1,195 @@
+#include "dispctrl/color_pipeline.hpp"
+
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/hash.hpp"
+#include "dispctrl/kms_device.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr double kIdentityTolerance = 1e-4;
+
+std::uint64_t to_s31_32(double v) noexcept
+{
+    const auto magnitude = static_cast<std::uint64_t>(std::llround(std::abs(v) * 4294967296.0));
+    return v < 0 ? magnitude | (std::uint64_t{1} << 63) : magnitude;
+}
+
+std::uint16_t to_u16(double v) noexcept
+{
+    return static_cast<std::uint16_t>(std::lround(std::clamp(v, 0.0, 1.0) * 65535));
+}
+
+template <typename Fn>
+std::vector<ColorLutEntry> sample_lut(std::uint32_t size, Fn&& fn)
+{
+    std::vector<ColorLutEntry> lut(size);
+    for (std::uint32_t i = 0; i < size; ++i) {
+        const double x = static_cast<double>(i) / (size - 1);
+        lut[i] = {to_u16(fn(0, x)), to_u16(fn(1, x)), to_u16(fn(2, x)), 0};
+    }
+    return lut;
+}
+
+std::uint64_t hash_lut(const std::vector<ColorLutEntry>& lut) noexcept
+{
+    return lut.empty() ? 0 : fnv1a64(lut.data(), lut.size() * sizeof(ColorLutEntry));
+}
+
+std::uint64_t cache_key(std::uint64_t source, std::uint64_t display, const CrtcColorCaps& caps) noexcept
+{
+    const std::uint64_t words[] = {source, display, caps.degamma_size, caps.gamma_size, caps.ctm};
+    return fnv1a64(words, sizeof(words));
+}
+
+// Queues one colour property if its contents changed; @p hash is 0 for
+// "cleared".
+std::error_code update(CommitQueue& queue, std::uint32_t crtc, std::uint32_t prop, std::uint64_t hash,
+                       const void* data, std::size_t size, std::uint64_t& current, bool known,
+                       ColorPipeline::Stats& stats)
+{
+    if (!prop)
+        return {};
+    if (known && current == hash) {
+        ++stats.skipped;
+        return {};
+    }
+    if (hash == 0) {
+        queue.set(crtc, prop, 0);
+    } else if (std::error_code ec = queue.set_blob(crtc, prop, data, size)) {
+        return ec;
+    }
+    current = hash;
+    ++stats.uploads;
+    return {};
+}
+
+} // namespace
+
+ColorTransform build_color_transform(const ColorProfile& source, const ColorProfile& display,
+                                     const CrtcColorCaps& caps)
+{
+    ColorTransform t;
+
+    const std::array<double, 9> m = color_matrix(source, display);
+    bool identity = true;
+    for (int i = 0; i < 9; ++i)
+        identity = identity && std::abs(m[i] - (i % 4 == 0 ? 1.0 : 0.0)) < kIdentityTolerance;
+
+    bool same_curves = true;
+    for (int c = 0; c < 3; ++c)
+        same_curves = same_curves && source.trc[c].hash() == display.trc[c].hash();
+
+    if (identity && same_curves) {
+        // Nothing to do; leave the hardware in bypass.
+    } else if (caps.degamma_size >= 2 && caps.gamma_size >= 2 && caps.ctm) {
+        t.degamma = sample_lut(caps.degamma_size, [&](int c, double x) { return source.trc[c].eval(x); });
+        t.gamma = sample_lut(caps.gamma_size, [&](int c, double x) { return display.trc[c].inverse(x); });
+        for (int i = 0; i < 9; ++i)
+            t.ctm[i] = to_s31_32(m[i]);
+        t.has_ctm = !identity;
+    } else if (identity && caps.gamma_size >= 2) {
+        t.gamma = sample_lut(caps.gamma_size,
+                             [&](int c, double x) { return display.trc[c].inverse(source.trc[c].eval(x)); });
+    } else {
+        t.offloaded = false;
+        t.lut3d = build_lut3d(source, display);
+    }
+
+    t.degamma_hash = hash_lut(t.degamma);
+    t.gamma_hash = hash_lut(t.gamma);
+    t.ctm_hash = t.has_ctm ? fnv1a64(t.ctm.data(), sizeof(t.ctm)) : 0;
+    return t;
+}
+
+std::shared_ptr<const ColorTransform> ColorTransformCache::lookup(const ColorProfile& source,
+                                                                  const ColorProfile& display,
+                                                                  const CrtcColorCaps& caps)
+{
+    const std::uint64_t src = source.hash();
+    const std::uint64_t dst = display.hash();
+    const std::uint64_t key = cache_key(src, dst, caps);
+    auto matches = [&](const Entry& e) { return e.source == src && e.display == dst && e.caps == caps; };
+
+    {
+        std::lock_guard lock(mutex_);
+        if (auto it = index_.find(key); it != index_.end() && matches(*it->second)) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++stats_.hits;
+            return it->second->transform;
+        }
+        ++stats_.misses;
+    }
+
+    auto transform = std::make_shared<const ColorTransform>(build_color_transform(source, display, caps));
+
+    std::lock_guard lock(mutex_);
+    if (auto it = index_.find(key); it != index_.end()) {
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    lru_.push_front(Entry{key, src, dst, caps, transform});
+    index_.emplace(key, lru_.begin());
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+    return transform;
+}
+
+ColorTransformCache::Stats ColorTransformCache::stats() const
+{
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+ColorPipeline::ColorPipeline(KmsDevice& device, std::uint32_t crtc_id, const CrtcColorCaps& caps,
+                             ColorTransformCache& cache)
+    : crtc_id_(crtc_id), caps_(caps), cache_(cache)
+{
+    const struct {
+        bool present;
+        const char* name;
+        std::uint32_t* prop;
+    } props[] = {
+        {caps.degamma_size > 0, "DEGAMMA_LUT", &degamma_prop_},
+        {caps.ctm, "CTM", &ctm_prop_},
+        {caps.gamma_size > 0, "GAMMA_LUT", &gamma_prop_},
+    };
+    for (const auto& p : props)
+        if (p.present)
+            if (std::error_code ec = device.find_property(crtc_id, ObjectType::Crtc, p.name, *p.prop))
+                throw std::system_error(ec, std::string("CRTC property ") + p.name);
+}
+
+void ColorPipeline::set_profiles(const ColorProfile& source, const ColorProfile& display)
+{
+    transform_ = cache_.lookup(source, display, caps_);
+}
+
+std::error_code ColorPipeline::apply(CommitQueue& queue)
+{
+    // Without a transform, the hardware goes to bypass.
+    static const ColorTransform kBypass;
+    const ColorTransform& t = transform_ ? *transform_ : kBypass;
+
+    if (std::error_code ec = update(queue, crtc_id_, degamma_prop_, t.degamma_hash, t.degamma.data(),
+                                    t.degamma.size() * sizeof(ColorLutEntry), degamma_hash_, known_, stats_))
+        return ec;
+    if (std::error_code ec = update(queue, crtc_id_, ctm_prop_, t.ctm_hash, t.ctm.data(), sizeof(t.ctm), ctm_hash_,
+                                    known_, stats_))
+        return ec;
+    if (std::error_code ec = update(queue, crtc_id_, gamma_prop_, t.gamma_hash, t.gamma.data(),
+                                    t.gamma.size() * sizeof(ColorLutEntry), gamma_hash_, known_, stats_))
+        return ec;
+    known_ = true;
+    return {};
+}
+
+} // namespace dispctrl
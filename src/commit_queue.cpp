@@ -0,0 +1,314 @@
+#include "dispctrl/commit_queue.hpp"
+
+#include "dispctrl/clock.hpp"
+#include "dispctrl/kms_shadow.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace dispctrl {
+
+CommitQueue::Batch& CommitQueue::batch()
+{
+    if (!batch_) {
+        std::pmr::polymorphic_allocator<Batch> alloc(&arena_);
+        batch_ = alloc.new_object<Batch>(&arena_);
+        batch_->first_write_ns = monotonic_ns();
+    }
+    return *batch_;
+}
+
+void CommitQueue::end_batch() noexcept
+{
+    if (!batch_)
+        return;
+    for (std::uint32_t blob_id : batch_->blobs)
+        device_.destroy_blob(blob_id);
+    // The arena reclaims the storage wholesale; only run the destructor.
+    batch_->~Batch();
+    batch_ = nullptr;
+    arena_.reset();
+}
+
+void CommitQueue::set(std::uint32_t object_id, std::uint32_t prop_id, std::uint64_t value)
+{
+    batch().request.set(object_id, prop_id, value);
+    ++stats_.writes;
+}
+
+std::error_code CommitQueue::set_blob(std::uint32_t object_id, std::uint32_t prop_id, const void* data,
+                                      std::size_t size)
+{
+    std::uint32_t blob_id = 0;
+    const bool tracked = shadow_ && !shadow_->is_volatile(prop_id);
+    if (tracked && shadow_->matches_blob(object_id, prop_id, data, size, blob_id)) {
+        // Still written, so it overrides earlier writes of the batch; the
+        // shadow drops it again at submission.
+        set(object_id, prop_id, blob_id);
+        return {};
+    }
+    if (std::error_code ec = device_.create_blob(data, size, blob_id))
+        return ec;
+    Batch& b = batch();
+    b.blobs.push_back(blob_id);
+    if (tracked) {
+        const auto* bytes = static_cast<const std::uint8_t*>(data);
+        b.blob_writes.push_back({object_id, prop_id, blob_id, b.blob_data.size(), size});
+        b.blob_data.insert(b.blob_data.end(), bytes, bytes + size);
+    }
+    set(object_id, prop_id, blob_id);
+    return {};
+}
+
+void CommitQueue::set_in_fence(std::uint32_t plane_id, std::uint32_t prop_id, UniqueFd fence)
+{
+    Batch& b = batch();
+    const auto it = std::find_if(b.in_fences.begin(), b.in_fences.end(), [&](const InFence& f) {
+        return f.plane_id == plane_id && f.prop_id == prop_id;
+    });
+    const int fd = fence.get();
+    if (it != b.in_fences.end())
+        it->fd = std::move(fence);
+    else
+        b.in_fences.push_back({plane_id, prop_id, std::move(fence)});
+    set(plane_id, prop_id, static_cast<std::uint64_t>(static_cast<std::int64_t>(fd)));
+}
+
+void CommitQueue::set_out_fence(std::uint32_t prop_id, OutFenceCallback cb)
+{
+    out_fence_prop_ = prop_id;
+    out_fence_cb_ = std::move(cb);
+}
+
+void CommitQueue::set_writeback(std::uint32_t connector_id, std::uint32_t fb_prop, std::uint32_t fence_prop,
+                                std::uint32_t fb_id, WritebackCallback cb)
+{
+    Batch& b = batch();
+    if (b.writeback)
+        std::exchange(b.writeback, {})(0, std::make_error_code(std::errc::operation_canceled), UniqueFd());
+    b.writeback = std::move(cb);
+    b.writeback_connector = connector_id;
+    b.writeback_fb_prop = fb_prop;
+    b.writeback_fence_prop = fence_prop;
+    set(connector_id, fb_prop, fb_id);
+}
+
+std::error_code CommitQueue::set_latched(std::uint32_t object_id, std::uint32_t prop_id, std::uint64_t value,
+                                         std::uint64_t input_ns) noexcept
+{
+    std::size_t i = 0;
+    while (i < latched_count_ && (latched_[i].object_id != object_id || latched_[i].prop_id != prop_id))
+        ++i;
+    if (i == latched_count_) {
+        if (latched_count_ == kMaxLatched)
+            return std::make_error_code(std::errc::no_buffer_space);
+        if (latched_count_++ == 0)
+            latched_first_ns_ = monotonic_ns();
+    }
+    latched_[i] = {object_id, prop_id, value};
+    latched_input_ns_ = std::max(latched_input_ns_, input_ns);
+    ++stats_.writes;
+    return {};
+}
+
+void CommitQueue::take_latched(AtomicRequest& request) noexcept
+{
+    // Appended last so they win over any frame write to the same property.
+    for (std::size_t i = 0; i < latched_count_; ++i)
+        request.set(latched_[i].object_id, latched_[i].prop_id, latched_[i].value);
+}
+
+std::error_code CommitQueue::flush()
+{
+    if (in_flight_) {
+        if (!empty() && !flush_deferred_) {
+            flush_deferred_ = true;
+            ++stats_.deferred;
+        }
+        return {};
+    }
+    if (empty())
+        return {};
+    return submit();
+}
+
+std::error_code CommitQueue::flush_latched()
+{
+    if (in_flight_ || latched_count_ == 0)
+        return {};
+    latch_request_.clear();
+    take_latched(latch_request_);
+    const std::size_t superseded = latch_request_.finalize();
+    const std::error_code ec =
+        commit(latch_request_, commit::Nonblock | commit::PageFlipEvent, superseded, latched_first_ns_, true);
+    return ec == std::errc::device_or_resource_busy ? std::error_code{} : ec;
+}
+
+std::error_code CommitQueue::submit()
+{
+    flush_deferred_ = false;
+    Batch& b = *batch_;
+    take_latched(b.request);
+    if (out_fence_prop_) {
+        out_fence_ = -1;
+        b.request.set(crtc_id_, out_fence_prop_, reinterpret_cast<std::uintptr_t>(&out_fence_));
+    }
+    if (b.writeback) {
+        writeback_fence_ = -1;
+        b.request.set(b.writeback_connector, b.writeback_fence_prop, reinterpret_cast<std::uintptr_t>(&writeback_fence_));
+    }
+    const std::size_t superseded = b.request.finalize();
+
+    std::uint32_t flags = commit::Nonblock | commit::PageFlipEvent;
+    if (b.allow_modeset)
+        flags |= commit::AllowModeset;
+
+    const std::error_code ec = commit(b.request, flags, superseded, b.first_write_ns, false);
+    if (ec == std::errc::device_or_resource_busy) {
+        // The previous commit is still being applied by the kernel; keep
+        // the batch (already coalesced) and try again on the next flush.
+        return {};
+    }
+    if (!ec && shadow_)
+        for (const BlobWrite& w : b.blob_writes)
+            shadow_->record_blob(w.object_id, w.prop_id, w.blob_id, b.blob_data.data() + w.offset, w.size);
+    WritebackCallback writeback = std::move(b.writeback);
+    UniqueFd writeback_fence(std::exchange(writeback_fence_, -1));
+    const bool committed = !ec && in_flight_;
+    if (committed) {
+        // The kernel has its own references now; keep the fds to read the
+        // signal times once the flip is done.
+        current_.in_fences = b.in_fences.size();
+        stats_.in_fences += b.in_fences.size();
+        for (InFence& f : b.in_fences)
+            fences_.push_back(std::move(f.fd));
+        if (out_fence_ >= 0) {
+            ++stats_.out_fences;
+            UniqueFd fence(std::exchange(out_fence_, -1));
+            if (out_fence_cb_)
+                out_fence_cb_(current_.serial, std::move(fence));
+        }
+        if (writeback) {
+            current_.writeback = true;
+            ++stats_.writebacks;
+        }
+    }
+    end_batch();
+    // Called last, so the callback may record the next frame.
+    if (writeback) {
+        if (committed)
+            writeback(current_.serial, {}, std::move(writeback_fence));
+        else
+            writeback(0, ec ? ec : std::make_error_code(std::errc::operation_canceled), UniqueFd());
+    }
+    return ec;
+}
+
+std::error_code CommitQueue::commit(AtomicRequest& request, std::uint32_t flags, std::size_t superseded,
+                                    std::uint64_t first_write_ns, bool latch_only)
+{
+    std::size_t actions = 0; // writes that change no state
+    if (!latch_only && out_fence_prop_)
+        ++actions;
+    if (shadow_) {
+        if (batch_ && !latch_only)
+            for (const InFence& f : batch_->in_fences)
+                shadow_->add_volatile(f.prop_id);
+        if (batch_ && !latch_only && batch_->writeback) {
+            // One-shot: the kernel clears the job once it has run.
+            shadow_->add_volatile(batch_->writeback_fb_prop);
+            shadow_->add_volatile(batch_->writeback_fence_prop);
+        }
+        if (actions)
+            shadow_->add_volatile(out_fence_prop_);
+    }
+    const std::size_t unchanged = shadow_ ? shadow_->filter(request) : 0;
+    stats_.unchanged += unchanged;
+    if (request.props().size() <= actions) {
+        // Nothing would change: no ioctl, no flip. The latched writes are
+        // in place as well.
+        latched_count_ = 0;
+        latched_input_ns_ = 0;
+        ++stats_.skipped;
+        return {};
+    }
+
+    const std::uint64_t serial = serial_ + 1;
+    const std::uint64_t start = monotonic_ns();
+    std::error_code ec = device_.atomic_commit(request, flags, serial);
+    const std::uint64_t end = monotonic_ns();
+
+    if (ec == std::errc::device_or_resource_busy) {
+        // Latched writes stay queued as well and are sent again.
+        ++stats_.busy;
+        return ec;
+    }
+
+    const std::size_t latched = latched_count_;
+    const std::uint64_t latched_input_ns = latched_input_ns_;
+    latched_count_ = 0;
+    latched_input_ns_ = 0;
+    if (ec) {
+        ++stats_.failed;
+        return ec;
+    }
+
+    if (shadow_)
+        shadow_->record(request);
+
+    serial_ = serial;
+    in_flight_ = true;
+    current_ = CommitReport{};
+    current_.serial = serial;
+    current_.properties = request.props().size();
+    current_.superseded = superseded;
+    current_.unchanged = unchanged;
+    current_.first_write_ns = first_write_ns;
+    current_.submit_ns = start;
+    current_.ioctl_ns = end - start;
+    current_.latched = latched;
+    current_.latched_input_ns = latched_input_ns;
+    current_.latch_only = latch_only;
+
+    ++stats_.commits;
+    stats_.superseded += superseded;
+    if (latch_only)
+        ++stats_.latch_commits;
+    return {};
+}
+
+std::error_code CommitQueue::on_flip_complete(const KmsEvent& event)
+{
+    if (event.type != KmsEvent::Type::FlipComplete || !in_flight_)
+        return {};
+    if ((event.crtc_id != 0 && event.crtc_id != crtc_id_) || event.user_data != serial_)
+        return {};
+
+    in_flight_ = false;
+    current_.complete_ns = event.timestamp_ns;
+    complete_fences();
+    if (report_)
+        report_(current_);
+
+    if (flush_deferred_ && !empty())
+        return submit();
+    flush_deferred_ = false;
+    return {};
+}
+
+void CommitQueue::complete_fences()
+{
+    for (const UniqueFd& fd : fences_) {
+        FenceStatus status;
+        if (device_.fence_status(fd.get(), status) || !status.signaled())
+            continue;
+        const std::uint64_t wait = status.timestamp_ns > current_.submit_ns ? status.timestamp_ns - current_.submit_ns : 0;
+        fence_wait_.record(wait);
+        if (wait)
+            ++stats_.fence_waits;
+        current_.fence_signal_ns = std::max(current_.fence_signal_ns, status.timestamp_ns);
+    }
+    fences_.clear();
+}
+
+} // namespace dispctrl
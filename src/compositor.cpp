@@ -0,0 +1,262 @@
+#include "dispctrl/compositor.hpp"
+
+#include "dispctrl/format.hpp"
+
+#include "blend_kernels.hpp"
+#include "fetch_kernels.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace dispctrl {
+
+namespace blend {
+
+void over_row_scalar(const std::uint32_t* src, std::uint32_t* dst, std::uint32_t width) noexcept
+{
+    for (std::uint32_t x = 0; x < width; ++x)
+        dst[x] = over_pixel(src[x], dst[x]);
+}
+
+const BlendKernels kScalarKernels{over_row_scalar};
+
+} // namespace blend
+
+namespace {
+
+const blend::BlendKernels* kernels_for(ConvertIsa isa) noexcept
+{
+    switch (isa) {
+    case ConvertIsa::Scalar:
+        return &blend::kScalarKernels;
+    case ConvertIsa::Avx2:
+#ifdef DISPCTRL_HAVE_AVX2
+        if (__builtin_cpu_supports("avx2"))
+            return &blend::kAvx2Kernels;
+#endif
+        return nullptr;
+    case ConvertIsa::Neon:
+#ifdef DISPCTRL_HAVE_NEON
+        return &blend::kNeonKernels;
+#endif
+        return nullptr;
+    }
+    return nullptr;
+}
+
+bool opaque(const CompositeLayer& layer) noexcept
+{
+    return !blend::has_alpha(layer.surface.fourcc) || layer.blend == BlendMode::Opaque;
+}
+
+std::size_t format_index(std::uint32_t format) noexcept
+{
+    const auto* it = std::find(blend::kSourceFormats.begin(), blend::kSourceFormats.end(), format);
+    return static_cast<std::size_t>(it - blend::kSourceFormats.begin());
+}
+
+// The crop after rotation, which is what gets scaled onto dst.
+std::int32_t rotated_width(const CompositeLayer& layer) noexcept
+{
+    return swaps_axes(layer.rotation) ? layer.src.height() : layer.src.width();
+}
+
+std::int32_t rotated_height(const CompositeLayer& layer) noexcept
+{
+    return swaps_axes(layer.rotation) ? layer.src.width() : layer.src.height();
+}
+
+// Nearest source coordinate for destination offset @p d of @p dst_len
+// pixels mapped onto @p src_len pixels (pixel centres).
+std::int32_t sample(std::int32_t d, std::int32_t src_len, std::int32_t dst_len) noexcept
+{
+    return static_cast<std::int32_t>((std::int64_t{2} * d + 1) * src_len / (std::int64_t{2} * dst_len));
+}
+
+bool valid(const CompositeLayer& layer) noexcept
+{
+    const Surface& s = layer.surface;
+    if (format_index(s.fourcc) == blend::kSourceFormats.size() ||
+        static_cast<std::size_t>(layer.blend) >= blend::kBlendModes ||
+        static_cast<std::size_t>(layer.rotation) >= blend::kRotations)
+        return false;
+    if (layer.dst.empty())
+        return true; // nothing to draw
+    const Rect bounds = Rect::from_size(0, 0, static_cast<std::int32_t>(s.width), static_cast<std::int32_t>(s.height));
+    return s.pixels && s.pitch >= s.width * 4 && !layer.src.empty() && bounds.contains(layer.src);
+}
+
+} // namespace
+
+struct TileCompositor::Frame {
+    std::span<const CompositeLayer> layers;
+    std::span<const LayerOp> ops;
+    std::span<const Rect> damage;
+    const OutputBuffer* out;
+    std::uint32_t background;
+    std::uint32_t tiles_x;
+};
+
+TileCompositor::TileCompositor(ThreadPool& pool, std::uint32_t tile_width, std::uint32_t tile_height)
+    : pool_(pool),
+      tile_w_(std::max(tile_width, 8u)),
+      tile_h_(std::max(tile_height, 1u)),
+      kernels_(kernels_for(best_convert_isa())),
+      scratch_(pool.size(), std::vector<std::uint32_t>(tile_w_))
+{
+}
+
+std::error_code TileCompositor::set_isa(ConvertIsa isa) noexcept
+{
+    const blend::BlendKernels* k = kernels_for(isa);
+    if (!k)
+        return std::make_error_code(std::errc::not_supported);
+    kernels_ = k;
+    return {};
+}
+
+std::error_code TileCompositor::compose(std::span<const CompositeLayer> layers, std::span<const Rect> damage,
+                                        OutputBuffer& out, std::uint32_t background)
+{
+    if (!out.pixels || out.pitch < out.width * 4)
+        return std::make_error_code(std::errc::invalid_argument);
+    try {
+        ops_.resize(layers.size());
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+    for (std::size_t i = 0; i < layers.size(); ++i) {
+        const CompositeLayer& layer = layers[i];
+        if (!valid(layer))
+            return std::make_error_code(std::errc::invalid_argument);
+        const std::size_t format = format_index(layer.surface.fourcc);
+        const bool scaled = rotated_width(layer) != layer.dst.width();
+        // Rows already in the output's layout are read where they are.
+        const bool in_place = layer.rotation == Rotation::R0 && !scaled &&
+                              (layer.surface.fourcc == fourcc::XRGB8888 ||
+                               (layer.surface.fourcc == fourcc::ARGB8888 && layer.blend != BlendMode::Coverage));
+        ops_[i].fetch = in_place ? kInPlace
+                                 : static_cast<std::uint16_t>(blend::fetch_index(format, layer.blend, layer.rotation, scaled));
+        ops_[i].copy = opaque(layer);
+    }
+
+    const std::uint32_t tiles_x = (out.width + tile_w_ - 1) / tile_w_;
+    const std::uint32_t tiles_y = (out.height + tile_h_ - 1) / tile_h_;
+    ++stats_.frames;
+    stats_.tiles += std::uint64_t{tiles_x} * tiles_y;
+    if (damage.empty())
+        return {};
+
+    const Frame frame{layers, {ops_.data(), layers.size()}, damage, &out, background, tiles_x};
+    pool_.parallel_for(std::size_t{tiles_x} * tiles_y,
+                       [&](std::size_t tile, unsigned thread) { draw_tile(frame, tile, thread); });
+    stats_.tiles_drawn = drawn_.load(std::memory_order_relaxed);
+    stats_.layers_culled = culled_.load(std::memory_order_relaxed);
+    return {};
+}
+
+void TileCompositor::draw_tile(const Frame& frame, std::size_t tile, unsigned thread) noexcept
+{
+    const OutputBuffer& out = *frame.out;
+    const auto tx = static_cast<std::int32_t>(tile % frame.tiles_x * tile_w_);
+    const auto ty = static_cast<std::int32_t>(tile / frame.tiles_x * tile_h_);
+    const Rect bounds =
+        intersect(Rect::from_size(tx, ty, static_cast<std::int32_t>(tile_w_), static_cast<std::int32_t>(tile_h_)),
+                  Rect::from_size(0, 0, static_cast<std::int32_t>(out.width), static_cast<std::int32_t>(out.height)));
+
+    // Redraw the bounding box of the damage inside this tile.
+    Rect clip;
+    for (const Rect& d : frame.damage)
+        clip = bounding(clip, intersect(d, bounds));
+    if (clip.empty())
+        return;
+    drawn_.fetch_add(1, std::memory_order_relaxed);
+
+    // Everything below the topmost opaque layer covering the clip is hidden.
+    const std::size_t n = frame.layers.size();
+    std::size_t first = 0;
+    bool fill = true;
+    for (std::size_t i = n; i-- > 0;) {
+        if (opaque(frame.layers[i]) && frame.layers[i].dst.contains(clip)) {
+            first = i;
+            fill = false;
+            break;
+        }
+    }
+    if (first)
+        culled_.fetch_add(first, std::memory_order_relaxed);
+
+    std::uint32_t* scratch = scratch_[thread].data();
+    const auto width = static_cast<std::uint32_t>(clip.width());
+    for (std::int32_t y = clip.y1; y < clip.y2; ++y) {
+        auto* row = reinterpret_cast<std::uint32_t*>(out.pixels + std::size_t(y) * out.pitch);
+        if (fill)
+            std::fill_n(row + clip.x1, width, frame.background);
+
+        for (std::size_t i = first; i < n; ++i) {
+            const CompositeLayer& layer = frame.layers[i];
+            const Rect span = intersect(layer.dst, clip);
+            if (span.empty() || y < span.y1 || y >= span.y2)
+                continue;
+
+            const Rect& src = layer.src;
+            const Rect& dst = layer.dst;
+            const LayerOp& op = frame.ops[i];
+            const auto count = static_cast<std::uint32_t>(span.width());
+            const std::int32_t rw = rotated_width(layer);
+            const std::int32_t u = span.x1 - dst.x1;
+            const std::int32_t rv = sample(y - dst.y1, rotated_height(layer), dst.height());
+            // Nearest sample of destination column u: ((2u + 1) * rw) / (2 * dst width).
+            const std::uint32_t denom = 2 * static_cast<std::uint32_t>(dst.width());
+            const std::uint64_t num = (std::uint64_t{2} * static_cast<std::uint32_t>(u) + 1) * static_cast<std::uint32_t>(rw);
+            const auto ru = static_cast<std::int32_t>(num / denom);
+
+            // First sample in crop coordinates, by undoing the rotation.
+            const std::int32_t w = src.width() - 1;
+            const std::int32_t h = src.height() - 1;
+            std::int32_t sx = ru, sy = rv;
+            switch (layer.rotation) {
+            case Rotation::R0:
+                break;
+            case Rotation::R90:
+                sx = w - rv;
+                sy = ru;
+                break;
+            case Rotation::R180:
+                sx = w - ru;
+                sy = h - rv;
+                break;
+            case Rotation::R270:
+                sx = rv;
+                sy = h - ru;
+                break;
+            }
+            const std::uint8_t* texel = layer.surface.pixels + std::size_t(src.y1 + sy) * layer.surface.pitch +
+                                        std::size_t(src.x1 + sx) * 4;
+
+            const std::uint32_t* pixels;
+            if (op.fetch == kInPlace) {
+                pixels = reinterpret_cast<const std::uint32_t*>(texel);
+            } else {
+                const blend::FetchSpan fetch{texel,
+                                             layer.surface.pitch,
+                                             static_cast<std::uint32_t>(rw) / static_cast<std::uint32_t>(dst.width()),
+                                             2 * (static_cast<std::uint32_t>(rw) % static_cast<std::uint32_t>(dst.width())),
+                                             static_cast<std::uint32_t>(num % denom),
+                                             denom};
+                blend::kFetchKernels[op.fetch](fetch, scratch, count);
+                pixels = scratch;
+            }
+
+            if (op.copy)
+                std::memcpy(row + span.x1, pixels, count * sizeof(std::uint32_t));
+            else
+                kernels_->over(pixels, row + span.x1, count);
+        }
+        if (lut_)
+            apply_lut3d(*lut_, row + clip.x1, width);
+    }
+}
+
+} // namespace dispctrl
@@ -0,0 +1,258 @@
+#include "dispctrl/config_store.hpp"
+
+#include "dispctrl/hash.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+namespace dispctrl {
+
+namespace {
+
+struct FileHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t record_size;
+    std::uint32_t count;
+    std::uint32_t reserved;
+    std::uint64_t checksum; ///< fnv1a64 of the records.
+};
+
+static_assert(sizeof(FileHeader) % alignof(ConnectorConfig) == 0);
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+bool name_less(const ConnectorConfig& c, std::string_view name) noexcept
+{
+    return c.name() < name;
+}
+
+std::error_code write_all(int fd, const void* data, std::size_t size) noexcept
+{
+    const auto* p = static_cast<const std::uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t len = ::write(fd, p, size);
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            return last_error();
+        }
+        p += len;
+        size -= static_cast<std::size_t>(len);
+    }
+    return {};
+}
+
+} // namespace
+
+std::string_view ConnectorConfig::name() const noexcept
+{
+    return {connector, ::strnlen(connector, kNameSize)};
+}
+
+std::uint64_t monitor_id(const DisplayInfo& info) noexcept
+{
+    std::uint64_t h = fnv1a64(info.vendor, sizeof(info.vendor));
+    h = fnv1a64(&info.product, sizeof(info.product), h);
+    h = fnv1a64(&info.serial, sizeof(info.serial), h);
+    return fnv1a64(info.name.data(), info.name.size(), h);
+}
+
+ConfigStore::ConfigStore(std::string path) : path_(std::move(path))
+{
+    thread_ = std::thread([this] { writer(); });
+}
+
+ConfigStore::~ConfigStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+    unmap();
+}
+
+void ConfigStore::unmap() noexcept
+{
+    if (map_)
+        ::munmap(map_, map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+}
+
+std::error_code ConfigStore::load()
+{
+    unmap();
+    owned_.clear();
+    view_ = {};
+
+    UniqueFd fd(::open(path_.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd)
+        return last_error();
+    struct stat st;
+    if (::fstat(fd.get(), &st) != 0)
+        return last_error();
+    const auto size = static_cast<std::size_t>(st.st_size);
+    if (size < sizeof(FileHeader))
+        return std::make_error_code(std::errc::invalid_argument);
+
+    // The file is a few KiB; populate it up front rather than faulting in
+    // the middle of the first modeset.
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd.get(), 0);
+    if (map == MAP_FAILED)
+        return last_error();
+    map_ = map;
+    map_size_ = size;
+
+    const auto* header = static_cast<const FileHeader*>(map);
+    const auto* records = reinterpret_cast<const ConnectorConfig*>(header + 1);
+    const std::size_t bytes = size - sizeof(FileHeader);
+    if (header->magic != kMagic || header->version != kVersion || header->record_size != sizeof(ConnectorConfig) ||
+        bytes != std::size_t{header->count} * sizeof(ConnectorConfig) ||
+        header->checksum != fnv1a64(records, bytes)) {
+        unmap();
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+    view_ = {records, header->count};
+    return {};
+}
+
+const ConnectorConfig* ConfigStore::find(std::string_view connector) const noexcept
+{
+    const auto it = std::lower_bound(view_.begin(), view_.end(), connector, name_less);
+    return it != view_.end() && it->name() == connector ? &*it : nullptr;
+}
+
+std::error_code ConfigStore::put(const ConnectorConfig& config)
+{
+    const std::string_view name = config.name();
+    if (name.empty() || name.size() == ConnectorConfig::kNameSize)
+        return std::make_error_code(std::errc::invalid_argument);
+
+    // Everything that allocates comes first, so running out of memory
+    // leaves the store as it was.
+    std::vector<ConnectorConfig> snapshot;
+    try {
+        // Copy on first write; the mapping stays read-only.
+        if (owned_.empty() && !view_.empty())
+            owned_.assign(view_.begin(), view_.end());
+        owned_.reserve(owned_.size() + 1);
+        snapshot.reserve(owned_.size() + 1);
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+
+    const auto it = std::lower_bound(owned_.begin(), owned_.end(), name, name_less);
+    if (it != owned_.end() && it->name() == name)
+        *it = config;
+    else
+        owned_.insert(it, config); // within the reserved capacity
+    view_ = owned_;
+    unmap();
+    snapshot.assign(owned_.begin(), owned_.end());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (dirty_)
+            ++stats_.coalesced;
+        pending_.swap(snapshot); // the replaced snapshot is freed outside the lock
+        dirty_ = true;
+    }
+    wake_.notify_one();
+    return {};
+}
+
+std::error_code ConfigStore::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return !dirty_ && !writing_; });
+    return result_;
+}
+
+ConfigStore::Stats ConfigStore::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ConfigStore::writer()
+{
+    std::vector<ConnectorConfig> records;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        // Drain a pending snapshot even when stopping, so the last put()
+        // before shutdown is not lost.
+        wake_.wait(lock, [this] { return dirty_ || stopping_; });
+        if (!dirty_)
+            return;
+        records.swap(pending_);
+        dirty_ = false;
+        writing_ = true;
+
+        lock.unlock();
+        const std::error_code ec = write_file(records);
+        lock.lock();
+
+        writing_ = false;
+        result_ = ec;
+        if (ec) {
+            ++stats_.errors;
+            stats_.last_error = ec;
+        } else {
+            ++stats_.writes;
+        }
+        done_.notify_all();
+    }
+}
+
+std::error_code ConfigStore::write_file(const std::vector<ConnectorConfig>& records) const
+{
+    const std::size_t bytes = records.size() * sizeof(ConnectorConfig);
+    FileHeader header{};
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.record_size = sizeof(ConnectorConfig);
+    header.count = static_cast<std::uint32_t>(records.size());
+    header.checksum = fnv1a64(records.data(), bytes);
+
+    const std::string tmp = path_ + ".tmp";
+    UniqueFd fd(::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (!fd)
+        return last_error();
+    std::error_code ec = write_all(fd.get(), &header, sizeof(header));
+    if (!ec)
+        ec = write_all(fd.get(), records.data(), bytes);
+    if (!ec && ::fsync(fd.get()) != 0)
+        ec = last_error();
+    if (!ec && ::close(fd.release()) != 0)
+        ec = last_error();
+    if (!ec && ::rename(tmp.c_str(), path_.c_str()) != 0)
+        ec = last_error();
+    if (ec) {
+        ::unlink(tmp.c_str());
+        return ec;
+    }
+
+    // Make the rename itself durable.
+    const std::size_t slash = path_.rfind('/');
+    const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path_.substr(0, slash);
+    UniqueFd dirfd(::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (dirfd && ::fsync(dirfd.get()) != 0)
+        return last_error();
+    return {};
+}
+
+} // namespace dispctrl
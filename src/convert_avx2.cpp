@@ -0,0 +1,120 @@
+// Built with -mavx2; only reached after a runtime CPU check.
+
+#include "convert_kernels.hpp"
+
+#include <immintrin.h>
+
+namespace dispctrl::convert {
+
+namespace {
+
+struct Rgb16 {
+    __m256i r, g, b;
+};
+
+// 16 pixels of YUV (16-bit lanes, chroma already replicated per pixel).
+inline Rgb16 yuv16_to_rgb(__m256i y, __m256i u, __m256i v) noexcept
+{
+    const __m256i ys = _mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(16)), _mm256_set1_epi16(kYScale));
+    const __m256i us = _mm256_sub_epi16(u, _mm256_set1_epi16(128));
+    const __m256i vs = _mm256_sub_epi16(v, _mm256_set1_epi16(128));
+    const __m256i round = _mm256_set1_epi16(kRound);
+
+    __m256i r = _mm256_add_epi16(ys, _mm256_mullo_epi16(vs, _mm256_set1_epi16(kRv)));
+    __m256i g = _mm256_sub_epi16(ys, _mm256_mullo_epi16(us, _mm256_set1_epi16(kGu)));
+    g = _mm256_sub_epi16(g, _mm256_mullo_epi16(vs, _mm256_set1_epi16(kGv)));
+    // Saturation only triggers when blue clamps to 255 (see convert_kernels.hpp).
+    __m256i b = _mm256_adds_epi16(ys, _mm256_mullo_epi16(us, _mm256_set1_epi16(kBu)));
+
+    r = _mm256_srai_epi16(_mm256_add_epi16(r, round), 6);
+    g = _mm256_srai_epi16(_mm256_add_epi16(g, round), 6);
+    b = _mm256_srai_epi16(_mm256_adds_epi16(b, round), 6);
+    return {r, g, b};
+}
+
+// Clamps 16 signed 16-bit lanes to bytes, preserving lane order.
+inline __m128i pack16(__m256i v) noexcept
+{
+    const __m256i p = _mm256_packus_epi16(v, v);
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(p, 0x08));
+}
+
+inline void store_xrgb16(std::uint32_t* dst, const Rgb16& c) noexcept
+{
+    const __m128i r = pack16(c.r);
+    const __m128i g = pack16(c.g);
+    const __m128i b = pack16(c.b);
+    const __m128i x = _mm_set1_epi8(static_cast<char>(0xff));
+
+    const __m128i bg_lo = _mm_unpacklo_epi8(b, g);
+    const __m128i bg_hi = _mm_unpackhi_epi8(b, g);
+    const __m128i rx_lo = _mm_unpacklo_epi8(r, x);
+    const __m128i rx_hi = _mm_unpackhi_epi8(r, x);
+
+    auto* out = reinterpret_cast<__m128i*>(dst);
+    _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(bg_lo, rx_lo));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bg_lo, rx_lo));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bg_hi, rx_hi));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bg_hi, rx_hi));
+}
+
+void nv12_row_avx2(const std::uint8_t* y, const std::uint8_t* uv, std::uint32_t* dst,
+                   std::uint32_t width) noexcept
+{
+    const __m128i lo_byte = _mm_set1_epi16(0x00ff);
+    std::uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m256i y16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + x));
+        const __m128i u8 = _mm_and_si128(c, lo_byte);
+        const __m128i v8 = _mm_srli_epi16(c, 8);
+        const __m256i u = _mm256_set_m128i(_mm_unpackhi_epi16(u8, u8), _mm_unpacklo_epi16(u8, u8));
+        const __m256i v = _mm256_set_m128i(_mm_unpackhi_epi16(v8, v8), _mm_unpacklo_epi16(v8, v8));
+        store_xrgb16(dst + x, yuv16_to_rgb(y16, u, v));
+    }
+    nv12_row_scalar(y + x, uv + x, dst + x, width - x);
+}
+
+void yuyv_row_avx2(const std::uint8_t* src, std::uint32_t* dst, std::uint32_t width) noexcept
+{
+    const __m256i lo_byte = _mm256_set1_epi16(0x00ff);
+    const __m256i lo_word = _mm256_set1_epi32(0x0000ffff);
+    std::uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        // Lane i holds Y_i in its low byte and U (even i) or V (odd i) above.
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 2));
+        const __m256i y16 = _mm256_and_si256(p, lo_byte);
+        const __m256i c = _mm256_srli_epi16(p, 8);
+        const __m256i ue = _mm256_and_si256(c, lo_word);
+        const __m256i vo = _mm256_srli_epi32(c, 16);
+        const __m256i u = _mm256_or_si256(ue, _mm256_slli_epi32(ue, 16));
+        const __m256i v = _mm256_or_si256(vo, _mm256_slli_epi32(vo, 16));
+        store_xrgb16(dst + x, yuv16_to_rgb(y16, u, v));
+    }
+    yuyv_row_scalar(src + x * 2, dst + x, width - x);
+}
+
+void rgb565_row_avx2(const std::uint8_t* src, std::uint32_t* dst, std::uint32_t width) noexcept
+{
+    const __m256i mask5 = _mm256_set1_epi16(0x1f);
+    const __m256i mask6 = _mm256_set1_epi16(0x3f);
+    std::uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 2));
+        const __m256i r5 = _mm256_srli_epi16(p, 11);
+        const __m256i g6 = _mm256_and_si256(_mm256_srli_epi16(p, 5), mask6);
+        const __m256i b5 = _mm256_and_si256(p, mask5);
+        Rgb16 c;
+        c.r = _mm256_or_si256(_mm256_slli_epi16(r5, 3), _mm256_srli_epi16(r5, 2));
+        c.g = _mm256_or_si256(_mm256_slli_epi16(g6, 2), _mm256_srli_epi16(g6, 4));
+        c.b = _mm256_or_si256(_mm256_slli_epi16(b5, 3), _mm256_srli_epi16(b5, 2));
+        store_xrgb16(dst + x, c);
+    }
+    rgb565_row_scalar(src + x * 2, dst + x, width - x);
+}
+
+} // namespace
+
+const RowKernels kAvx2Kernels{nv12_row_avx2, yuyv_row_avx2, rgb565_row_avx2};
+
+} // namespace dispctrl::convert
@@ -0,0 +1,72 @@
+#pragma once
+
+// Row kernels behind convert_to_xrgb8888(). Each SIMD translation unit is
+// compiled with its own ISA flags and exports a RowKernels table; all of
+// them must reproduce the scalar arithmetic below exactly.
+
+#include <algorithm>
+#include <cstdint>
+
+namespace dispctrl::convert {
+
+using Nv12Row = void (*)(const std::uint8_t* y, const std::uint8_t* uv, std::uint32_t* dst,
+                         std::uint32_t width);
+using PackedRow = void (*)(const std::uint8_t* src, std::uint32_t* dst, std::uint32_t width);
+
+struct RowKernels {
+    Nv12Row nv12;
+    PackedRow yuyv;
+    PackedRow rgb565;
+};
+
+// BT.601 limited range in 6-bit fixed point. The coefficients are chosen
+// so every intermediate fits a signed 16-bit lane; only the blue sum can
+// exceed it, and then only when the result clamps to 255 anyway, which
+// lets SIMD kernels use saturating 16-bit adds and stay bit-exact.
+inline constexpr int kYScale = 74;  // 1.164 * 64
+inline constexpr int kRv = 102;     // 1.596 * 64
+inline constexpr int kGu = 25;      // 0.391 * 64
+inline constexpr int kGv = 52;      // 0.813 * 64
+inline constexpr int kBu = 129;     // 2.018 * 64
+inline constexpr int kRound = 32;
+
+inline std::uint32_t clamp_u8(int v) noexcept
+{
+    return static_cast<std::uint32_t>(std::clamp(v, 0, 255));
+}
+
+inline std::uint32_t yuv_to_xrgb(int y, int u, int v) noexcept
+{
+    const int ys = (y - 16) * kYScale;
+    const int us = u - 128;
+    const int vs = v - 128;
+    const std::uint32_t r = clamp_u8((ys + kRv * vs + kRound) >> 6);
+    const std::uint32_t g = clamp_u8((ys - kGu * us - kGv * vs + kRound) >> 6);
+    const std::uint32_t b = clamp_u8((ys + kBu * us + kRound) >> 6);
+    return 0xff000000u | r << 16 | g << 8 | b;
+}
+
+inline std::uint32_t rgb565_to_xrgb(std::uint16_t p) noexcept
+{
+    const std::uint32_t r = p >> 11 & 0x1f;
+    const std::uint32_t g = p >> 5 & 0x3f;
+    const std::uint32_t b = p & 0x1f;
+    return 0xff000000u | (r << 3 | r >> 2) << 16 | (g << 2 | g >> 4) << 8 | (b << 3 | b >> 2);
+}
+
+// Scalar rows, also used by the SIMD kernels for the tail of each row.
+// YUYV rows have an even width.
+void nv12_row_scalar(const std::uint8_t* y, const std::uint8_t* uv, std::uint32_t* dst,
+                     std::uint32_t width) noexcept;
+void yuyv_row_scalar(const std::uint8_t* src, std::uint32_t* dst, std::uint32_t width) noexcept;
+void rgb565_row_scalar(const std::uint8_t* src, std::uint32_t* dst, std::uint32_t width) noexcept;
+
+extern const RowKernels kScalarKernels;
+#ifdef DISPCTRL_HAVE_AVX2
+extern const RowKernels kAvx2Kernels;
+#endif
+#ifdef DISPCTRL_HAVE_NEON
+extern const RowKernels kNeonKernels;
+#endif
+
+} // namespace dispctrl::convert
@@ -0,0 +1,108 @@
+// AArch64 Advanced SIMD kernels; Advanced SIMD is part of the base ISA there.
+
+#include "convert_kernels.hpp"
+
+#include <arm_neon.h>
+
+namespace dispctrl::convert {
+
+namespace {
+
+struct Rgb8 {
+    uint8x8_t r, g, b;
+};
+
+// 8 pixels; same arithmetic and lane widths as the AVX2 kernels.
+inline Rgb8 yuv8_to_rgb(uint8x8_t y, uint8x8_t u, uint8x8_t v) noexcept
+{
+    const int16x8_t ys = vmulq_n_s16(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), vdupq_n_s16(16)), kYScale);
+    const int16x8_t us = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u)), vdupq_n_s16(128));
+    const int16x8_t vs = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v)), vdupq_n_s16(128));
+    const int16x8_t round = vdupq_n_s16(kRound);
+
+    int16x8_t r = vaddq_s16(ys, vmulq_n_s16(vs, kRv));
+    int16x8_t g = vsubq_s16(ys, vmulq_n_s16(us, kGu));
+    g = vsubq_s16(g, vmulq_n_s16(vs, kGv));
+    int16x8_t b = vqaddq_s16(ys, vmulq_n_s16(us, kBu));
+
+    r = vshrq_n_s16(vaddq_s16(r, round), 6);
+    g = vshrq_n_s16(vaddq_s16(g, round), 6);
+    b = vshrq_n_s16(vqaddq_s16(b, round), 6);
+    return {vqmovun_s16(r), vqmovun_s16(g), vqmovun_s16(b)};
+}
+
+inline void store_xrgb16(std::uint32_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b) noexcept
+{
+    uint8x16x4_t px;
+    px.val[0] = b;
+    px.val[1] = g;
+    px.val[2] = r;
+    px.val[3] = vdupq_n_u8(0xff);
+    vst4q_u8(reinterpret_cast<std::uint8_t*>(dst), px);
+}
+
+void nv12_row_neon(const std::uint8_t* y, const std::uint8_t* uv, std::uint32_t* dst,
+                   std::uint32_t width) noexcept
+{
+    std::uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        // Even and odd luma samples share the chroma pair at the same index.
+        const uint8x8x2_t luma = vld2_u8(y + x);
+        const uint8x8x2_t chroma = vld2_u8(uv + x);
+        const Rgb8 even = yuv8_to_rgb(luma.val[0], chroma.val[0], chroma.val[1]);
+        const Rgb8 odd = yuv8_to_rgb(luma.val[1], chroma.val[0], chroma.val[1]);
+        const uint8x8x2_t r = vzip_u8(even.r, odd.r);
+        const uint8x8x2_t g = vzip_u8(even.g, odd.g);
+        const uint8x8x2_t b = vzip_u8(even.b, odd.b);
+        store_xrgb16(dst + x, vcombine_u8(r.val[0], r.val[1]), vcombine_u8(g.val[0], g.val[1]),
+                     vcombine_u8(b.val[0], b.val[1]));
+    }
+    nv12_row_scalar(y + x, uv + x, dst + x, width - x);
+}
+
+void yuyv_row_neon(const std::uint8_t* src, std::uint32_t* dst, std::uint32_t width) noexcept
+{
+    std::uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x8x4_t p = vld4_u8(src + x * 2); // Y0 U Y1 V
+        const Rgb8 even = yuv8_to_rgb(p.val[0], p.val[1], p.val[3]);
+        const Rgb8 odd = yuv8_to_rgb(p.val[2], p.val[1], p.val[3]);
+        const uint8x8x2_t r = vzip_u8(even.r, odd.r);
+        const uint8x8x2_t g = vzip_u8(even.g, odd.g);
+        const uint8x8x2_t b = vzip_u8(even.b, odd.b);
+        store_xrgb16(dst + x, vcombine_u8(r.val[0], r.val[1]), vcombine_u8(g.val[0], g.val[1]),
+                     vcombine_u8(b.val[0], b.val[1]));
+    }
+    yuyv_row_scalar(src + x * 2, dst + x, width - x);
+}
+
+inline uint8x8_t expand(uint16x8_t v, int bits) noexcept
+{
+    // v << (8 - bits) | v >> (2 * bits - 8), for 5- and 6-bit channels.
+    const uint16x8_t hi = vshlq_u16(v, vdupq_n_s16(static_cast<std::int16_t>(8 - bits)));
+    const uint16x8_t lo = vshlq_u16(v, vdupq_n_s16(static_cast<std::int16_t>(8 - 2 * bits)));
+    return vmovn_u16(vorrq_u16(hi, lo));
+}
+
+void rgb565_row_neon(const std::uint8_t* src, std::uint32_t* dst, std::uint32_t width) noexcept
+{
+    std::uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint16x8_t p0 = vld1q_u16(reinterpret_cast<const std::uint16_t*>(src + x * 2));
+        const uint16x8_t p1 = vld1q_u16(reinterpret_cast<const std::uint16_t*>(src + x * 2 + 16));
+        const uint16x8_t m5 = vdupq_n_u16(0x1f);
+        const uint16x8_t m6 = vdupq_n_u16(0x3f);
+        const uint8x16_t r = vcombine_u8(expand(vshrq_n_u16(p0, 11), 5), expand(vshrq_n_u16(p1, 11), 5));
+        const uint8x16_t g = vcombine_u8(expand(vandq_u16(vshrq_n_u16(p0, 5), m6), 6),
+                                         expand(vandq_u16(vshrq_n_u16(p1, 5), m6), 6));
+        const uint8x16_t b = vcombine_u8(expand(vandq_u16(p0, m5), 5), expand(vandq_u16(p1, m5), 5));
+        store_xrgb16(dst + x, r, g, b);
+    }
+    rgb565_row_scalar(src + x * 2, dst + x, width - x);
+}
+
+} // namespace
+
+const RowKernels kNeonKernels{nv12_row_neon, yuyv_row_neon, rgb565_row_neon};
+
+} // namespace dispctrl::convert
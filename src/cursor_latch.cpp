@@ -0,0 +1,141 @@
+#include "dispctrl/cursor_latch.hpp"
+
+#include "dispctrl/clock.hpp"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+namespace dispctrl {
+
+namespace {
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+} // namespace
+
+CursorLatch::CursorLatch(KmsDevice& device, CommitQueue& queue, std::uint32_t refresh_mhz)
+    : device_(device), queue_(queue), period_ns_(refresh_mhz ? 1'000'000'000'000ULL / refresh_mhz : 0),
+      timer_(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+{
+    if (!timer_)
+        throw std::system_error(last_error(), "timerfd_create");
+    // Never let the margin eat most of the frame.
+    if (period_ns_)
+        margin_ns_ = std::min(margin_ns_, period_ns_ / 2);
+}
+
+std::error_code CursorLatch::add_plane(std::uint32_t plane_id, std::size_t& index)
+{
+    Plane plane{plane_id, 0, 0};
+    if (std::error_code ec = device_.find_property(plane_id, ObjectType::Plane, "CRTC_X", plane.crtc_x))
+        return ec;
+    if (std::error_code ec = device_.find_property(plane_id, ObjectType::Plane, "CRTC_Y", plane.crtc_y))
+        return ec;
+    planes_.push_back(plane);
+    index = planes_.size() - 1;
+    return {};
+}
+
+std::error_code CursorLatch::move(std::size_t index, std::int32_t x, std::int32_t y, std::uint64_t input_ns)
+{
+    if (index >= planes_.size())
+        return std::make_error_code(std::errc::invalid_argument);
+    const Plane& p = planes_[index];
+    // CRTC_X/Y are signed range properties.
+    if (std::error_code ec = queue_.set_latched(p.plane_id, p.crtc_x, static_cast<std::uint64_t>(std::int64_t{x}), input_ns))
+        return ec;
+    if (std::error_code ec = queue_.set_latched(p.plane_id, p.crtc_y, static_cast<std::uint64_t>(std::int64_t{y}), input_ns))
+        return ec;
+    ++stats_.moves;
+
+    if (!period_ns_ || !last_vblank_ns_)
+        return latch(); // no grid to aim at: as soon as possible
+    return armed_ ? std::error_code{} : arm(monotonic_ns());
+}
+
+std::error_code CursorLatch::arm(std::uint64_t now_ns)
+{
+    // First vblank of the grid whose latch point is still ahead.
+    const std::uint64_t earliest = now_ns + margin_ns_;
+    std::uint64_t vblank = last_vblank_ns_ + period_ns_;
+    if (earliest >= vblank)
+        vblank += ((earliest - vblank) / period_ns_ + 1) * period_ns_;
+
+    itimerspec spec{};
+    const std::uint64_t at = vblank - margin_ns_;
+    spec.it_value.tv_sec = static_cast<time_t>(at / 1'000'000'000);
+    spec.it_value.tv_nsec = static_cast<long>(at % 1'000'000'000);
+    if (::timerfd_settime(timer_.get(), TFD_TIMER_ABSTIME, &spec, nullptr) != 0)
+        return last_error();
+    armed_ = true;
+    target_vblank_ns_ = vblank;
+    return {};
+}
+
+std::error_code CursorLatch::on_timer()
+{
+    std::uint64_t expirations;
+    if (::read(timer_.get(), &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        return last_error();
+    armed_ = false;
+    return latch();
+}
+
+std::error_code CursorLatch::latch()
+{
+    if (!queue_.has_latched())
+        return {}; // a frame commit took the positions
+    if (queue_.in_flight()) {
+        ++stats_.blocked;
+        // With a grid, aim at the next vblank; without one, on_report()
+        // sends them when the commit in flight completes.
+        return period_ns_ && last_vblank_ns_ ? arm(monotonic_ns()) : std::error_code{};
+    }
+    if (std::error_code ec = queue_.flush_latched())
+        return ec;
+    if (queue_.in_flight()) {
+        ++stats_.latches;
+        pending_target_ns_ = period_ns_ && last_vblank_ns_ ? target_vblank_ns_ : 0;
+    }
+    return {};
+}
+
+void CursorLatch::on_report(const CommitReport& report)
+{
+    if (report.complete_ns)
+        last_vblank_ns_ = report.complete_ns;
+    if (report.latched && report.latched_input_ns && report.complete_ns >= report.latched_input_ns)
+        input_to_photon_.record(report.complete_ns - report.latched_input_ns);
+    if (report.latched && !report.latch_only)
+        ++stats_.merged;
+
+    if (report.latch_only && pending_target_ns_) {
+        ioctl_ns_ = ioctl_ns_ ? (ioctl_ns_ * 7 + report.ioctl_ns) / 8 : report.ioctl_ns;
+        if (report.complete_ns > pending_target_ns_ + period_ns_ / 2) {
+            ++stats_.missed;
+            margin_ns_ += margin_ns_ / 2;
+        } else {
+            margin_ns_ -= margin_ns_ / 16;
+        }
+        const std::uint64_t ceiling = period_ns_ / 2;
+        const std::uint64_t floor = std::min(std::max(kMinMarginNs, 2 * ioctl_ns_), ceiling);
+        margin_ns_ = std::clamp(margin_ns_, floor, ceiling);
+    }
+    pending_target_ns_ = 0;
+
+    // Positions that arrived while the commit was in flight.
+    if (queue_.has_latched() && !armed_) {
+        if (!period_ns_)
+            latch();
+        else
+            arm(monotonic_ns());
+    }
+}
+
+} // namespace dispctrl
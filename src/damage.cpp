@@ -0,0 +1,185 @@
+#include "dispctrl/damage.hpp"
+
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/kms_shadow.hpp"
+
+#include <limits>
+#include <utility>
+
+namespace dispctrl {
+
+namespace {
+
+// Pixels the bounding box of @p a and @p b covers that neither of them does.
+std::uint64_t merge_waste(const Rect& a, const Rect& b) noexcept
+{
+    const std::uint64_t covered = a.area() + b.area() - intersect(a, b).area();
+    return bounding(a, b).area() - covered;
+}
+
+bool worth_merging(const Rect& a, const Rect& b, double max_waste) noexcept
+{
+    return static_cast<double>(merge_waste(a, b)) <= max_waste * static_cast<double>(bounding(a, b).area());
+}
+
+std::int32_t scale_floor(std::int64_t v, std::int64_t num, std::int64_t den) noexcept
+{
+    const std::int64_t p = v * num;
+    return static_cast<std::int32_t>(p >= 0 ? p / den : -((-p + den - 1) / den));
+}
+
+std::int32_t scale_ceil(std::int64_t v, std::int64_t num, std::int64_t den) noexcept
+{
+    const std::int64_t p = v * num;
+    return static_cast<std::int32_t>(p >= 0 ? (p + den - 1) / den : -(-p / den));
+}
+
+} // namespace
+
+void DamageRegion::add(const Rect& rect, const DamagePolicy& policy)
+{
+    if (rect.empty())
+        return;
+
+    // Grow the incoming rectangle by absorbing every neighbour it is worth
+    // merging with, restarting after each merge since the larger box may
+    // now qualify against rectangles that were rejected before.
+    Rect r = rect;
+    for (bool merged = true; merged;) {
+        merged = false;
+        for (std::size_t i = 0; i < rects_.size();) {
+            const Rect& e = rects_[i];
+            if (e.contains(r))
+                return;
+            if (r.contains(e) || worth_merging(e, r, policy.max_waste)) {
+                merged = merged || !r.contains(e);
+                r = bounding(e, r);
+                rects_[i] = rects_.back();
+                rects_.pop_back();
+                continue;
+            }
+            ++i;
+        }
+    }
+    rects_.push_back(r);
+    enforce_limit(policy);
+}
+
+void DamageRegion::enforce_limit(const DamagePolicy& policy)
+{
+    const std::size_t limit = policy.max_rects ? policy.max_rects : 1;
+    while (rects_.size() > limit) {
+        std::size_t best_i = 0;
+        std::size_t best_j = 1;
+        std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+        for (std::size_t i = 0; i < rects_.size(); ++i) {
+            for (std::size_t j = i + 1; j < rects_.size(); ++j) {
+                const std::uint64_t waste = merge_waste(rects_[i], rects_[j]);
+                if (waste < best) {
+                    best = waste;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+        const Rect merged = bounding(rects_[best_i], rects_[best_j]);
+        rects_[best_j] = rects_.back();
+        rects_.pop_back();
+        rects_[best_i] = merged;
+        for (std::size_t k = 0; k < rects_.size();) {
+            if (k != best_i && merged.contains(rects_[k])) {
+                rects_[k] = rects_.back();
+                rects_.pop_back();
+                if (best_i == rects_.size())
+                    best_i = k;
+                continue;
+            }
+            ++k;
+        }
+    }
+}
+
+Rect DamageRegion::bounds() const noexcept
+{
+    Rect box;
+    for (const Rect& r : rects_)
+        box = bounding(box, r);
+    return box;
+}
+
+std::uint64_t DamageRegion::area() const noexcept
+{
+    std::uint64_t total = 0;
+    for (const Rect& r : rects_)
+        total += r.area();
+    return total;
+}
+
+void DamageTracker::add(const Rect& rect)
+{
+    if (full_)
+        return;
+    current_.add(intersect(rect, output_), policy_);
+}
+
+void DamageTracker::add_layer_damage(const Rect& dst, std::int32_t src_w, std::int32_t src_h,
+                                     const Rect& buffer_damage)
+{
+    if (src_w <= 0 || src_h <= 0) {
+        add(dst);
+        return;
+    }
+    const Rect clipped = intersect(buffer_damage, Rect{0, 0, src_w, src_h});
+    if (clipped.empty())
+        return;
+    add({dst.x1 + scale_floor(clipped.x1, dst.width(), src_w), dst.y1 + scale_floor(clipped.y1, dst.height(), src_h),
+         dst.x1 + scale_ceil(clipped.x2, dst.width(), src_w), dst.y1 + scale_ceil(clipped.y2, dst.height(), src_h)});
+}
+
+void DamageTracker::add_layer_change(const Rect& old_dst, const Rect& new_dst)
+{
+    if (old_dst == new_dst) {
+        add(new_dst);
+        return;
+    }
+    add(old_dst);
+    add(new_dst);
+}
+
+const DamageRegion& DamageTracker::end_frame()
+{
+    frame_.clear();
+    if (full_) {
+        frame_.add(output_, policy_);
+        ++stats_.full_frames;
+    } else {
+        std::swap(frame_, current_);
+        if (frame_.empty())
+            ++stats_.idle_frames;
+    }
+    current_.clear();
+    full_ = false;
+
+    ++stats_.frames;
+    stats_.pixels_total += output_.area();
+    stats_.pixels_damaged += std::min(frame_.area(), output_.area());
+    return frame_;
+}
+
+std::error_code set_damage_clips(CommitQueue& queue, std::uint32_t plane_id, std::uint32_t prop_id,
+                                 const DamageRegion& damage)
+{
+    static_assert(sizeof(Rect) == 4 * sizeof(std::int32_t), "Rect must match struct drm_mode_rect");
+    // Clips describe one commit, not state: a commit without them is full
+    // damage, so the shadow must never drop a repeat of the last ones.
+    if (KmsShadow* shadow = queue.shadow())
+        shadow->add_volatile(prop_id);
+    if (damage.empty()) {
+        queue.set(plane_id, prop_id, 0);
+        return {};
+    }
+    const std::span<const Rect> rects = damage.rects();
+    return queue.set_blob(plane_id, prop_id, rects.data(), rects.size_bytes());
+}
+
+} // namespace dispctrl
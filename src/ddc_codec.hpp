@@ -0,0 +1,64 @@
+#pragma once
+
+// DDC/CI message framing (VESA DDC/CI 1.1) for DdcQueue and its
+// transports. Messages are written to and read from I2C slave 0x37; the
+// host calls itself 0x51 in requests, the display 0x6E in replies.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dispctrl::ddc {
+
+inline constexpr int kAddress = 0x37; // 7-bit DDC/CI slave address
+inline constexpr std::uint8_t kHostAddress = 0x51;
+inline constexpr std::uint8_t kRequestSeed = kAddress << 1; // 0x6E, checksum seed of requests
+inline constexpr std::uint8_t kReplySeed = 0x50;            // virtual host address, seed of replies
+
+inline constexpr std::uint8_t kGetVcp = 0x01;
+inline constexpr std::uint8_t kGetVcpReply = 0x02;
+inline constexpr std::uint8_t kSetVcp = 0x03;
+inline constexpr std::uint8_t kCapabilities = 0xf3;
+inline constexpr std::uint8_t kCapabilitiesReply = 0xe3;
+
+/// Longest payload of one message: a capabilities reply fragment.
+inline constexpr std::size_t kMaxPayload = 3 + 32;
+/// Framing around a payload: address, length, checksum.
+inline constexpr std::size_t kOverhead = 3;
+
+/// XOR checksum over the message.
+inline std::uint8_t checksum(std::uint8_t seed, const std::uint8_t* p, std::size_t size) noexcept
+{
+    for (std::size_t i = 0; i < size; ++i)
+        seed ^= p[i];
+    return seed;
+}
+
+/// Frames @p payload (at most kMaxPayload bytes) as a request into @p out,
+/// which holds size + kOverhead bytes; returns the message length.
+inline std::size_t encode(const std::uint8_t* payload, std::size_t size, std::uint8_t* out) noexcept
+{
+    out[0] = kHostAddress;
+    out[1] = static_cast<std::uint8_t>(0x80 | size);
+    for (std::size_t i = 0; i < size; ++i)
+        out[2 + i] = payload[i];
+    out[2 + size] = checksum(kRequestSeed, out, 2 + size);
+    return size + kOverhead;
+}
+
+/// Checks the framing of the reply in @p msg (as read, possibly with
+/// trailing padding) and locates its payload. A zero-length payload is
+/// the null message a busy display answers with.
+inline bool decode(const std::uint8_t* msg, std::size_t len, const std::uint8_t*& payload, std::size_t& size) noexcept
+{
+    if (len < kOverhead || !(msg[1] & 0x80))
+        return false;
+    size = msg[1] & 0x7f;
+    if (size > kMaxPayload || size + kOverhead > len)
+        return false;
+    if (checksum(kReplySeed, msg, 2 + size) != msg[2 + size])
+        return false;
+    payload = msg + 2;
+    return true;
+}
+
+} // namespace dispctrl::ddc
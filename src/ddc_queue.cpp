@@ -0,0 +1,277 @@
+#include "dispctrl/ddc_queue.hpp"
+
+#include "dispctrl/clock.hpp"
+
+#include "ddc_codec.hpp"
+
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <new>
+#include <utility>
+
+namespace dispctrl {
+
+namespace {
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+std::error_code canceled() noexcept
+{
+    return std::make_error_code(std::errc::operation_canceled);
+}
+
+} // namespace
+
+std::unique_ptr<I2cDdcTransport> I2cDdcTransport::open(const std::string& i2c_dev)
+{
+    UniqueFd fd(::open(i2c_dev.c_str(), O_RDWR | O_CLOEXEC));
+    if (!fd)
+        throw std::system_error(last_error(), "open " + i2c_dev);
+    if (::ioctl(fd.get(), I2C_SLAVE, ddc::kAddress) != 0)
+        throw std::system_error(last_error(), "I2C_SLAVE " + i2c_dev);
+    return std::unique_ptr<I2cDdcTransport>(new I2cDdcTransport(std::move(fd)));
+}
+
+std::error_code I2cDdcTransport::write(std::span<const std::uint8_t> msg) noexcept
+{
+    ssize_t ret;
+    do {
+        ret = ::write(fd_.get(), msg.data(), msg.size());
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        return last_error();
+    return static_cast<std::size_t>(ret) == msg.size() ? std::error_code{} : std::make_error_code(std::errc::io_error);
+}
+
+std::error_code I2cDdcTransport::read(std::span<std::uint8_t> msg, std::size_t& len) noexcept
+{
+    ssize_t ret;
+    do {
+        ret = ::read(fd_.get(), msg.data(), msg.size());
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        return last_error();
+    len = static_cast<std::size_t>(ret);
+    return {};
+}
+
+DdcQueue::DdcQueue(DdcTransport& bus, DdcTiming timing) : bus_(bus), timing_(timing)
+{
+    thread_ = std::thread([this] { worker(); });
+}
+
+DdcQueue::~DdcQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void DdcQueue::set_vcp(std::uint8_t code, std::uint16_t value, Callback done)
+{
+    Callback superseded;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Only the last command can take the value: folding it into an
+        // earlier write would move it ahead of whatever was queued since.
+        if (!queue_.empty() && queue_.back().kind == Command::Kind::Set && queue_.back().code == code) {
+            queue_.back().value = value;
+            superseded = std::exchange(queue_.back().done, std::move(done));
+            ++stats_.superseded;
+        } else {
+            queue_.push_back({Command::Kind::Set, code, value, std::move(done)});
+        }
+    }
+    wake_.notify_one();
+    if (superseded)
+        superseded(canceled(), Reply{});
+}
+
+void DdcQueue::get_vcp(std::uint8_t code, Callback done)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back({Command::Kind::Get, code, 0, std::move(done)});
+    }
+    wake_.notify_one();
+}
+
+void DdcQueue::read_capabilities(Callback done)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back({Command::Kind::Capabilities, 0, 0, std::move(done)});
+    }
+    wake_.notify_one();
+}
+
+void DdcQueue::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return stopping_ || (queue_.empty() && !running_); });
+}
+
+std::size_t DdcQueue::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + (running_ ? 1 : 0);
+}
+
+DdcQueue::Stats DdcQueue::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+bool DdcQueue::pause(std::unique_lock<std::mutex>& lock, std::uint64_t until_ns)
+{
+    const std::uint64_t now = monotonic_ns();
+    if (until_ns > now)
+        wake_.wait_for(lock, std::chrono::nanoseconds(until_ns - now), [this] { return stopping_; });
+    return !stopping_;
+}
+
+std::error_code DdcQueue::transact(std::unique_lock<std::mutex>& lock, const std::uint8_t* request, std::size_t size,
+                                   std::uint64_t delay_ns, std::uint8_t* reply, std::size_t& reply_size)
+{
+    std::uint8_t msg[ddc::kMaxPayload + ddc::kOverhead];
+    const std::size_t len = ddc::encode(request, size, msg);
+    std::error_code ec;
+    for (unsigned attempt = 0; attempt <= kMaxRetries; ++attempt) {
+        if (attempt)
+            ++stats_.retries;
+        if (!pause(lock, next_ns_))
+            return canceled();
+
+        // The bus itself is slow too (about 0.1 ms per byte at 100 kHz);
+        // nobody waits on the lock meanwhile.
+        lock.unlock();
+        ec = bus_.write({msg, len});
+        lock.lock();
+        ++stats_.transactions;
+        if (!ec && reply) {
+            if (!pause(lock, monotonic_ns() + delay_ns))
+                return canceled();
+            std::uint8_t in[ddc::kMaxPayload + ddc::kOverhead];
+            std::size_t got = 0;
+            lock.unlock();
+            ec = bus_.read(in, got);
+            lock.lock();
+            const std::uint8_t* payload;
+            std::size_t payload_size;
+            if (!ec && !ddc::decode(in, got, payload, payload_size))
+                ec = std::make_error_code(std::errc::io_error);
+            else if (!ec && payload_size == 0)
+                ec = std::make_error_code(std::errc::device_or_resource_busy); // null message
+            if (!ec) {
+                std::copy_n(payload, payload_size, reply);
+                reply_size = payload_size;
+            }
+        }
+        next_ns_ = monotonic_ns() + timing_.command_interval_ns;
+        if (!ec)
+            return {};
+    }
+    return ec;
+}
+
+std::error_code DdcQueue::execute(std::unique_lock<std::mutex>& lock, const Command& cmd, Reply& reply)
+{
+    std::uint8_t in[ddc::kMaxPayload];
+    std::size_t size = 0;
+    switch (cmd.kind) {
+    case Command::Kind::Set: {
+        const std::uint8_t request[] = {ddc::kSetVcp, cmd.code, static_cast<std::uint8_t>(cmd.value >> 8),
+                                        static_cast<std::uint8_t>(cmd.value)};
+        return transact(lock, request, sizeof(request), 0, nullptr, size);
+    }
+    case Command::Kind::Get: {
+        const std::uint8_t request[] = {ddc::kGetVcp, cmd.code};
+        if (std::error_code ec = transact(lock, request, sizeof(request), timing_.reply_delay_ns, in, size))
+            return ec;
+        // Opcode, result, code, type, max (2), current (2).
+        if (size != 8 || in[0] != ddc::kGetVcpReply || in[2] != cmd.code)
+            return std::make_error_code(std::errc::io_error);
+        if (in[1] != 0)
+            return std::make_error_code(std::errc::not_supported);
+        reply.value.type = in[3];
+        reply.value.max = static_cast<std::uint16_t>(in[4] << 8 | in[5]);
+        reply.value.current = static_cast<std::uint16_t>(in[6] << 8 | in[7]);
+        return {};
+    }
+    case Command::Kind::Capabilities:
+        break;
+    }
+
+    // Fragments of up to 32 bytes at increasing offsets; an empty one ends
+    // the string.
+    std::size_t offset = 0;
+    try {
+        while (reply.capabilities.size() < kMaxCapabilities) {
+            const std::uint8_t request[] = {ddc::kCapabilities, static_cast<std::uint8_t>(offset >> 8),
+                                            static_cast<std::uint8_t>(offset)};
+            if (std::error_code ec =
+                    transact(lock, request, sizeof(request), timing_.capabilities_delay_ns, in, size))
+                return ec;
+            if (size < 3 || in[0] != ddc::kCapabilitiesReply || (in[1] << 8 | in[2]) != static_cast<int>(offset))
+                return std::make_error_code(std::errc::io_error);
+            if (size == 3)
+                break;
+            reply.capabilities.append(reinterpret_cast<const char*>(in + 3), size - 3);
+            offset += size - 3;
+        }
+        // Some monitors NUL-terminate the string.
+        while (!reply.capabilities.empty() && reply.capabilities.back() == '\0')
+            reply.capabilities.pop_back();
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+    return {};
+}
+
+void DdcQueue::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (stopping_)
+            break;
+        Command cmd = std::move(queue_.front());
+        queue_.pop_front();
+        running_ = true;
+
+        Reply reply;
+        const std::error_code ec = execute(lock, cmd, reply);
+        if (ec && ec != std::errc::operation_canceled)
+            ++stats_.errors;
+        lock.unlock();
+        if (cmd.done)
+            cmd.done(ec, reply);
+        lock.lock();
+        running_ = false;
+        if (queue_.empty())
+            idle_.notify_all();
+    }
+
+    std::deque<Command> left = std::move(queue_);
+    queue_.clear();
+    lock.unlock();
+    idle_.notify_all();
+    for (Command& cmd : left)
+        if (cmd.done)
+            cmd.done(canceled(), Reply{});
+}
+
+} // namespace dispctrl
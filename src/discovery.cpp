@@ -0,0 +1,258 @@
+#include "dispctrl/discovery.hpp"
+
+#include "dispctrl/clock.hpp"
+
+#include "drm_uapi.hpp"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace dispctrl {
+
+namespace {
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+// Index is DRM_MODE_CONNECTOR_*; the names the kernel uses in sysfs.
+constexpr const char* kConnectorNames[] = {
+    "Unknown", "VGA", "DVI-I", "DVI-D", "DVI-A", "Composite", "SVIDEO", "LVDS", "Component", "DIN",
+    "DP", "HDMI-A", "HDMI-B", "TV", "eDP", "Virtual", "DSI", "DPI", "Writeback", "SPI", "USB",
+};
+
+std::string connector_name(std::uint32_t type, std::uint32_t type_id)
+{
+    const char* base = type < std::size(kConnectorNames) ? kConnectorNames[type] : "Unknown";
+    return std::string(base) + "-" + std::to_string(type_id);
+}
+
+ModeInfo to_mode(const uapi::drm_mode_modeinfo& m) noexcept
+{
+    ModeInfo mode;
+    mode.clock_khz = m.clock;
+    mode.hdisplay = m.hdisplay;
+    mode.hsync_start = m.hsync_start;
+    mode.hsync_end = m.hsync_end;
+    mode.htotal = m.htotal;
+    mode.vdisplay = m.vdisplay;
+    mode.vsync_start = m.vsync_start;
+    mode.vsync_end = m.vsync_end;
+    mode.vtotal = m.vtotal;
+    mode.flags = m.flags & (ModeInfo::PHSync | ModeInfo::NHSync | ModeInfo::PVSync | ModeInfo::NVSync | ModeInfo::Interlace);
+    mode.preferred = (m.type & uapi::DRM_MODE_TYPE_PREFERRED) != 0;
+    return mode;
+}
+
+} // namespace
+
+std::error_code get_card_resources(const DrmDevice& device, CardResources& out)
+{
+    try {
+        uapi::drm_mode_card_res res{};
+        // The counts can change between the two calls (MST hotplug); retry
+        // until the second call fits.
+        for (;;) {
+            if (uapi::drm_ioctl(device.fd(), uapi::DRM_IOCTL_MODE_GETRESOURCES, &res) != 0)
+                return last_error();
+            out.crtcs.resize(res.count_crtcs);
+            out.connectors.resize(res.count_connectors);
+            out.encoders.resize(res.count_encoders);
+            res.fb_id_ptr = 0;
+            res.count_fbs = 0;
+            res.crtc_id_ptr = uapi::to_user_ptr(out.crtcs.data());
+            res.connector_id_ptr = uapi::to_user_ptr(out.connectors.data());
+            res.encoder_id_ptr = uapi::to_user_ptr(out.encoders.data());
+            if (uapi::drm_ioctl(device.fd(), uapi::DRM_IOCTL_MODE_GETRESOURCES, &res) != 0)
+                return last_error();
+            if (res.count_crtcs <= out.crtcs.size() && res.count_connectors <= out.connectors.size() &&
+                res.count_encoders <= out.encoders.size())
+                break;
+        }
+        out.crtcs.resize(res.count_crtcs);
+        out.connectors.resize(res.count_connectors);
+        out.encoders.resize(res.count_encoders);
+        return {};
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+}
+
+std::error_code probe_connector(const DrmDevice& device, std::uint32_t connector_id, bool force,
+                                EdidCache* edids, ConnectorInfo& out)
+{
+    const int fd = device.fd();
+    try {
+        // A zero mode count makes the kernel re-detect the output (and
+        // re-read its EDID); any other count returns its cached state.
+        std::vector<uapi::drm_mode_modeinfo> modes(force ? 0 : 1);
+        std::vector<std::uint32_t> encoders;
+        uapi::drm_mode_get_connector req{};
+        for (;;) {
+            req = {};
+            req.connector_id = connector_id;
+            req.count_modes = static_cast<std::uint32_t>(modes.size());
+            req.modes_ptr = uapi::to_user_ptr(modes.data());
+            req.count_encoders = static_cast<std::uint32_t>(encoders.size());
+            req.encoders_ptr = uapi::to_user_ptr(encoders.data());
+            if (uapi::drm_ioctl(fd, uapi::DRM_IOCTL_MODE_GETCONNECTOR, &req) != 0)
+                return last_error();
+
+            const bool unknown =
+                req.connection != uapi::DRM_MODE_CONNECTED && req.connection != uapi::DRM_MODE_DISCONNECTED;
+            const bool no_modes = req.connection == uapi::DRM_MODE_CONNECTED && req.count_modes == 0;
+            if (!force && (unknown || no_modes)) {
+                force = true;
+                modes.clear();
+                continue;
+            }
+            if (req.count_modes <= modes.size() && req.count_encoders <= encoders.size() && !modes.empty())
+                break;
+            // Keep at least one mode slot so the next call does not probe.
+            modes.resize(std::max<std::size_t>(req.count_modes, 1));
+            encoders.resize(req.count_encoders);
+        }
+
+        ConnectorInfo info;
+        info.connector_id = connector_id;
+        info.type = req.connector_type;
+        info.type_id = req.connector_type_id;
+        info.name = connector_name(req.connector_type, req.connector_type_id);
+        info.status = req.connection == uapi::DRM_MODE_CONNECTED      ? ConnectorInfo::Status::Connected
+                      : req.connection == uapi::DRM_MODE_DISCONNECTED ? ConnectorInfo::Status::Disconnected
+                                                                      : ConnectorInfo::Status::Unknown;
+        info.width_mm = req.mm_width;
+        info.height_mm = req.mm_height;
+        for (std::uint32_t i = 0; i < req.count_modes; ++i)
+            info.modes.push_back(to_mode(modes[i]));
+        std::stable_partition(info.modes.begin(), info.modes.end(), [](const ModeInfo& m) { return m.preferred; });
+
+        for (std::uint32_t i = 0; i < req.count_encoders; ++i) {
+            uapi::drm_mode_get_encoder enc{};
+            enc.encoder_id = encoders[i];
+            if (uapi::drm_ioctl(fd, uapi::DRM_IOCTL_MODE_GETENCODER, &enc) == 0)
+                info.possible_crtcs |= enc.possible_crtcs;
+        }
+
+        std::uint32_t edid_prop;
+        std::uint64_t edid_blob = 0;
+        std::vector<std::uint8_t> blob;
+        if (info.connected() &&
+            !device.get_property(connector_id, ObjectType::Connector, "EDID", edid_prop, edid_blob) && edid_blob &&
+            !device.read_blob(static_cast<std::uint32_t>(edid_blob), blob)) {
+            std::shared_ptr<const DisplayInfo> display;
+            if (edids) {
+                if (!edids->lookup(blob, display))
+                    info.display = std::move(display);
+            } else if (auto decoded = std::make_shared<DisplayInfo>(); !parse_display_info(blob, *decoded)) {
+                info.display = std::move(decoded);
+            }
+        }
+        out = std::move(info);
+        return {};
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+}
+
+std::vector<std::string> find_card_nodes(const std::string& dir)
+{
+    std::vector<std::pair<unsigned long, std::string>> found;
+    if (DIR* d = ::opendir(dir.c_str())) {
+        while (const dirent* e = ::readdir(d)) {
+            const char* name = e->d_name;
+            if (std::strncmp(name, "card", 4) != 0 || name[4] < '0' || name[4] > '9')
+                continue;
+            char* end;
+            const unsigned long n = std::strtoul(name + 4, &end, 10);
+            if (*end == '\0')
+                found.emplace_back(n, dir + "/" + name);
+        }
+        ::closedir(d);
+    }
+    std::sort(found.begin(), found.end());
+    std::vector<std::string> paths;
+    for (auto& f : found)
+        paths.push_back(std::move(f.second));
+    return paths;
+}
+
+DeviceDiscovery::DeviceDiscovery(EdidCache& edids, ConnectorCallback callback, bool force_probe)
+    : edids_(edids), callback_(std::move(callback)), force_(force_probe)
+{
+}
+
+DeviceDiscovery::~DeviceDiscovery()
+{
+    for (std::thread& t : threads_)
+        t.join();
+}
+
+void DeviceDiscovery::start(const std::vector<std::string>& paths)
+{
+    for (const std::string& path : paths) {
+        auto card = std::make_unique<ProbedCard>();
+        card->path = path;
+        ProbedCard* raw = card.get();
+        cards_.push_back(std::move(card));
+        threads_.emplace_back([this, raw] { probe(*raw); });
+    }
+}
+
+std::vector<ProbedCard> DeviceDiscovery::wait()
+{
+    for (std::thread& t : threads_)
+        t.join();
+    threads_.clear();
+    std::vector<ProbedCard> results;
+    results.reserve(cards_.size());
+    for (std::unique_ptr<ProbedCard>& card : cards_)
+        results.push_back(std::move(*card));
+    cards_.clear();
+    return results;
+}
+
+void DeviceDiscovery::probe(ProbedCard& card) noexcept
+{
+    // Runs on its own thread: anything escaping would terminate the
+    // process, so every failure ends up in card.error.
+    const std::uint64_t start = monotonic_ns();
+    std::error_code failure;
+    try {
+        card.device = DrmDevice::open(card.path);
+        if ((card.error = get_card_resources(*card.device, card.resources)))
+            return;
+
+        // Reserved up front: callbacks keep references into the vector.
+        card.connectors.reserve(card.resources.connectors.size());
+        for (std::uint32_t id : card.resources.connectors) {
+            ConnectorInfo info;
+            if (std::error_code ec = probe_connector(*card.device, id, force_, &edids_, info)) {
+                if (!card.error)
+                    card.error = ec;
+                continue;
+            }
+            card.connectors.push_back(std::move(info));
+            if (callback_)
+                callback_(card, card.connectors.back());
+        }
+        card.probe_ns = monotonic_ns() - start;
+        return;
+    } catch (const std::system_error& e) {
+        failure = e.code();
+    } catch (const std::bad_alloc&) {
+        failure = std::make_error_code(std::errc::not_enough_memory);
+    } catch (...) {
+        failure = std::make_error_code(std::errc::operation_canceled);
+    }
+    if (!card.error)
+        card.error = failure;
+}
+
+} // namespace dispctrl
@@ -0,0 +1,302 @@
+#include "dispctrl/kms_device.hpp"
+
+#include "dispctrl/format.hpp"
+
+#include "drm_uapi.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+namespace dispctrl {
+
+namespace {
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+bool get_cap(int fd, std::uint64_t cap, std::uint64_t& value) noexcept
+{
+    uapi::drm_get_cap req{};
+    req.capability = cap;
+    if (uapi::drm_ioctl(fd, uapi::DRM_IOCTL_GET_CAP, &req) != 0)
+        return false;
+    value = req.value;
+    return true;
+}
+
+bool set_client_cap(int fd, std::uint64_t cap, std::uint64_t value) noexcept
+{
+    uapi::drm_set_client_cap req{};
+    req.capability = cap;
+    req.value = value;
+    return uapi::drm_ioctl(fd, uapi::DRM_IOCTL_SET_CLIENT_CAP, &req) == 0;
+}
+
+std::uint64_t to_ns(std::uint32_t sec, std::uint32_t usec) noexcept
+{
+    return static_cast<std::uint64_t>(sec) * 1'000'000'000ULL +
+           static_cast<std::uint64_t>(usec) * 1'000ULL;
+}
+
+} // namespace
+
+std::error_code read_kms_events(int fd, std::span<KmsEvent> out, std::size_t& count) noexcept
+{
+    count = 0;
+    if (out.size() < kMaxEventsPerRead)
+        return std::make_error_code(std::errc::invalid_argument);
+
+    // The kernel only returns whole events, so a buffer of kMaxEventsPerRead
+    // vblank-sized records can never produce more entries than @p out holds.
+    alignas(8) unsigned char buf[kMaxEventsPerRead * sizeof(uapi::drm_event_vblank)];
+    ssize_t len;
+    do {
+        len = ::read(fd, buf, sizeof(buf));
+    } while (len < 0 && errno == EINTR);
+    if (len < 0)
+        return errno == EAGAIN ? std::error_code{} : last_error();
+
+    std::size_t offset = 0;
+    while (offset + sizeof(uapi::drm_event) <= static_cast<std::size_t>(len)) {
+        uapi::drm_event header;
+        std::memcpy(&header, buf + offset, sizeof(header));
+        if (header.length < sizeof(header) || offset + header.length > static_cast<std::size_t>(len))
+            break;
+
+        if ((header.type == uapi::DRM_EVENT_VBLANK || header.type == uapi::DRM_EVENT_FLIP_COMPLETE) &&
+            header.length >= sizeof(uapi::drm_event_vblank)) {
+            uapi::drm_event_vblank ev;
+            std::memcpy(&ev, buf + offset, sizeof(ev));
+            KmsEvent& e = out[count++];
+            e.type = header.type == uapi::DRM_EVENT_VBLANK ? KmsEvent::Type::Vblank
+                                                           : KmsEvent::Type::FlipComplete;
+            e.crtc_id = ev.crtc_id;
+            e.sequence = ev.sequence;
+            e.timestamp_ns = to_ns(ev.tv_sec, ev.tv_usec);
+            e.user_data = ev.user_data;
+        } else if (header.type == uapi::DRM_EVENT_CRTC_SEQUENCE &&
+                   header.length >= sizeof(uapi::drm_event_crtc_sequence)) {
+            uapi::drm_event_crtc_sequence ev;
+            std::memcpy(&ev, buf + offset, sizeof(ev));
+            KmsEvent& e = out[count++];
+            e.type = KmsEvent::Type::Vblank;
+            e.sequence = static_cast<std::uint32_t>(ev.sequence);
+            e.timestamp_ns = static_cast<std::uint64_t>(ev.time_ns);
+            e.user_data = ev.user_data;
+        }
+        offset += header.length;
+    }
+    return {};
+}
+
+std::unique_ptr<DrmDevice> DrmDevice::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0)
+        throw std::system_error(last_error(), "open " + path);
+    return std::make_unique<DrmDevice>(UniqueFd(fd));
+}
+
+DrmDevice::DrmDevice(UniqueFd fd) : fd_(std::move(fd))
+{
+    std::uint64_t prime = 0;
+    if (!get_cap(fd_.get(), uapi::DRM_CAP_PRIME, prime) || !(prime & uapi::DRM_PRIME_CAP_IMPORT))
+        throw std::system_error(std::make_error_code(std::errc::not_supported),
+                                "DRM device cannot import DMA-BUFs");
+    prime_export_ = (prime & uapi::DRM_PRIME_CAP_EXPORT) != 0;
+
+    std::uint64_t value = 0;
+    modifiers_ = get_cap(fd_.get(), uapi::DRM_CAP_ADDFB2_MODIFIERS, value) && value;
+
+    // Universal planes must be enabled before atomic; both are optional so
+    // the legacy flip path keeps working on older drivers.
+    set_client_cap(fd_.get(), uapi::DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
+    atomic_ = set_client_cap(fd_.get(), uapi::DRM_CLIENT_CAP_ATOMIC, 1);
+}
+
+bool DrmDevice::enable_writeback() noexcept
+{
+    return atomic_ && set_client_cap(fd_.get(), uapi::DRM_CLIENT_CAP_WRITEBACK_CONNECTORS, 1);
+}
+
+std::error_code DrmDevice::import_dmabuf(int dmabuf_fd, std::uint32_t& handle) noexcept
+{
+    uapi::drm_prime_handle req{};
+    req.fd = dmabuf_fd;
+    if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_PRIME_FD_TO_HANDLE, &req) != 0)
+        return last_error();
+    handle = req.handle;
+    return {};
+}
+
+void DrmDevice::close_handle(std::uint32_t handle) noexcept
+{
+    uapi::drm_gem_close req{};
+    req.handle = handle;
+    uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_GEM_CLOSE, &req);
+}
+
+std::error_code DrmDevice::add_framebuffer(const FramebufferLayout& layout,
+                                           std::uint32_t& fb_id) noexcept
+{
+    if (layout.plane_count == 0 || layout.plane_count > 4)
+        return std::make_error_code(std::errc::invalid_argument);
+
+    uapi::drm_mode_fb_cmd2 req{};
+    req.width = layout.width;
+    req.height = layout.height;
+    req.pixel_format = layout.fourcc;
+    // modifier::Invalid means "implicit layout": no modifier is passed and
+    // the driver infers tiling from the buffer object itself.
+    const bool explicit_modifier = layout.modifier != modifier::Invalid;
+    if (explicit_modifier && !modifiers_ && layout.modifier != modifier::Linear)
+        return std::make_error_code(std::errc::not_supported);
+    if (explicit_modifier && modifiers_)
+        req.flags = uapi::DRM_MODE_FB_MODIFIERS;
+
+    for (std::uint32_t i = 0; i < layout.plane_count; ++i) {
+        req.handles[i] = layout.handles[i];
+        req.pitches[i] = layout.pitches[i];
+        req.offsets[i] = layout.offsets[i];
+        if (req.flags & uapi::DRM_MODE_FB_MODIFIERS)
+            req.modifier[i] = layout.modifier;
+    }
+
+    if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_ADDFB2, &req) != 0)
+        return last_error();
+    fb_id = req.fb_id;
+    return {};
+}
+
+void DrmDevice::remove_framebuffer(std::uint32_t fb_id) noexcept
+{
+    unsigned int id = fb_id;
+    uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_RMFB, &id);
+}
+
+std::error_code DrmDevice::page_flip(std::uint32_t crtc_id, std::uint32_t fb_id,
+                                     std::uint64_t user_data) noexcept
+{
+    uapi::drm_mode_crtc_page_flip req{};
+    req.crtc_id = crtc_id;
+    req.fb_id = fb_id;
+    req.flags = uapi::DRM_MODE_PAGE_FLIP_EVENT;
+    req.user_data = user_data;
+    if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_PAGE_FLIP, &req) != 0)
+        return last_error();
+    return {};
+}
+
+std::error_code DrmDevice::atomic_commit(const AtomicRequest& request, std::uint32_t flags,
+                                         std::uint64_t user_data) noexcept
+{
+    if (!atomic_)
+        return std::make_error_code(std::errc::not_supported);
+
+    const auto objects = request.objects();
+    uapi::drm_mode_atomic req{};
+    req.flags = flags;
+    req.count_objs = static_cast<std::uint32_t>(objects.size());
+    req.objs_ptr = uapi::to_user_ptr(objects.data());
+    req.count_props_ptr = uapi::to_user_ptr(request.prop_counts().data());
+    req.props_ptr = uapi::to_user_ptr(request.props().data());
+    req.prop_values_ptr = uapi::to_user_ptr(request.values().data());
+    req.user_data = user_data;
+    if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_ATOMIC, &req) != 0)
+        return last_error();
+    return {};
+}
+
+std::error_code DrmDevice::find_property(std::uint32_t object_id, ObjectType type,
+                                         std::string_view name, std::uint32_t& prop_id) noexcept
+{
+    std::uint64_t value;
+    return get_property(object_id, type, name, prop_id, value);
+}
+
+std::error_code DrmDevice::get_property(std::uint32_t object_id, ObjectType type, std::string_view name,
+                                        std::uint32_t& prop_id, std::uint64_t& value) const noexcept
+{
+    try {
+        uapi::drm_mode_obj_get_properties req{};
+        req.obj_id = object_id;
+        req.obj_type = static_cast<std::uint32_t>(type);
+        if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_OBJ_GETPROPERTIES, &req) != 0)
+            return last_error();
+
+        std::vector<std::uint32_t> ids(req.count_props);
+        std::vector<std::uint64_t> values(req.count_props);
+        req.props_ptr = uapi::to_user_ptr(ids.data());
+        req.prop_values_ptr = uapi::to_user_ptr(values.data());
+        if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_OBJ_GETPROPERTIES, &req) != 0)
+            return last_error();
+
+        for (std::uint32_t i = 0; i < req.count_props && i < ids.size(); ++i) {
+            uapi::drm_mode_get_property prop{};
+            prop.prop_id = ids[i];
+            if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_GETPROPERTY, &prop) != 0)
+                continue;
+            if (name == std::string_view(prop.name, ::strnlen(prop.name, sizeof(prop.name)))) {
+                prop_id = ids[i];
+                value = values[i];
+                return {};
+            }
+        }
+        return std::make_error_code(std::errc::no_such_file_or_directory);
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+}
+
+std::error_code DrmDevice::read_blob(std::uint32_t blob_id, std::vector<std::uint8_t>& out) const noexcept
+{
+    try {
+        uapi::drm_mode_get_blob req{};
+        req.blob_id = blob_id;
+        if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_GETPROPBLOB, &req) != 0)
+            return last_error();
+        out.resize(req.length);
+        req.data = uapi::to_user_ptr(out.data());
+        if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_GETPROPBLOB, &req) != 0)
+            return last_error();
+        return {};
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+}
+
+std::error_code DrmDevice::export_dmabuf(std::uint32_t handle, int& dmabuf_fd) const noexcept
+{
+    uapi::drm_prime_handle req{};
+    req.handle = handle;
+    req.flags = uapi::DRM_CLOEXEC | uapi::DRM_RDWR;
+    if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_PRIME_HANDLE_TO_FD, &req) != 0)
+        return last_error();
+    dmabuf_fd = req.fd;
+    return {};
+}
+
+std::error_code DrmDevice::create_blob(const void* data, std::size_t size, std::uint32_t& blob_id) noexcept
+{
+    uapi::drm_mode_create_blob req{};
+    req.data = uapi::to_user_ptr(data);
+    req.length = static_cast<std::uint32_t>(size);
+    if (uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_CREATEPROPBLOB, &req) != 0)
+        return last_error();
+    blob_id = req.blob_id;
+    return {};
+}
+
+void DrmDevice::destroy_blob(std::uint32_t blob_id) noexcept
+{
+    uapi::drm_mode_destroy_blob req{};
+    req.blob_id = blob_id;
+    uapi::drm_ioctl(fd_.get(), uapi::DRM_IOCTL_MODE_DESTROYPROPBLOB, &req);
+}
+
+} // namespace dispctrl
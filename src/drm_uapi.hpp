@@ -0,0 +1,277 @@
+#pragma once
+
+// Minimal mirror of the kernel DRM UAPI (include/uapi/drm/drm.h and
+// drm_mode.h). DispCtrl talks to the kernel directly instead of through
+// libdrm; the layouts below are stable kernel ABI and must not be changed.
+
+#include <linux/ioctl.h>
+#include <sys/ioctl.h>
+
+#include <cerrno>
+#include <cstdint>
+
+namespace dispctrl::uapi {
+
+struct drm_gem_close {
+    std::uint32_t handle;
+    std::uint32_t pad;
+};
+
+struct drm_get_cap {
+    std::uint64_t capability;
+    std::uint64_t value;
+};
+
+struct drm_set_client_cap {
+    std::uint64_t capability;
+    std::uint64_t value;
+};
+
+struct drm_prime_handle {
+    std::uint32_t handle;
+    std::uint32_t flags;
+    std::int32_t fd;
+};
+
+struct drm_mode_fb_cmd2 {
+    std::uint32_t fb_id;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t pixel_format;
+    std::uint32_t flags;
+    std::uint32_t handles[4];
+    std::uint32_t pitches[4];
+    std::uint32_t offsets[4];
+    std::uint64_t modifier[4];
+};
+
+struct drm_mode_crtc_page_flip {
+    std::uint32_t crtc_id;
+    std::uint32_t fb_id;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+    std::uint64_t user_data;
+};
+
+struct drm_mode_card_res {
+    std::uint64_t fb_id_ptr;
+    std::uint64_t crtc_id_ptr;
+    std::uint64_t connector_id_ptr;
+    std::uint64_t encoder_id_ptr;
+    std::uint32_t count_fbs;
+    std::uint32_t count_crtcs;
+    std::uint32_t count_connectors;
+    std::uint32_t count_encoders;
+    std::uint32_t min_width;
+    std::uint32_t max_width;
+    std::uint32_t min_height;
+    std::uint32_t max_height;
+};
+
+struct drm_mode_modeinfo {
+    std::uint32_t clock;
+    std::uint16_t hdisplay;
+    std::uint16_t hsync_start;
+    std::uint16_t hsync_end;
+    std::uint16_t htotal;
+    std::uint16_t hskew;
+    std::uint16_t vdisplay;
+    std::uint16_t vsync_start;
+    std::uint16_t vsync_end;
+    std::uint16_t vtotal;
+    std::uint16_t vscan;
+    std::uint32_t vrefresh;
+    std::uint32_t flags;
+    std::uint32_t type;
+    char name[32];
+};
+
+struct drm_mode_get_encoder {
+    std::uint32_t encoder_id;
+    std::uint32_t encoder_type;
+    std::uint32_t crtc_id;
+    std::uint32_t possible_crtcs;
+    std::uint32_t possible_clones;
+};
+
+struct drm_mode_get_connector {
+    std::uint64_t encoders_ptr;
+    std::uint64_t modes_ptr;
+    std::uint64_t props_ptr;
+    std::uint64_t prop_values_ptr;
+    std::uint32_t count_modes;
+    std::uint32_t count_props;
+    std::uint32_t count_encoders;
+    std::uint32_t encoder_id;
+    std::uint32_t connector_id;
+    std::uint32_t connector_type;
+    std::uint32_t connector_type_id;
+    std::uint32_t connection;
+    std::uint32_t mm_width;
+    std::uint32_t mm_height;
+    std::uint32_t subpixel;
+    std::uint32_t pad;
+};
+
+struct drm_mode_get_blob {
+    std::uint32_t blob_id;
+    std::uint32_t length;
+    std::uint64_t data;
+};
+
+struct drm_mode_get_plane {
+    std::uint32_t plane_id;
+    std::uint32_t crtc_id;
+    std::uint32_t fb_id;
+    std::uint32_t possible_crtcs;
+    std::uint32_t gamma_size;
+    std::uint32_t count_format_types;
+    std::uint64_t format_type_ptr;
+};
+
+/// Header of an IN_FORMATS blob; offsets are from its start.
+struct drm_format_modifier_blob {
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint32_t count_formats;
+    std::uint32_t formats_offset;
+    std::uint32_t count_modifiers;
+    std::uint32_t modifiers_offset;
+};
+
+/// Bit i of formats covers the format at index offset + i.
+struct drm_format_modifier {
+    std::uint64_t formats;
+    std::uint32_t offset;
+    std::uint32_t pad;
+    std::uint64_t modifier;
+};
+
+struct drm_mode_obj_get_properties {
+    std::uint64_t props_ptr;
+    std::uint64_t prop_values_ptr;
+    std::uint32_t count_props;
+    std::uint32_t obj_id;
+    std::uint32_t obj_type;
+};
+
+struct drm_mode_get_property {
+    std::uint64_t values_ptr;
+    std::uint64_t enum_blob_ptr;
+    std::uint32_t prop_id;
+    std::uint32_t flags;
+    char name[32];
+    std::uint32_t count_values;
+    std::uint32_t count_enum_blobs;
+};
+
+struct drm_mode_atomic {
+    std::uint32_t flags;
+    std::uint32_t count_objs;
+    std::uint64_t objs_ptr;
+    std::uint64_t count_props_ptr;
+    std::uint64_t props_ptr;
+    std::uint64_t prop_values_ptr;
+    std::uint64_t reserved;
+    std::uint64_t user_data;
+};
+
+struct drm_mode_create_blob {
+    std::uint64_t data;
+    std::uint32_t length;
+    std::uint32_t blob_id;
+};
+
+struct drm_mode_destroy_blob {
+    std::uint32_t blob_id;
+};
+
+struct drm_event {
+    std::uint32_t type;
+    std::uint32_t length;
+};
+
+struct drm_event_vblank {
+    drm_event base;
+    std::uint64_t user_data;
+    std::uint32_t tv_sec;
+    std::uint32_t tv_usec;
+    std::uint32_t sequence;
+    std::uint32_t crtc_id;
+};
+
+struct drm_event_crtc_sequence {
+    drm_event base;
+    std::uint64_t user_data;
+    std::int64_t time_ns;
+    std::uint64_t sequence;
+};
+
+inline constexpr unsigned kIoctlBase = 'd';
+
+inline constexpr unsigned long DRM_IOCTL_GEM_CLOSE = _IOW(kIoctlBase, 0x09, drm_gem_close);
+inline constexpr unsigned long DRM_IOCTL_GET_CAP = _IOWR(kIoctlBase, 0x0c, drm_get_cap);
+inline constexpr unsigned long DRM_IOCTL_SET_CLIENT_CAP = _IOW(kIoctlBase, 0x0d, drm_set_client_cap);
+inline constexpr unsigned long DRM_IOCTL_PRIME_HANDLE_TO_FD = _IOWR(kIoctlBase, 0x2d, drm_prime_handle);
+inline constexpr unsigned long DRM_IOCTL_PRIME_FD_TO_HANDLE = _IOWR(kIoctlBase, 0x2e, drm_prime_handle);
+inline constexpr unsigned long DRM_IOCTL_MODE_GETRESOURCES = _IOWR(kIoctlBase, 0xA0, drm_mode_card_res);
+inline constexpr unsigned long DRM_IOCTL_MODE_GETENCODER = _IOWR(kIoctlBase, 0xA6, drm_mode_get_encoder);
+inline constexpr unsigned long DRM_IOCTL_MODE_GETCONNECTOR = _IOWR(kIoctlBase, 0xA7, drm_mode_get_connector);
+inline constexpr unsigned long DRM_IOCTL_MODE_GETPROPERTY = _IOWR(kIoctlBase, 0xAA, drm_mode_get_property);
+inline constexpr unsigned long DRM_IOCTL_MODE_GETPROPBLOB = _IOWR(kIoctlBase, 0xAC, drm_mode_get_blob);
+inline constexpr unsigned long DRM_IOCTL_MODE_RMFB = _IOWR(kIoctlBase, 0xAF, unsigned int);
+inline constexpr unsigned long DRM_IOCTL_MODE_PAGE_FLIP = _IOWR(kIoctlBase, 0xB0, drm_mode_crtc_page_flip);
+inline constexpr unsigned long DRM_IOCTL_MODE_GETPLANE = _IOWR(kIoctlBase, 0xB6, drm_mode_get_plane);
+inline constexpr unsigned long DRM_IOCTL_MODE_ADDFB2 = _IOWR(kIoctlBase, 0xB8, drm_mode_fb_cmd2);
+inline constexpr unsigned long DRM_IOCTL_MODE_OBJ_GETPROPERTIES =
+    _IOWR(kIoctlBase, 0xB9, drm_mode_obj_get_properties);
+inline constexpr unsigned long DRM_IOCTL_MODE_ATOMIC = _IOWR(kIoctlBase, 0xBC, drm_mode_atomic);
+inline constexpr unsigned long DRM_IOCTL_MODE_CREATEPROPBLOB = _IOWR(kIoctlBase, 0xBD, drm_mode_create_blob);
+inline constexpr unsigned long DRM_IOCTL_MODE_DESTROYPROPBLOB = _IOWR(kIoctlBase, 0xBE, drm_mode_destroy_blob);
+
+inline constexpr std::uint64_t DRM_CAP_PRIME = 0x5;
+inline constexpr std::uint64_t DRM_CAP_TIMESTAMP_MONOTONIC = 0x6;
+inline constexpr std::uint64_t DRM_CAP_ADDFB2_MODIFIERS = 0x10;
+inline constexpr std::uint64_t DRM_CAP_CRTC_IN_VBLANK_EVENT = 0x12;
+inline constexpr std::uint64_t DRM_PRIME_CAP_IMPORT = 0x1;
+inline constexpr std::uint64_t DRM_PRIME_CAP_EXPORT = 0x2;
+
+inline constexpr std::uint32_t DRM_CLOEXEC = 02000000; // O_CLOEXEC
+inline constexpr std::uint32_t DRM_RDWR = 02;          // O_RDWR
+
+inline constexpr std::uint64_t DRM_CLIENT_CAP_UNIVERSAL_PLANES = 2;
+inline constexpr std::uint64_t DRM_CLIENT_CAP_ATOMIC = 3;
+inline constexpr std::uint64_t DRM_CLIENT_CAP_WRITEBACK_CONNECTORS = 5;
+
+inline constexpr std::uint32_t DRM_MODE_TYPE_PREFERRED = 1u << 3;
+inline constexpr std::uint32_t DRM_MODE_CONNECTED = 1;
+inline constexpr std::uint32_t DRM_MODE_DISCONNECTED = 2;
+
+inline constexpr std::uint32_t DRM_MODE_FB_MODIFIERS = 1u << 1;
+inline constexpr std::uint32_t DRM_MODE_PAGE_FLIP_EVENT = 0x01;
+
+inline constexpr std::uint32_t DRM_MODE_ATOMIC_TEST_ONLY = 0x0100;
+inline constexpr std::uint32_t DRM_MODE_ATOMIC_NONBLOCK = 0x0200;
+inline constexpr std::uint32_t DRM_MODE_ATOMIC_ALLOW_MODESET = 0x0400;
+
+inline constexpr std::uint32_t DRM_EVENT_VBLANK = 0x01;
+inline constexpr std::uint32_t DRM_EVENT_FLIP_COMPLETE = 0x02;
+inline constexpr std::uint32_t DRM_EVENT_CRTC_SEQUENCE = 0x03;
+
+/// ioctl() that restarts on EINTR/EAGAIN, like libdrm's drmIoctl().
+inline int drm_ioctl(int fd, unsigned long request, void* arg) noexcept
+{
+    int ret;
+    do {
+        ret = ::ioctl(fd, request, arg);
+    } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+    return ret;
+}
+
+template <typename T>
+inline std::uint64_t to_user_ptr(T* ptr) noexcept
+{
+    return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(ptr));
+}
+
+} // namespace dispctrl::uapi
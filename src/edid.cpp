@@ -0,0 +1,377 @@
+#include "dispctrl/edid.hpp"
+
+#include "dispctrl/hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr std::size_t kBlockSize = 128;
+constexpr std::uint8_t kEdidHeader[8] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+
+constexpr std::uint8_t kExtCta = 0x02;
+constexpr std::uint8_t kExtDisplayId = 0x70;
+
+constexpr std::uint8_t kDescName = 0xfc;
+constexpr std::uint8_t kDescRangeLimits = 0xfd;
+
+constexpr std::uint8_t kCtaVideoBlock = 2;
+
+constexpr std::uint8_t kDidTypeI = 0x03;
+constexpr std::uint8_t kDidTypeVII = 0x22;
+
+constexpr std::uint32_t kPP = ModeInfo::PHSync | ModeInfo::PVSync;
+constexpr std::uint32_t kNN = ModeInfo::NHSync | ModeInfo::NVSync;
+constexpr std::uint32_t kPPi = kPP | ModeInfo::Interlace;
+
+struct Vic {
+    std::uint8_t vic;
+    ModeInfo mode;
+};
+
+// The CTA-861 formats seen on signage and video-wall panels, including the
+// film and PAL rates (24/25/30/50 Hz) that must not be approximated.
+const Vic kVics[] = {
+    {1, {25175, 640, 656, 752, 800, 480, 490, 492, 525, kNN}},
+    {2, {27000, 720, 736, 798, 858, 480, 489, 495, 525, kNN}},
+    {3, {27000, 720, 736, 798, 858, 480, 489, 495, 525, kNN}},
+    {4, {74250, 1280, 1390, 1430, 1650, 720, 725, 730, 750, kPP}},
+    {5, {74250, 1920, 2008, 2052, 2200, 1080, 1084, 1094, 1125, kPPi}},
+    {16, {148500, 1920, 2008, 2052, 2200, 1080, 1084, 1089, 1125, kPP}},
+    {17, {27000, 720, 732, 796, 864, 576, 581, 586, 625, kNN}},
+    {18, {27000, 720, 732, 796, 864, 576, 581, 586, 625, kNN}},
+    {19, {74250, 1280, 1720, 1760, 1980, 720, 725, 730, 750, kPP}},
+    {20, {74250, 1920, 2448, 2492, 2640, 1080, 1084, 1094, 1125, kPPi}},
+    {31, {148500, 1920, 2448, 2492, 2640, 1080, 1084, 1089, 1125, kPP}},
+    {32, {74250, 1920, 2558, 2602, 2750, 1080, 1084, 1089, 1125, kPP}},
+    {33, {74250, 1920, 2448, 2492, 2640, 1080, 1084, 1089, 1125, kPP}},
+    {34, {74250, 1920, 2008, 2052, 2200, 1080, 1084, 1089, 1125, kPP}},
+    {63, {297000, 1920, 2008, 2052, 2200, 1080, 1084, 1089, 1125, kPP}},
+    {64, {297000, 1920, 2448, 2492, 2640, 1080, 1084, 1089, 1125, kPP}},
+    {93, {297000, 3840, 5116, 5204, 5500, 2160, 2168, 2178, 2250, kPP}},
+    {94, {297000, 3840, 4896, 4984, 5280, 2160, 2168, 2178, 2250, kPP}},
+    {95, {297000, 3840, 4016, 4104, 4400, 2160, 2168, 2178, 2250, kPP}},
+    {96, {594000, 3840, 4896, 4984, 5280, 2160, 2168, 2178, 2250, kPP}},
+    {97, {594000, 3840, 4016, 4104, 4400, 2160, 2168, 2178, 2250, kPP}},
+};
+
+std::uint16_t le16(const std::uint8_t* p) noexcept
+{
+    return static_cast<std::uint16_t>(p[0] | p[1] << 8);
+}
+
+bool checksum_ok(const std::uint8_t* p, std::size_t size) noexcept
+{
+    std::uint8_t sum = 0;
+    for (std::size_t i = 0; i < size; ++i)
+        sum = static_cast<std::uint8_t>(sum + p[i]);
+    return sum == 0;
+}
+
+void add_mode(DisplayInfo& info, const ModeInfo& mode)
+{
+    if (mode.hdisplay == 0 || mode.vdisplay == 0 || mode.htotal == 0 || mode.vtotal == 0)
+        return;
+    auto same = [&](const ModeInfo& m) {
+        ModeInfo a = m;
+        a.preferred = mode.preferred;
+        return a == mode;
+    };
+    auto it = std::find_if(info.modes.begin(), info.modes.end(), same);
+    if (it != info.modes.end()) {
+        it->preferred = it->preferred || mode.preferred;
+        return;
+    }
+    info.modes.push_back(mode);
+}
+
+// 18-byte detailed timing descriptor (EDID 1.4 section 3.10.2).
+void parse_dtd(const std::uint8_t* d, bool preferred, DisplayInfo& info)
+{
+    const std::uint32_t clock = le16(d) * 10u;
+    if (clock == 0)
+        return;
+    // Interlaced DTDs describe one field; modern panels do not use them and
+    // the CTA VIC table covers the broadcast interlaced formats.
+    if (d[17] & 0x80)
+        return;
+
+    const unsigned hactive = d[2] | (d[4] & 0xf0) << 4;
+    const unsigned hblank = d[3] | (d[4] & 0x0f) << 8;
+    const unsigned vactive = d[5] | (d[7] & 0xf0) << 4;
+    const unsigned vblank = d[6] | (d[7] & 0x0f) << 8;
+    const unsigned hso = d[8] | (d[11] & 0xc0) << 2;
+    const unsigned hsw = d[9] | (d[11] & 0x30) << 4;
+    const unsigned vso = (d[10] >> 4) | (d[11] & 0x0c) << 2;
+    const unsigned vsw = (d[10] & 0x0f) | (d[11] & 0x03) << 4;
+
+    ModeInfo m;
+    m.clock_khz = clock;
+    m.hdisplay = static_cast<std::uint16_t>(hactive);
+    m.hsync_start = static_cast<std::uint16_t>(hactive + hso);
+    m.hsync_end = static_cast<std::uint16_t>(hactive + hso + hsw);
+    m.htotal = static_cast<std::uint16_t>(hactive + hblank);
+    m.vdisplay = static_cast<std::uint16_t>(vactive);
+    m.vsync_start = static_cast<std::uint16_t>(vactive + vso);
+    m.vsync_end = static_cast<std::uint16_t>(vactive + vso + vsw);
+    m.vtotal = static_cast<std::uint16_t>(vactive + vblank);
+    if ((d[17] & 0x18) == 0x18) { // digital separate sync
+        m.flags |= (d[17] & 0x02) ? ModeInfo::PHSync : ModeInfo::NHSync;
+        m.flags |= (d[17] & 0x04) ? ModeInfo::PVSync : ModeInfo::NVSync;
+    } else {
+        m.flags |= ModeInfo::NHSync | ModeInfo::NVSync;
+    }
+    m.preferred = preferred;
+    add_mode(info, m);
+}
+
+void parse_descriptor(const std::uint8_t* d, DisplayInfo& info)
+{
+    if (d[0] != 0 || d[1] != 0 || d[2] != 0)
+        return;
+    switch (d[3]) {
+    case kDescName: {
+        const char* text = reinterpret_cast<const char*>(d + 5);
+        std::size_t len = 0;
+        while (len < 13 && text[len] != '\n' && text[len] != '\0')
+            ++len;
+        while (len > 0 && text[len - 1] == ' ')
+            --len;
+        info.name.assign(text, len);
+        break;
+    }
+    case kDescRangeLimits:
+        info.min_vrefresh = static_cast<std::uint16_t>(d[5] + ((d[4] & 0x01) ? 255 : 0));
+        info.max_vrefresh = static_cast<std::uint16_t>(d[6] + ((d[4] & 0x02) ? 255 : 0));
+        break;
+    default:
+        break;
+    }
+}
+
+void parse_cta(const std::uint8_t* ext, DisplayInfo& info)
+{
+    const std::size_t dtd_start = ext[2];
+    if (dtd_start < 4 || dtd_start > kBlockSize - 1)
+        return;
+
+    for (std::size_t i = 4; i < dtd_start;) {
+        const std::uint8_t tag = ext[i] >> 5;
+        const std::size_t len = ext[i] & 0x1f;
+        if (i + 1 + len > dtd_start)
+            break;
+        if (tag == kCtaVideoBlock) {
+            for (std::size_t j = 0; j < len; ++j) {
+                const std::uint8_t svd = ext[i + 1 + j];
+                // CTA-861-F: codes 129..192 are VICs 1..64 flagged native.
+                const bool native = svd >= 129 && svd <= 192;
+                const std::uint8_t vic = native ? svd & 0x7f : svd;
+                for (const Vic& v : kVics) {
+                    if (v.vic == vic) {
+                        ModeInfo m = v.mode;
+                        m.preferred = native;
+                        add_mode(info, m);
+                    }
+                }
+            }
+        }
+        i += 1 + len;
+    }
+
+    for (std::size_t off = dtd_start; off + 18 <= kBlockSize - 1; off += 18) {
+        if (le16(ext + off) == 0)
+            break;
+        parse_dtd(ext + off, false, info);
+    }
+}
+
+// DisplayID type I (10 kHz clock) and type VII (1 kHz clock) timings share
+// a 20-byte layout of "value minus one" fields.
+void parse_displayid_timing(const std::uint8_t* t, std::uint32_t clock_unit_khz, DisplayInfo& info)
+{
+    const std::uint32_t clock = ((t[0] | t[1] << 8 | t[2] << 16) + 1u) * clock_unit_khz;
+    const bool preferred = t[3] & 0x80;
+    if (t[3] & 0x10) // interlaced
+        return;
+
+    const unsigned hactive = le16(t + 4) + 1u;
+    const unsigned hblank = le16(t + 6) + 1u;
+    const unsigned hso = (le16(t + 8) & 0x7fff) + 1u;
+    const unsigned hsw = le16(t + 10) + 1u;
+    const unsigned vactive = le16(t + 12) + 1u;
+    const unsigned vblank = le16(t + 14) + 1u;
+    const unsigned vso = (le16(t + 16) & 0x7fff) + 1u;
+    const unsigned vsw = le16(t + 18) + 1u;
+
+    ModeInfo m;
+    m.clock_khz = clock;
+    m.hdisplay = static_cast<std::uint16_t>(hactive);
+    m.hsync_start = static_cast<std::uint16_t>(hactive + hso);
+    m.hsync_end = static_cast<std::uint16_t>(hactive + hso + hsw);
+    m.htotal = static_cast<std::uint16_t>(hactive + hblank);
+    m.vdisplay = static_cast<std::uint16_t>(vactive);
+    m.vsync_start = static_cast<std::uint16_t>(vactive + vso);
+    m.vsync_end = static_cast<std::uint16_t>(vactive + vso + vsw);
+    m.vtotal = static_cast<std::uint16_t>(vactive + vblank);
+    m.flags = ((t[9] & 0x80) ? ModeInfo::PHSync : ModeInfo::NHSync) |
+              ((t[17] & 0x80) ? ModeInfo::PVSync : ModeInfo::NVSync);
+    m.preferred = preferred;
+    add_mode(info, m);
+}
+
+// A DisplayID section: 4-byte header (version, payload length, product
+// type, extension count), @c payload bytes of data blocks, checksum.
+bool parse_displayid(const std::uint8_t* p, std::size_t size, DisplayInfo& info)
+{
+    if (size < 5)
+        return false;
+    const std::size_t payload = p[1];
+    if (5 + payload > size || !checksum_ok(p, 5 + payload))
+        return false;
+
+    // DisplayID 1.x and 2.0 share this framing; only the block tags differ.
+    for (std::size_t i = 4; i + 3 <= 4 + payload;) {
+        const std::uint8_t tag = p[i];
+        const std::size_t len = p[i + 2];
+        if (i + 3 + len > 4 + payload)
+            break;
+        const std::uint8_t* body = p + i + 3;
+        if (tag == kDidTypeI || tag == kDidTypeVII) {
+            const std::uint32_t unit = tag == kDidTypeI ? 10 : 1;
+            for (std::size_t off = 0; off + 20 <= len; off += 20)
+                parse_displayid_timing(body + off, unit, info);
+        }
+        if (tag == 0 && len == 0)
+            break; // padding
+        i += 3 + len;
+    }
+    return true;
+}
+
+void sort_modes(DisplayInfo& info)
+{
+    std::stable_partition(info.modes.begin(), info.modes.end(), [](const ModeInfo& m) { return m.preferred; });
+    // Only the first preferred mode keeps the flag, as the kernel does.
+    bool seen = false;
+    for (ModeInfo& m : info.modes) {
+        m.preferred = m.preferred && !seen;
+        seen = seen || m.preferred;
+    }
+}
+
+std::error_code parse_edid(std::span<const std::uint8_t> blob, DisplayInfo& info)
+{
+    const std::uint8_t* b = blob.data();
+    if (!checksum_ok(b, kBlockSize))
+        return std::make_error_code(std::errc::invalid_argument);
+
+    const std::uint16_t id = static_cast<std::uint16_t>(b[8] << 8 | b[9]);
+    info.vendor[0] = static_cast<char>('A' - 1 + ((id >> 10) & 0x1f));
+    info.vendor[1] = static_cast<char>('A' - 1 + ((id >> 5) & 0x1f));
+    info.vendor[2] = static_cast<char>('A' - 1 + (id & 0x1f));
+    info.vendor[3] = '\0';
+    info.product = le16(b + 10);
+    info.serial = static_cast<std::uint32_t>(b[12] | b[13] << 8 | b[14] << 16) | static_cast<std::uint32_t>(b[15]) << 24;
+    info.width_mm = static_cast<std::uint16_t>(b[21] * 10);
+    info.height_mm = static_cast<std::uint16_t>(b[22] * 10);
+
+    for (int i = 0; i < 4; ++i) {
+        const std::uint8_t* d = b + 54 + i * 18;
+        if (le16(d) != 0)
+            parse_dtd(d, i == 0, info); // EDID 1.3+: the first DTD is preferred
+        else
+            parse_descriptor(d, info);
+    }
+
+    const std::size_t blocks = std::min<std::size_t>(1 + b[126], blob.size() / kBlockSize);
+    for (std::size_t n = 1; n < blocks; ++n) {
+        const std::uint8_t* ext = b + n * kBlockSize;
+        if (!checksum_ok(ext, kBlockSize))
+            continue;
+        if (ext[0] == kExtCta)
+            parse_cta(ext, info);
+        else if (ext[0] == kExtDisplayId)
+            parse_displayid(ext + 1, kBlockSize - 2, info);
+    }
+    return {};
+}
+
+} // namespace
+
+std::error_code parse_display_info(std::span<const std::uint8_t> blob, DisplayInfo& out)
+{
+    DisplayInfo info;
+    if (blob.size() >= kBlockSize && std::memcmp(blob.data(), kEdidHeader, sizeof(kEdidHeader)) == 0) {
+        if (std::error_code ec = parse_edid(blob, info))
+            return ec;
+    } else if (!parse_displayid(blob.data(), blob.size(), info)) {
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+    sort_modes(info);
+    out = std::move(info);
+    return {};
+}
+
+std::error_code EdidCache::lookup(std::span<const std::uint8_t> blob, std::shared_ptr<const DisplayInfo>& out)
+{
+    const std::uint64_t hash = fnv1a64(blob.data(), blob.size());
+    auto matches = [&](const Entry& e) {
+        return e.blob.size() == blob.size() && std::memcmp(e.blob.data(), blob.data(), blob.size()) == 0;
+    };
+
+    {
+        std::lock_guard lock(mutex_);
+        if (auto it = index_.find(hash); it != index_.end() && matches(*it->second)) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++stats_.hits;
+            out = it->second->info;
+            return {};
+        }
+        ++stats_.misses;
+    }
+
+    auto info = std::make_shared<DisplayInfo>();
+    if (std::error_code ec = parse_display_info(blob, *info))
+        return ec;
+
+    std::lock_guard lock(mutex_);
+    if (auto it = index_.find(hash); it != index_.end()) {
+        // Another prober decoded the same blob meanwhile, or a different
+        // blob collided on the hash; in both cases the newest entry wins.
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    lru_.push_front(Entry{hash, std::vector<std::uint8_t>(blob.begin(), blob.end()), info});
+    index_.emplace(hash, lru_.begin());
+    while (lru_.size() > capacity_) {
+        index_.erase(lru_.back().hash);
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+    out = std::move(info);
+    return {};
+}
+
+void EdidCache::clear()
+{
+    std::lock_guard lock(mutex_);
+    index_.clear();
+    lru_.clear();
+}
+
+std::size_t EdidCache::size() const
+{
+    std::lock_guard lock(mutex_);
+    return lru_.size();
+}
+
+EdidCache::Stats EdidCache::stats() const
+{
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+} // namespace dispctrl
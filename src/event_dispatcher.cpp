@@ -0,0 +1,170 @@
+#include "dispctrl/event_dispatcher.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <utility>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr std::uint64_t kWakeupTag = ~std::uint64_t{0};
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+UniqueFd make_eventfd()
+{
+    int fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0)
+        throw std::system_error(last_error(), "eventfd");
+    return UniqueFd(fd);
+}
+
+void signal_eventfd(int fd) noexcept
+{
+    const std::uint64_t one = 1;
+    // EAGAIN means the counter is saturated, i.e. already signalled.
+    [[maybe_unused]] ssize_t ret = ::write(fd, &one, sizeof(one));
+}
+
+} // namespace
+
+EventDispatcher::Head::Head(KmsDevice& device, std::uint32_t crtc_id)
+    : device_(&device), crtc_id_(crtc_id), notify_(make_eventfd())
+{
+}
+
+void EventDispatcher::Head::clear_notify() noexcept
+{
+    std::uint64_t value;
+    [[maybe_unused]] ssize_t ret = ::read(notify_.get(), &value, sizeof(value));
+}
+
+void EventDispatcher::Head::push(const KmsEvent& event) noexcept
+{
+    if (!ring_.try_push(event)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    signal_eventfd(notify_.get());
+}
+
+EventDispatcher::EventDispatcher()
+{
+    int fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(last_error(), "epoll_create1");
+    epoll_.reset(fd);
+    wakeup_ = make_eventfd();
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeupTag;
+    if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, wakeup_.get(), &ev) != 0)
+        throw std::system_error(last_error(), "epoll_ctl");
+}
+
+EventDispatcher::Head& EventDispatcher::add_head(KmsDevice& device, std::uint32_t crtc_id)
+{
+    Source* source = nullptr;
+    for (Source& s : sources_)
+        if (s.device == &device)
+            source = &s;
+
+    if (!source) {
+        const int fd = device.event_fd();
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = sources_.size();
+        if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, fd, &ev) != 0)
+            throw std::system_error(last_error(), "epoll_ctl");
+        source = &sources_.emplace_back(Source{&device, fd, {}});
+    }
+
+    for (Head* head : source->heads)
+        if (head->crtc_id_ == crtc_id)
+            return *head;
+
+    // Head's constructor is private to us, so std::make_unique cannot
+    // reach it; own it before anything else can throw.
+    std::unique_ptr<Head> head(new Head(device, crtc_id));
+    source->heads.reserve(source->heads.size() + 1);
+    heads_.push_back(std::move(head));
+    source->heads.push_back(heads_.back().get());
+    return *heads_.back();
+}
+
+std::error_code EventDispatcher::drain(const Source& source)
+{
+    std::array<KmsEvent, kMaxEventsPerRead> events;
+    for (;;) {
+        std::size_t count = 0;
+        if (std::error_code ec = read_kms_events(source.fd, events, count))
+            return ec;
+        if (count == 0)
+            return {};
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const KmsEvent& event = events[i];
+            ++stats_.events;
+            Head* target = nullptr;
+            for (Head* head : source.heads)
+                if (head->crtc_id_ == event.crtc_id)
+                    target = head;
+            // Kernels without DRM_CAP_CRTC_IN_VBLANK_EVENT report crtc_id 0;
+            // that is only unambiguous when the device drives a single head.
+            if (!target && event.crtc_id == 0 && source.heads.size() == 1)
+                target = source.heads.front();
+            if (target)
+                target->push(event);
+            else
+                ++stats_.unrouted;
+        }
+        // Level-triggered epoll re-reports the fd if a short read left
+        // events behind, so one read per wakeup is enough in the common case.
+        if (count < kMaxEventsPerRead)
+            return {};
+    }
+}
+
+std::error_code EventDispatcher::dispatch(int timeout_ms)
+{
+    std::array<epoll_event, 16> ready;
+    const int n = ::epoll_wait(epoll_.get(), ready.data(), static_cast<int>(ready.size()), timeout_ms);
+    if (n < 0)
+        return errno == EINTR ? std::error_code{} : last_error();
+
+    for (int i = 0; i < n; ++i) {
+        if (ready[i].data.u64 == kWakeupTag) {
+            std::uint64_t value;
+            [[maybe_unused]] ssize_t ret = ::read(wakeup_.get(), &value, sizeof(value));
+            continue;
+        }
+        if (std::error_code ec = drain(sources_[ready[i].data.u64]))
+            return ec;
+    }
+    return {};
+}
+
+std::error_code EventDispatcher::run()
+{
+    while (!stopping_.load(std::memory_order_acquire))
+        if (std::error_code ec = dispatch(-1))
+            return ec;
+    return {};
+}
+
+void EventDispatcher::stop() noexcept
+{
+    stopping_.store(true, std::memory_order_release);
+    signal_eventfd(wakeup_.get());
+}
+
+} // namespace dispctrl
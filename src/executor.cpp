@@ -0,0 +1,288 @@
+#include "dispctrl/executor.hpp"
+
+#include "dispctrl/clock.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <ctime>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr std::uint64_t kWakeupTag = 0; // watches are tagged with their address
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+bool later(const auto& a, const auto& b) noexcept
+{
+    return a.deadline != b.deadline ? a.deadline > b.deadline : a.seq > b.seq;
+}
+
+} // namespace
+
+/// Owns a spawned task: runs it to completion, then unregisters itself.
+struct Executor::Detached {
+    struct promise_type {
+        promise_type(Executor& ex, Task<void>&) noexcept : ex(&ex) {}
+
+        Detached get_return_object() noexcept
+        {
+            return {std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        auto final_suspend() const noexcept
+        {
+            struct Finish {
+                Executor* ex;
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<promise_type> h) const noexcept
+                {
+                    ex->finished(h);
+                    h.destroy();
+                }
+                void await_resume() const noexcept {}
+            };
+            return Finish{ex};
+        }
+        void return_void() const noexcept {}
+        [[noreturn]] void unhandled_exception() const noexcept { std::terminate(); }
+
+        Executor* ex;
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+Executor::Executor()
+{
+    int fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(last_error(), "epoll_create1");
+    epoll_.reset(fd);
+
+    fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0)
+        throw std::system_error(last_error(), "eventfd");
+    wakeup_.reset(fd);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeupTag;
+    if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, wakeup_.get(), &ev) != 0)
+        throw std::system_error(last_error(), "epoll_ctl");
+}
+
+Executor::~Executor()
+{
+    // Destroying a frame runs the destructors of its awaiters, which may
+    // unregister themselves; iterate over a copy.
+    const std::vector<std::coroutine_handle<>> frames = std::move(detached_);
+    for (std::coroutine_handle<> h : frames)
+        h.destroy();
+}
+
+Executor::Detached Executor::drive(Task<void> task)
+{
+    co_await std::move(task);
+}
+
+void Executor::spawn(Task<void> task)
+{
+    Detached d = drive(std::move(task));
+    detached_.push_back(d.handle);
+    ready_.push_back(d.handle);
+}
+
+void Executor::finished(std::coroutine_handle<> h) noexcept
+{
+    const auto it = std::find(detached_.begin(), detached_.end(), h);
+    if (it != detached_.end()) {
+        *it = detached_.back();
+        detached_.pop_back();
+    }
+}
+
+void Executor::stop() noexcept
+{
+    stopping_.store(true, std::memory_order_relaxed);
+    const std::uint64_t one = 1;
+    [[maybe_unused]] ssize_t ret = ::write(wakeup_.get(), &one, sizeof(one));
+}
+
+std::error_code Executor::watch(int fd, Callback callback)
+{
+    if (watches_.count(fd))
+        return std::make_error_code(std::errc::file_exists);
+    auto w = std::make_unique<Watch>(Watch{fd, std::move(callback), {}});
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = w.get();
+    if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, fd, &ev) != 0)
+        return last_error();
+    watches_.emplace(fd, std::move(w));
+    return {};
+}
+
+void Executor::unwatch(int fd) noexcept
+{
+    const auto it = watches_.find(fd);
+    if (it == watches_.end())
+        return;
+    ::epoll_ctl(epoll_.get(), EPOLL_CTL_DEL, fd, nullptr);
+    // Events for it may still be queued in the current dispatch batch.
+    it->second->dead = true;
+    try {
+        graveyard_.push_back(std::move(it->second));
+    } catch (const std::bad_alloc&) {
+        // Leave it in the map; dead watches are never dispatched.
+        return;
+    }
+    watches_.erase(it);
+}
+
+std::error_code Executor::arm(int fd, std::coroutine_handle<> waiter) noexcept
+{
+    if (watches_.count(fd))
+        return std::make_error_code(std::errc::device_or_resource_busy);
+    Watch* w;
+    try {
+        if (spare_.empty()) {
+            w = watches_.emplace(fd, std::make_unique<Watch>(Watch{fd, {}, {}})).first->second.get();
+        } else {
+            // The node of the last wait that fired, so a coroutine waiting
+            // in a loop does not allocate.
+            spare_.key() = fd;
+            *spare_.mapped() = Watch{fd, {}, {}};
+            w = watches_.insert(std::move(spare_)).position->second.get();
+        }
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+
+    // One-shot: the fd fires once and is forgotten before its waiter
+    // resumes, so an fd nobody is waiting on never wakes the loop.
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = w;
+    if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, fd, &ev) != 0) {
+        std::error_code ec = last_error();
+        watches_.erase(fd);
+        return ec;
+    }
+    w->waiter = waiter;
+    return {};
+}
+
+bool Executor::ReadableAwaiter::await_suspend(std::coroutine_handle<> h) noexcept
+{
+    error_ = ex_.arm(fd_, h);
+    return !error_;
+}
+
+bool Executor::SleepAwaiter::await_ready() const noexcept
+{
+    return deadline_ <= monotonic_ns();
+}
+
+void Executor::SleepAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    ex_.timers_.push_back({deadline_, ++ex_.timer_seq_, h});
+    std::push_heap(ex_.timers_.begin(), ex_.timers_.end(), [](const Timer& a, const Timer& b) { return later(a, b); });
+}
+
+Executor::SleepAwaiter Executor::sleep_for(std::uint64_t duration_ns) noexcept
+{
+    return {*this, monotonic_ns() + duration_ns};
+}
+
+void Executor::fire_timers()
+{
+    const std::uint64_t now = monotonic_ns();
+    const auto cmp = [](const Timer& a, const Timer& b) { return later(a, b); };
+    while (!timers_.empty() && timers_.front().deadline <= now) {
+        std::pop_heap(timers_.begin(), timers_.end(), cmp);
+        ready_.push_back(timers_.back().handle);
+        timers_.pop_back();
+    }
+}
+
+int Executor::wait_events(std::uint64_t timeout_ns)
+{
+    std::array<epoll_event, 32> events;
+    int n = -1;
+    errno = ENOSYS;
+#ifdef DISPCTRL_HAVE_EPOLL_PWAIT2
+    timespec ts{static_cast<time_t>(timeout_ns / 1'000'000'000), static_cast<long>(timeout_ns % 1'000'000'000)};
+    n = ::epoll_pwait2(epoll_.get(), events.data(), static_cast<int>(events.size()),
+                       timeout_ns == UINT64_MAX ? nullptr : &ts, nullptr);
+#endif
+    if (n < 0 && errno == ENOSYS) {
+        // Pre-2.35 glibc or pre-5.11 kernel; millisecond resolution,
+        // rounded up.
+        const int ms = timeout_ns == UINT64_MAX ? -1 : static_cast<int>(std::min<std::uint64_t>((timeout_ns + 999'999) / 1'000'000, INT32_MAX));
+        n = ::epoll_wait(epoll_.get(), events.data(), static_cast<int>(events.size()), ms);
+    }
+    if (n < 0)
+        return errno == EINTR ? 0 : -errno;
+
+    for (int i = 0; i < n; ++i) {
+        if (events[static_cast<std::size_t>(i)].data.u64 == kWakeupTag) {
+            std::uint64_t value;
+            [[maybe_unused]] ssize_t ret = ::read(wakeup_.get(), &value, sizeof(value));
+            continue;
+        }
+        auto* w = static_cast<Watch*>(events[static_cast<std::size_t>(i)].data.ptr);
+        if (w->dead)
+            continue;
+        if (w->callback) {
+            w->callback();
+        } else if (w->waiter) {
+            // Done with the fd: the waiter may wait on it again, or hand it
+            // to watch(), once resumed.
+            const std::coroutine_handle<> waiter = std::exchange(w->waiter, {});
+            ::epoll_ctl(epoll_.get(), EPOLL_CTL_DEL, w->fd, nullptr);
+            spare_ = watches_.extract(w->fd);
+            waiter.resume();
+        }
+    }
+    graveyard_.clear();
+    return 0;
+}
+
+std::error_code Executor::run()
+{
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        // Only what is ready now; coroutines posted meanwhile wait for the
+        // next iteration so fds and timers are not starved.
+        for (std::size_t n = ready_.size(); n > 0 && !ready_.empty(); --n) {
+            std::coroutine_handle<> h = ready_.front();
+            ready_.pop_front();
+            h.resume();
+        }
+        fire_timers();
+        if (detached_.empty() && ready_.empty())
+            break;
+
+        std::uint64_t timeout = UINT64_MAX;
+        if (!ready_.empty())
+            timeout = 0;
+        else if (!timers_.empty()) {
+            const std::uint64_t now = monotonic_ns();
+            timeout = timers_.front().deadline > now ? timers_.front().deadline - now : 0;
+        }
+        if (int err = wait_events(timeout))
+            return {-err, std::system_category()};
+    }
+    return {};
+}
+
+} // namespace dispctrl
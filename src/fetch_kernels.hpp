@@ -0,0 +1,130 @@
+#pragma once
+
+// Source fetch stage of TileCompositor: reads a run of nearest samples of
+// a layer and writes it out as premultiplied ARGB8888 for the blend
+// kernels. A kernel is instantiated for every source format, blend mode,
+// rotation and scaled/unscaled combination, and kFetchKernels holds them
+// all in fetch_index() order, so a layer picks its kernel once and the
+// per-pixel loops carry no runtime switches.
+
+#include "dispctrl/compositor.hpp"
+#include "dispctrl/format.hpp"
+#include "dispctrl/geometry.hpp"
+
+#include "blend_kernels.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace dispctrl::blend {
+
+inline constexpr std::array<std::uint32_t, 4> kSourceFormats = {fourcc::XRGB8888, fourcc::ARGB8888,
+                                                                fourcc::XBGR8888, fourcc::ABGR8888};
+inline constexpr std::size_t kBlendModes = 3;
+inline constexpr std::size_t kRotations = 4;
+
+constexpr bool has_alpha(std::uint32_t format) noexcept
+{
+    return format == fourcc::ARGB8888 || format == fourcc::ABGR8888;
+}
+
+/// One run of samples along a destination row. The source coordinate
+/// advances by step per pixel, plus one whenever rem, growing by step_rem,
+/// reaches denom: the exact integer form of nearest sampling, without a
+/// division per pixel.
+struct FetchSpan {
+    const std::uint8_t* first; ///< Source pixel of the first sample.
+    std::uint32_t pitch;       ///< Surface pitch; rotated kernels walk columns.
+    std::uint32_t step;
+    std::uint32_t step_rem;
+    std::uint32_t rem;
+    std::uint32_t denom;
+};
+
+using FetchRow = void (*)(const FetchSpan& span, std::uint32_t* out, std::uint32_t count) noexcept;
+
+// Colour channels times alpha: mul_div255() on red and blue side by side
+// in 16-bit halves, which never carry into each other, and on green.
+inline std::uint32_t premultiply(std::uint32_t p) noexcept
+{
+    const std::uint32_t a = p >> 24;
+    std::uint32_t rb = (p & 0xff00ffu) * a + 0x800080u;
+    rb = (rb + (rb >> 8 & 0xff00ffu)) >> 8 & 0xff00ffu;
+    return a << 24 | rb | mul_div255(p >> 8 & 0xff, a) << 8;
+}
+
+template <std::uint32_t Format, BlendMode Mode>
+inline std::uint32_t load(const std::uint8_t* p) noexcept
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    if constexpr (Format == fourcc::XBGR8888 || Format == fourcc::ABGR8888)
+        v = (v & 0xff00ff00u) | (v >> 16 & 0xff) | (v & 0xff) << 16;
+    if constexpr (!has_alpha(Format) || Mode == BlendMode::Opaque)
+        return v | 0xff000000u;
+    else if constexpr (Mode == BlendMode::Coverage)
+        return premultiply(v);
+    else
+        return v;
+}
+
+template <std::uint32_t Format, BlendMode Mode, Rotation Rot, bool Scaled>
+void fetch_row(const FetchSpan& span, std::uint32_t* out, std::uint32_t count) noexcept
+{
+    // Unrotated rows keep a constant stride the compiler can vectorise.
+    std::ptrdiff_t stride = 4;
+    if constexpr (swaps_axes(Rot))
+        stride = static_cast<std::ptrdiff_t>(span.pitch);
+    if constexpr (Rot == Rotation::R180 || Rot == Rotation::R270)
+        stride = -stride;
+
+    // Offsets rather than pointers: the walk may end outside the surface.
+    std::ptrdiff_t offset = 0;
+    if constexpr (!Scaled) {
+        for (std::uint32_t k = 0; k < count; ++k, offset += stride)
+            out[k] = load<Format, Mode>(span.first + offset);
+    } else {
+        const std::ptrdiff_t jump = stride * static_cast<std::ptrdiff_t>(span.step);
+        std::uint32_t rem = span.rem;
+        for (std::uint32_t k = 0; k < count; ++k) {
+            out[k] = load<Format, Mode>(span.first + offset);
+            offset += jump;
+            rem += span.step_rem;
+            if (rem >= span.denom) {
+                rem -= span.denom;
+                offset += stride;
+            }
+        }
+    }
+}
+
+constexpr std::size_t fetch_index(std::size_t format, BlendMode mode, Rotation rotation, bool scaled) noexcept
+{
+    return ((format * kBlendModes + static_cast<std::size_t>(mode)) * kRotations +
+            static_cast<std::size_t>(rotation)) * 2 + (scaled ? 1 : 0);
+}
+
+template <std::size_t I>
+constexpr FetchRow fetch_kernel() noexcept
+{
+    return &fetch_row<kSourceFormats[I / (kBlendModes * kRotations * 2)],
+                      static_cast<BlendMode>(I / (kRotations * 2) % kBlendModes),
+                      static_cast<Rotation>(I / 2 % kRotations), I % 2 != 0>;
+}
+
+template <std::size_t... I>
+constexpr std::array<FetchRow, sizeof...(I)> make_fetch_kernels(std::index_sequence<I...>) noexcept
+{
+    return {fetch_kernel<I>()...};
+}
+
+inline constexpr std::array kFetchKernels =
+    make_fetch_kernels(std::make_index_sequence<kSourceFormats.size() * kBlendModes * kRotations * 2>{});
+
+static_assert(kFetchKernels[fetch_index(3, BlendMode::Coverage, Rotation::R270, true)] ==
+              &fetch_row<fourcc::ABGR8888, BlendMode::Coverage, Rotation::R270, true>);
+
+} // namespace dispctrl::blend
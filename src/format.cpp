@@ -0,0 +1,30 @@
+#include "dispctrl/format.hpp"
+
+#include <array>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr std::array kFormats{
+    FormatInfo{fourcc::XRGB8888, 1, {4, 0, 0}, 1, 1, false, false},
+    FormatInfo{fourcc::ARGB8888, 1, {4, 0, 0}, 1, 1, true, false},
+    FormatInfo{fourcc::XBGR8888, 1, {4, 0, 0}, 1, 1, false, false},
+    FormatInfo{fourcc::ABGR8888, 1, {4, 0, 0}, 1, 1, true, false},
+    FormatInfo{fourcc::XRGB2101010, 1, {4, 0, 0}, 1, 1, false, false},
+    FormatInfo{fourcc::RGB565, 1, {2, 0, 0}, 1, 1, false, false},
+    FormatInfo{fourcc::YUYV, 1, {2, 0, 0}, 2, 1, false, true},
+    FormatInfo{fourcc::NV12, 2, {1, 2, 0}, 2, 2, false, true},
+};
+
+} // namespace
+
+const FormatInfo* format_info(std::uint32_t code) noexcept
+{
+    for (const FormatInfo& info : kFormats)
+        if (info.fourcc == code)
+            return &info;
+    return nullptr;
+}
+
+} // namespace dispctrl
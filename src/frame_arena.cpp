@@ -0,0 +1,94 @@
+#include "dispctrl/frame_arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr std::size_t kHeaderSize = 64; // keeps block payloads cache-line aligned
+
+std::byte* payload(void* block) noexcept
+{
+    return static_cast<std::byte*>(block) + kHeaderSize;
+}
+
+} // namespace
+
+FrameArena::FrameArena(std::size_t initial_bytes, std::pmr::memory_resource* upstream) : upstream_(upstream)
+{
+    first_ = current_ = allocate_block(std::max<std::size_t>(initial_bytes, 256));
+}
+
+FrameArena::~FrameArena()
+{
+    free_blocks(first_);
+}
+
+FrameArena::Block* FrameArena::allocate_block(std::size_t size)
+{
+    void* mem = upstream_->allocate(kHeaderSize + size, kHeaderSize);
+    ++stats_.upstream_allocations;
+    stats_.capacity += size;
+    return ::new (mem) Block{nullptr, size};
+}
+
+void FrameArena::free_blocks(Block* block) noexcept
+{
+    while (block) {
+        Block* next = block->next;
+        const std::size_t size = block->size;
+        stats_.capacity -= size;
+        upstream_->deallocate(block, kHeaderSize + size, kHeaderSize);
+        block = next;
+    }
+}
+
+void* FrameArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    for (;;) {
+        const auto base = reinterpret_cast<std::uintptr_t>(payload(current_));
+        const std::size_t aligned = ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+        if (aligned + bytes <= current_->size) {
+            offset_ = aligned + bytes;
+            stats_.used += bytes;
+            return payload(current_) + aligned;
+        }
+        if (!current_->next) {
+            // Grow geometrically so a burst costs O(log n) upstream calls.
+            const std::size_t want = std::max(current_->size * 2, bytes + alignment);
+            current_->next = allocate_block(want);
+        }
+        current_ = current_->next;
+        offset_ = 0;
+    }
+}
+
+void FrameArena::reset() noexcept
+{
+    stats_.high_water = std::max(stats_.high_water, stats_.used);
+    ++stats_.resets;
+
+    if (first_->next) {
+        // The frame spilled into extra blocks; fold them into a single block
+        // sized for the whole frame so the next one fits without growing.
+        const std::size_t total = stats_.capacity;
+        Block* spill = first_->next;
+        first_->next = nullptr;
+        free_blocks(spill);
+        try {
+            Block* merged = allocate_block(total);
+            free_blocks(first_);
+            first_ = merged;
+        } catch (const std::bad_alloc&) {
+            // Keep the original block; the next frame simply grows again.
+        }
+    }
+    current_ = first_;
+    offset_ = 0;
+    stats_.used = 0;
+}
+
+} // namespace dispctrl
@@ -0,0 +1,116 @@
+#include "dispctrl/frame_pacer.hpp"
+
+#include "dispctrl/commit_queue.hpp"
+
+#include <algorithm>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr std::uint64_t kNsPerSec = 1'000'000'000;
+
+std::uint64_t sub_floor(std::uint64_t a, std::uint64_t b) noexcept
+{
+    return a > b ? a - b : 0;
+}
+
+} // namespace
+
+FramePacer::FramePacer(std::uint32_t min_hz, std::uint32_t max_hz) noexcept
+{
+    if (max_hz == 0)
+        max_hz = 60;
+    if (min_hz == 0 || min_hz > max_hz)
+        min_hz = max_hz;
+    min_interval_ = kNsPerSec / max_hz;
+    max_interval_ = kNsPerSec / min_hz;
+}
+
+void FramePacer::set_content_interval(std::uint64_t interval_ns) noexcept
+{
+    content_ = interval_ns;
+    lfc_ = 1;
+    // Below the window, split each frame into the fewest equal refreshes
+    // that keep the repeat guard, as a lone repeat would; every refresh
+    // interval then stays within the range.
+    const std::uint64_t limit = repeat_limit();
+    if (interval_ns > limit)
+        lfc_ = static_cast<unsigned>((interval_ns + limit - 1) / limit);
+}
+
+std::uint64_t FramePacer::repeat_limit() const noexcept
+{
+    return std::max(sub_floor(max_interval_, kRepeatGuardNs), min_interval_);
+}
+
+void FramePacer::on_vblank(std::uint64_t timestamp_ns, bool repeat) noexcept
+{
+    if (submit_ns_ && timestamp_ns > submit_ns_) {
+        const std::uint64_t sample = timestamp_ns - submit_ns_;
+        latency_ = latency_ ? (latency_ * 7 + sample) / 8 : sample;
+    }
+    submit_ns_ = 0;
+
+    if (vrr_ && last_vblank_ && timestamp_ns - last_vblank_ > max_interval_)
+        ++stats_.late;
+    last_vblank_ = timestamp_ns;
+    if (repeat) {
+        ++stats_.repeats;
+    } else {
+        ++stats_.frames;
+        last_frame_vblank_ = timestamp_ns;
+    }
+}
+
+std::uint64_t FramePacer::schedule(std::uint64_t ready_ns) noexcept
+{
+    // At a fixed rate the kernel latches the flip at the next vblank anyway.
+    if (!vrr_ || !last_vblank_)
+        return ready_ns;
+
+    std::uint64_t target = last_vblank_ + min_interval_;
+    if (content_ && last_frame_vblank_)
+        target = std::max(target, last_frame_vblank_ + content_);
+    const std::uint64_t submit = std::max(ready_ns, sub_floor(target, latency_));
+    if (submit > ready_ns)
+        ++stats_.held;
+    return submit;
+}
+
+std::uint64_t FramePacer::repeat_deadline() const noexcept
+{
+    if (!vrr_ || !last_vblank_)
+        return 0;
+    // A window narrower than two refreshes can push the split below the
+    // minimum interval; the panel cannot refresh any sooner.
+    const std::uint64_t interval = lfc_ > 1 ? std::max(content_ / lfc_, min_interval_) : repeat_limit();
+    return std::max(last_vblank_ + 1, sub_floor(last_vblank_ + interval, latency_));
+}
+
+std::uint64_t FramePacer::predict_next_vblank(std::uint64_t now_ns) const noexcept
+{
+    const std::uint64_t earliest = now_ns + latency_;
+    if (!last_vblank_)
+        return earliest;
+
+    if (!vrr_) {
+        // Fixed refresh: the first vblank of the grid after the flip lands.
+        if (earliest <= last_vblank_)
+            return last_vblank_ + min_interval_;
+        const std::uint64_t periods = (earliest - last_vblank_ + min_interval_ - 1) / min_interval_;
+        return last_vblank_ + periods * min_interval_;
+    }
+
+    std::uint64_t vblank = std::max(earliest, last_vblank_ + min_interval_);
+    if (content_ && last_frame_vblank_)
+        vblank = std::max(vblank, last_frame_vblank_ + content_);
+    return vblank;
+}
+
+void set_vrr_enabled(CommitQueue& queue, std::uint32_t crtc_id, std::uint32_t prop_id, bool enabled)
+{
+    queue.set(crtc_id, prop_id, enabled ? 1 : 0);
+}
+
+} // namespace dispctrl
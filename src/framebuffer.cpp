@@ -0,0 +1,156 @@
+#include "dispctrl/framebuffer.hpp"
+
+#include "dispctrl/format.hpp"
+#include "dispctrl/modifier.hpp"
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <functional>
+
+namespace dispctrl {
+
+namespace {
+
+inline void hash_combine(std::size_t& seed, std::uint64_t value) noexcept
+{
+    seed ^= std::hash<std::uint64_t>{}(value) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+} // namespace
+
+Framebuffer::~Framebuffer()
+{
+    owner_.release(*this);
+}
+
+std::size_t FramebufferImporter::KeyHash::operator()(const Key& key) const noexcept
+{
+    std::size_t seed = key.plane_count;
+    for (std::uint32_t i = 0; i < key.plane_count; ++i) {
+        hash_combine(seed, key.ino[i]);
+        hash_combine(seed, static_cast<std::uint64_t>(key.offsets[i]) << 32 | key.pitches[i]);
+    }
+    hash_combine(seed, static_cast<std::uint64_t>(key.width) << 32 | key.height);
+    hash_combine(seed, key.fourcc);
+    hash_combine(seed, key.modifier);
+    return seed;
+}
+
+FramebufferImporter::~FramebufferImporter()
+{
+    clear();
+}
+
+std::error_code FramebufferImporter::make_key(const DmaBufDesc& desc, Key& key) const noexcept
+{
+    const FormatInfo* info = format_info(desc.fourcc);
+    if (!info || desc.width == 0 || desc.height == 0)
+        return std::make_error_code(std::errc::invalid_argument);
+    // Compressed layouts (CCS, DCC) add auxiliary planes after the colour
+    // planes; the modifier defines how many.
+    const bool aux = classify_modifier(desc.modifier) == LayoutClass::Compressed;
+    if (desc.plane_count < info->plane_count || desc.plane_count > (aux ? 4u : info->plane_count))
+        return std::make_error_code(std::errc::invalid_argument);
+
+    key.plane_count = desc.plane_count;
+    key.width = desc.width;
+    key.height = desc.height;
+    key.fourcc = desc.fourcc;
+    key.modifier = desc.modifier;
+    for (std::uint32_t i = 0; i < desc.plane_count; ++i) {
+        const DmaBufDesc::Plane& plane = desc.planes[i];
+        if (plane.fd < 0 || plane.pitch == 0)
+            return std::make_error_code(std::errc::invalid_argument);
+        // A DMA-BUF is identified by its anon inode, not by the fd number:
+        // clients may dup() or re-send the same buffer under a new fd.
+        struct stat st;
+        if (::fstat(plane.fd, &st) != 0)
+            return {errno, std::system_category()};
+        key.dev[i] = st.st_dev;
+        key.ino[i] = st.st_ino;
+        key.offsets[i] = plane.offset;
+        key.pitches[i] = plane.pitch;
+    }
+    return {};
+}
+
+std::error_code FramebufferImporter::import(const DmaBufDesc& desc, std::shared_ptr<Framebuffer>& out)
+{
+    Key key;
+    if (std::error_code ec = make_key(desc, key))
+        return ec;
+
+    if (auto it = cache_.find(key); it != cache_.end()) {
+        out = it->second;
+        return {};
+    }
+
+    FramebufferLayout layout;
+    layout.width = desc.width;
+    layout.height = desc.height;
+    layout.fourcc = desc.fourcc;
+    layout.modifier = desc.modifier;
+    layout.plane_count = desc.plane_count;
+
+    std::uint32_t imported = 0;
+    auto unwind = [&] {
+        for (std::uint32_t i = 0; i < imported; ++i)
+            unref_handle(layout.handles[i]);
+    };
+
+    for (std::uint32_t i = 0; i < desc.plane_count; ++i) {
+        std::uint32_t handle = 0;
+        if (std::error_code ec = device_.import_dmabuf(desc.planes[i].fd, handle)) {
+            unwind();
+            return ec;
+        }
+        ref_handle(handle);
+        layout.handles[i] = handle;
+        layout.pitches[i] = desc.planes[i].pitch;
+        layout.offsets[i] = desc.planes[i].offset;
+        ++imported;
+    }
+
+    std::uint32_t fb_id = 0;
+    if (std::error_code ec = device_.add_framebuffer(layout, fb_id)) {
+        unwind();
+        return ec;
+    }
+
+    out.reset(new Framebuffer(*this, layout, fb_id));
+    cache_.emplace(key, out);
+    return {};
+}
+
+void FramebufferImporter::evict(const DmaBufDesc& desc)
+{
+    Key key;
+    if (!make_key(desc, key))
+        cache_.erase(key);
+}
+
+void FramebufferImporter::ref_handle(std::uint32_t handle)
+{
+    ++handle_refs_[handle];
+}
+
+void FramebufferImporter::unref_handle(std::uint32_t handle) noexcept
+{
+    auto it = handle_refs_.find(handle);
+    if (it == handle_refs_.end())
+        return;
+    if (--it->second == 0) {
+        handle_refs_.erase(it);
+        device_.close_handle(handle);
+    }
+}
+
+void FramebufferImporter::release(Framebuffer& fb) noexcept
+{
+    device_.remove_framebuffer(fb.fb_id_);
+    for (std::uint32_t i = 0; i < fb.layout_.plane_count; ++i)
+        unref_handle(fb.layout_.handles[i]);
+}
+
+} // namespace dispctrl
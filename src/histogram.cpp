@@ -0,0 +1,72 @@
+#include "dispctrl/histogram.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr unsigned kSub = LatencyHistogram::kSubBucketBits;
+constexpr std::uint64_t kHalf = std::uint64_t{1} << (kSub - 1);
+
+std::size_t bucket_of(std::uint64_t v) noexcept
+{
+    if (v < (std::uint64_t{1} << kSub))
+        return static_cast<std::size_t>(v);
+    const unsigned shift = std::min<unsigned>(static_cast<unsigned>(std::bit_width(v)) - kSub, LatencyHistogram::kMaxShift);
+    const std::uint64_t mantissa = std::min<std::uint64_t>(v >> shift, 2 * kHalf - 1);
+    return (std::size_t{shift} << (kSub - 1)) + static_cast<std::size_t>(mantissa);
+}
+
+// Midpoint of a bucket, the value reported for it.
+std::uint64_t value_of(std::size_t bucket) noexcept
+{
+    if (bucket < (std::size_t{1} << kSub))
+        return bucket;
+    const unsigned shift = static_cast<unsigned>(bucket >> (kSub - 1)) - 1;
+    const std::uint64_t mantissa = bucket - (std::size_t{shift} << (kSub - 1));
+    return (mantissa << shift) + ((std::uint64_t{1} << shift) >> 1);
+}
+
+} // namespace
+
+void LatencyHistogram::record(std::uint64_t value_ns) noexcept
+{
+    buckets_[bucket_of(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t seen = max_.load(std::memory_order_relaxed);
+    while (value_ns > seen && !max_.compare_exchange_weak(seen, value_ns, std::memory_order_relaxed)) {
+    }
+}
+
+std::uint64_t LatencyHistogram::percentile(double q) const noexcept
+{
+    const std::uint64_t total = count();
+    if (total == 0)
+        return 0;
+    const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * total)));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(value_of(i), max());
+    }
+    return max();
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const noexcept
+{
+    return {count(), percentile(0.50), percentile(0.99), percentile(0.999), max()};
+}
+
+void LatencyHistogram::reset() noexcept
+{
+    for (std::atomic<std::uint64_t>& b : buckets_)
+        b.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+} // namespace dispctrl
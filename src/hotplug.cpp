@@ -0,0 +1,332 @@
+#include "dispctrl/hotplug.hpp"
+
+#include <linux/filter.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <string_view>
+
+namespace dispctrl {
+
+namespace {
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+/// Kernel uevent multicast group (udevd rebroadcasts on group 2).
+constexpr unsigned kKernelGroup = 1;
+
+template <typename T>
+bool parse_number(std::string_view s, T& out) noexcept
+{
+    const auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc{} && end == s.data() + s.size();
+}
+
+bool same_display(const ConnectorInfo& a, const ConnectorInfo& b) noexcept
+{
+    // Through an EdidCache an unchanged EDID is the same object; without
+    // one, or once its entry was evicted, every probe decodes a new one.
+    return a.display == b.display || (a.display && b.display && *a.display == *b.display);
+}
+
+bool same_state(const ConnectorInfo& a, const ConnectorInfo& b) noexcept
+{
+    return a.status == b.status && a.modes == b.modes && same_display(a, b) && a.width_mm == b.width_mm &&
+           a.height_mm == b.height_mm;
+}
+
+} // namespace
+
+bool parse_drm_uevent(std::span<const char> msg, DrmUevent& out) noexcept
+{
+    constexpr std::string_view kChange = "change@";
+    const std::string_view all(msg.data(), msg.size());
+    if (!all.starts_with(kChange))
+        return false;
+
+    DrmUevent ev;
+    bool drm = false, hotplug = false;
+    // The "action@devpath" header, then NUL-separated KEY=value pairs.
+    for (std::size_t pos = all.find('\0'); pos != std::string_view::npos && pos + 1 < all.size();) {
+        const std::size_t end = std::min(all.find('\0', pos + 1), all.size());
+        const std::string_view field = all.substr(pos + 1, end - pos - 1);
+        pos = end;
+        const std::size_t eq = field.find('=');
+        if (eq == std::string_view::npos)
+            continue;
+        const std::string_view key = field.substr(0, eq);
+        const std::string_view value = field.substr(eq + 1);
+        if (key == "SUBSYSTEM")
+            drm = value == "drm";
+        else if (key == "HOTPLUG")
+            hotplug = value == "1";
+        else if (key == "CONNECTOR")
+            parse_number(value, ev.connector_id);
+        else if (key == "PROPERTY")
+            parse_number(value, ev.property_id);
+        else if (key == "SEQNUM")
+            parse_number(value, ev.seqnum);
+        else if (key == "DEVNAME" && value.starts_with("dri/card"))
+            parse_number(value.substr(8), ev.card);
+    }
+    if (!drm || !hotplug)
+        return false;
+    out = ev;
+    return true;
+}
+
+std::unique_ptr<UeventSocket> UeventSocket::open()
+{
+    UniqueFd fd(::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT));
+    if (!fd)
+        throw std::system_error(last_error(), "uevent socket");
+
+    // Accept only messages starting with "change@"; the loads are big
+    // endian.
+    sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x6368616e, 0, 5), // "chan"
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x6765, 0, 3), // "ge"
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 6),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, '@', 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    const sock_fprog prog{static_cast<unsigned short>(std::size(code)), code};
+    if (::setsockopt(fd.get(), SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != 0)
+        throw std::system_error(last_error(), "uevent socket filter");
+
+    // Room for the burst a dock with several outputs produces; the forced
+    // size needs CAP_NET_ADMIN.
+    const int size = 1 << 20;
+    if (::setsockopt(fd.get(), SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0)
+        ::setsockopt(fd.get(), SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = kKernelGroup;
+    if (::bind(fd.get(), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+        throw std::system_error(last_error(), "uevent socket bind");
+    return std::unique_ptr<UeventSocket>(new UeventSocket(std::move(fd)));
+}
+
+std::error_code UeventSocket::read(std::span<DrmUevent> out, std::size_t& count) noexcept
+{
+    count = 0;
+    char buf[8192];
+    while (count < out.size()) {
+        sockaddr_nl addr{};
+        iovec iov{buf, sizeof(buf)};
+        msghdr msg{};
+        msg.msg_name = &addr;
+        msg.msg_namelen = sizeof(addr);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        const ssize_t n = ::recvmsg(fd_.get(), &msg, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return {};
+            if (errno == ENOBUFS) {
+                ++stats_.overruns;
+                return std::make_error_code(std::errc::no_buffer_space);
+            }
+            return last_error();
+        }
+        // Only the kernel sends with port id 0.
+        if (addr.nl_pid != 0 || (msg.msg_flags & MSG_TRUNC))
+            continue;
+        ++stats_.received;
+        if (parse_drm_uevent({buf, static_cast<std::size_t>(n)}, out[count]))
+            ++count;
+        else
+            ++stats_.filtered;
+    }
+    return {};
+}
+
+std::error_code DrmConnectorProber::probe(std::uint32_t connector_id, ConnectorInfo& out)
+{
+    // Forced: the cached mode list would still be the previous monitor's
+    // after a swap. Only this connector is probed.
+    return probe_connector(device_, connector_id, true, edids_, out);
+}
+
+std::error_code DrmConnectorProber::connectors(std::vector<std::uint32_t>& out)
+{
+    CardResources res;
+    if (std::error_code ec = get_card_resources(device_, res))
+        return ec;
+    out = std::move(res.connectors);
+    return {};
+}
+
+HotplugMonitor::HotplugMonitor(ConnectorProber& prober, int card, ChangeCallback callback, HotplugDebounce debounce)
+    : prober_(prober), card_(card), callback_(std::move(callback)), debounce_(debounce)
+{
+}
+
+void HotplugMonitor::seed(std::span<const ConnectorInfo> connectors)
+{
+    for (const ConnectorInfo& info : connectors) {
+        Connector& c = connectors_[info.connector_id];
+        c.info = info;
+        c.known = true;
+    }
+}
+
+void HotplugMonitor::schedule(Connector& c, std::uint64_t now_ns)
+{
+    if (c.window_events == 0 || now_ns - c.window_start_ns > debounce_.flap_window_ns) {
+        c.window_start_ns = now_ns;
+        c.window_events = 0;
+    }
+    ++c.window_events;
+    std::uint64_t settle = debounce_.settle_ns;
+    if (c.window_events > debounce_.flap_threshold) {
+        const unsigned doublings = std::min(c.window_events - debounce_.flap_threshold, 32u);
+        settle = doublings >= 32 || settle > (debounce_.max_settle_ns >> doublings) ? debounce_.max_settle_ns
+                                                                                    : settle << doublings;
+    }
+    if (c.pending)
+        ++stats_.debounced;
+    else
+        c.first_event_ns = now_ns;
+    c.pending = true;
+    c.deadline_ns = std::min(now_ns + settle, c.first_event_ns + debounce_.max_settle_ns);
+}
+
+void HotplugMonitor::on_uevent(const DrmUevent& event, std::uint64_t now_ns)
+{
+    if (card_ >= 0 && event.card >= 0 && event.card != card_)
+        return;
+    ++stats_.events;
+    if (event.connector_id == 0) {
+        rescan(now_ns);
+        return;
+    }
+    Connector& c = connectors_[event.connector_id];
+    if (event.property_id == 0) {
+        schedule(c, now_ns);
+        return;
+    }
+    // Property changes are not flaps of the link; they are passed on at
+    // the next poll(), once each.
+    if (std::find(c.properties.begin(), c.properties.end(), event.property_id) == c.properties.end())
+        c.properties.push_back(event.property_id);
+    else
+        ++stats_.debounced;
+    if (property_ns_ == 0)
+        property_ns_ = now_ns ? now_ns : 1;
+}
+
+void HotplugMonitor::rescan(std::uint64_t now_ns)
+{
+    if (rescan_)
+        ++stats_.debounced;
+    rescan_ = true;
+    rescan_deadline_ns_ = now_ns + debounce_.settle_ns;
+}
+
+std::uint64_t HotplugMonitor::next_deadline() const noexcept
+{
+    std::uint64_t next = property_ns_;
+    const auto earlier = [&next](std::uint64_t t) { next = next == 0 ? t : std::min(next, t); };
+    if (rescan_)
+        earlier(rescan_deadline_ns_);
+    for (const auto& [id, c] : connectors_)
+        if (c.pending)
+            earlier(c.deadline_ns);
+    return next;
+}
+
+const ConnectorInfo* HotplugMonitor::connector(std::uint32_t connector_id) const noexcept
+{
+    const auto it = connectors_.find(connector_id);
+    return it != connectors_.end() && it->second.known ? &it->second.info : nullptr;
+}
+
+void HotplugMonitor::emit(ConnectorChange::Kind kind, std::uint32_t id, std::uint32_t property_id,
+                          const ConnectorInfo* info)
+{
+    if (callback_)
+        callback_({kind, id, property_id, info});
+}
+
+void HotplugMonitor::reprobe(std::uint32_t id, Connector& c)
+{
+    c.pending = false;
+    ++stats_.probes;
+    ConnectorInfo info;
+    if (prober_.probe(id, info)) {
+        ++stats_.errors;
+        return;
+    }
+    const bool was_known = c.known;
+    const bool was_connected = c.known && c.info.connected();
+    if (was_known && same_state(c.info, info)) {
+        ++stats_.unchanged;
+        return;
+    }
+    c.info = std::move(info);
+    c.known = true;
+    if (c.info.connected())
+        emit(was_connected ? ConnectorChange::Kind::Updated : ConnectorChange::Kind::Connected, id, 0, &c.info);
+    else if (was_connected)
+        emit(ConnectorChange::Kind::Disconnected, id, 0, &c.info);
+    else if (!was_known)
+        return; // a new connector with nothing plugged in
+    else
+        ++stats_.unchanged;
+}
+
+void HotplugMonitor::scan()
+{
+    ++stats_.rescans;
+    if (prober_.connectors(ids_)) {
+        ++stats_.errors;
+        return;
+    }
+    std::vector<std::uint32_t> removed;
+    for (const auto& [id, c] : connectors_)
+        if (std::find(ids_.begin(), ids_.end(), id) == ids_.end())
+            removed.push_back(id);
+    for (std::uint32_t id : removed) {
+        const bool known = connectors_[id].known;
+        connectors_.erase(id);
+        if (known)
+            emit(ConnectorChange::Kind::Removed, id, 0, nullptr);
+    }
+    for (std::uint32_t id : ids_)
+        reprobe(id, connectors_[id]);
+}
+
+void HotplugMonitor::poll(std::uint64_t now_ns)
+{
+    if (rescan_ && rescan_deadline_ns_ <= now_ns) {
+        rescan_ = false;
+        scan(); // probes the pending connectors as well
+    }
+    for (auto& [id, c] : connectors_)
+        if (c.pending && c.deadline_ns <= now_ns)
+            reprobe(id, c);
+
+    if (property_ns_ == 0 || property_ns_ > now_ns)
+        return;
+    property_ns_ = 0;
+    for (auto& [id, c] : connectors_) {
+        for (std::uint32_t prop : c.properties)
+            emit(ConnectorChange::Kind::Property, id, prop, c.known ? &c.info : nullptr);
+        c.properties.clear();
+    }
+}
+
+} // namespace dispctrl
@@ -0,0 +1,121 @@
+#include "dispctrl/idle_scheduler.hpp"
+
+#include "dispctrl/unique_fd.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr off_t kDpcdPsrSupport = 0x070; // DP_PSR_SUPPORT, followed by DP_PSR_CAPS
+constexpr std::uint8_t kPsrSetupTimeMask = 0x0e;
+constexpr std::uint8_t kPsrSetupTimeShift = 1;
+constexpr std::uint8_t kPsr2SuGranularity = 0x20;
+
+// DP_PSR_CAPS setup time field; encodings past 6 are reserved.
+constexpr std::uint32_t kPsrSetupTimesUs[] = {330, 275, 220, 165, 110, 55, 0};
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+} // namespace
+
+std::error_code read_psr_caps(const std::string& aux_dev, PsrCaps& caps) noexcept
+{
+    UniqueFd fd(::open(aux_dev.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd)
+        return last_error();
+    // Each read is an AUX transaction; the chardev maps file offsets to
+    // DPCD addresses.
+    std::uint8_t dpcd[2];
+    ssize_t n;
+    while ((n = ::pread(fd.get(), dpcd, sizeof(dpcd), kDpcdPsrSupport)) < 0 && errno == EINTR) {
+    }
+    if (n < 0)
+        return last_error();
+    if (n != sizeof(dpcd))
+        return std::make_error_code(std::errc::io_error);
+
+    caps = PsrCaps{};
+    if (dpcd[0] > static_cast<std::uint8_t>(PsrCaps::Version::Psr2EarlyTransport))
+        caps.version = PsrCaps::Version::Psr2EarlyTransport; // newer revisions keep the older features
+    else
+        caps.version = static_cast<PsrCaps::Version>(dpcd[0]);
+    const unsigned setup = (dpcd[1] & kPsrSetupTimeMask) >> kPsrSetupTimeShift;
+    caps.setup_time_us = setup < std::size(kPsrSetupTimesUs) ? kPsrSetupTimesUs[setup] : kPsrSetupTimesUs[0];
+    caps.su_granularity_required = caps.selective_update() && (dpcd[1] & kPsr2SuGranularity);
+    return {};
+}
+
+std::string find_dp_aux(const std::string& connector_dir)
+{
+    std::string found;
+    if (DIR* d = ::opendir(connector_dir.c_str())) {
+        while (const dirent* e = ::readdir(d)) {
+            if (std::strncmp(e->d_name, "drm_dp_aux", 10) == 0) {
+                found = std::string("/dev/") + e->d_name;
+                break;
+            }
+        }
+        ::closedir(d);
+    }
+    return found;
+}
+
+bool IdleScheduler::on_activity(std::uint64_t now_ns)
+{
+    last_change_ns_ = now_ns;
+    if (state_ != State::Idle)
+        return false;
+    wake(now_ns);
+    return true;
+}
+
+bool IdleScheduler::begin_frame(bool dirty, std::uint64_t now_ns)
+{
+    ++stats_.frames;
+    if (dirty) {
+        ++stats_.committed;
+        last_change_ns_ = now_ns;
+        if (state_ == State::Idle)
+            wake(now_ns); // a tick the loop had already scheduled
+        state_ = State::Active;
+        return true;
+    }
+
+    ++stats_.suppressed;
+    if (state_ == State::Active)
+        state_ = State::Suppressing;
+    if (state_ == State::Suppressing && now_ns - last_change_ns_ >= policy_.idle_timeout_ns) {
+        state_ = State::Idle;
+        idle_since_ns_ = now_ns;
+        ++stats_.idle_entries;
+        if (idle_cb_)
+            idle_cb_(true);
+    }
+    return false;
+}
+
+std::uint64_t IdleScheduler::idle_deadline() const noexcept
+{
+    return state_ == State::Suppressing ? last_change_ns_ + policy_.idle_timeout_ns : 0;
+}
+
+void IdleScheduler::wake(std::uint64_t now_ns)
+{
+    stats_.idle_ns += now_ns - idle_since_ns_;
+    state_ = State::Active;
+    if (idle_cb_)
+        idle_cb_(false);
+}
+
+} // namespace dispctrl
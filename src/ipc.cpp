@@ -0,0 +1,632 @@
+#include "dispctrl/ipc.hpp"
+
+#include "dispctrl/spsc_ring.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace dispctrl {
+
+namespace ipc {
+
+inline constexpr std::uint32_t kChannelMagic = 0x4e484344; // "DCHN"
+
+/// Start of every client's memfd, constructed by the daemon.
+///
+/// A consumer about to sleep on its doorbell sets its *_sleeping flag and
+/// checks its ring once more; a producer rings the doorbell only if it
+/// finds the flag set after pushing. Fences on both sides make that
+/// Dekker-style handshake lose no wakeup.
+struct Channel {
+    std::uint32_t magic = kChannelMagic;
+    std::uint32_t version = kIpcVersion;
+    alignas(kCacheLine) std::atomic<std::uint32_t> server_sleeping{1};
+    alignas(kCacheLine) std::atomic<std::uint32_t> client_sleeping{0};
+    SpscRing<IpcLayerUpdate, IpcServer::kUpdateRing> updates; ///< Client to daemon.
+    SpscRing<IpcEvent, IpcServer::kEventRing> events;         ///< Daemon to client.
+};
+
+static_assert(std::atomic<std::size_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+              "ring indices are shared between processes");
+static_assert(std::is_trivially_copyable_v<IpcLayerUpdate> && std::is_trivially_copyable_v<IpcEvent>);
+
+enum class MessageType : std::uint32_t { Hello, Welcome, Attach, Detach };
+
+/// Control datagram; fds travel alongside as SCM_RIGHTS.
+struct Message {
+    MessageType type;
+    std::uint32_t version;
+    std::uint32_t buffer_id;
+    DmaBufDesc buffer; ///< Attach; plane fds are the ones received, in order.
+};
+
+static_assert(std::is_trivially_copyable_v<Message>);
+
+/// Largest fd count of one message: a buffer's planes, or the handshake's
+/// memfd and two eventfds.
+inline constexpr std::size_t kMaxFds = 4;
+static_assert(sizeof(DmaBufDesc::planes) / sizeof(DmaBufDesc::Plane) == kMaxFds);
+
+} // namespace ipc
+
+namespace {
+
+constexpr std::uint64_t kListenTag = ~std::uint64_t{0};
+constexpr std::uint64_t kDoorbellBit = 1;
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+UniqueFd make_eventfd()
+{
+    int fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0)
+        throw std::system_error(last_error(), "eventfd");
+    return UniqueFd(fd);
+}
+
+void signal_eventfd(int fd) noexcept
+{
+    const std::uint64_t one = 1;
+    // EAGAIN means the counter is saturated, i.e. already signalled.
+    [[maybe_unused]] ssize_t ret = ::write(fd, &one, sizeof(one));
+}
+
+void clear_eventfd(int fd) noexcept
+{
+    std::uint64_t value;
+    [[maybe_unused]] ssize_t ret = ::read(fd, &value, sizeof(value));
+}
+
+// Producer side, after a push.
+void wake(std::atomic<std::uint32_t>& sleeping, int doorbell) noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(0, std::memory_order_relaxed))
+        signal_eventfd(doorbell);
+}
+
+// Consumer side, after finding the ring empty: true if it still is and
+// the producer will ring.
+template <typename Ring>
+bool sleep_if_empty(std::atomic<std::uint32_t>& sleeping, const Ring& ring) noexcept
+{
+    sleeping.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ring.empty())
+        return true;
+    sleeping.store(0, std::memory_order_relaxed);
+    return false;
+}
+
+bool make_address(const std::string& path, sockaddr_un& addr, socklen_t& len) noexcept
+{
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return false;
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    if (path[0] == '@')
+        addr.sun_path[0] = '\0'; // abstract: the name is not NUL-terminated
+    len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + (path[0] == '@' ? 0 : 1));
+    return true;
+}
+
+std::error_code send_message(int socket, const ipc::Message& message, std::span<const int> fds) noexcept
+{
+    iovec iov{const_cast<ipc::Message*>(&message), sizeof(message)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * ipc::kMaxFds)] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (!fds.empty()) {
+        if (fds.size() > ipc::kMaxFds)
+            return std::make_error_code(std::errc::invalid_argument);
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    }
+    while (::sendmsg(socket, &msg, MSG_NOSIGNAL) < 0) {
+        if (errno != EINTR)
+            return last_error();
+    }
+    return {};
+}
+
+// Receives one message into @p message and its fds into @p fds (owned,
+// close-on-exec). Returns 0 on success, EOF as errc::connection_reset,
+// and errc::bad_message for anything malformed.
+std::error_code recv_message(int socket, ipc::Message& message, std::array<UniqueFd, ipc::kMaxFds>& fds,
+                             std::size_t& fd_count, int flags) noexcept
+{
+    iovec iov{&message, sizeof(message)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * ipc::kMaxFds)];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    while ((n = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC | flags)) < 0) {
+        if (errno != EINTR)
+            return last_error();
+    }
+    fd_count = 0;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        const std::size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (std::size_t i = 0; i < count; ++i) {
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (fd_count < ipc::kMaxFds)
+                fds[fd_count++].reset(fd);
+            else
+                ::close(fd);
+        }
+    }
+    if (n == 0)
+        return std::make_error_code(std::errc::connection_reset);
+    if (static_cast<std::size_t>(n) != sizeof(message) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+        return std::make_error_code(std::errc::bad_message);
+    return {};
+}
+
+std::size_t channel_size() noexcept
+{
+    const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return (sizeof(ipc::Channel) + page - 1) / page * page;
+}
+
+} // namespace
+
+struct IpcServer::Client {
+    explicit Client(std::uint32_t id_, UniqueFd socket_) noexcept : id(id_), socket(std::move(socket_)) {}
+    ~Client()
+    {
+        if (channel) {
+            channel->~Channel();
+            ::munmap(channel, map_size);
+        }
+    }
+
+    std::uint32_t id;
+    UniqueFd socket;
+    UniqueFd doorbell;
+    UniqueFd notify;
+    ipc::Channel* channel = nullptr; ///< Set by the handshake.
+    std::size_t map_size = 0;
+    std::unordered_map<std::uint32_t, Buffer> buffers;
+    bool ready = false;   ///< Listed in ready_.
+    bool closing = false; ///< Listed in closing_.
+};
+
+IpcServer::IpcServer(const std::string& path, Handler& handler) : handler_(handler), path_(path)
+{
+    sockaddr_un addr;
+    socklen_t len;
+    if (!make_address(path, addr, len))
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument), "ipc socket path");
+
+    int fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(last_error(), "epoll_create1");
+    epoll_.reset(fd);
+
+    fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+        throw std::system_error(last_error(), "socket");
+    listen_.reset(fd);
+    if (path[0] != '@')
+        ::unlink(path.c_str()); // left behind by a daemon that did not exit cleanly
+    if (::bind(listen_.get(), reinterpret_cast<const sockaddr*>(&addr), len) != 0)
+        throw std::system_error(last_error(), "bind");
+    if (::listen(listen_.get(), SOMAXCONN) != 0)
+        throw std::system_error(last_error(), "listen");
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kListenTag;
+    if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, listen_.get(), &ev) != 0)
+        throw std::system_error(last_error(), "epoll_ctl");
+}
+
+IpcServer::~IpcServer()
+{
+    if (path_[0] != '@')
+        ::unlink(path_.c_str());
+}
+
+std::error_code IpcServer::dispatch(int timeout_ms)
+{
+    // Clients left with updates last time get their turn without waiting.
+    std::array<epoll_event, 64> events;
+    const int n = ::epoll_wait(epoll_.get(), events.data(), static_cast<int>(events.size()),
+                               ready_.empty() ? timeout_ms : 0);
+    if (n < 0 && errno != EINTR)
+        return last_error();
+
+    turn_.swap(ready_);
+    for (std::uint32_t id : turn_) {
+        const auto it = clients_.find(id);
+        if (it == clients_.end())
+            continue;
+        Client& c = *it->second;
+        c.ready = false;
+        if (!c.closing && drain(c) && !c.ready) {
+            c.ready = true;
+            ready_.push_back(id);
+        }
+    }
+    turn_.clear();
+
+    for (int i = 0; i < n; ++i) {
+        const std::uint64_t tag = events[static_cast<std::size_t>(i)].data.u64;
+        if (tag == kListenTag) {
+            accept_clients();
+            continue;
+        }
+        const auto it = clients_.find(static_cast<std::uint32_t>(tag >> 1));
+        if (it == clients_.end())
+            continue;
+        Client& c = *it->second;
+        if (c.closing)
+            continue;
+        if (!(tag & kDoorbellBit)) {
+            read_socket(c);
+            continue;
+        }
+        clear_eventfd(c.doorbell.get());
+        ++stats_.wakeups;
+        if (drain(c) && !c.ready) {
+            c.ready = true;
+            ready_.push_back(c.id);
+        }
+    }
+
+    for (std::uint32_t id : closing_)
+        remove(id);
+    closing_.clear();
+    return {};
+}
+
+void IpcServer::accept_clients()
+{
+    for (;;) {
+        const int fd = ::accept4(listen_.get(), nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0)
+            return; // EAGAIN, or a connection that went away meanwhile
+        UniqueFd socket(fd);
+        try {
+            const std::uint32_t id = next_id_++;
+            auto client = std::make_unique<Client>(id, std::move(socket));
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u64 = std::uint64_t{id} << 1;
+            if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, client->socket.get(), &ev) != 0) {
+                ++stats_.rejected;
+                continue;
+            }
+            clients_.emplace(id, std::move(client));
+        } catch (const std::bad_alloc&) {
+            ++stats_.rejected;
+        }
+    }
+}
+
+void IpcServer::read_socket(Client& c)
+{
+    for (;;) {
+        ipc::Message msg;
+        std::array<UniqueFd, ipc::kMaxFds> fds;
+        std::size_t fd_count = 0;
+        const std::error_code ec = recv_message(c.socket.get(), msg, fds, fd_count, MSG_DONTWAIT);
+        if (ec == std::errc::resource_unavailable_try_again || ec == std::errc::operation_would_block)
+            return;
+        if (ec) {
+            disconnect(c.id); // closed, or not speaking the protocol
+            return;
+        }
+
+        switch (msg.type) {
+        case ipc::MessageType::Hello:
+            if (c.channel || msg.version != kIpcVersion || !handshake(c)) {
+                ++stats_.rejected;
+                disconnect(c.id);
+                return;
+            }
+            break;
+        case ipc::MessageType::Attach:
+            if (!c.channel || !attach(c, msg, fds, fd_count)) {
+                disconnect(c.id);
+                return;
+            }
+            break;
+        case ipc::MessageType::Detach:
+            if (c.buffers.erase(msg.buffer_id))
+                handler_.on_detach(c.id, msg.buffer_id);
+            break;
+        default:
+            disconnect(c.id);
+            return;
+        }
+    }
+}
+
+bool IpcServer::handshake(Client& c)
+{
+    ucred cred{};
+    socklen_t cred_len = sizeof(cred);
+    if (::getsockopt(c.socket.get(), SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0)
+        return false;
+
+    UniqueFd memfd(::memfd_create("dispctrl-ipc", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    const std::size_t size = channel_size();
+    if (!memfd || ::ftruncate(memfd.get(), static_cast<off_t>(size)) != 0)
+        return false;
+    // A client that could shrink the file would fault the daemon on access.
+    if (::fcntl(memfd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0)
+        return false;
+    void* map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, memfd.get(), 0);
+    if (map == MAP_FAILED)
+        return false;
+    c.channel = new (map) ipc::Channel;
+    c.map_size = size;
+
+    try {
+        c.doorbell = make_eventfd();
+        c.notify = make_eventfd();
+    } catch (const std::system_error&) {
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = std::uint64_t{c.id} << 1 | kDoorbellBit;
+    if (::epoll_ctl(epoll_.get(), EPOLL_CTL_ADD, c.doorbell.get(), &ev) != 0)
+        return false;
+
+    ipc::Message welcome{};
+    welcome.type = ipc::MessageType::Welcome;
+    welcome.version = kIpcVersion;
+    const int fds[] = {memfd.get(), c.doorbell.get(), c.notify.get()};
+    if (send_message(c.socket.get(), welcome, fds))
+        return false;
+
+    ++stats_.connects;
+    handler_.on_connect(c.id, IpcPeer{cred.pid, cred.uid, cred.gid});
+    return true;
+}
+
+bool IpcServer::attach(Client& c, const ipc::Message& msg, std::array<UniqueFd, ipc::kMaxFds>& fds,
+                       std::size_t fd_count)
+{
+    const std::uint32_t planes = msg.buffer.plane_count;
+    if (msg.buffer_id == 0 || planes == 0 || planes > 4 || fd_count != planes)
+        return false;
+
+    Buffer buffer;
+    buffer.desc = msg.buffer;
+    for (std::uint32_t i = 0; i < planes; ++i) {
+        buffer.desc.planes[i].fd = fds[i].get();
+        buffer.fds[i] = std::move(fds[i]);
+    }
+    for (std::uint32_t i = planes; i < 4; ++i)
+        buffer.desc.planes[i] = {};
+    try {
+        Buffer& slot = c.buffers[msg.buffer_id]; // re-attaching an id replaces it
+        if (slot.desc.plane_count)
+            handler_.on_detach(c.id, msg.buffer_id);
+        slot = std::move(buffer);
+        ++stats_.attaches;
+        handler_.on_attach(c.id, msg.buffer_id, slot.desc);
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+    return true;
+}
+
+bool IpcServer::drain(Client& c)
+{
+    ipc::Channel& ch = *c.channel;
+    IpcLayerUpdate update;
+    for (std::size_t n = 0; n < kUpdateRing; ++n) {
+        if (!ch.updates.try_pop(update)) {
+            if (sleep_if_empty(ch.server_sleeping, ch.updates))
+                return false;
+            continue;
+        }
+        ++stats_.updates;
+        const DmaBufDesc* buffer = nullptr;
+        if (update.buffer_id) {
+            auto it = c.buffers.find(update.buffer_id);
+            if (it == c.buffers.end()) {
+                // The attach was sent first but its datagram may not have
+                // been read yet.
+                read_socket(c);
+                it = c.buffers.find(update.buffer_id);
+            }
+            if (it != c.buffers.end())
+                buffer = &it->second.desc;
+        }
+        if (c.closing)
+            return false;
+        handler_.on_update(c.id, update, buffer);
+        if (c.closing)
+            return false;
+    }
+    return true;
+}
+
+std::error_code IpcServer::post(std::uint32_t client, const IpcEvent& event) noexcept
+{
+    const auto it = clients_.find(client);
+    if (it == clients_.end() || !it->second->channel || it->second->closing)
+        return std::make_error_code(std::errc::invalid_argument);
+    Client& c = *it->second;
+    if (!c.channel->events.try_push(event)) {
+        ++stats_.overflows;
+        return std::make_error_code(std::errc::no_buffer_space);
+    }
+    wake(c.channel->client_sleeping, c.notify.get());
+    return {};
+}
+
+void IpcServer::disconnect(std::uint32_t client)
+{
+    const auto it = clients_.find(client);
+    if (it == clients_.end() || it->second->closing)
+        return;
+    it->second->closing = true;
+    closing_.push_back(client);
+}
+
+void IpcServer::remove(std::uint32_t client)
+{
+    const auto it = clients_.find(client);
+    if (it == clients_.end())
+        return;
+    Client& c = *it->second;
+    ::epoll_ctl(epoll_.get(), EPOLL_CTL_DEL, c.socket.get(), nullptr);
+    if (c.doorbell)
+        ::epoll_ctl(epoll_.get(), EPOLL_CTL_DEL, c.doorbell.get(), nullptr);
+    const bool connected = c.channel != nullptr;
+    for (const auto& [buffer_id, buffer] : c.buffers)
+        handler_.on_detach(client, buffer_id);
+    c.buffers.clear();
+    clients_.erase(it);
+    if (connected) {
+        ++stats_.disconnects;
+        handler_.on_disconnect(client);
+    }
+}
+
+IpcClient::IpcClient(const std::string& path)
+{
+    sockaddr_un addr;
+    socklen_t len;
+    if (!make_address(path, addr, len))
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument), "ipc socket path");
+    socket_.reset(::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0));
+    if (!socket_)
+        throw std::system_error(last_error(), "socket");
+    if (::connect(socket_.get(), reinterpret_cast<const sockaddr*>(&addr), len) != 0)
+        throw std::system_error(last_error(), "connect");
+
+    ipc::Message hello{};
+    hello.type = ipc::MessageType::Hello;
+    hello.version = kIpcVersion;
+    if (std::error_code ec = send_message(socket_.get(), hello, {}))
+        throw std::system_error(ec, "ipc hello");
+
+    ipc::Message welcome;
+    std::array<UniqueFd, ipc::kMaxFds> fds;
+    std::size_t fd_count = 0;
+    if (std::error_code ec = recv_message(socket_.get(), welcome, fds, fd_count, 0))
+        throw std::system_error(ec, "ipc welcome");
+    if (welcome.type != ipc::MessageType::Welcome || welcome.version != kIpcVersion || fd_count != 3)
+        throw std::system_error(std::make_error_code(std::errc::protocol_error), "ipc welcome");
+
+    struct stat st;
+    if (::fstat(fds[0].get(), &st) != 0)
+        throw std::system_error(last_error(), "fstat");
+    map_size_ = static_cast<std::size_t>(st.st_size);
+    if (map_size_ < sizeof(ipc::Channel))
+        throw std::system_error(std::make_error_code(std::errc::protocol_error), "ipc channel");
+    void* map = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0].get(), 0);
+    if (map == MAP_FAILED)
+        throw std::system_error(last_error(), "mmap");
+    channel_ = static_cast<ipc::Channel*>(map);
+    if (channel_->magic != ipc::kChannelMagic || channel_->version != kIpcVersion) {
+        ::munmap(map, map_size_);
+        throw std::system_error(std::make_error_code(std::errc::protocol_error), "ipc channel");
+    }
+    doorbell_ = std::move(fds[1]);
+    notify_ = std::move(fds[2]);
+}
+
+IpcClient::~IpcClient()
+{
+    // The daemon constructed the channel and destroys it; only unmap.
+    if (channel_)
+        ::munmap(channel_, map_size_);
+}
+
+std::error_code IpcClient::attach_buffer(std::uint32_t buffer_id, const DmaBufDesc& desc) noexcept
+{
+    if (buffer_id == 0 || desc.plane_count == 0 || desc.plane_count > 4)
+        return std::make_error_code(std::errc::invalid_argument);
+    ipc::Message msg{};
+    msg.type = ipc::MessageType::Attach;
+    msg.version = kIpcVersion;
+    msg.buffer_id = buffer_id;
+    msg.buffer = desc;
+    int fds[4];
+    for (std::uint32_t i = 0; i < desc.plane_count; ++i) {
+        fds[i] = desc.planes[i].fd;
+        msg.buffer.planes[i].fd = -1; // meaningless on the other side
+    }
+    return send_message(socket_.get(), msg, {fds, desc.plane_count});
+}
+
+std::error_code IpcClient::detach_buffer(std::uint32_t buffer_id) noexcept
+{
+    ipc::Message msg{};
+    msg.type = ipc::MessageType::Detach;
+    msg.version = kIpcVersion;
+    msg.buffer_id = buffer_id;
+    return send_message(socket_.get(), msg, {});
+}
+
+std::error_code IpcClient::submit(const IpcLayerUpdate& update) noexcept
+{
+    if (!channel_->updates.try_push(update))
+        return std::make_error_code(std::errc::no_buffer_space);
+    wake(channel_->server_sleeping, doorbell_.get());
+    return {};
+}
+
+std::size_t IpcClient::read_events(std::span<IpcEvent> out) noexcept
+{
+    clear_eventfd(notify_.get());
+    std::size_t count = 0;
+    while (count < out.size()) {
+        if (channel_->events.try_pop(out[count])) {
+            ++count;
+            continue;
+        }
+        if (sleep_if_empty(channel_->client_sleeping, channel_->events))
+            break;
+    }
+    return count;
+}
+
+bool IpcClient::connected() const noexcept
+{
+    pollfd pfd{socket_.get(), POLLIN, 0};
+    return ::poll(&pfd, 1, 0) == 0 || !(pfd.revents & (POLLHUP | POLLERR));
+}
+
+} // namespace dispctrl
@@ -0,0 +1,138 @@
+#include "dispctrl/kms_shadow.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace dispctrl {
+
+namespace {
+
+// For std::lower_bound over KmsShadow::values_ by key.
+constexpr auto by_key = [](const auto& entry, std::uint64_t key) { return entry.key < key; };
+
+// std::lower_bound for a sweep in key order: probes 1, 2, 4, ... entries
+// ahead of @p first before bisecting, so a request that writes most of the
+// shadow costs about a comparison per write and a sparse one stays
+// logarithmic.
+template <class It>
+It seek(It first, It last, std::uint64_t key) noexcept
+{
+    std::ptrdiff_t step = 1;
+    while (step < last - first && first[step - 1].key < key) {
+        first += step;
+        step *= 2;
+    }
+    return std::lower_bound(first, last - first > step ? first + step : last, key, by_key);
+}
+
+} // namespace
+
+void KmsShadow::add_volatile(std::uint32_t prop_id)
+{
+    if (!is_volatile(prop_id))
+        volatile_.push_back(prop_id);
+}
+
+bool KmsShadow::is_volatile(std::uint32_t prop_id) const noexcept
+{
+    return std::find(volatile_.begin(), volatile_.end(), prop_id) != volatile_.end();
+}
+
+bool KmsShadow::matches(std::uint32_t object_id, std::uint32_t prop_id, std::uint64_t value) const noexcept
+{
+    const std::uint64_t k = key(object_id, prop_id);
+    const auto it = std::lower_bound(values_.begin(), values_.end(), k, by_key);
+    return it != values_.end() && it->key == k && it->value == value;
+}
+
+bool KmsShadow::matches_blob(std::uint32_t object_id, std::uint32_t prop_id, const void* data, std::size_t size,
+                             std::uint32_t& blob_id) const noexcept
+{
+    const auto it = blobs_.find(key(object_id, prop_id));
+    if (it == blobs_.end() || !matches(object_id, prop_id, it->second.blob_id))
+        return false; // unknown, or overwritten by a plain write since
+    const std::vector<std::uint8_t>& held = it->second.data;
+    if (held.size() != size || (size && std::memcmp(held.data(), data, size) != 0))
+        return false;
+    blob_id = it->second.blob_id;
+    return true;
+}
+
+std::size_t KmsShadow::filter(AtomicRequest& request) noexcept
+{
+    stats_.checked += request.props().size();
+    // Locals, since the compaction's stores could alias the members.
+    const Value* it = values_.data();
+    const Value* const end = it + values_.size();
+    const std::uint32_t* const vol = volatile_.data();
+    const std::uint32_t* const vol_end = vol + volatile_.size();
+    const std::size_t dropped = request.erase_if([&](std::uint32_t object_id, std::uint32_t prop_id, std::uint64_t value) {
+        if (vol != vol_end && std::find(vol, vol_end, prop_id) != vol_end)
+            return false;
+        // The request is sorted by key too: each search starts where the
+        // previous one ended.
+        const std::uint64_t k = key(object_id, prop_id);
+        if (it != end && it->key < k && (++it == end || it->key < k))
+            it = seek(it, end, k); // the common case is the very next entry
+        return it != end && it->key == k && it->value == value;
+    });
+    stats_.unchanged += dropped;
+    return dropped;
+}
+
+void KmsShadow::record(const AtomicRequest& request) noexcept
+try {
+    const auto objects = request.objects();
+    const auto counts = request.prop_counts();
+    const auto props = request.props();
+    const auto values = request.values();
+
+    std::size_t pos = 0; // index into values_; the request is sorted
+    std::size_t p = 0;
+    for (std::size_t o = 0; o < objects.size(); ++o) {
+        for (const std::size_t end = p + counts[o]; p < end; ++p) {
+            if (is_volatile(props[p]))
+                continue;
+            const std::uint64_t k = key(objects[o], props[p]);
+            pos = static_cast<std::size_t>(seek(values_.begin() + static_cast<std::ptrdiff_t>(pos), values_.end(), k) -
+                                           values_.begin());
+            if (pos < values_.size() && values_[pos].key == k)
+                values_[pos].value = values[p];
+            else
+                values_.insert(values_.begin() + static_cast<std::ptrdiff_t>(pos), Value{k, values[p]});
+            ++stats_.recorded;
+        }
+    }
+} catch (const std::bad_alloc&) {
+    invalidate(); // unknown beats stale
+}
+
+void KmsShadow::record_blob(std::uint32_t object_id, std::uint32_t prop_id, std::uint32_t blob_id, const void* data,
+                            std::size_t size) noexcept
+try {
+    Blob& blob = blobs_[key(object_id, prop_id)];
+    blob.blob_id = blob_id;
+    const auto* bytes = static_cast<const std::uint8_t*>(data);
+    blob.data.assign(bytes, bytes + size);
+} catch (const std::bad_alloc&) {
+    invalidate();
+}
+
+void KmsShadow::forget(std::uint32_t object_id) noexcept
+{
+    const auto first = std::lower_bound(values_.begin(), values_.end(), key(object_id, 0), by_key);
+    auto last = first;
+    while (last != values_.end() && last->key >> 32 == object_id)
+        ++last;
+    values_.erase(first, last);
+    std::erase_if(blobs_, [&](const auto& entry) { return entry.first >> 32 == object_id; });
+}
+
+void KmsShadow::invalidate() noexcept
+{
+    values_.clear();
+    blobs_.clear();
+}
+
+} // namespace dispctrl
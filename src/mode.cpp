@@ -0,0 +1,16 @@
+#include "dispctrl/mode.hpp"
+
+#include <cstdio>
+
+namespace dispctrl {
+
+std::string ModeInfo::name() const
+{
+    const std::uint32_t mhz = refresh_mhz();
+    char buf[48];
+    std::snprintf(buf, sizeof(buf), "%ux%u%s@%u.%02u", hdisplay, vdisplay, (flags & Interlace) ? "i" : "",
+                  mhz / 1000, (mhz % 1000) / 10);
+    return buf;
+}
+
+} // namespace dispctrl
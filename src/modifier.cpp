@@ -0,0 +1,217 @@
+#include "dispctrl/modifier.hpp"
+
+#include "drm_uapi.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace dispctrl {
+
+namespace {
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+constexpr std::uint64_t kValueMask = 0x00ffffffffffffffULL;
+
+} // namespace
+
+LayoutClass classify_modifier(std::uint64_t m) noexcept
+{
+    if (m == modifier::Invalid)
+        return LayoutClass::Implicit;
+    if (m == modifier::Linear)
+        return LayoutClass::Linear;
+
+    const std::uint64_t value = m & kValueMask;
+    bool compressed = false;
+    switch (modifier::vendor(m)) {
+    case modifier::Vendor::Intel:
+        // X, Y, Yf and 4 tiling are 1, 2, 3 and 9; every other value is a
+        // CCS variant of one of them.
+        compressed = value != 1 && value != 2 && value != 3 && value != 9;
+        break;
+    case modifier::Vendor::Amd:
+        compressed = (value >> 13) & 1; // AMD_FMT_MOD_DCC
+        break;
+    case modifier::Vendor::Nvidia:
+        compressed = (value & 0x10) && ((value >> 23) & 7) != 0; // block linear, compression kind
+        break;
+    case modifier::Vendor::Qcom:
+        compressed = value == 1; // DRM_FORMAT_MOD_QCOM_COMPRESSED
+        break;
+    case modifier::Vendor::Arm: {
+        const std::uint64_t type = (value >> 52) & 0xf;
+        compressed = type == 0 || type == 2; // AFBC, AFRC
+        break;
+    }
+    default:
+        break;
+    }
+    return compressed ? LayoutClass::Compressed : LayoutClass::Tiled;
+}
+
+std::error_code parse_in_formats(std::span<const std::uint8_t> blob, std::vector<PlaneFormat>& out)
+{
+    out.clear();
+    uapi::drm_format_modifier_blob header;
+    if (blob.size() < sizeof(header))
+        return std::make_error_code(std::errc::invalid_argument);
+    std::memcpy(&header, blob.data(), sizeof(header));
+    const std::uint64_t formats_end = std::uint64_t{header.formats_offset} + std::uint64_t{header.count_formats} * 4;
+    const std::uint64_t modifiers_end =
+        std::uint64_t{header.modifiers_offset} + std::uint64_t{header.count_modifiers} * sizeof(uapi::drm_format_modifier);
+    if (header.version != 1 || formats_end > blob.size() || modifiers_end > blob.size())
+        return std::make_error_code(std::errc::invalid_argument);
+
+    try {
+        std::vector<std::uint32_t> formats(header.count_formats);
+        std::memcpy(formats.data(), blob.data() + header.formats_offset, formats.size() * 4);
+        // Kernel order is by modifier, which is the driver's preference
+        // order; keep it.
+        for (std::uint32_t i = 0; i < header.count_modifiers; ++i) {
+            uapi::drm_format_modifier mod;
+            std::memcpy(&mod, blob.data() + header.modifiers_offset + i * sizeof(mod), sizeof(mod));
+            for (std::uint64_t bits = mod.formats; bits; bits &= bits - 1) {
+                const std::uint64_t index = std::uint64_t{mod.offset} + static_cast<unsigned>(__builtin_ctzll(bits));
+                if (index < formats.size())
+                    out.push_back({formats[index], mod.modifier});
+            }
+        }
+        return {};
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+}
+
+std::error_code read_plane_formats(const DrmDevice& device, std::uint32_t plane_id, std::vector<PlaneFormat>& out)
+{
+    out.clear();
+    std::uint32_t prop;
+    std::uint64_t blob_id = 0;
+    if (device.supports_modifiers() &&
+        !device.get_property(plane_id, ObjectType::Plane, "IN_FORMATS", prop, blob_id) && blob_id) {
+        std::vector<std::uint8_t> blob;
+        if (std::error_code ec = device.read_blob(static_cast<std::uint32_t>(blob_id), blob))
+            return ec;
+        return parse_in_formats(blob, out);
+    }
+
+    try {
+        uapi::drm_mode_get_plane req{};
+        req.plane_id = plane_id;
+        if (uapi::drm_ioctl(device.fd(), uapi::DRM_IOCTL_MODE_GETPLANE, &req) != 0)
+            return last_error();
+        std::vector<std::uint32_t> formats(req.count_format_types);
+        req.format_type_ptr = uapi::to_user_ptr(formats.data());
+        if (uapi::drm_ioctl(device.fd(), uapi::DRM_IOCTL_MODE_GETPLANE, &req) != 0)
+            return last_error();
+        formats.resize(std::min<std::size_t>(formats.size(), req.count_format_types));
+        for (std::uint32_t f : formats)
+            out.push_back({f, modifier::Linear});
+        return {};
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+}
+
+std::error_code negotiate_modifier(std::uint32_t fourcc, std::span<const PlaneFormat> producer,
+                                   std::span<const PlaneFormat> consumer, ModifierChoice& out)
+{
+    const PlaneFormat* best_common = nullptr;
+    const PlaneFormat* best_own = nullptr;
+    for (const PlaneFormat& p : producer) {
+        if (p.fourcc != fourcc || p.modifier == modifier::Invalid)
+            continue;
+        const LayoutClass cls = classify_modifier(p.modifier);
+        if (!best_own || cls > classify_modifier(best_own->modifier))
+            best_own = &p;
+        if (best_common && cls <= classify_modifier(best_common->modifier))
+            continue;
+        if (std::find(consumer.begin(), consumer.end(), p) != consumer.end())
+            best_common = &p;
+    }
+    if (!best_own)
+        return std::make_error_code(std::errc::not_supported);
+    out.direct = best_common != nullptr;
+    out.modifier = best_common ? best_common->modifier : best_own->modifier;
+    return {};
+}
+
+bool scanout_compatible(const DmaBufDesc& desc, std::span<const PlaneFormat> consumer,
+                        std::uint32_t linear_pitch_align) noexcept
+{
+    if (std::find(consumer.begin(), consumer.end(), PlaneFormat{desc.fourcc, desc.modifier}) == consumer.end())
+        return false;
+    if (desc.modifier == modifier::Linear && linear_pitch_align > 1) {
+        for (std::uint32_t i = 0; i < desc.plane_count && i < 4; ++i)
+            if (desc.planes[i].pitch % linear_pitch_align != 0)
+                return false;
+    }
+    return true;
+}
+
+std::size_t ModifierNegotiator::KeyHash::operator()(const Key& key) const noexcept
+{
+    const std::uint64_t v = (std::uint64_t{key.producer} << 32 | key.consumer) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<std::size_t>(v ^ (std::uint64_t{key.fourcc} * 0xc2b2ae3d27d4eb4fULL));
+}
+
+std::uint32_t ModifierNegotiator::add_device(std::vector<PlaneFormat> formats)
+{
+    auto list = std::make_shared<const std::vector<PlaneFormat>>(std::move(formats));
+    std::lock_guard lock(mutex_);
+    devices_.push_back(std::move(list));
+    return static_cast<std::uint32_t>(devices_.size() - 1);
+}
+
+void ModifierNegotiator::update(std::uint32_t device, std::vector<PlaneFormat> formats)
+{
+    auto list = std::make_shared<const std::vector<PlaneFormat>>(std::move(formats));
+    std::lock_guard lock(mutex_);
+    if (device >= devices_.size())
+        return;
+    devices_[device] = std::move(list);
+    std::erase_if(results_, [device](const auto& r) { return r.first.producer == device || r.first.consumer == device; });
+}
+
+std::error_code ModifierNegotiator::negotiate(std::uint32_t producer, std::uint32_t consumer, std::uint32_t fourcc,
+                                              ModifierChoice& out)
+{
+    const Key key{producer, consumer, fourcc};
+    FormatList from, to;
+    {
+        std::lock_guard lock(mutex_);
+        if (auto it = results_.find(key); it != results_.end()) {
+            ++stats_.hits;
+            out = it->second.choice;
+            return it->second.error;
+        }
+        if (producer >= devices_.size() || consumer >= devices_.size())
+            return std::make_error_code(std::errc::invalid_argument);
+        ++stats_.misses;
+        from = devices_[producer];
+        to = devices_[consumer];
+    }
+
+    Result result;
+    result.error = negotiate_modifier(fourcc, *from, *to, result.choice);
+
+    std::lock_guard lock(mutex_);
+    // Skip caching if update() swapped either list meanwhile.
+    if (devices_[producer] == from && devices_[consumer] == to)
+        results_.try_emplace(key, result);
+    out = result.choice;
+    return result.error;
+}
+
+ModifierNegotiator::Stats ModifierNegotiator::stats() const
+{
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+} // namespace dispctrl
@@ -0,0 +1,142 @@
+#include "dispctrl/pixel_convert.hpp"
+
+#include "dispctrl/format.hpp"
+
+#include "convert_kernels.hpp"
+
+#include <cstring>
+
+namespace dispctrl {
+
+namespace convert {
+
+void nv12_row_scalar(const std::uint8_t* y, const std::uint8_t* uv, std::uint32_t* dst,
+                     std::uint32_t width) noexcept
+{
+    for (std::uint32_t x = 0; x < width; ++x) {
+        const std::uint8_t* c = uv + (x & ~1u);
+        dst[x] = yuv_to_xrgb(y[x], c[0], c[1]);
+    }
+}
+
+void yuyv_row_scalar(const std::uint8_t* src, std::uint32_t* dst, std::uint32_t width) noexcept
+{
+    for (std::uint32_t x = 0; x < width; ++x) {
+        const std::uint8_t* pair = src + (x & ~1u) * 2;
+        dst[x] = yuv_to_xrgb(src[x * 2], pair[1], pair[3]);
+    }
+}
+
+void rgb565_row_scalar(const std::uint8_t* src, std::uint32_t* dst, std::uint32_t width) noexcept
+{
+    for (std::uint32_t x = 0; x < width; ++x) {
+        std::uint16_t p;
+        std::memcpy(&p, src + x * 2, sizeof(p));
+        dst[x] = rgb565_to_xrgb(p);
+    }
+}
+
+const RowKernels kScalarKernels{nv12_row_scalar, yuyv_row_scalar, rgb565_row_scalar};
+
+} // namespace convert
+
+namespace {
+
+const convert::RowKernels* kernels_for(ConvertIsa isa) noexcept
+{
+    switch (isa) {
+    case ConvertIsa::Scalar:
+        return &convert::kScalarKernels;
+    case ConvertIsa::Avx2:
+#ifdef DISPCTRL_HAVE_AVX2
+        if (__builtin_cpu_supports("avx2"))
+            return &convert::kAvx2Kernels;
+#endif
+        return nullptr;
+    case ConvertIsa::Neon:
+#ifdef DISPCTRL_HAVE_NEON
+        // Advanced SIMD is mandatory on AArch64, the only target built with it.
+        return &convert::kNeonKernels;
+#endif
+        return nullptr;
+    }
+    return nullptr;
+}
+
+ConvertIsa detect_best_isa() noexcept
+{
+    for (ConvertIsa isa : {ConvertIsa::Avx2, ConvertIsa::Neon})
+        if (kernels_for(isa))
+            return isa;
+    return ConvertIsa::Scalar;
+}
+
+} // namespace
+
+const char* to_string(ConvertIsa isa) noexcept
+{
+    switch (isa) {
+    case ConvertIsa::Scalar:
+        return "scalar";
+    case ConvertIsa::Avx2:
+        return "avx2";
+    case ConvertIsa::Neon:
+        return "neon";
+    }
+    return "unknown";
+}
+
+ConvertIsa best_convert_isa() noexcept
+{
+    static const ConvertIsa best = detect_best_isa();
+    return best;
+}
+
+bool convert_isa_available(ConvertIsa isa) noexcept
+{
+    return kernels_for(isa) != nullptr;
+}
+
+std::error_code convert_to_xrgb8888(const ConstImage& src, std::uint8_t* dst,
+                                    std::uint32_t dst_pitch) noexcept
+{
+    return convert_to_xrgb8888(src, dst, dst_pitch, best_convert_isa());
+}
+
+std::error_code convert_to_xrgb8888(const ConstImage& src, std::uint8_t* dst, std::uint32_t dst_pitch,
+                                    ConvertIsa isa) noexcept
+{
+    const convert::RowKernels* k = kernels_for(isa);
+    if (!k)
+        return std::make_error_code(std::errc::not_supported);
+    if (!dst || !src.planes[0] || dst_pitch < src.width * 4)
+        return std::make_error_code(std::errc::invalid_argument);
+
+    auto row = [&](std::uint32_t y) { return reinterpret_cast<std::uint32_t*>(dst + std::size_t{y} * dst_pitch); };
+    auto line = [&](int plane, std::uint32_t y) { return src.planes[plane] + std::size_t{y} * src.pitches[plane]; };
+
+    switch (src.fourcc) {
+    case fourcc::NV12:
+        if (!src.planes[1])
+            return std::make_error_code(std::errc::invalid_argument);
+        for (std::uint32_t y = 0; y < src.height; ++y)
+            k->nv12(line(0, y), line(1, y / 2), row(y), src.width);
+        return {};
+    case fourcc::YUYV:
+        // A macropixel carries two pixels; the last one of an odd row
+        // would have no V sample.
+        if (src.width % 2)
+            return std::make_error_code(std::errc::invalid_argument);
+        for (std::uint32_t y = 0; y < src.height; ++y)
+            k->yuyv(line(0, y), row(y), src.width);
+        return {};
+    case fourcc::RGB565:
+        for (std::uint32_t y = 0; y < src.height; ++y)
+            k->rgb565(line(0, y), row(y), src.width);
+        return {};
+    default:
+        return std::make_error_code(std::errc::not_supported);
+    }
+}
+
+} // namespace dispctrl
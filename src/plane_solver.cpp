@@ -0,0 +1,418 @@
+#include "dispctrl/plane_solver.hpp"
+
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/format.hpp"
+#include "dispctrl/hash.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <system_error>
+
+namespace dispctrl {
+
+namespace {
+
+template <typename T>
+std::uint64_t mix(std::uint64_t h, const T& value) noexcept
+{
+    return fnv1a64(&value, sizeof(value), h);
+}
+
+std::uint64_t mix(std::uint64_t h, const Rect& r) noexcept
+{
+    h = mix(h, r.x1);
+    h = mix(h, r.y1);
+    h = mix(h, r.x2);
+    return mix(h, r.y2);
+}
+
+bool scale_ok(std::int32_t src, std::int32_t dst, double max_down, double max_up) noexcept
+{
+    if (src == dst)
+        return true;
+    const double ratio = static_cast<double>(dst) / static_cast<double>(src);
+    return ratio > 1.0 ? ratio <= max_up : 1.0 / ratio <= max_down;
+}
+
+// Crop size once rotated, i.e. as scaled onto the destination.
+std::int32_t rotated_width(const Rect& src, Rotation r) noexcept
+{
+    return swaps_axes(r) ? src.height() : src.width();
+}
+
+std::int32_t rotated_height(const Rect& src, Rotation r) noexcept
+{
+    return swaps_axes(r) ? src.width() : src.height();
+}
+
+bool scaled(const Layer& layer) noexcept
+{
+    return rotated_width(layer.src, layer.rotation) != layer.dst.width() ||
+           rotated_height(layer.src, layer.rotation) != layer.dst.height();
+}
+
+std::uint64_t frame_bytes(std::uint32_t fourcc, std::uint64_t width, std::uint64_t height) noexcept
+{
+    const FormatInfo* info = format_info(fourcc);
+    if (!info)
+        return width * height * 4;
+    std::uint64_t bytes = width * height * info->bytes_per_pixel[0];
+    for (unsigned p = 1; p < info->plane_count; ++p)
+        bytes += (width / info->hsub) * (height / info->vsub) * info->bytes_per_pixel[p];
+    return bytes;
+}
+
+} // namespace
+
+bool PlaneCaps::supports(std::uint32_t fourcc, std::uint64_t modifier) const noexcept
+{
+    return std::find(formats.begin(), formats.end(), PlaneFormat{fourcc, modifier}) != formats.end();
+}
+
+bool PlaneCaps::supports(Rotation rotation, std::uint64_t modifier) const noexcept
+{
+    if (!(rotations & drm_rotation(rotation)))
+        return false;
+    return !swaps_axes(rotation) || rotate_linear || modifier != modifier::Linear;
+}
+
+std::size_t PlaneAssignment::offloaded() const noexcept
+{
+    return static_cast<std::size_t>(std::count_if(plane_ids.begin(), plane_ids.end(), [](std::uint32_t id) { return id != 0; }));
+}
+
+PlaneSolver::PlaneSolver(KmsDevice& device, std::uint32_t crtc_id, std::vector<PlaneCaps> planes,
+                         PlaneLimits limits)
+    : device_(device), crtc_id_(crtc_id), limits_(limits)
+{
+    if (std::count_if(planes.begin(), planes.end(), [](const PlaneCaps& p) { return p.type == PlaneType::Primary; }) != 1)
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument), "PlaneSolver: need one primary plane");
+
+    std::stable_sort(planes.begin(), planes.end(), [](const PlaneCaps& a, const PlaneCaps& b) {
+        const bool ap = a.type == PlaneType::Primary;
+        const bool bp = b.type == PlaneType::Primary;
+        return ap != bp ? ap : a.zpos < b.zpos;
+    });
+
+    for (PlaneCaps& caps : planes) {
+        Plane plane{std::move(caps), {}};
+        const struct {
+            const char* name;
+            std::uint32_t Props::*field;
+        } names[] = {
+            {"FB_ID", &Props::fb_id},   {"CRTC_ID", &Props::crtc_id}, {"SRC_X", &Props::src_x},
+            {"SRC_Y", &Props::src_y},   {"SRC_W", &Props::src_w},     {"SRC_H", &Props::src_h},
+            {"CRTC_X", &Props::crtc_x}, {"CRTC_Y", &Props::crtc_y},   {"CRTC_W", &Props::crtc_w},
+            {"CRTC_H", &Props::crtc_h},
+        };
+        for (const auto& n : names)
+            if (std::error_code ec = device_.find_property(plane.caps.plane_id, ObjectType::Plane, n.name, plane.props.*n.field))
+                throw std::system_error(ec, std::string("plane property ") + n.name);
+        if (plane.caps.rotations & ~drm_rotation(Rotation::R0))
+            if (std::error_code ec = device_.find_property(plane.caps.plane_id, ObjectType::Plane, "rotation", plane.props.rotation))
+                throw std::system_error(ec, "plane property rotation");
+        planes_.push_back(std::move(plane));
+    }
+}
+
+void PlaneSolver::invalidate() noexcept
+{
+    for (CacheEntry& entry : cache_)
+        entry.last_used = 0;
+}
+
+std::uint64_t PlaneSolver::make_key(std::span<const Layer> layers, const CompositionTarget& target)
+{
+    key_.clear();
+    std::uint64_t h = mix(mix(mix(kFnvOffset, target.fourcc), target.modifier), target.rotation);
+    for (const Layer& layer : layers) {
+        key_.push_back({layer.fourcc, layer.modifier, layer.src, layer.dst, layer.rotation});
+        h = mix(mix(h, layer.fourcc), layer.modifier);
+        h = mix(mix(mix(h, layer.src), layer.dst), layer.rotation);
+    }
+    return h;
+}
+
+bool PlaneSolver::fits(const Plane& plane, const Layer& layer) const noexcept
+{
+    const PlaneCaps& caps = plane.caps;
+    if (layer.src.empty() || layer.dst.empty() || !caps.supports(layer.fourcc, layer.modifier) ||
+        !caps.supports(layer.rotation, layer.modifier))
+        return false;
+    if (static_cast<std::uint32_t>(layer.src.width()) > caps.max_width ||
+        static_cast<std::uint32_t>(layer.src.height()) > caps.max_height)
+        return false;
+    const std::int32_t w = rotated_width(layer.src, layer.rotation);
+    const std::int32_t h = rotated_height(layer.src, layer.rotation);
+    return scale_ok(w, layer.dst.width(), caps.max_downscale, caps.max_upscale) &&
+           scale_ok(h, layer.dst.height(), caps.max_downscale, caps.max_upscale) && within_quality(layer);
+}
+
+bool PlaneSolver::within_quality(const Layer& layer) const noexcept
+{
+    // Without a GPU the compositor's nearest sampling is worse than any
+    // plane scaler, so the plane gets the layer however far it shrinks.
+    const double limit = limits_.max_quality_downscale;
+    if (limit <= 0.0 || limits_.costs.gpu_bytes_per_ns <= 0.0)
+        return true;
+    return scale_ok(rotated_width(layer.src, layer.rotation), layer.dst.width(), limit, 1e9) &&
+           scale_ok(rotated_height(layer.src, layer.rotation), layer.dst.height(), limit, 1e9);
+}
+
+bool PlaneSolver::rotates_target(const CompositionTarget& target) const noexcept
+{
+    return planes_[0].caps.supports(target.rotation, target.modifier);
+}
+
+TransformPath PlaneSolver::compose_path(const Layer& layer, const CompositionTarget& target,
+                                        std::uint64_t& ns) const noexcept
+{
+    // The compositor reads the source and reads and writes the covered
+    // part of the target; layers are blended into the target through its
+    // rotation, so a layer rotated like the target is upright there.
+    const TransformCosts& c = limits_.costs;
+    const auto relative = static_cast<Rotation>((static_cast<unsigned>(layer.rotation) + 4 -
+                                                 static_cast<unsigned>(target.rotation)) % 4);
+    const double src = static_cast<double>(frame_bytes(layer.fourcc, static_cast<std::uint64_t>(layer.src.width()),
+                                                       static_cast<std::uint64_t>(layer.src.height())));
+    const double dst = static_cast<double>(frame_bytes(target.fourcc, layer.dst.area(), 1));
+    if (relative == Rotation::R0 && !scaled(layer)) {
+        ns = static_cast<std::uint64_t>((src + 2 * dst) / c.cpu_bytes_per_ns);
+        return TransformPath::Cpu;
+    }
+
+    const double fetch = relative == Rotation::R0 ? src : src * c.cpu_rotate_factor;
+    const double cpu = (fetch + 2 * dst) / c.cpu_bytes_per_ns;
+    if (c.gpu_bytes_per_ns <= 0.0) {
+        ns = static_cast<std::uint64_t>(cpu);
+        return TransformPath::Cpu;
+    }
+    // The GPU writes a transformed copy the size of dst, which is then
+    // blended like an untransformed layer.
+    const double gpu = static_cast<double>(c.gpu_pass_ns) + (src + dst) / c.gpu_bytes_per_ns + 3 * dst / c.cpu_bytes_per_ns;
+    if (gpu < cpu || !within_quality(layer)) {
+        ns = static_cast<std::uint64_t>(gpu);
+        return TransformPath::Gpu;
+    }
+    ns = static_cast<std::uint64_t>(cpu);
+    return TransformPath::Cpu;
+}
+
+void PlaneSolver::choose_paths(std::span<const Layer> layers, const CompositionTarget& target,
+                               PlaneAssignment& assignment)
+{
+    assignment.paths.resize(layers.size());
+    for (std::size_t i = 0; i < layers.size(); ++i) {
+        if (assignment.plane_ids[i]) {
+            assignment.paths[i] = TransformPath::Plane;
+            continue;
+        }
+        std::uint64_t ns = 0;
+        assignment.paths[i] = compose_path(layers[i], target, ns);
+        if (assignment.paths[i] == TransformPath::Gpu)
+            ++stats_.gpu_transforms;
+        else if (layers[i].rotation != target.rotation || scaled(layers[i]))
+            ++stats_.cpu_transforms;
+    }
+}
+
+void PlaneSolver::search(std::span<const Layer> layers, const CompositionTarget&, PlaneAssignment& out) const
+{
+    const std::size_t n = layers.size();
+    out.plane_ids.assign(n, 0);
+
+    // Offload from the top down, each layer onto the highest free plane
+    // below the previous one. A layer covered by a composited layer has to
+    // stay composited too, or it would end up in front of it.
+    std::size_t next = planes_.size(); // one past the highest usable overlay
+    unsigned scalers = limits_.max_scalers ? limits_.max_scalers : std::numeric_limits<unsigned>::max();
+    for (std::size_t i = n; i-- > 0;) {
+        bool covered = false;
+        for (std::size_t j = i + 1; j < n && !covered; ++j)
+            covered = out.plane_ids[j] == 0 && !intersect(layers[i].dst, layers[j].dst).empty();
+        if (covered || (scaled(layers[i]) && scalers == 0))
+            continue;
+        // With everything above it offloaded, the bottom layer can go on
+        // the primary plane directly and composition is skipped altogether.
+        if (i == 0 && out.offloaded() == n - 1 && fits(planes_[0], layers[0])) {
+            out.plane_ids[0] = planes_[0].caps.plane_id;
+            break;
+        }
+        for (std::size_t p = next; p-- > 1;) {
+            if (fits(planes_[p], layers[i])) {
+                out.plane_ids[i] = planes_[p].caps.plane_id;
+                scalers -= scaled(layers[i]);
+                next = p;
+                break;
+            }
+        }
+    }
+    out.composited = n == 0 || out.offloaded() < n;
+}
+
+std::uint64_t PlaneSolver::fetch_bytes(std::span<const Layer> layers, const CompositionTarget& target,
+                                       const PlaneAssignment& assignment) const noexcept
+{
+    std::uint64_t bytes = assignment.composited ? frame_bytes(target.fourcc, target.width, target.height) : 0;
+    for (std::size_t i = 0; i < layers.size(); ++i)
+        if (assignment.plane_ids[i])
+            bytes += frame_bytes(layers[i].fourcc, static_cast<std::uint64_t>(layers[i].src.width()),
+                                 static_cast<std::uint64_t>(layers[i].src.height()));
+    return bytes;
+}
+
+void PlaneSolver::restore_order(std::span<const Layer> layers, PlaneAssignment& assignment) const noexcept
+{
+    const std::size_t n = layers.size();
+    // Composited layers sit below every overlay, so anything offloaded
+    // beneath one that overlaps it must be composited as well.
+    for (std::size_t i = n; i-- > 0;) {
+        if (assignment.plane_ids[i] != 0)
+            continue;
+        for (std::size_t j = 0; j < i; ++j)
+            if (assignment.plane_ids[j] && !intersect(layers[i].dst, layers[j].dst).empty())
+                assignment.plane_ids[j] = 0;
+    }
+    assignment.composited = n == 0 || assignment.offloaded() < n;
+    // The primary plane now carries the composition target.
+    if (assignment.composited)
+        for (std::uint32_t& id : assignment.plane_ids)
+            if (id == planes_[0].caps.plane_id)
+                id = 0;
+}
+
+bool PlaneSolver::demote(std::span<const Layer> layers, const CompositionTarget& target,
+                         PlaneAssignment& assignment) const
+{
+    // Keep the layers that save the most composition work: drop the
+    // offloaded one that is cheapest to composite.
+    std::size_t victim = layers.size();
+    std::uint64_t cheapest = std::numeric_limits<std::uint64_t>::max();
+    for (std::size_t i = 0; i < layers.size(); ++i) {
+        std::uint64_t ns = 0;
+        if (assignment.plane_ids[i] && (compose_path(layers[i], target, ns), ns < cheapest)) {
+            cheapest = ns;
+            victim = i;
+        }
+    }
+    if (victim == layers.size())
+        return false;
+    assignment.plane_ids[victim] = 0;
+    restore_order(layers, assignment);
+    return true;
+}
+
+template <typename Sink>
+void PlaneSolver::write_state(std::span<const Layer> layers, const CompositionTarget& target,
+                              const PlaneAssignment& assignment, Sink& sink) const
+{
+    auto show = [&](const Plane& plane, std::uint32_t fb_id, const Rect& src, const Rect& dst, Rotation rotation) {
+        const std::uint32_t id = plane.caps.plane_id;
+        const Props& p = plane.props;
+        sink.set(id, p.fb_id, fb_id);
+        sink.set(id, p.crtc_id, crtc_id_);
+        // SRC_* are 16.16 fixed point; CRTC_X/Y are signed.
+        sink.set(id, p.src_x, static_cast<std::uint64_t>(src.x1) << 16);
+        sink.set(id, p.src_y, static_cast<std::uint64_t>(src.y1) << 16);
+        sink.set(id, p.src_w, static_cast<std::uint64_t>(src.width()) << 16);
+        sink.set(id, p.src_h, static_cast<std::uint64_t>(src.height()) << 16);
+        sink.set(id, p.crtc_x, static_cast<std::uint64_t>(static_cast<std::int64_t>(dst.x1)));
+        sink.set(id, p.crtc_y, static_cast<std::uint64_t>(static_cast<std::int64_t>(dst.y1)));
+        sink.set(id, p.crtc_w, static_cast<std::uint64_t>(dst.width()));
+        sink.set(id, p.crtc_h, static_cast<std::uint64_t>(dst.height()));
+        if (p.rotation)
+            sink.set(id, p.rotation, drm_rotation(rotation));
+    };
+
+    for (std::size_t p = 0; p < planes_.size(); ++p) {
+        const Plane& plane = planes_[p];
+        if (p == 0 && assignment.composited) {
+            const auto w = static_cast<std::int32_t>(target.width);
+            const auto h = static_cast<std::int32_t>(target.height);
+            const Rect output = swaps_axes(target.rotation) ? Rect::from_size(0, 0, h, w) : Rect::from_size(0, 0, w, h);
+            show(plane, target.fb_id, Rect::from_size(0, 0, w, h), output, target.rotation);
+            continue;
+        }
+        const auto it = std::find(assignment.plane_ids.begin(), assignment.plane_ids.end(), plane.caps.plane_id);
+        if (it != assignment.plane_ids.end()) {
+            const Layer& layer = layers[static_cast<std::size_t>(it - assignment.plane_ids.begin())];
+            show(plane, layer.fb_id, layer.src, layer.dst, layer.rotation);
+        } else {
+            sink.set(plane.caps.plane_id, plane.props.fb_id, 0);
+            sink.set(plane.caps.plane_id, plane.props.crtc_id, 0);
+        }
+    }
+}
+
+std::error_code PlaneSolver::test(std::span<const Layer> layers, const CompositionTarget& target,
+                                  const PlaneAssignment& assignment)
+{
+    request_.clear();
+    write_state(layers, target, assignment, request_);
+    request_.finalize();
+    ++stats_.test_commits;
+    std::error_code ec = device_.atomic_commit(request_, commit::TestOnly, 0);
+    if (ec)
+        ++stats_.test_failures;
+    return ec;
+}
+
+std::error_code PlaneSolver::solve(std::span<const Layer> layers, const CompositionTarget& target,
+                                   PlaneAssignment& out)
+{
+    ++stats_.solves;
+    if (!rotates_target(target))
+        return std::make_error_code(std::errc::not_supported);
+    const std::uint64_t hash = make_key(layers, target);
+    const PlaneFormat target_format{target.fourcc, target.modifier};
+    for (CacheEntry& entry : cache_) {
+        if (entry.last_used && entry.hash == hash && entry.target_format == target_format &&
+            entry.target_rotation == target.rotation && entry.topology == key_) {
+            entry.last_used = ++clock_;
+            out = entry.assignment;
+            ++stats_.cache_hits;
+            return {};
+        }
+    }
+
+    search(layers, target, out);
+    while (limits_.max_fetch_bytes && fetch_bytes(layers, target, out) > limits_.max_fetch_bytes)
+        if (!demote(layers, target, out))
+            break;
+
+    for (unsigned tests = 0;; ++tests) {
+        if (tests >= limits_.max_tests && out.offloaded()) {
+            // Out of budget: fall back to compositing everything.
+            std::fill(out.plane_ids.begin(), out.plane_ids.end(), 0);
+            out.composited = true;
+        }
+        std::error_code ec = test(layers, target, out);
+        if (!ec)
+            break;
+        if (!out.offloaded())
+            return ec;
+        demote(layers, target, out);
+    }
+    choose_paths(layers, target, out);
+
+    CacheEntry* slot = &cache_[0];
+    for (CacheEntry& entry : cache_)
+        if (entry.last_used < slot->last_used)
+            slot = &entry;
+    slot->hash = hash;
+    slot->topology = key_;
+    slot->target_format = target_format;
+    slot->target_rotation = target.rotation;
+    slot->assignment = out;
+    slot->last_used = ++clock_;
+    return {};
+}
+
+void PlaneSolver::apply(std::span<const Layer> layers, const CompositionTarget& target,
+                        const PlaneAssignment& assignment, CommitQueue& queue) const
+{
+    write_state(layers, target, assignment, queue);
+}
+
+} // namespace dispctrl
@@ -0,0 +1,66 @@
+#include "dispctrl/scanout.hpp"
+
+#include <utility>
+
+namespace dispctrl {
+
+std::error_code ScanoutPipeline::present(std::shared_ptr<Framebuffer> fb)
+{
+    if (!fb)
+        return std::make_error_code(std::errc::invalid_argument);
+    ++stats_.presented;
+
+    if (pending_) {
+        // Presenting the queued buffer again replaces nothing.
+        if (queued_ && queued_ != fb) {
+            ++stats_.replaced;
+            std::shared_ptr<Framebuffer> replaced = std::exchange(queued_, std::move(fb));
+            release(std::move(replaced));
+        } else {
+            queued_ = std::move(fb);
+        }
+        return {};
+    }
+    return flip(std::move(fb));
+}
+
+std::error_code ScanoutPipeline::on_flip_complete(const KmsEvent& event)
+{
+    if (event.type != KmsEvent::Type::FlipComplete || !pending_)
+        return {};
+    // Kernels without DRM_CAP_CRTC_IN_VBLANK_EVENT report crtc_id == 0; the
+    // flip serial in user_data still identifies our flip.
+    if ((event.crtc_id != 0 && event.crtc_id != crtc_id_) || event.user_data != flip_serial_)
+        return {};
+
+    ++stats_.flipped;
+    std::shared_ptr<Framebuffer> previous = std::exchange(front_, std::move(pending_));
+    // Scanout of the previous buffer ended at this vblank, so it is safe to
+    // return it to the client unless it is also the new front buffer.
+    if (previous && previous != front_)
+        release(std::move(previous));
+
+    if (queued_)
+        return flip(std::move(queued_));
+    return {};
+}
+
+std::error_code ScanoutPipeline::flip(std::shared_ptr<Framebuffer> fb)
+{
+    const std::uint64_t serial = flip_serial_ + 1;
+    if (std::error_code ec = device_.page_flip(crtc_id_, fb->id(), serial)) {
+        release(std::move(fb));
+        return ec;
+    }
+    flip_serial_ = serial;
+    pending_ = std::move(fb);
+    return {};
+}
+
+void ScanoutPipeline::release(std::shared_ptr<Framebuffer> fb)
+{
+    if (release_ && fb && fb != front_ && fb != pending_ && fb != queued_)
+        release_(fb);
+}
+
+} // namespace dispctrl
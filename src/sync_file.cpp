@@ -0,0 +1,103 @@
+#include "dispctrl/sync_file.hpp"
+
+#include "dispctrl/clock.hpp"
+
+#include <linux/sync_file.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <new>
+
+namespace dispctrl {
+
+namespace {
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+int sync_ioctl(int fd, unsigned long request, void* arg) noexcept
+{
+    int r;
+    do
+        r = ::ioctl(fd, request, arg);
+    while (r < 0 && (errno == EINTR || errno == EAGAIN));
+    return r;
+}
+
+} // namespace
+
+std::error_code query_fence(int fence_fd, FenceStatus& status) noexcept
+{
+    sync_file_info info{};
+    if (sync_ioctl(fence_fd, SYNC_IOC_FILE_INFO, &info) < 0)
+        return last_error();
+    status = {};
+    if (info.status < 0) {
+        status.state = FenceStatus::State::Error;
+        return {};
+    }
+    if (info.status == 0 || info.num_fences == 0) {
+        status.state = info.status ? FenceStatus::State::Signaled : FenceStatus::State::Pending;
+        return {};
+    }
+
+    // A second call fills in the fences, whose timestamps say when each
+    // signalled. Files merged from more than a handful are rare.
+    std::array<sync_fence_info, 8> local{};
+    std::unique_ptr<sync_fence_info[]> heap;
+    sync_fence_info* fences = local.data();
+    if (info.num_fences > local.size()) {
+        heap.reset(new (std::nothrow) sync_fence_info[info.num_fences]);
+        if (!heap)
+            return std::make_error_code(std::errc::not_enough_memory);
+        fences = heap.get();
+    }
+    info.sync_fence_info = reinterpret_cast<std::uintptr_t>(fences);
+    if (sync_ioctl(fence_fd, SYNC_IOC_FILE_INFO, &info) < 0)
+        return last_error();
+    status.state = info.status < 0 ? FenceStatus::State::Error
+                   : info.status    ? FenceStatus::State::Signaled
+                                    : FenceStatus::State::Pending;
+    if (status.signaled())
+        for (std::uint32_t i = 0; i < info.num_fences; ++i)
+            status.timestamp_ns = std::max<std::uint64_t>(status.timestamp_ns, fences[i].timestamp_ns);
+    return {};
+}
+
+std::error_code wait_fence(int fence_fd, std::uint64_t timeout_ns) noexcept
+{
+    const std::uint64_t deadline = monotonic_ns() + timeout_ns;
+    for (;;) {
+        const std::uint64_t now = monotonic_ns();
+        const std::uint64_t left = deadline > now ? deadline - now : 0;
+        timespec ts{static_cast<time_t>(left / 1'000'000'000), static_cast<long>(left % 1'000'000'000)};
+        pollfd pfd{fence_fd, POLLIN, 0};
+        const int r = ::ppoll(&pfd, 1, &ts, nullptr);
+        if (r > 0)
+            return pfd.revents & (POLLERR | POLLNVAL) ? std::make_error_code(std::errc::io_error) : std::error_code{};
+        if (r == 0)
+            return std::make_error_code(std::errc::timed_out);
+        if (errno != EINTR)
+            return last_error();
+    }
+}
+
+std::error_code merge_fences(int a, int b, UniqueFd& merged) noexcept
+{
+    sync_merge_data data{};
+    std::strncpy(data.name, "dispctrl", sizeof(data.name) - 1);
+    data.fd2 = b;
+    if (sync_ioctl(a, SYNC_IOC_MERGE, &data) < 0)
+        return last_error();
+    merged.reset(data.fence);
+    return {};
+}
+
+} // namespace dispctrl
@@ -0,0 +1,193 @@
+#include "dispctrl/thread_pool.hpp"
+
+#include "dispctrl/topology.hpp"
+
+#include <algorithm>
+
+namespace dispctrl {
+
+namespace {
+
+/// Most items one dispatch() can hand out.
+constexpr std::size_t kMaxRange = UINT32_MAX;
+
+constexpr std::uint64_t pack(std::uint64_t begin, std::uint64_t end) noexcept
+{
+    return begin | end << 32;
+}
+
+constexpr std::uint32_t begin_of(std::uint64_t r) noexcept
+{
+    return static_cast<std::uint32_t>(r);
+}
+
+constexpr std::uint32_t end_of(std::uint64_t r) noexcept
+{
+    return static_cast<std::uint32_t>(r >> 32);
+}
+
+unsigned pool_size(unsigned threads, std::span<const unsigned> cpus) noexcept
+{
+    if (threads)
+        return threads;
+    if (!cpus.empty())
+        return static_cast<unsigned>(cpus.size());
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads, std::span<const unsigned> cpus)
+    : slots_(pool_size(threads, cpus))
+{
+    threads_.reserve(slots_.size() - 1);
+    try {
+        for (unsigned i = 1; i < slots_.size(); ++i) {
+            // Thread 0 is the caller, so the workers start at cpus[0].
+            const int cpu = cpus.empty() ? -1 : static_cast<int>(cpus[(i - 1) % cpus.size()]);
+            threads_.emplace_back([this, i, cpu] { worker(i, cpu); });
+        }
+    } catch (...) {
+        stopping_.store(true);
+        generation_.fetch_add(1);
+        generation_.notify_all();
+        for (std::thread& t : threads_)
+            t.join();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    stopping_.store(true, std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+    generation_.notify_all();
+    for (std::thread& t : threads_)
+        t.join();
+}
+
+ThreadPool::Stats ThreadPool::stats() const noexcept
+{
+    return {jobs_.load(std::memory_order_relaxed), steals_.load(std::memory_order_relaxed)};
+}
+
+bool ThreadPool::take(unsigned self, std::size_t& index) noexcept
+{
+    std::atomic<std::uint64_t>& range = slots_[self].range;
+    std::uint64_t r = range.load(std::memory_order_acquire);
+    for (;;) {
+        const std::uint32_t b = begin_of(r);
+        const std::uint32_t e = end_of(r);
+        if (b >= e)
+            return false;
+        if (range.compare_exchange_weak(r, pack(b + 1, e), std::memory_order_acq_rel)) {
+            index = b;
+            return true;
+        }
+    }
+}
+
+bool ThreadPool::steal(unsigned self) noexcept
+{
+    const auto n = static_cast<unsigned>(slots_.size());
+    for (unsigned k = 1; k < n; ++k) {
+        std::atomic<std::uint64_t>& victim = slots_[(self + k) % n].range;
+        std::uint64_t r = victim.load(std::memory_order_acquire);
+        for (;;) {
+            const std::uint32_t b = begin_of(r);
+            const std::uint32_t e = end_of(r);
+            if (b >= e)
+                break;
+            // Take the upper half; the owner keeps consuming from the bottom.
+            const std::uint32_t mid = b + (e - b) / 2;
+            if (victim.compare_exchange_weak(r, pack(b, mid), std::memory_order_acq_rel)) {
+                // Our own slot is empty, so nobody else is writing it.
+                slots_[self].range.store(pack(mid, e), std::memory_order_release);
+                steals_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(unsigned self) noexcept
+{
+    do {
+        std::size_t index;
+        while (take(self, index))
+            invoke_(ctx_, index, self);
+    } while (steal(self));
+}
+
+void ThreadPool::worker(unsigned self, int cpu) noexcept
+{
+    if (cpu >= 0) {
+        // Best effort: a CPU outside our cpuset leaves the worker floating.
+        const unsigned one = static_cast<unsigned>(cpu);
+        pin_current_thread({&one, 1});
+    }
+    std::uint64_t seen = 0;
+    for (;;) {
+        generation_.wait(seen, std::memory_order_acquire);
+        seen = generation_.load(std::memory_order_acquire);
+        if (stopping_.load(std::memory_order_relaxed))
+            return;
+        work(self);
+        if (running_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            running_.notify_one();
+    }
+}
+
+void ThreadPool::run(std::size_t count, Invoke invoke, void* ctx)
+{
+    if (count == 0)
+        return;
+    jobs_.fetch_add(1, std::memory_order_relaxed);
+    const auto n = static_cast<unsigned>(slots_.size());
+    if (n == 1 || count == 1) {
+        for (std::size_t i = 0; i < count; ++i)
+            invoke(ctx, i, 0);
+        return;
+    }
+    if (count > kMaxRange) {
+        // Run it in pieces whose ranges fit the 32-bit halves of a slot,
+        // each offset into the whole.
+        struct Piece {
+            Invoke invoke;
+            void* ctx;
+            std::size_t base;
+        } piece{invoke, ctx, 0};
+        const Invoke offset = [](void* p, std::size_t index, unsigned thread) {
+            const auto* piece = static_cast<const Piece*>(p);
+            piece->invoke(piece->ctx, piece->base + index, thread);
+        };
+        for (; piece.base < count; piece.base += kMaxRange)
+            dispatch(std::min(count - piece.base, kMaxRange), offset, &piece);
+        return;
+    }
+    dispatch(count, invoke, ctx);
+}
+
+void ThreadPool::dispatch(std::size_t count, Invoke invoke, void* ctx)
+{
+    const auto n = static_cast<unsigned>(slots_.size());
+    invoke_ = invoke;
+    ctx_ = ctx;
+    for (unsigned t = 0; t < n; ++t) {
+        const std::uint64_t begin = count * t / n;
+        const std::uint64_t end = count * (t + 1) / n;
+        slots_[t].range.store(pack(begin, end), std::memory_order_relaxed);
+    }
+    // Every worker wakes for every job and checks out through running_, so
+    // none can still be looking at invoke_/ctx_ once we return.
+    running_.store(n - 1, std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+    generation_.notify_all();
+
+    work(0);
+    for (unsigned left = running_.load(std::memory_order_acquire); left; left = running_.load(std::memory_order_acquire))
+        running_.wait(left, std::memory_order_acquire);
+}
+
+} // namespace dispctrl
@@ -0,0 +1,291 @@
+#include "dispctrl/topology.hpp"
+
+#include "dispctrl/unique_fd.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+
+namespace dispctrl {
+
+namespace {
+
+constexpr unsigned long kMaxCpus = 1ul << 16;
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+// Whole small sysfs attribute, without the trailing newline; empty if it
+// cannot be read.
+std::string read_attribute(const std::string& path)
+{
+    UniqueFd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd)
+        return {};
+    char buf[4096];
+    const ssize_t len = ::read(fd.get(), buf, sizeof(buf));
+    if (len <= 0)
+        return {};
+    std::string s(buf, static_cast<std::size_t>(len));
+    while (!s.empty() && (s.back() == '\n' || s.back() == ' '))
+        s.pop_back();
+    return s;
+}
+
+// "0-3,8,10-11" as used by cpulist and online.
+std::vector<unsigned> parse_cpu_list(const std::string& list)
+{
+    std::vector<unsigned> cpus;
+    const char* p = list.c_str();
+    while (*p) {
+        char* end;
+        const unsigned long first = std::strtoul(p, &end, 10);
+        if (end == p)
+            break;
+        unsigned long last = first;
+        p = end;
+        if (*p == '-') {
+            last = std::strtoul(p + 1, &end, 10);
+            p = end;
+        }
+        for (unsigned long cpu = first; cpu <= last && cpu < kMaxCpus; ++cpu)
+            cpus.push_back(static_cast<unsigned>(cpu));
+        if (*p == ',')
+            ++p;
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string card_name(const std::string& card)
+{
+    const std::size_t slash = card.rfind('/');
+    return slash == std::string::npos ? card : card.substr(slash + 1);
+}
+
+std::size_t page_size() noexcept
+{
+    return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+} // namespace
+
+Topology Topology::discover(const std::string& sysfs)
+{
+    Topology t;
+    t.sysfs_ = sysfs;
+    std::vector<unsigned> online = parse_cpu_list(read_attribute(sysfs + "/devices/system/cpu/online"));
+    if (online.empty())
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+            online.push_back(cpu);
+
+    const std::string node_dir = sysfs + "/devices/system/node";
+    if (DIR* d = ::opendir(node_dir.c_str())) {
+        while (const dirent* e = ::readdir(d)) {
+            const char* name = e->d_name;
+            if (std::strncmp(name, "node", 4) != 0 || name[4] < '0' || name[4] > '9')
+                continue;
+            char* end;
+            const long id = std::strtol(name + 4, &end, 10);
+            if (*end != '\0' || id > INT_MAX)
+                continue;
+            Node node;
+            node.id = static_cast<int>(id);
+            for (unsigned cpu : parse_cpu_list(read_attribute(node_dir + "/" + name + "/cpulist")))
+                if (std::binary_search(online.begin(), online.end(), cpu))
+                    node.cpus.push_back(cpu);
+            t.nodes_.push_back(std::move(node));
+        }
+        ::closedir(d);
+    }
+    if (t.nodes_.empty())
+        t.nodes_.push_back(Node{0, std::move(online)});
+    std::sort(t.nodes_.begin(), t.nodes_.end(), [](const Node& a, const Node& b) { return a.id < b.id; });
+    return t;
+}
+
+const Topology::Node* Topology::node(int id) const noexcept
+{
+    for (const Node& n : nodes_)
+        if (n.id == id)
+            return &n;
+    return nullptr;
+}
+
+int Topology::node_of(unsigned cpu) const noexcept
+{
+    for (const Node& n : nodes_)
+        if (std::binary_search(n.cpus.begin(), n.cpus.end(), cpu))
+            return n.id;
+    return -1;
+}
+
+std::vector<unsigned> Topology::cpus() const
+{
+    std::vector<unsigned> all;
+    for (const Node& n : nodes_)
+        all.insert(all.end(), n.cpus.begin(), n.cpus.end());
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+int Topology::device_node(const std::string& card) const
+{
+    const std::string value = read_attribute(sysfs_ + "/class/drm/" + card_name(card) + "/device/numa_node");
+    if (value.empty())
+        return -1;
+    char* end;
+    const long node = std::strtol(value.c_str(), &end, 10);
+    return *end == '\0' && node >= 0 && node <= INT_MAX ? static_cast<int>(node) : -1;
+}
+
+std::string Topology::device_address(const std::string& card) const
+{
+    const std::string link = sysfs_ + "/class/drm/" + card_name(card) + "/device";
+    char* resolved = ::realpath(link.c_str(), nullptr);
+    if (!resolved)
+        return {};
+    std::string address = card_name(resolved);
+    std::free(resolved);
+    // Domain:bus:device.function; platform devices have other names.
+    if (address.size() != 12 || address[4] != ':' || address[7] != ':' || address[10] != '.')
+        return {};
+    return address;
+}
+
+void PlacementPolicy::set(const std::string& device, Placement placement)
+{
+    devices_[device] = std::move(placement);
+}
+
+ResolvedPlacement PlacementPolicy::resolve(const std::string& card) const
+{
+    const Placement* p = &default_;
+    if (const auto it = devices_.find(card_name(card)); it != devices_.end()) {
+        p = &it->second;
+    } else if (const std::string address = topology_.device_address(card); !address.empty()) {
+        if (const auto by_address = devices_.find(address); by_address != devices_.end())
+            p = &by_address->second;
+    }
+
+    ResolvedPlacement out;
+    int node = -1;
+    switch (p->cpus) {
+    case Placement::Cpus::Any:
+        break;
+    case Placement::Cpus::DeviceNode:
+        node = topology_.device_node(card);
+        break;
+    case Placement::Cpus::Node:
+        node = p->node;
+        break;
+    case Placement::Cpus::List:
+        for (unsigned cpu : p->cpu_list)
+            if (topology_.node_of(cpu) >= 0)
+                out.cpus.push_back(cpu);
+        // Memory follows the list only when it stays on one node.
+        if (!out.cpus.empty()) {
+            node = topology_.node_of(out.cpus.front());
+            for (unsigned cpu : out.cpus)
+                if (topology_.node_of(cpu) != node)
+                    node = -1;
+        }
+        break;
+    }
+    if (p->cpus != Placement::Cpus::List) {
+        const Topology::Node* n = topology_.node(node);
+        if (!n || n->cpus.empty())
+            return out; // unknown or CPU-less node: no placement at all
+        out.cpus = n->cpus;
+    }
+    if (p->local_memory)
+        out.memory_node = node;
+    return out;
+}
+
+std::error_code pin_current_thread(std::span<const unsigned> cpus) noexcept
+{
+    if (cpus.empty())
+        return {};
+    const unsigned count = *std::max_element(cpus.begin(), cpus.end()) + 1;
+    cpu_set_t* set = CPU_ALLOC(count);
+    if (!set)
+        return std::make_error_code(std::errc::not_enough_memory);
+    const std::size_t size = CPU_ALLOC_SIZE(count);
+    CPU_ZERO_S(size, set);
+    for (unsigned cpu : cpus)
+        CPU_SET_S(cpu, size, set);
+    // pid 0 is the calling thread, not the whole process.
+    const int ret = ::sched_setaffinity(0, size, set);
+    CPU_FREE(set);
+    return ret == 0 ? std::error_code{} : last_error();
+}
+
+std::error_code bind_memory(void* addr, std::size_t size, int node) noexcept
+{
+    if (node < 0 || size == 0)
+        return {};
+    constexpr unsigned kBits = sizeof(unsigned long) * CHAR_BIT;
+    unsigned long mask[16] = {};
+    if (static_cast<unsigned>(node) >= std::size(mask) * kBits)
+        return std::make_error_code(std::errc::invalid_argument);
+    mask[node / kBits] = 1ul << (node % kBits);
+    // The kernel reads one bit less than maxnode says.
+    if (::syscall(SYS_mbind, addr, size, MPOL_PREFERRED, mask, std::size(mask) * kBits + 1, MPOL_MF_MOVE) != 0)
+        return last_error();
+    return {};
+}
+
+void* NodeMemoryResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    const std::size_t page = page_size();
+    const std::size_t size = (std::max<std::size_t>(bytes, 1) + page - 1) / page * page;
+    const std::size_t slack = alignment > page ? alignment - page : 0;
+    void* map = ::mmap(nullptr, size + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        throw std::bad_alloc();
+    auto* base = static_cast<char*>(map);
+    if (slack) {
+        // Trim the mapping to exactly `size` aligned bytes.
+        auto* aligned = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(base) + alignment - 1) / alignment *
+                                                alignment);
+        if (aligned > base)
+            ::munmap(base, static_cast<std::size_t>(aligned - base));
+        if (const std::size_t tail = static_cast<std::size_t>(base + size + slack - (aligned + size)))
+            ::munmap(aligned + size, tail);
+        base = aligned;
+    }
+    // Before the first touch, so pages fault in on the node; a policy the
+    // kernel refuses (no such node, restricted cpuset) leaves the default.
+    bind_memory(base, size, node_);
+    return base;
+}
+
+void NodeMemoryResource::do_deallocate(void* p, std::size_t bytes, std::size_t) noexcept
+{
+    const std::size_t page = page_size();
+    ::munmap(p, (std::max<std::size_t>(bytes, 1) + page - 1) / page * page);
+}
+
+bool NodeMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    // Any instance can unmap another's blocks.
+    return dynamic_cast<const NodeMemoryResource*>(&other) != nullptr;
+}
+
+} // namespace dispctrl
@@ -0,0 +1,237 @@
+#include "dispctrl/trace.hpp"
+
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/spsc_ring.hpp"
+#include "dispctrl/unique_fd.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <thread>
+
+namespace dispctrl {
+
+namespace {
+
+std::atomic<std::uint64_t> g_next_tracer{1};
+
+/// The rings of the tracers this thread recorded into last.
+struct RingCache {
+    struct Entry {
+        std::uint64_t tracer = 0;
+        void* ring = nullptr;
+    };
+    std::array<Entry, Tracer::kRingCacheSize> entries;
+    std::size_t next = 0; ///< Entry to replace on a miss.
+};
+thread_local RingCache t_rings;
+
+std::error_code last_error() noexcept
+{
+    return {errno, std::system_category()};
+}
+
+std::size_t index(TracePoint point) noexcept
+{
+    return static_cast<std::size_t>(point);
+}
+
+} // namespace
+
+struct Tracer::ThreadRing {
+    SpscRing<TraceEvent, kRingSize> events;
+    std::thread::id owner = std::this_thread::get_id();
+    std::uint32_t tid = static_cast<std::uint32_t>(::gettid());
+    std::atomic<std::uint64_t> dropped{0};
+};
+
+Tracer::Tracer(TraceMode mode, std::uint32_t heads)
+    : id_(g_next_tracer.fetch_add(1, std::memory_order_relaxed)), mode_(mode), head_count_(heads),
+      heads_(std::make_unique<Head[]>(heads))
+{
+}
+
+Tracer::~Tracer() = default;
+
+Tracer::ThreadRing* Tracer::ring() noexcept
+{
+    for (const RingCache::Entry& e : t_rings.entries)
+        if (e.tracer == id_)
+            return static_cast<ThreadRing*>(e.ring);
+
+    // First event from this thread, or its entry was evicted by others.
+    std::lock_guard lock(mutex_);
+    ThreadRing* found = nullptr;
+    for (const std::unique_ptr<ThreadRing>& r : rings_)
+        if (r->owner == std::this_thread::get_id())
+            found = r.get();
+    if (!found) {
+        try {
+            rings_.push_back(std::make_unique<ThreadRing>());
+        } catch (const std::bad_alloc&) {
+            return nullptr;
+        }
+        found = rings_.back().get();
+    }
+    t_rings.entries[t_rings.next] = {id_, found};
+    t_rings.next = (t_rings.next + 1) % kRingCacheSize;
+    return found;
+}
+
+void Tracer::record(std::uint32_t head, std::uint64_t frame, TracePoint point, std::uint64_t timestamp_ns) noexcept
+{
+    const TraceMode mode = mode_.load(std::memory_order_relaxed);
+    if (mode == TraceMode::Off)
+        return;
+    if (head >= head_count_) {
+        bad_head_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Head& h = heads_[head];
+    if (point == TracePoint::FlipComplete) {
+        complete(h, frame, timestamp_ns);
+    } else {
+        // Seqlock-style: invalidate, write, publish; complete() rereads
+        // the tag to reject a slot being reused by frame + kFrameSlots.
+        Slot& s = h.slots[frame % kFrameSlots][index(point)];
+        s.frame.store(UINT64_MAX, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s.timestamp.store(timestamp_ns, std::memory_order_relaxed);
+        s.frame.store(frame, std::memory_order_release);
+    }
+
+    if (mode == TraceMode::Full) {
+        if (ThreadRing* r = ring(); r && !r->events.try_push({timestamp_ns, frame, head, r->tid, point}))
+            r->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Tracer::complete(Head& head, std::uint64_t frame, std::uint64_t flip_ns) noexcept
+{
+    auto& slots = head.slots[frame % kFrameSlots];
+    std::uint64_t ts[kTracePointCount];
+    bool have[kTracePointCount];
+    for (std::size_t p = 0; p < index(TracePoint::FlipComplete); ++p) {
+        const std::uint64_t tag = slots[p].frame.load(std::memory_order_acquire);
+        ts[p] = slots[p].timestamp.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        have[p] = tag == frame && slots[p].frame.load(std::memory_order_relaxed) == frame;
+    }
+
+    const auto sample = [&](LatencyHistogram& h, TracePoint from, std::uint64_t to_ns, bool have_to) {
+        if (have[index(from)] && have_to && to_ns >= ts[index(from)])
+            h.record(to_ns - ts[index(from)]);
+    };
+    const std::size_t end = index(TracePoint::CommitEnd);
+    sample(head.latency.submit_to_flip, TracePoint::ClientSubmit, flip_ns, true);
+    sample(head.latency.compose, TracePoint::ComposeBegin, ts[index(TracePoint::ComposeEnd)],
+           have[index(TracePoint::ComposeEnd)]);
+    sample(head.latency.commit, TracePoint::CommitBegin, ts[end], have[end]);
+    sample(head.latency.commit_to_flip, TracePoint::CommitEnd, flip_ns, true);
+    head.latency.frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Tracer::record_commit(std::uint32_t head, std::uint64_t frame, const CommitReport& report) noexcept
+{
+    record(head, frame, TracePoint::CommitBegin, report.submit_ns);
+    record(head, frame, TracePoint::CommitEnd, report.submit_ns + report.ioctl_ns);
+    if (report.complete_ns)
+        record(head, frame, TracePoint::FlipComplete, report.complete_ns);
+}
+
+std::size_t Tracer::collect()
+{
+    std::lock_guard lock(mutex_);
+    std::size_t moved = 0;
+    TraceEvent event;
+    for (const std::unique_ptr<ThreadRing>& r : rings_) {
+        while (r->events.try_pop(event)) {
+            if (history_.size() == kHistorySize)
+                history_.pop_front();
+            history_.push_back(event);
+            ++moved;
+        }
+    }
+    stats_.events += moved;
+    return moved;
+}
+
+Tracer::Stats Tracer::stats() const
+{
+    std::lock_guard lock(mutex_);
+    Stats s = stats_;
+    for (const std::unique_ptr<ThreadRing>& r : rings_)
+        s.dropped += r->dropped.load(std::memory_order_relaxed);
+    s.bad_head = bad_head_.load(std::memory_order_relaxed);
+    return s;
+}
+
+std::error_code Tracer::export_chrome_trace(const std::string& path)
+{
+    collect();
+    std::vector<TraceEvent> events;
+    {
+        std::lock_guard lock(mutex_);
+        events.assign(history_.begin(), history_.end());
+    }
+    // Rings are drained one after another, and record_commit() logs past
+    // timestamps; viewers want begin/end pairs in time order.
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TraceEvent& a, const TraceEvent& b) { return a.timestamp_ns < b.timestamp_ns; });
+
+    static constexpr struct {
+        const char* name;
+        char phase;
+    } kPoints[kTracePointCount] = {
+        {"submit", 'i'}, {"compose", 'B'}, {"compose", 'E'}, {"commit", 'B'}, {"commit", 'E'}, {"flip", 'i'},
+    };
+
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char buf[192];
+    std::vector<bool> heads(head_count_);
+    for (const TraceEvent& e : events)
+        heads[e.head] = true;
+    bool first = true;
+    for (std::uint32_t h = 0; h < head_count_; ++h) {
+        if (!heads[h])
+            continue;
+        std::snprintf(buf, sizeof(buf), "%s{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%u,\"args\":{\"name\":\"head %u\"}}",
+                      first ? "" : ",", h, h);
+        json += buf;
+        first = false;
+    }
+    for (const TraceEvent& e : events) {
+        const auto& p = kPoints[index(e.point)];
+        std::snprintf(buf, sizeof(buf),
+                      "%s{\"ph\":\"%c\",\"name\":\"%s\",\"pid\":%u,\"tid\":%u,\"ts\":%" PRIu64 ".%03u%s,\"args\":{\"frame\":%" PRIu64 "}}",
+                      first ? "" : ",", p.phase, p.name, e.head, e.tid, e.timestamp_ns / 1000,
+                      static_cast<unsigned>(e.timestamp_ns % 1000), p.phase == 'i' ? ",\"s\":\"t\"" : "", e.frame);
+        json += buf;
+        first = false;
+    }
+    json += "]}\n";
+
+    UniqueFd fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (!fd)
+        return last_error();
+    const char* p = json.data();
+    std::size_t left = json.size();
+    while (left > 0) {
+        const ssize_t len = ::write(fd.get(), p, left);
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            return last_error();
+        }
+        p += len;
+        left -= static_cast<std::size_t>(len);
+    }
+    return {};
+}
+
+} // namespace dispctrl
@@ -0,0 +1,498 @@
+#include "dispctrl/virtual_kms.hpp"
+
+#include "dispctrl/atomic_request.hpp"
+#include "dispctrl/clock.hpp"
+#include "dispctrl/hash.hpp"
+
+#include "drm_uapi.hpp"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <system_error>
+#include <utility>
+
+namespace dispctrl {
+
+namespace {
+
+// Fences a head can have pending at once: its commit's out-fence, the
+// writeback fences of two overlapping captures and one render fence.
+constexpr std::size_t kFencesPerHead = 4;
+
+// A stand-in fence is one end of a socket pair; the socket's inode tells
+// it apart from whatever later reuses its fd number.
+bool stand_in_key(int fd, std::uint64_t& key) noexcept
+{
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISSOCK(st.st_mode))
+        return false;
+    key = st.st_ino;
+    return true;
+}
+
+} // namespace
+
+VirtualKms::VirtualKms(std::vector<VirtualHead> heads, Clock clock)
+    : clock_(clock), epoch_ns_(monotonic_ns()), now_ns_(epoch_ns_)
+{
+    int fds[2];
+    if (::pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0)
+        throw std::system_error(errno, std::system_category(), "pipe2");
+    read_.reset(fds[0]);
+    write_.reset(fds[1]);
+    // Room for a few frames of every head; the default 64 KiB holds 2048
+    // events. Failing to grow it only costs dropped events under load.
+    const std::size_t want = heads.size() * sizeof(uapi::drm_event_vblank) * 4;
+    if (want > 65536)
+        ::fcntl(write_.get(), F_SETPIPE_SZ, static_cast<int>(std::min<std::size_t>(want, 1 << 20)));
+
+    heads_.reserve(heads.size());
+    for (const VirtualHead& h : heads) {
+        const std::uint32_t refresh = h.refresh_mhz ? h.refresh_mhz : 60000;
+        heads_.push_back({h, 1'000'000'000'000ULL / refresh, h.connected});
+    }
+
+    // At most one flip, one hotplug transition and a few fences are due
+    // per head, so the commit path never allocates.
+    fences_.reserve(heads_.size() * kFencesPerHead);
+    std::vector<Due> storage;
+    storage.reserve(heads_.size() * (2 + kFencesPerHead));
+    due_ = decltype(due_)(std::greater<Due>{}, std::move(storage));
+    notifications_.reserve(heads_.size());
+    touched_.reserve(heads_.size());
+    find_property(0, ObjectType::Plane, "CRTC_ID", crtc_id_prop_);
+    find_property(0, ObjectType::Plane, "IN_FENCE_FD", in_fence_prop_);
+    find_property(0, ObjectType::Crtc, "OUT_FENCE_PTR", out_fence_prop_);
+    find_property(0, ObjectType::Connector, "WRITEBACK_OUT_FENCE_PTR", writeback_fence_prop_);
+    for (std::uint32_t i = 0; i < heads_.size(); ++i)
+        if (heads_[i].config.hotplug_period_ns)
+            due_.push({epoch_ns_ + heads_[i].config.hotplug_phase_ns, i, Due::Kind::Hotplug, 0});
+
+    if (clock_ == Clock::Realtime)
+        thread_ = std::thread([this] { worker(); });
+}
+
+VirtualKms::~VirtualKms()
+{
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+bool VirtualKms::connected(std::size_t head) const
+{
+    std::lock_guard lock(mutex_);
+    return heads_[head].connected;
+}
+
+void VirtualKms::set_hotplug_handler(HotplugHandler handler)
+{
+    std::lock_guard lock(mutex_);
+    hotplug_handler_ = std::move(handler);
+}
+
+void VirtualKms::set_connected(std::size_t head, bool connected)
+{
+    std::unique_lock lock(mutex_);
+    toggle(static_cast<std::uint32_t>(head), connected, clock_ == Clock::Manual ? now_ns_ : monotonic_ns());
+    run_until(lock, 0);
+}
+
+std::uint64_t VirtualKms::now() const
+{
+    if (clock_ == Clock::Realtime)
+        return monotonic_ns();
+    std::lock_guard lock(mutex_);
+    return now_ns_;
+}
+
+void VirtualKms::advance(std::uint64_t ns)
+{
+    if (clock_ != Clock::Manual)
+        return;
+    std::unique_lock lock(mutex_);
+    run_until(lock, now_ns_ + ns);
+}
+
+void VirtualKms::complete_flips()
+{
+    if (clock_ != Clock::Manual)
+        return;
+    std::unique_lock lock(mutex_);
+    std::uint64_t last = now_ns_;
+    for (const Head& h : heads_)
+        if (h.flip_pending)
+            last = std::max(last, h.flip_due_ns);
+    run_until(lock, last);
+}
+
+void VirtualKms::set_plane_limit(std::size_t planes, std::uint32_t fb_prop)
+{
+    std::lock_guard lock(mutex_);
+    plane_limit_ = planes;
+    fb_prop_ = fb_prop;
+}
+
+VirtualKms::Stats VirtualKms::stats() const
+{
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+std::uint64_t VirtualKms::next_vblank(const Head& head, std::uint64_t after_ns) const noexcept
+{
+    return epoch_ns_ + ((after_ns - epoch_ns_) / head.period_ns + 1) * head.period_ns;
+}
+
+std::uint64_t VirtualKms::queue_flip(std::uint32_t head, std::uint64_t user_data, std::uint64_t not_before_ns)
+{
+    Head& h = heads_[head];
+    const std::uint64_t now = clock_ == Clock::Manual ? now_ns_ : monotonic_ns();
+    const std::uint64_t at = next_vblank(h, std::max(now + h.config.flip_latency_ns, not_before_ns));
+    const bool earliest = due_.empty() || at < due_.top().time_ns;
+    h.flip_pending = true;
+    h.flip_due_ns = at;
+    due_.push({at, head, Due::Kind::Flip, user_data});
+    if (earliest && clock_ == Clock::Realtime)
+        wake_.notify_one();
+    return at;
+}
+
+std::error_code VirtualKms::create_fence(std::uint64_t signal_ns, UniqueFd& fence) noexcept
+{
+    std::unique_lock lock(mutex_);
+    if (std::error_code ec = add_fence(signal_ns, fence))
+        return ec;
+    run_until(lock, 0); // signals it at once if it is not in the future
+    return {};
+}
+
+std::vector<VirtualKms::Fence>::iterator VirtualKms::find_fence(std::uint64_t key) noexcept
+{
+    return std::find_if(fences_.begin(), fences_.end(), [key](const Fence& f) { return f.key == key; });
+}
+
+std::error_code VirtualKms::add_fence(std::uint64_t signal_ns, UniqueFd& fence)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, fds) != 0)
+        return {errno, std::system_category()};
+    UniqueFd fd(fds[0]);
+    UniqueFd signal(fds[1]);
+    std::uint64_t key = 0;
+    if (!stand_in_key(fd.get(), key))
+        return {errno, std::system_category()};
+    try {
+        fences_.push_back({key, signal_ns, std::move(signal)});
+        const bool earliest = due_.empty() || signal_ns < due_.top().time_ns;
+        due_.push({signal_ns, 0, Due::Kind::Fence, key});
+        if (earliest && clock_ == Clock::Realtime)
+            wake_.notify_one();
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+    fence = std::move(fd);
+    return {};
+}
+
+std::error_code VirtualKms::fence_status(int fence_fd, FenceStatus& status) noexcept
+{
+    std::uint64_t key = 0;
+    if (stand_in_key(fence_fd, key)) {
+        {
+            std::lock_guard lock(mutex_);
+            if (find_fence(key) != fences_.end()) {
+                status = {};
+                status.state = FenceStatus::State::Pending;
+                return {};
+            }
+        }
+        // Signalled: the signal time waits in the socket, and peeking
+        // leaves it there for the next query.
+        std::uint64_t signal_ns = 0;
+        if (::recv(fence_fd, &signal_ns, sizeof(signal_ns), MSG_PEEK | MSG_DONTWAIT) == sizeof(signal_ns)) {
+            status = {};
+            status.state = FenceStatus::State::Signaled;
+            status.timestamp_ns = signal_ns;
+            return {};
+        }
+    }
+    return query_fence(fence_fd, status);
+}
+
+void VirtualKms::schedule_hotplug(std::uint32_t head, std::uint64_t from_ns)
+{
+    const VirtualHead& c = heads_[head].config;
+    const std::uint64_t down = std::min(c.hotplug_down_ns, c.hotplug_period_ns);
+    // from_ns is the transition just made; the pattern alternates.
+    if (heads_[head].connected)
+        due_.push({from_ns + (c.hotplug_period_ns - down), head, Due::Kind::Hotplug, 0});
+    else
+        due_.push({from_ns + down, head, Due::Kind::Hotplug, 1});
+}
+
+void VirtualKms::toggle(std::uint32_t head, bool connected, std::uint64_t time_ns)
+{
+    Head& h = heads_[head];
+    if (h.connected == connected)
+        return;
+    h.connected = connected;
+    ++stats_.hotplugs;
+    notifications_.push_back({connector_id(head), connected, time_ns});
+}
+
+void VirtualKms::run_until(std::unique_lock<std::mutex>& lock, std::uint64_t time_ns)
+{
+    while (!due_.empty() && due_.top().time_ns <= time_ns) {
+        const Due d = due_.top();
+        due_.pop();
+        if (d.kind == Due::Kind::Flip) {
+            heads_[d.head].flip_pending = false;
+            emit(d.head, d.user_data, d.time_ns);
+        } else if (d.kind == Due::Kind::Fence) {
+            // Makes the caller's end readable with the signal time, even if
+            // it is already closed, and forgets the fence.
+            auto it = find_fence(d.user_data);
+            if (it != fences_.end() && it->signal_ns == d.time_ns) {
+                [[maybe_unused]] ssize_t n =
+                    ::send(it->signal.get(), &d.time_ns, sizeof(d.time_ns), MSG_DONTWAIT | MSG_NOSIGNAL);
+                *it = std::move(fences_.back());
+                fences_.pop_back();
+            }
+        } else {
+            toggle(d.head, d.user_data != 0, d.time_ns);
+            schedule_hotplug(d.head, d.time_ns);
+        }
+    }
+    if (clock_ == Clock::Manual)
+        now_ns_ = std::max(now_ns_, time_ns);
+
+    if (notifications_.empty() || !hotplug_handler_) {
+        notifications_.clear();
+        return;
+    }
+    // Handlers run unlocked so they may call back into the device.
+    std::vector<Notification> batch;
+    batch.swap(notifications_);
+    HotplugHandler handler = hotplug_handler_;
+    lock.unlock();
+    for (const Notification& n : batch)
+        handler(n.connector_id, n.connected, n.timestamp_ns);
+    lock.lock();
+    batch.clear();
+    if (notifications_.empty())
+        notifications_.swap(batch); // keep the reserved capacity
+}
+
+void VirtualKms::emit(std::uint32_t head, std::uint64_t user_data, std::uint64_t time_ns) noexcept
+{
+    uapi::drm_event_vblank ev{};
+    ev.base.type = uapi::DRM_EVENT_FLIP_COMPLETE;
+    ev.base.length = sizeof(ev);
+    ev.user_data = user_data;
+    ev.tv_sec = static_cast<std::uint32_t>(time_ns / 1'000'000'000);
+    ev.tv_usec = static_cast<std::uint32_t>(time_ns % 1'000'000'000 / 1000);
+    ev.sequence = static_cast<std::uint32_t>((time_ns - epoch_ns_) / heads_[head].period_ns);
+    ev.crtc_id = crtc_id(head);
+    if (::write(write_.get(), &ev, sizeof(ev)) == static_cast<ssize_t>(sizeof(ev)))
+        ++stats_.flips;
+    else
+        ++stats_.dropped;
+}
+
+void VirtualKms::worker()
+{
+    std::unique_lock lock(mutex_);
+    while (!stopping_) {
+        run_until(lock, monotonic_ns());
+        if (stopping_)
+            break;
+        if (due_.empty()) {
+            wake_.wait(lock);
+            continue;
+        }
+        const std::uint64_t now = monotonic_ns();
+        const std::uint64_t at = due_.top().time_ns;
+        if (at > now)
+            wake_.wait_for(lock, std::chrono::nanoseconds(at - now));
+    }
+}
+
+std::error_code VirtualKms::import_dmabuf(int, std::uint32_t& handle) noexcept
+{
+    std::lock_guard lock(mutex_);
+    handle = ++next_id_;
+    return {};
+}
+
+std::error_code VirtualKms::add_framebuffer(const FramebufferLayout&, std::uint32_t& fb_id) noexcept
+{
+    std::lock_guard lock(mutex_);
+    fb_id = ++next_id_;
+    return {};
+}
+
+std::error_code VirtualKms::page_flip(std::uint32_t crtc_id, std::uint32_t, std::uint64_t user_data) noexcept
+{
+    if (crtc_id < kFirstCrtc || crtc_id - kFirstCrtc >= heads_.size())
+        return std::make_error_code(std::errc::invalid_argument);
+    const std::uint32_t head = crtc_id - kFirstCrtc;
+    std::lock_guard lock(mutex_);
+    ++stats_.commits;
+    if (heads_[head].flip_pending) {
+        ++stats_.busy;
+        return std::make_error_code(std::errc::device_or_resource_busy);
+    }
+    queue_flip(head, user_data, 0);
+    return {};
+}
+
+std::error_code VirtualKms::atomic_commit(const AtomicRequest& request, std::uint32_t flags,
+                                          std::uint64_t user_data) noexcept
+{
+    const auto is_crtc = [this](std::uint32_t id) { return id >= kFirstCrtc && id - kFirstCrtc < heads_.size(); };
+    std::lock_guard lock(mutex_);
+    ++stats_.commits;
+    if (flags & commit::TestOnly) {
+        std::size_t planes = 0;
+        for (std::size_t i = 0; i < request.props().size(); ++i)
+            planes += request.props()[i] == fb_prop_ && request.values()[i] != 0;
+        return planes > plane_limit_ ? std::make_error_code(std::errc::invalid_argument) : std::error_code{};
+    }
+
+    // Heads the commit affects: CRTCs it writes, and CRTCs of the planes
+    // it writes, with bindings the commit itself makes taking precedence.
+    const auto objects = request.objects();
+    const auto counts = request.prop_counts();
+    std::size_t p = 0;
+    touched_.clear();
+    const auto touch = [this](std::uint32_t head) {
+        if (!heads_[head].touched) {
+            heads_[head].touched = true;
+            touched_.push_back(head);
+        }
+    };
+    for (std::size_t o = 0; o < objects.size(); p += counts[o], ++o) {
+        if (is_crtc(objects[o])) {
+            touch(objects[o] - kFirstCrtc);
+            continue;
+        }
+        std::uint64_t crtc = 0;
+        bool rebinds = false;
+        for (std::size_t i = p; i < p + counts[o]; ++i) {
+            if (request.props()[i] == crtc_id_prop_) {
+                crtc = request.values()[i];
+                rebinds = true;
+            }
+        }
+        if (!rebinds) {
+            if (auto it = plane_heads_.find(objects[o]); it != plane_heads_.end())
+                touch(it->second);
+        } else if (crtc <= UINT32_MAX && is_crtc(static_cast<std::uint32_t>(crtc))) {
+            touch(static_cast<std::uint32_t>(crtc) - kFirstCrtc);
+        }
+    }
+
+    bool busy = false;
+    for (std::uint32_t head : touched_) {
+        busy = busy || heads_[head].flip_pending;
+        heads_[head].touched = false;
+    }
+    if (busy && (flags & commit::PageFlipEvent)) {
+        // All or nothing: reject before anything is applied.
+        ++stats_.busy;
+        return std::make_error_code(std::errc::device_or_resource_busy);
+    }
+
+    try {
+        for (std::size_t o = 0, q = 0; o < objects.size(); q += counts[o], ++o) {
+            for (std::size_t i = q; i < q + counts[o]; ++i) {
+                if (request.props()[i] != crtc_id_prop_ || is_crtc(objects[o]))
+                    continue;
+                const std::uint64_t crtc = request.values()[i];
+                if (crtc <= UINT32_MAX && is_crtc(static_cast<std::uint32_t>(crtc)))
+                    plane_heads_[objects[o]] = static_cast<std::uint32_t>(crtc) - kFirstCrtc;
+                else
+                    plane_heads_.erase(objects[o]);
+            }
+        }
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+
+    // Flips wait for the commit's in-fences; an out-fence signals with
+    // the last of its flips.
+    std::uint64_t not_before = 0;
+    std::int32_t* out_fence = nullptr;
+    for (std::size_t o = 0, q = 0; o < objects.size(); q += counts[o], ++o) {
+        for (std::size_t i = q; i < q + counts[o]; ++i) {
+            const std::uint64_t value = request.values()[i];
+            if (request.props()[i] == in_fence_prop_ && !is_crtc(objects[o])) {
+                // Only pending fences hold the flip back.
+                std::uint64_t key = 0;
+                if (stand_in_key(static_cast<int>(static_cast<std::int64_t>(value)), key))
+                    if (auto it = find_fence(key); it != fences_.end())
+                        not_before = std::max(not_before, it->signal_ns);
+            } else if (request.props()[i] == out_fence_prop_ && is_crtc(objects[o])) {
+                out_fence = reinterpret_cast<std::int32_t*>(static_cast<std::uintptr_t>(value));
+            }
+        }
+    }
+
+    std::uint64_t done = clock_ == Clock::Manual ? now_ns_ : monotonic_ns();
+    if (flags & commit::PageFlipEvent)
+        for (std::uint32_t head : touched_)
+            done = std::max(done, queue_flip(head, user_data, not_before));
+    if (out_fence) {
+        UniqueFd fence;
+        *out_fence = add_fence(done, fence) ? -1 : fence.release();
+    }
+
+    // A writeback job runs while the frame it captures is scanned out.
+    for (std::size_t o = 0, q = 0; o < objects.size(); q += counts[o], ++o) {
+        for (std::size_t i = q; i < q + counts[o]; ++i) {
+            if (request.props()[i] != writeback_fence_prop_ || is_crtc(objects[o]))
+                continue;
+            auto* ptr = reinterpret_cast<std::int32_t*>(static_cast<std::uintptr_t>(request.values()[i]));
+            const auto it = plane_heads_.find(objects[o]);
+            if (it == plane_heads_.end()) {
+                *ptr = -1;
+                continue;
+            }
+            UniqueFd fence;
+            const Head& h = heads_[it->second];
+            const std::uint64_t now = clock_ == Clock::Manual ? now_ns_ : monotonic_ns();
+            const std::uint64_t shown = h.flip_pending ? h.flip_due_ns : next_vblank(h, now);
+            *ptr = add_fence(shown + h.period_ns, fence) ? -1 : fence.release();
+            ++stats_.writebacks;
+        }
+    }
+    return {};
+}
+
+std::error_code VirtualKms::find_property(std::uint32_t, ObjectType, std::string_view name,
+                                          std::uint32_t& prop_id) noexcept
+{
+    prop_id = static_cast<std::uint32_t>(fnv1a64(name.data(), name.size()) & 0xffff) + 1;
+    return {};
+}
+
+std::error_code VirtualKms::create_blob(const void*, std::size_t, std::uint32_t& blob_id) noexcept
+{
+    std::lock_guard lock(mutex_);
+    blob_id = ++next_id_;
+    return {};
+}
+
+} // namespace dispctrl
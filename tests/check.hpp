@@ -0,0 +1,27 @@
+#pragma once
+
+// Minimal assertion helpers for the self-checking test programs: a failed
+// CHECK reports its location and the program exits non-zero at the end.
+
+#include <cstdio>
+
+namespace dispctrl::test {
+
+inline int failures = 0;
+
+inline int result()
+{
+    if (failures)
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
+
+} // namespace dispctrl::test
+
+#define CHECK(cond)                                                                          \
+    do {                                                                                     \
+        if (!(cond)) {                                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);    \
+            ++::dispctrl::test::failures;                                                    \
+        }                                                                                    \
+    } while (0)
@@ -0,0 +1,124 @@
+#include "dispctrl/async_kms.hpp"
+#include "dispctrl/executor.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include "check.hpp"
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace {
+
+using namespace dispctrl;
+
+// A coroutine that runs at once and whose frame lives until the object
+// is destroyed, so a test can destroy it while it is suspended.
+class Waiter {
+public:
+    struct promise_type {
+        Waiter get_return_object() noexcept { return Waiter(Handle::from_promise(*this)); }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_always final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Waiter(Waiter&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Waiter& operator=(Waiter&&) = delete;
+    ~Waiter()
+    {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    bool done() const noexcept { return handle_.done(); }
+
+private:
+    explicit Waiter(Handle h) noexcept : handle_(h) {}
+
+    Handle handle_;
+};
+
+struct Woken {
+    int count = 0;
+    std::uint32_t connector_id = 0;
+};
+
+// Waits for one hotplug; then destroys @p victim, if any, still waiting or
+// not.
+Waiter wait_hotplug(AsyncKms& kms, Woken& woken, std::optional<Waiter>* victim)
+{
+    const HotplugEvent event = co_await kms.hotplug();
+    ++woken.count;
+    woken.connector_id = event.connector_id;
+    if (victim)
+        victim->reset();
+}
+
+// Waits for two hotplugs in a row.
+Waiter wait_twice(AsyncKms& kms, Woken& woken)
+{
+    for (int i = 0; i < 2; ++i) {
+        const HotplugEvent event = co_await kms.hotplug();
+        ++woken.count;
+        woken.connector_id = event.connector_id;
+    }
+}
+
+void check_sibling_destroyed()
+{
+    Executor ex;
+    VirtualKms device(1, VirtualHead{});
+    AsyncKms kms(ex, device);
+
+    // Waiters are resumed newest first: killer, then victim, then last.
+    Woken last_woken, victim_woken, killer_woken;
+    std::optional<Waiter> last(wait_hotplug(kms, last_woken, nullptr));
+    std::optional<Waiter> victim(wait_hotplug(kms, victim_woken, nullptr));
+    std::optional<Waiter> killer(wait_hotplug(kms, killer_woken, &victim));
+
+    kms.notify_hotplug({7, 1});
+    CHECK(killer_woken.count == 1 && killer->done());
+    CHECK(!victim);
+    CHECK(victim_woken.count == 0);
+    CHECK(last_woken.count == 1 && last_woken.connector_id == 7 && last->done());
+
+    // Nothing is left waiting, destroyed or not.
+    kms.notify_hotplug({8, 2});
+    CHECK(killer_woken.count == 1 && last_woken.count == 1);
+}
+
+void check_rewait()
+{
+    Executor ex;
+    VirtualKms device(1, VirtualHead{});
+    AsyncKms kms(ex, device);
+
+    // A waiter that waits again at once sees the next event, not this one.
+    Woken woken;
+    std::optional<Waiter> waiter(wait_twice(kms, woken));
+    kms.notify_hotplug({3, 1});
+    CHECK(woken.count == 1 && !waiter->done());
+    kms.notify_hotplug({4, 2});
+    CHECK(woken.count == 2 && woken.connector_id == 4 && waiter->done());
+
+    // A waiter destroyed while suspended unlinks itself.
+    Woken gone;
+    std::optional<Waiter> abandoned(wait_hotplug(kms, gone, nullptr));
+    abandoned.reset();
+    kms.notify_hotplug({5, 3});
+    CHECK(gone.count == 0);
+}
+
+} // namespace
+
+int main()
+{
+    check_sibling_destroyed();
+    check_rewait();
+    return test::result();
+}
@@ -0,0 +1,262 @@
+#include "dispctrl/compositor.hpp"
+#include "dispctrl/format.hpp"
+#include "dispctrl/pixel_convert.hpp"
+
+#include "check.hpp"
+
+#include "blend_kernels.hpp"
+#include "fetch_kernels.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::array<std::uint32_t, 4> kEdgeAlphas = {0, 1, 254, 255};
+constexpr std::uint32_t kSurfaceSize = 160; ///< Square source, large enough for every walk below.
+
+// A buffer whose last byte is followed by an unmapped page, so a kernel
+// reading past the end of its rows faults instead of passing unnoticed.
+class GuardedBuffer {
+public:
+    explicit GuardedBuffer(std::size_t size)
+    {
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        map_size_ = (size + page - 1) / page * page + page;
+        map_ = static_cast<std::uint8_t*>(
+            ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        ::mprotect(map_ + map_size_ - page, page, PROT_NONE);
+        data_ = map_ + map_size_ - page - size;
+    }
+    ~GuardedBuffer() { ::munmap(map_, map_size_); }
+    GuardedBuffer(const GuardedBuffer&) = delete;
+    GuardedBuffer& operator=(const GuardedBuffer&) = delete;
+
+    std::uint8_t* data() const noexcept { return data_; }
+    std::uint32_t* pixels() const noexcept { return reinterpret_cast<std::uint32_t*>(data_); }
+
+private:
+    std::uint8_t* map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::uint8_t* data_ = nullptr;
+};
+
+// x * y / 255 rounded to nearest, by definition (x * y is never an odd
+// multiple of 127.5, so there are no ties).
+std::uint32_t ref_mul(std::uint32_t x, std::uint32_t y)
+{
+    return (2 * x * y + 255) / 510;
+}
+
+std::uint32_t ref_over(std::uint32_t s, std::uint32_t d)
+{
+    const std::uint32_t inv = 255 - (s >> 24);
+    std::uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        const std::uint32_t c = (s >> shift & 0xff) + ref_mul(d >> shift & 0xff, inv);
+        out |= std::min(c, 255u) << shift;
+    }
+    return out;
+}
+
+std::uint32_t ref_load(std::uint32_t format, BlendMode mode, const std::uint8_t* p)
+{
+    const bool bgr = format == fourcc::XBGR8888 || format == fourcc::ABGR8888;
+    const std::uint32_t b = p[bgr ? 2 : 0], g = p[1], r = p[bgr ? 0 : 2];
+    if (!blend::has_alpha(format) || mode == BlendMode::Opaque)
+        return 0xff000000u | r << 16 | g << 8 | b;
+    const std::uint32_t a = p[3];
+    if (mode == BlendMode::Coverage)
+        return a << 24 | ref_mul(r, a) << 16 | ref_mul(g, a) << 8 | ref_mul(b, a);
+    return a << 24 | r << 16 | g << 8 | b;
+}
+
+// Random channels under an alpha that is mostly one of the edge cases.
+std::uint32_t random_pixel(std::mt19937& rng)
+{
+    const std::uint32_t a = rng() % 4 != 0 ? kEdgeAlphas[rng() % kEdgeAlphas.size()] : rng() & 0xff;
+    return a << 24 | (rng() & 0xffffff);
+}
+
+struct NamedKernels {
+    const char* name;
+    const blend::BlendKernels* kernels;
+};
+
+std::vector<NamedKernels> available_kernels()
+{
+    std::vector<NamedKernels> sets{{"scalar", &blend::kScalarKernels}};
+#ifdef DISPCTRL_HAVE_AVX2
+    if (convert_isa_available(ConvertIsa::Avx2))
+        sets.push_back({"avx2", &blend::kAvx2Kernels});
+#endif
+#ifdef DISPCTRL_HAVE_NEON
+    if (convert_isa_available(ConvertIsa::Neon))
+        sets.push_back({"neon", &blend::kNeonKernels});
+#endif
+    return sets;
+}
+
+void check_mul_div255()
+{
+    int bad = 0;
+    for (std::uint32_t x = 0; x < 256; ++x)
+        for (std::uint32_t y = 0; y < 256; ++y)
+            bad += blend::mul_div255(x, y) != ref_mul(x, y);
+    CHECK(bad == 0);
+
+    int bad_premultiply = 0;
+    for (std::uint32_t a : {0u, 1u, 127u, 128u, 254u, 255u})
+        for (std::uint32_t c = 0; c < 256; ++c) {
+            const std::uint32_t p = a << 24 | c << 16 | (255 - c) << 8 | c;
+            bad_premultiply += blend::premultiply(p) != (a << 24 | ref_mul(c, a) << 16 | ref_mul(255 - c, a) << 8 |
+                                                         ref_mul(c, a));
+        }
+    CHECK(bad_premultiply == 0);
+}
+
+// Blends @p width source pixels, the row ending at a guard page, with
+// @p fill choosing the alphas: 0 mixed, 1 all opaque, 2 all transparent,
+// 3 one edge alpha per run of 8.
+void check_over(const NamedKernels& set, std::uint32_t width, int fill, std::mt19937& rng)
+{
+    GuardedBuffer src(std::size_t{width} * 4);
+    GuardedBuffer dst(std::size_t{width} * 4);
+    std::vector<std::uint32_t> expected(width);
+    for (std::uint32_t x = 0; x < width; ++x) {
+        std::uint32_t s = random_pixel(rng);
+        if (fill == 1)
+            s |= 0xff000000u;
+        else if (fill == 2)
+            s &= 0x00ffffffu;
+        else if (fill == 3)
+            s = kEdgeAlphas[x / 8 % kEdgeAlphas.size()] << 24 | (s & 0xffffff);
+        src.pixels()[x] = s;
+        dst.pixels()[x] = rng();
+        expected[x] = ref_over(s, dst.pixels()[x]);
+    }
+    set.kernels->over(src.pixels(), dst.pixels(), width);
+    int bad = 0;
+    for (std::uint32_t x = 0; x < width; ++x)
+        bad += dst.pixels()[x] != expected[x];
+    if (bad)
+        std::fprintf(stderr, "%s over: width %u fill %d: %d pixel(s) differ\n", set.name, width, fill, bad);
+    CHECK(bad == 0);
+}
+
+struct Walk {
+    std::uint32_t step;
+    std::uint32_t step_rem;
+    std::uint32_t denom;
+    std::uint32_t rem;
+};
+
+// Runs fetch kernel @p index over @p count samples from the edge of the
+// surface it walks away from, and compares each sample to ref_load() of
+// the pixel the nearest-sampling walk lands on.
+void check_fetch(std::size_t index, std::uint32_t format, BlendMode mode, Rotation rotation, bool scaled,
+                 const GuardedBuffer& surface, std::uint32_t count)
+{
+    constexpr std::uint32_t pitch = kSurfaceSize * 4;
+    constexpr std::uint32_t last = kSurfaceSize - 1;
+    // Start row/column 3 so rotated walks cross pixels of every alpha.
+    std::uint32_t x = 0, y = 3;
+    std::ptrdiff_t stride = 4;
+    switch (rotation) {
+    case Rotation::R0:
+        break;
+    case Rotation::R90:
+        x = 3;
+        y = 0;
+        stride = pitch;
+        break;
+    case Rotation::R180:
+        x = last;
+        stride = -4;
+        break;
+    case Rotation::R270:
+        x = 3;
+        y = last;
+        stride = -std::ptrdiff_t{pitch};
+        break;
+    }
+
+    // Upscaling 3 -> 7 (step 0) and downscaling 16 -> 11 (step 1).
+    const std::array<Walk, 2> walks = {Walk{0, 2 * 3, 2 * 7, 3}, Walk{1, 2 * 5, 2 * 11, 16}};
+    for (const Walk& walk : scaled ? std::span<const Walk>(walks) : std::span<const Walk>(walks.data(), 1)) {
+        const std::uint8_t* first = surface.data() + std::size_t{y} * pitch + std::size_t{x} * 4;
+        const blend::FetchSpan span{first, pitch, walk.step, walk.step_rem, walk.rem, walk.denom};
+        std::vector<std::uint32_t> out(count + 1, 0xdeadbeef);
+        blend::kFetchKernels[index](span, out.data(), count);
+
+        int bad = 0;
+        for (std::uint32_t k = 0; k < count; ++k) {
+            const std::uint64_t advance =
+                scaled ? std::uint64_t{k} * walk.step + (walk.rem + std::uint64_t{k} * walk.step_rem) / walk.denom : k;
+            const std::uint8_t* p = first + static_cast<std::ptrdiff_t>(advance) * stride;
+            bad += out[k] != ref_load(format, mode, p);
+        }
+        if (bad)
+            std::fprintf(stderr, "fetch %zu (format %zu mode %d rotation %d scaled %d) count %u: %d sample(s) differ\n",
+                         index, index / (blend::kBlendModes * blend::kRotations * 2), static_cast<int>(mode),
+                         static_cast<int>(rotation), scaled, count, bad);
+        CHECK(bad == 0);
+        CHECK(out[count] == 0xdeadbeef); // nothing written past the run
+    }
+}
+
+void check_fetch_table(std::mt19937& rng)
+{
+    GuardedBuffer surface(std::size_t{kSurfaceSize} * kSurfaceSize * 4);
+    for (std::size_t i = 0; i < std::size_t{kSurfaceSize} * kSurfaceSize; ++i)
+        surface.pixels()[i] = random_pixel(rng);
+
+    std::size_t expected_index = 0;
+    for (std::size_t format = 0; format < blend::kSourceFormats.size(); ++format)
+        for (std::size_t mode = 0; mode < blend::kBlendModes; ++mode)
+            for (std::size_t rotation = 0; rotation < blend::kRotations; ++rotation)
+                for (bool scaled : {false, true}) {
+                    const auto m = static_cast<BlendMode>(mode);
+                    const auto r = static_cast<Rotation>(rotation);
+                    const std::size_t index = blend::fetch_index(format, m, r, scaled);
+                    CHECK(index == expected_index++);
+                    for (std::uint32_t count = 1; count <= 67; ++count)
+                        check_fetch(index, blend::kSourceFormats[format], m, r, scaled, surface, count);
+                }
+    CHECK(expected_index == blend::kFetchKernels.size());
+    CHECK(blend::kFetchKernels.size() == 96);
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(4321);
+    check_mul_div255();
+
+    const std::vector<NamedKernels> sets = available_kernels();
+    for (const NamedKernels& set : sets) {
+        // Every tail length around the 8- and 16-pixel blocks, and rows
+        // that are not a multiple of either.
+        for (std::uint32_t width = 0; width <= 67; ++width)
+            for (int fill = 0; fill < 4; ++fill)
+                check_over(set, width, fill, rng);
+        for (std::uint32_t width : {127u, 129u, 1279u, 1921u})
+            check_over(set, width, 0, rng);
+    }
+    check_fetch_table(rng);
+
+    std::printf("checked %zu over kernel set(s) and %zu fetch kernels\n", sets.size(), blend::kFetchKernels.size());
+    return test::result();
+}
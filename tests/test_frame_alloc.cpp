@@ -0,0 +1,132 @@
+#include "dispctrl/alloc_counter.hpp"
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/frame_arena.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/kms_shadow.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include "check.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <memory_resource>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::uint32_t kCrtc = VirtualKms::kFirstCrtc;
+constexpr std::uint32_t kFirstPlane = 50;
+constexpr std::uint32_t kPlanes = 16;
+constexpr int kWarmupFrames = 8;
+constexpr int kFrames = 1000;
+
+struct PlaneState {
+    std::uint32_t plane_id;
+    std::uint64_t fb_id;
+};
+
+class FrameLoop {
+public:
+    explicit FrameLoop(bool shadowed) : kms_(1, VirtualHead{}), queue_(kms_, kCrtc)
+    {
+        if (shadowed)
+            queue_.set_shadow(&shadow_);
+        kms_.find_property(kFirstPlane, ObjectType::Plane, "FB_ID", fb_prop_);
+        kms_.find_property(kFirstPlane, ObjectType::Plane, "CRTC_ID", crtc_prop_);
+        // Each frame's release fence replaces, and closes, the last one.
+        std::uint32_t out_fence_prop = 0;
+        kms_.find_property(kCrtc, ObjectType::Crtc, "OUT_FENCE_PTR", out_fence_prop);
+        queue_.set_out_fence(out_fence_prop, [this](std::uint64_t, UniqueFd fence) { release_ = std::move(fence); });
+    }
+
+    // A compositor frame: the scene is gathered on the frame arena, every
+    // plane's state is recorded, then the commit is submitted with an
+    // out-fence and its flip completed.
+    bool frame()
+    {
+        ++frame_;
+        {
+            std::pmr::vector<PlaneState> scene(&arena_);
+            for (std::uint32_t p = 0; p < kPlanes; ++p)
+                scene.push_back({kFirstPlane + p, 1000 + (frame_ + p) % 3});
+            for (const PlaneState& plane : scene) {
+                queue_.set(plane.plane_id, fb_prop_, plane.fb_id);
+                queue_.set(plane.plane_id, crtc_prop_, kCrtc);
+            }
+        }
+        arena_.reset();
+        if (queue_.flush())
+            return false;
+        kms_.complete_flips();
+        std::array<KmsEvent, kMaxEventsPerRead> events;
+        std::size_t count = 0;
+        if (read_kms_events(kms_.event_fd(), events, count))
+            return false;
+        for (std::size_t i = 0; i < count; ++i)
+            queue_.on_flip_complete(events[i]);
+        return count != 0;
+    }
+
+    const CommitQueue& queue() const noexcept { return queue_; }
+    const FrameArena& arena() const noexcept { return arena_; }
+
+private:
+    VirtualKms kms_;
+    KmsShadow shadow_; // outlives the queue that diffs against it
+    FrameArena arena_;
+    CommitQueue queue_;
+    std::uint32_t fb_prop_ = 0;
+    std::uint32_t crtc_prop_ = 0;
+    std::uint64_t frame_ = 0;
+    UniqueFd release_;
+};
+
+void check_steady_state(bool shadowed)
+{
+    FrameLoop loop(shadowed);
+    for (int i = 0; i < kWarmupFrames; ++i)
+        CHECK(loop.frame());
+
+    const std::uint64_t upstream = loop.arena().stats().upstream_allocations;
+    const std::uint64_t queue_upstream = loop.queue().arena_stats().upstream_allocations;
+    const std::uint64_t commits = loop.queue().stats().commits;
+    HeapAllocationScope scope;
+    bool ok = true;
+    for (int i = 0; i < kFrames; ++i)
+        ok = loop.frame() && ok;
+    const std::uint64_t allocations = scope.count();
+
+    if (allocations)
+        std::fprintf(stderr, "shadow %d: %llu heap allocation(s) in %d frames\n", shadowed,
+                     static_cast<unsigned long long>(allocations), kFrames);
+    CHECK(ok);
+    CHECK(allocations == 0);
+    CHECK(loop.queue().stats().commits - commits == kFrames);
+    CHECK(loop.queue().stats().out_fences >= kFrames);
+    CHECK(loop.arena().stats().upstream_allocations == upstream);
+    CHECK(loop.queue().arena_stats().upstream_allocations == queue_upstream);
+}
+
+} // namespace
+
+int main()
+{
+    // Without the hooks every count would read zero and prove nothing.
+    CHECK(heap_allocation_tracking());
+
+    // The counter must see an allocation to be trusted with a zero.
+    {
+        HeapAllocationScope scope;
+        std::vector<int> v(16);
+        int* volatile escape = v.data(); // keep the allocation from being elided
+        (void)escape;
+        CHECK(scope.count() >= 1);
+    }
+
+    check_steady_state(false);
+    check_steady_state(true);
+    return test::result();
+}
@@ -0,0 +1,153 @@
+#include "dispctrl/edid.hpp"
+#include "dispctrl/hotplug.hpp"
+
+#include "check.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::uint32_t kConnector = 40;
+
+void set_checksum(std::uint8_t* block)
+{
+    std::uint8_t sum = 0;
+    for (int i = 0; i < 127; ++i)
+        sum = static_cast<std::uint8_t>(sum + block[i]);
+    block[127] = static_cast<std::uint8_t>(0x100 - sum);
+}
+
+// A 1920x1080@60 monitor; @p serial tells two of them apart.
+std::vector<std::uint8_t> make_edid(std::uint32_t serial)
+{
+    std::vector<std::uint8_t> edid(128, 0);
+    std::uint8_t* b = edid.data();
+    const std::uint8_t header[] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+    std::copy(std::begin(header), std::end(header), b);
+    b[8] = 0x10; // "DEL"
+    b[9] = 0xac;
+    b[12] = static_cast<std::uint8_t>(serial);
+    b[13] = static_cast<std::uint8_t>(serial >> 8);
+    b[18] = 1;
+    b[19] = 4;
+    b[21] = 53;
+    b[22] = 30;
+
+    // DTD: 148.5 MHz, 1920/2200 x 1080/1125.
+    std::uint8_t* d = b + 54;
+    d[0] = 14850 & 0xff;
+    d[1] = 14850 >> 8;
+    d[2] = 1920 & 0xff;
+    d[3] = 280 & 0xff;
+    d[4] = (1920 >> 8) << 4 | (280 >> 8);
+    d[5] = 1080 & 0xff;
+    d[6] = 45;
+    d[7] = (1080 >> 8) << 4;
+    d[8] = 88;
+    d[9] = 44;
+    d[10] = 4 << 4 | 5;
+    d[17] = 0x1e;
+
+    for (int desc = 72; desc < 126; desc += 18)
+        b[desc + 3] = 0x10; // dummy descriptors
+    set_checksum(b);
+    return edid;
+}
+
+// Probes like DrmConnectorProber: the monitor's EDID is read and decoded
+// on every probe, into a new DisplayInfo unless an EdidCache is given.
+class EdidProber final : public ConnectorProber {
+public:
+    explicit EdidProber(EdidCache* edids) noexcept : edids_(edids) {}
+
+    void plug(std::vector<std::uint8_t> edid) { edid_ = std::move(edid); }
+
+    std::error_code probe(std::uint32_t connector_id, ConnectorInfo& out) override
+    {
+        out = {};
+        out.connector_id = connector_id;
+        out.status = ConnectorInfo::Status::Connected;
+        out.width_mm = 530;
+        out.height_mm = 300;
+        std::shared_ptr<const DisplayInfo> display;
+        if (edids_) {
+            if (std::error_code ec = edids_->lookup(edid_, display))
+                return ec;
+        } else {
+            auto decoded = std::make_shared<DisplayInfo>();
+            if (std::error_code ec = parse_display_info(edid_, *decoded))
+                return ec;
+            display = std::move(decoded);
+        }
+        out.modes = display->modes;
+        out.display = std::move(display);
+        return {};
+    }
+
+    std::error_code connectors(std::vector<std::uint32_t>& out) override
+    {
+        out.assign(1, kConnector);
+        return {};
+    }
+
+private:
+    EdidCache* edids_;
+    std::vector<std::uint8_t> edid_;
+};
+
+void reprobe(HotplugMonitor& monitor, std::uint64_t& now)
+{
+    monitor.on_uevent({0, kConnector, 0, 0}, now);
+    now = monitor.next_deadline();
+    monitor.poll(now);
+}
+
+// A replug of the same monitor must not count as a change, whether or not
+// its DisplayInfo is shared through a cache; another monitor must.
+void check_reprobe(EdidCache* edids)
+{
+    EdidProber prober(edids);
+    prober.plug(make_edid(1));
+    int updated = 0;
+    int connected = 0;
+    HotplugMonitor monitor(prober, -1, [&](const ConnectorChange& change) {
+        updated += change.kind == ConnectorChange::Kind::Updated;
+        connected += change.kind == ConnectorChange::Kind::Connected;
+    });
+
+    std::uint64_t now = 1;
+    reprobe(monitor, now);
+    CHECK(connected == 1);
+    const ConnectorInfo* first = monitor.connector(kConnector);
+    CHECK(first && first->display && !first->display->modes.empty());
+
+    for (int i = 0; i < 4; ++i)
+        reprobe(monitor, now);
+    CHECK(monitor.stats().probes == 5);
+    CHECK(monitor.stats().unchanged == 4);
+    CHECK(monitor.stats().errors == 0);
+    CHECK(updated == 0);
+
+    prober.plug(make_edid(2));
+    reprobe(monitor, now);
+    CHECK(updated == 1);
+    CHECK(monitor.stats().unchanged == 4);
+    const ConnectorInfo* swapped = monitor.connector(kConnector);
+    CHECK(swapped && swapped->display && swapped->display->serial == 2);
+}
+
+} // namespace
+
+int main()
+{
+    check_reprobe(nullptr);
+    EdidCache cache;
+    check_reprobe(&cache);
+    return test::result();
+}
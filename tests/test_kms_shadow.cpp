@@ -0,0 +1,178 @@
+#include "dispctrl/atomic_request.hpp"
+#include "dispctrl/commit_queue.hpp"
+#include "dispctrl/kms_device.hpp"
+#include "dispctrl/kms_shadow.hpp"
+#include "dispctrl/virtual_kms.hpp"
+
+#include "check.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace {
+
+using namespace dispctrl;
+
+constexpr std::uint32_t kCrtc = VirtualKms::kFirstCrtc;
+constexpr std::uint32_t kConnector = VirtualKms::kFirstConnector;
+constexpr std::uint32_t kPlane = 50;
+
+// Forwards to a VirtualKms and records what reaches the "ioctls".
+class RecordingKms final : public KmsDevice {
+public:
+    RecordingKms() : kms_(1, VirtualHead{}) {}
+
+    VirtualKms& virtual_kms() noexcept { return kms_; }
+
+    int event_fd() const noexcept override { return kms_.event_fd(); }
+    std::error_code import_dmabuf(int dmabuf_fd, std::uint32_t& handle) noexcept override
+    {
+        return kms_.import_dmabuf(dmabuf_fd, handle);
+    }
+    void close_handle(std::uint32_t handle) noexcept override { kms_.close_handle(handle); }
+    std::error_code add_framebuffer(const FramebufferLayout& layout, std::uint32_t& fb_id) noexcept override
+    {
+        return kms_.add_framebuffer(layout, fb_id);
+    }
+    void remove_framebuffer(std::uint32_t fb_id) noexcept override { kms_.remove_framebuffer(fb_id); }
+    std::error_code page_flip(std::uint32_t crtc_id, std::uint32_t fb_id, std::uint64_t user_data) noexcept override
+    {
+        return kms_.page_flip(crtc_id, fb_id, user_data);
+    }
+    std::error_code atomic_commit(const AtomicRequest& request, std::uint32_t flags,
+                                  std::uint64_t user_data) noexcept override
+    {
+        ++commits;
+        writes += request.props().size();
+        modesets += (flags & commit::AllowModeset) != 0;
+        return kms_.atomic_commit(request, flags, user_data);
+    }
+    std::error_code find_property(std::uint32_t object_id, ObjectType type, std::string_view name,
+                                  std::uint32_t& prop_id) noexcept override
+    {
+        return kms_.find_property(object_id, type, name, prop_id);
+    }
+    std::error_code create_blob(const void* data, std::size_t size, std::uint32_t& blob_id) noexcept override
+    {
+        ++blobs;
+        return kms_.create_blob(data, size, blob_id);
+    }
+    void destroy_blob(std::uint32_t blob_id) noexcept override { kms_.destroy_blob(blob_id); }
+    std::error_code fence_status(int fence_fd, FenceStatus& status) noexcept override
+    {
+        return kms_.fence_status(fence_fd, status);
+    }
+
+    std::uint64_t commits = 0;
+    std::uint64_t writes = 0;
+    std::uint64_t modesets = 0;
+    std::uint64_t blobs = 0;
+
+private:
+    VirtualKms kms_;
+};
+
+struct Props {
+    std::uint32_t mode_id = 0;
+    std::uint32_t active = 0;
+    std::uint32_t connector_crtc = 0;
+    std::uint32_t fb = 0;
+    std::uint32_t plane_crtc = 0;
+    std::uint32_t src_w = 0;
+    std::uint32_t src_h = 0;
+    std::uint32_t crtc_w = 0;
+    std::uint32_t crtc_h = 0;
+};
+
+// An orchestrator's "apply config": the whole state of the head, with a
+// mode set allowed in case it is needed.
+std::error_code apply(CommitQueue& queue, const Props& p, std::uint32_t fb_id, std::uint32_t hdisplay)
+{
+    const std::array<std::uint32_t, 4> mode = {hdisplay, 1080, 60000, 0};
+    if (std::error_code ec = queue.set_blob(kCrtc, p.mode_id, mode.data(), sizeof(mode)))
+        return ec;
+    queue.set(kCrtc, p.active, 1);
+    queue.set(kConnector, p.connector_crtc, kCrtc);
+    queue.set(kPlane, p.fb, fb_id);
+    queue.set(kPlane, p.plane_crtc, kCrtc);
+    queue.set(kPlane, p.src_w, std::uint64_t{hdisplay} << 16);
+    queue.set(kPlane, p.src_h, std::uint64_t{1080} << 16);
+    queue.set(kPlane, p.crtc_w, hdisplay);
+    queue.set(kPlane, p.crtc_h, 1080);
+    queue.allow_modeset();
+    return queue.flush();
+}
+
+void complete(RecordingKms& device, CommitQueue& queue)
+{
+    device.virtual_kms().complete_flips();
+    std::array<KmsEvent, kMaxEventsPerRead> events;
+    std::size_t count = 0;
+    CHECK(!read_kms_events(device.event_fd(), events, count));
+    for (std::size_t i = 0; i < count; ++i)
+        CHECK(!queue.on_flip_complete(events[i]));
+    CHECK(!queue.in_flight());
+}
+
+void check_idempotent_apply()
+{
+    RecordingKms device;
+    KmsShadow shadow;
+    CommitQueue queue(device, kCrtc);
+    queue.set_shadow(&shadow);
+
+    Props p;
+    device.find_property(kCrtc, ObjectType::Crtc, "MODE_ID", p.mode_id);
+    device.find_property(kCrtc, ObjectType::Crtc, "ACTIVE", p.active);
+    device.find_property(kConnector, ObjectType::Connector, "CRTC_ID", p.connector_crtc);
+    device.find_property(kPlane, ObjectType::Plane, "FB_ID", p.fb);
+    device.find_property(kPlane, ObjectType::Plane, "CRTC_ID", p.plane_crtc);
+    device.find_property(kPlane, ObjectType::Plane, "SRC_W", p.src_w);
+    device.find_property(kPlane, ObjectType::Plane, "SRC_H", p.src_h);
+    device.find_property(kPlane, ObjectType::Plane, "CRTC_W", p.crtc_w);
+    device.find_property(kPlane, ObjectType::Plane, "CRTC_H", p.crtc_h);
+
+    CHECK(!apply(queue, p, 1000, 1920));
+    complete(device, queue);
+    CHECK(device.commits == 1);
+    CHECK(device.modesets == 1);
+    CHECK(device.writes == 9);
+    CHECK(device.blobs == 1);
+
+    // The same configuration again: no ioctl at all, so no ALLOW_MODESET,
+    // no property write and no new mode blob.
+    const std::uint64_t skipped = queue.stats().skipped;
+    CHECK(!apply(queue, p, 1000, 1920));
+    CHECK(!queue.in_flight());
+    CHECK(device.commits == 1);
+    CHECK(device.modesets == 1);
+    CHECK(device.writes == 9);
+    CHECK(device.blobs == 1);
+    CHECK(queue.stats().skipped == skipped + 1);
+    CHECK(queue.stats().unchanged == 9);
+
+    // Only what differs is sent.
+    CHECK(!apply(queue, p, 1001, 1920));
+    complete(device, queue);
+    CHECK(device.commits == 2);
+    CHECK(device.modesets == 2);
+    CHECK(device.writes == 10);
+    CHECK(device.blobs == 1);
+
+    // Another mode is a new blob; MODE_ID, SRC_W and CRTC_W change.
+    CHECK(!apply(queue, p, 1001, 2560));
+    complete(device, queue);
+    CHECK(device.commits == 3);
+    CHECK(device.modesets == 3);
+    CHECK(device.blobs == 2);
+    CHECK(device.writes == 10 + 3);
+}
+
+} // namespace
+
+int main()
+{
+    check_idempotent_apply();
+    return test::result();
+}
@@ -0,0 +1,120 @@
+#include "dispctrl/format.hpp"
+#include "dispctrl/pixel_convert.hpp"
+
+#include "check.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace dispctrl;
+
+// A buffer whose last byte is followed by an unmapped page, so a kernel
+// reading past the end of its rows faults instead of passing unnoticed.
+class GuardedBuffer {
+public:
+    explicit GuardedBuffer(std::size_t size)
+    {
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        map_size_ = (size + page - 1) / page * page + page;
+        map_ = static_cast<std::uint8_t*>(
+            ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        ::mprotect(map_ + map_size_ - page, page, PROT_NONE);
+        data_ = map_ + map_size_ - page - size;
+    }
+    ~GuardedBuffer() { ::munmap(map_, map_size_); }
+    GuardedBuffer(const GuardedBuffer&) = delete;
+    GuardedBuffer& operator=(const GuardedBuffer&) = delete;
+
+    std::uint8_t* data() const noexcept { return data_; }
+
+private:
+    std::uint8_t* map_ = nullptr;
+    std::size_t map_size_ = 0;
+    std::uint8_t* data_ = nullptr;
+};
+
+void fill(std::uint8_t* p, std::size_t n, std::mt19937& rng)
+{
+    for (std::size_t i = 0; i < n; ++i)
+        p[i] = static_cast<std::uint8_t>(rng());
+}
+
+// Converts a width x 3 image with tightly packed rows (the last one ending
+// at a guard page) with @p isa, and compares it to the scalar reference.
+void check_format(std::uint32_t fourcc, std::uint32_t width, ConvertIsa isa, std::mt19937& rng)
+{
+    constexpr std::uint32_t kHeight = 3;
+    ConstImage img;
+    img.width = width;
+    img.height = kHeight;
+    img.fourcc = fourcc;
+
+    const std::uint32_t chroma_pitch = (width + 1) / 2 * 2;
+    const std::uint32_t pitch = fourcc == fourcc::NV12 ? width : width * 2;
+    GuardedBuffer luma(std::size_t{pitch} * kHeight);
+    GuardedBuffer chroma(std::size_t{chroma_pitch} * ((kHeight + 1) / 2));
+    fill(luma.data(), std::size_t{pitch} * kHeight, rng);
+    fill(chroma.data(), std::size_t{chroma_pitch} * ((kHeight + 1) / 2), rng);
+    img.planes[0] = luma.data();
+    img.pitches[0] = pitch;
+    if (fourcc == fourcc::NV12) {
+        img.planes[1] = chroma.data();
+        img.pitches[1] = chroma_pitch;
+    }
+
+    const std::uint32_t dst_pitch = width * 4;
+    std::vector<std::uint8_t> ref(std::size_t{dst_pitch} * kHeight, 0);
+    std::vector<std::uint8_t> out(ref.size(), 0x5a);
+    CHECK(!convert_to_xrgb8888(img, ref.data(), dst_pitch, ConvertIsa::Scalar));
+    CHECK(!convert_to_xrgb8888(img, out.data(), dst_pitch, isa));
+    if (std::memcmp(ref.data(), out.data(), ref.size()) != 0) {
+        std::fprintf(stderr, "%s differs from scalar: fourcc %08x width %u\n", to_string(isa), fourcc, width);
+        ++test::failures;
+    }
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(1234);
+    std::vector<std::uint32_t> widths;
+    for (std::uint32_t w = 1; w <= 67; ++w) // every tail length around the 16-pixel blocks
+        widths.push_back(w);
+    for (std::uint32_t w : {127u, 128u, 129u, 1279u, 1280u, 1919u, 1920u, 1921u})
+        widths.push_back(w);
+
+    int paths = 0;
+    for (ConvertIsa isa : {ConvertIsa::Scalar, ConvertIsa::Avx2, ConvertIsa::Neon}) {
+        if (!convert_isa_available(isa))
+            continue;
+        ++paths;
+        for (std::uint32_t w : widths) {
+            check_format(fourcc::NV12, w, isa, rng);
+            check_format(fourcc::RGB565, w, isa, rng);
+            if (w % 2 == 0)
+                check_format(fourcc::YUYV, w, isa, rng);
+        }
+    }
+    std::printf("checked %d kernel set(s), best: %s\n", paths, to_string(best_convert_isa()));
+    CHECK(convert_isa_available(best_convert_isa()));
+
+    // Odd YUYV widths have no V sample for the last pixel.
+    std::uint8_t src[6] = {};
+    std::uint32_t dst[3];
+    ConstImage odd;
+    odd.width = 3;
+    odd.height = 1;
+    odd.fourcc = fourcc::YUYV;
+    odd.planes[0] = src;
+    odd.pitches[0] = sizeof(src);
+    CHECK(convert_to_xrgb8888(odd, reinterpret_cast<std::uint8_t*>(dst), sizeof(dst)) == std::errc::invalid_argument);
+    return test::result();
+}